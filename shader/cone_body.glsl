@@ -0,0 +1,15 @@
+void main()
+{
+	// the rectangle of the view plane covered by this pixel; the view plane
+	// is parallel to the image, so the derivatives are exact
+	vec3 center = s_worldSpacePos.xyz;
+	vec3 halfX = dFdx(s_worldSpacePos.xyz) * 0.5;
+	vec3 halfY = dFdy(s_worldSpacePos.xyz) * 0.5;
+
+	// start at the distance of the coarser level
+	float start = 0.0;
+	if(u_coneScale > 0)
+		start = texelFetch(u_coneDistance, ivec2(gl_FragCoord.xy) / u_coneScale, 0).r;
+
+	vFragColor = vec4(ConeMarch(center, halfX, halfY, start), 0.0, 0.0, 0.0);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+//---------------------------------------------------------------------------
+/// Shading pass of the deferred shading; shades the surfaces stored by the
+/// geometry pass in gbuffer_body.glsl, one texel per pixel.
+//---------------------------------------------------------------------------
+uniform sampler2D u_gbufferPos;
+uniform sampler2D u_gbufferNormal;
+uniform sampler2D u_gbufferColor;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec4 pos = texelFetch(u_gbufferPos, texel, 0);
+	vec4 normal = texelFetch(u_gbufferNormal, texel, 0);
+
+	SampleGlobalResult res;
+	res._inside = pos.w > 0.0;
+	res._normal = normal.xyz;
+	res._color = texelFetch(u_gbufferColor, texel, 0).rgb;
+	res._error = int(normal.w);
+	res._pos = pos.xyz;
+	res._value = 0.0;
+
+	if(HasError(res))
+	{
+		vFragColor = vec4(ErrorToColor(res), 1.0);
+		return;
+	}
+
+	// the background
+	if(res._inside == false)
+	{
+		vFragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	vFragColor = vec4(FinalCompositing(res) * pos.w, 1.0);
+}
@@ -0,0 +1,18 @@
+
+//---------------------------------------------------------------------------
+/// Bakes one voxel of the density volume, see DensityVolume in
+/// densityvolume.h. The field is summed from the metaballs;
+/// u_densityVolumeSize is 0 in this pass.
+//---------------------------------------------------------------------------
+void main()
+{
+	// the view plane is stretched over one slice of the grid
+	MetaballFieldSample fieldSample = MetaballField(s_worldSpacePos.xyz, true);
+
+	// outside of every compact kernel the color is not defined
+	vec3 color = fieldSample._color;
+	if(any(isnan(color)) || any(isinf(color)))
+		color = vec3(0.0);
+
+	vFragColor = vec4(color, fieldSample._value);
+}
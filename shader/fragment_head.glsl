@@ -13,14 +13,20 @@ smooth in vec4 s_worldSpacePos;
 uniform vec3 u_camPos;
 
 //---------------------------------------------------------------------------
-/// noise texture
+/// Noise texture, see noise.h: a 2D slice of depth 1 in the red channel, or
+/// a 3D volume with two noises in the red and green channels.
 //---------------------------------------------------------------------------
-uniform sampler2D u_noiseTexture;
+uniform sampler3D u_noiseTexture;
 
 //---------------------------------------------------------------------------
-/// Turn noise effect on/off.
+/// Turn noise effect on/off. A NOISE definition makes it a constant, see
+/// ShaderPermutation in program.h.
 //---------------------------------------------------------------------------
+#ifdef NOISE
+const int u_noise = NOISE;
+#else
 uniform int u_noise;
+#endif
 
 //---------------------------------------------------------------------------
 /// Animation time value.
@@ -28,9 +34,13 @@ uniform int u_noise;
 uniform float u_animation;
 
 //---------------------------------------------------------------------------
-/// Shading mode.
+/// Shading mode. A SHADING_MODE definition makes it a constant.
 //---------------------------------------------------------------------------
+#ifdef SHADING_MODE
+const int u_shadingMode = SHADING_MODE;
+#else
 uniform int u_shadingMode;
+#endif
 
 //---------------------------------------------------------------------------
 /// Number of metaball influencer
@@ -38,14 +48,146 @@ uniform int u_shadingMode;
 uniform int u_objectCnt;
 
 //---------------------------------------------------------------------------
-/// Positions of metaball influencer
+/// Upper bound of u_objectCnt known at compile time; lets the compiler
+/// unroll the metaball loops.
 //---------------------------------------------------------------------------
-uniform vec3 u_objectPos[18];
+#ifdef OBJECT_BUCKET
+const int OBJECT_LOOP_MAX = OBJECT_BUCKET;
+#else
+const int OBJECT_LOOP_MAX = 0x7fffffff;
+#endif
 
 //---------------------------------------------------------------------------
-/// Colors of metaball influencer
+/// Positions and colors of metaball influencer. Stores the components x, y, z,
+/// r, g and b in separate arrays, u_objectStride elements apart.
 //---------------------------------------------------------------------------
-uniform vec3 u_objectColor[18];
+uniform samplerBuffer u_objectData;
+
+//---------------------------------------------------------------------------
+/// Distance between the components in u_objectData.
+//---------------------------------------------------------------------------
+uniform int u_objectStride;
+
+//---------------------------------------------------------------------------
+/// Box containing every point where the metaball field can reach the
+/// threshold, see GetFieldBounds() in scene.h.
+//---------------------------------------------------------------------------
+uniform vec3 u_boundsMin;
+uniform vec3 u_boundsMax;
+
+// metaball kernels for u_fieldKernel
+const int KERNEL_INVERSE_SQUARE = 0;
+const int KERNEL_WYVILL = 1;
+const int KERNEL_SMOOTH_MIN = 2;
+
+//---------------------------------------------------------------------------
+/// Metaball kernel.
+//---------------------------------------------------------------------------
+uniform int u_fieldKernel;
+
+//---------------------------------------------------------------------------
+/// Radius and scale of the compact Wyvill kernel.
+//---------------------------------------------------------------------------
+uniform float u_kernelRadius;
+uniform float u_kernelScale;
+
+//---------------------------------------------------------------------------
+/// Distance over which the smooth minimum blends two spheres, used with
+/// KERNEL_SMOOTH_MIN.
+//---------------------------------------------------------------------------
+uniform float u_blendDistance;
+
+//---------------------------------------------------------------------------
+/// Uniform grid over the metaballs, used with KERNEL_WYVILL. Each cell stores
+/// the offset and the number of its entries in u_gridIndices.
+//---------------------------------------------------------------------------
+uniform isamplerBuffer u_gridCells;
+uniform isamplerBuffer u_gridIndices;
+uniform vec3 u_gridMin;
+uniform float u_gridCellSize;
+uniform ivec3 u_gridDim;
+
+//---------------------------------------------------------------------------
+/// Per-tile metaball lists of the primary rays, used with KERNEL_WYVILL. The
+/// tiles are stored in u_gridCells after the grid cells, starting at
+/// u_tileOffset; see TileLists in tilelists.h.
+//---------------------------------------------------------------------------
+uniform int u_tileOffset;
+uniform vec3 u_tileOrigin;
+uniform float u_tileSize;
+uniform int u_tileCountX;
+uniform int u_tileCountY;
+
+//---------------------------------------------------------------------------
+/// Tile of the primary ray; -1 to use the grid. Only valid for samples along
+/// the primary ray, see SetPrimaryRayTile().
+//---------------------------------------------------------------------------
+int g_tile = -1;
+
+//---------------------------------------------------------------------------
+/// Barnes-Hut octree over the metaballs, used with KERNEL_INVERSE_SQUARE if
+/// u_openingAngle is larger than 0. Three texels per node in depth-first
+/// order, see OctreeNode in octree.h:
+/// (center, radius), (color sum, count), (next, first, leaf count, unused)
+//---------------------------------------------------------------------------
+uniform samplerBuffer u_octreeNodes;
+uniform isamplerBuffer u_octreeIndices;
+uniform int u_octreeNodeCnt;
+uniform float u_openingAngle;
+
+//---------------------------------------------------------------------------
+/// Set to 1 to find the surface of the exact inverse square field by
+/// bounding the field on ray intervals, see IntervalTrace().
+//---------------------------------------------------------------------------
+uniform int u_intervalRays;
+
+//---------------------------------------------------------------------------
+/// Hit distances of the previous frame, see ReprojectionHistory in
+/// reprojection.h. u_displacement is the largest distance a metaball moved
+/// since then; negative if the hit distances are invalid.
+//---------------------------------------------------------------------------
+uniform sampler2D u_prevHitDistance;
+uniform float u_displacement;
+
+//---------------------------------------------------------------------------
+/// Distances of the cone prepass, see ConeMarch(). u_coneScale is the number
+/// of pixels per texel in each direction; 0 without a prepass.
+//---------------------------------------------------------------------------
+uniform sampler2D u_coneDistance;
+uniform int u_coneScale;
+
+//---------------------------------------------------------------------------
+/// Depth map of the surface seen from the light, see ShadowMap in
+/// shadowmap.h. The dot products of the offset to u_shadowOrigin with the
+/// axes are the texel coordinates; u_shadowMapSize is 0 to march shadow rays.
+//---------------------------------------------------------------------------
+uniform sampler2D u_shadowMap;
+uniform int u_shadowMapSize;
+uniform vec3 u_shadowOrigin;
+uniform vec3 u_shadowAxisU;
+uniform vec3 u_shadowAxisV;
+uniform float u_shadowBias;
+
+//---------------------------------------------------------------------------
+/// Samples inside the field on the march toward the light, see LightVolume
+/// in lightvolume.h. The grid covers the box at u_lightVolumeMin with the
+/// edges u_lightVolumeExtent; u_lightVolumeSize is 0 to march instead.
+//---------------------------------------------------------------------------
+uniform sampler3D u_lightVolume;
+uniform int u_lightVolumeSize;
+uniform vec3 u_lightVolumeMin;
+uniform vec3 u_lightVolumeExtent;
+
+//---------------------------------------------------------------------------
+/// The metaball field baked into a grid, see DensityVolume in
+/// densityvolume.h; rgb is the color, a the field value. The grid covers the
+/// box at u_densityVolumeMin with the edges u_densityVolumeExtent;
+/// u_densityVolumeSize is 0 to sum the metaballs instead.
+//---------------------------------------------------------------------------
+uniform sampler3D u_densityVolume;
+uniform int u_densityVolumeSize;
+uniform vec3 u_densityVolumeMin;
+uniform vec3 u_densityVolumeExtent;
 
 //---------------------------------------------------------------------------
 /// Returns the vector to the light source.
@@ -68,6 +210,16 @@ const float CONST_TAU = 6.2831;
 // threshold value separating "inside" and "outside"
 const float METABALL_THRESHOLD = 20.0;
 
+// maximum absolute value GetRandomFieldValue() adds to the field
+const float NOISE_FIELD_AMPLITUDE = 10.0;
+
+// sphere radius of KERNEL_SMOOTH_MIN; the iso-surface radius of an isolated
+// metaball
+const float SDF_SPHERE_RADIUS = 0.2236068;
+
+// distance below which sphere tracing counts as a surface hit
+const float SDF_HIT_DISTANCE = 0.001;
+
 //---------------------------------------------------------------------------
 /// Structure storing data from sampling space with SampleSpace().
 //---------------------------------------------------------------------------
@@ -78,6 +230,7 @@ struct SampleGlobalResult
 	vec3 _color;	// color
 	int _error;		// error code; 
 	vec3 _pos;		// world space position
+	float _value;	// field value; also set if not inside.
 };
 
 
@@ -110,30 +263,123 @@ float GetAnimation11(float timeFactor)
 /// METABALLS
 // ----------------------------------------------------------------------
 
-float GetRandomFieldValue(vec3 worldPos)
+//---------------------------------------------------------------------------
+/// Returns the texel coordinate of the mirrored repeat wrap mode.
+//---------------------------------------------------------------------------
+ivec3 MirroredRepeat(ivec3 i, ivec3 size)
 {
+	// % is undefined for negative operands
+	ivec3 period = size * 2;
+	ivec3 m = i - period * ivec3(floor(vec3(i) / vec3(period)));
+	return ivec3(m.x < size.x ? m.x : period.x - 1 - m.x,
+				 m.y < size.y ? m.y : period.y - 1 - m.y,
+				 m.z < size.z ? m.z : period.z - 1 - m.z);
+}
+
+//---------------------------------------------------------------------------
+/// Derivative of the trilinear filtered noise texture.
+/// @param[in]	uvw		Texture coordinate.
+/// @param[in]	blend	Weight of the green channel.
+/// @return				Derivatives with respect to u, v and w.
+//---------------------------------------------------------------------------
+vec3 NoiseTextureGradient(vec3 uvw, float blend)
+{
+	ivec3 size = textureSize(u_noiseTexture, 0);
+	vec3 texel = uvw * vec3(size) - 0.5;
+	vec3 f = floor(texel);
+	vec3 t = texel - f;
+
+	ivec3 i0 = MirroredRepeat(ivec3(f), size);
+	ivec3 i1 = MirroredRepeat(ivec3(f) + 1, size);
+
+	float c[8];
+	for(int k = 0; k < 8; ++k)
+	{
+		ivec3 i = ivec3((k & 1) == 0 ? i0.x : i1.x, (k & 2) == 0 ? i0.y : i1.y, (k & 4) == 0 ? i0.z : i1.z);
+		vec2 rg = texelFetch(u_noiseTexture, i, 0).rg;
+		c[k] = mix(rg.r, rg.g, blend);
+	}
+
+	float bottom0 = mix(c[0], c[1], t.x);
+	float top0 = mix(c[2], c[3], t.x);
+	float bottom1 = mix(c[4], c[5], t.x);
+	float top1 = mix(c[6], c[7], t.x);
+
+	float du = mix(mix(c[1] - c[0], c[3] - c[2], t.y), mix(c[5] - c[4], c[7] - c[6], t.y), t.z);
+	float dv = mix(top0 - bottom0, top1 - bottom1, t.z);
+	float dw = mix(bottom1, top1, t.y) - mix(bottom0, top0, t.y);
+
+	return vec3(du, dv, dw) * vec3(size);
+}
+
+//---------------------------------------------------------------------------
+/// Noise field value.
+/// @param[in]	worldPos	World space position.
+/// @param[in]	gradient	Set to true to calculate the gradient.
+/// @param[out]	grad		Gradient of the noise field; zero if gradient is false.
+/// @return					Noise field value.
+//---------------------------------------------------------------------------
+float GetRandomFieldValue(vec3 worldPos, bool gradient, out vec3 grad)
+{
+	grad = vec3(0.0);
+
+	if(textureSize(u_noiseTexture, 0).z > 1)
+	{
+		// the volume spans the box [-2, 2]^3 and drifts along z; the
+		// animation blends between its two noises
+		vec3 uvw = (worldPos + vec3(2.0)) * 0.25 + vec3(0.0, 0.0, u_animation * 0.002);
+		float blend = GetAnimation01(0.03);
+
+		vec2 rg = texture(u_noiseTexture, uvw).rg;
+		float value = mix(rg.r, rg.g, blend);
+
+		// chain rule: duvw/dpos = 0.25
+		if(gradient == true)
+			grad = NoiseTextureGradient(uvw, blend) * 0.25 * 20.0;
+
+		return (value * 20.0) - 10.0;
+	}
+
 	float z = (worldPos.z + 2.0) * 0.5;
 	float y = (worldPos.y + 1.0) * 0.5;
 	float x = (worldPos.x + 2.0) * 0.25;
 
+	float animY = GetAnimation01(00.02);
+	float animX = GetAnimation01Cos(0.03);
+
 	//z = z * GetAnimation01(0.1);
-	y = (y + z) * .5 * GetAnimation01(00.02);
-	x = (x + z) * .5 * GetAnimation01Cos(0.03);
+	y = (y + z) * .5 * animY;
+	x = (x + z) * .5 * animX;
 	
-	vec4 value = texture(u_noiseTexture, vec2(x,y));
+	// the 2D slice is sampled at its center
+	vec4 value = texture(u_noiseTexture, vec3(x, y, 0.5));
 	float res = ((value.x) * 20.0) - 10.0;
+
+	if(gradient == true)
+	{
+		// chain rule: dx/dpos = (0.125, 0, 0.25) * animX,
+		// dy/dpos = (0, 0.25, 0.25) * animY
+		vec2 uvGrad = NoiseTextureGradient(vec3(x, y, 0.5), 0.0).xy * vec2(animX, animY);
+		grad = vec3(0.125 * uvGrad.x, 0.25 * uvGrad.y, 0.25 * (uvGrad.x + uvGrad.y)) * 20.0;
+	}
 	
 	return res;
 }
 
 vec3 GetMetaballPos(int i)
 {
-	return u_objectPos[i];
+	float x = texelFetch(u_objectData, i).x;
+	float y = texelFetch(u_objectData, i + u_objectStride).x;
+	float z = texelFetch(u_objectData, i + u_objectStride * 2).x;
+	return vec3(x, y, z);
 }
 
 vec3 GetMetaballColor(int i)
 {
-	return u_objectColor[i];
+	float r = texelFetch(u_objectData, i + u_objectStride * 3).x;
+	float g = texelFetch(u_objectData, i + u_objectStride * 4).x;
+	float b = texelFetch(u_objectData, i + u_objectStride * 5).x;
+	return vec3(r, g, b);
 }
 
 //---------------------------------------------------------------------------
@@ -165,63 +411,326 @@ struct MetaballFieldSample
 {
 	float _value;
 	vec3 _color;
+	vec3 _gradient;	// only calculated together with the color
 };
 
 //---------------------------------------------------------------------------
-/// Samples the world metaball field.
+/// Samples the compact metaball field using the tile of the primary ray or
+/// the grid cell containing the position.
 /// @param[in]	pos		World space position.
-/// @param[in]	color	Set to true to calculate the interpolate color.
-/// @return				MetaballFieldSample object with the result value and optional color.
+/// @param[in]	color	Set to true to calculate the color sum.
+/// @return				MetaballFieldSample object with the result value and color sum.
 //---------------------------------------------------------------------------
-MetaballFieldSample MetaballField(vec3 pos, bool color)
+MetaballFieldSample CompactMetaballField(vec3 pos, bool color)
 {
 	MetaballFieldSample fieldSample;
 	fieldSample._value = 0.0;
 	fieldSample._color = vec3(0.0);
+	fieldSample._gradient = vec3(0.0);
+
+	int cell = u_tileOffset + g_tile;
 
-	for(int i = 0; i < u_objectCnt; ++i)
+	// primary rays only need the metaballs of their tile
+	if(g_tile < 0)
 	{
-		vec3 metaballCenter = GetMetaballPos(i);
-		fieldSample._value += MetaballFunction(pos, metaballCenter);
+		ivec3 c = ivec3(floor((pos - u_gridMin) / u_gridCellSize));
+
+		if(any(lessThan(c, ivec3(0))) || any(greaterThanEqual(c, u_gridDim)))
+			return fieldSample;
+
+		cell = (c.z * u_gridDim.y + c.y) * u_gridDim.x + c.x;
+	}
+
+	ivec2 range = texelFetch(u_gridCells, cell).xy;
+
+	for(int k = 0; k < range.y; ++k)
+	{
+		int i = texelFetch(u_gridIndices, range.x + k).x;
+		vec3 d = pos - GetMetaballPos(i);
+		float f = 1.0 - dot(d, d) / (u_kernelRadius * u_kernelRadius);
+
+		if(f <= 0.0)
+			continue;
 
+		float value = u_kernelScale * f * f * f;
+		fieldSample._value += value;
+
+		// the kernel value also weights the color
 		if(color == true)
 		{
-			vec3 metaballColor = GetMetaballColor(i);
+			fieldSample._color += GetMetaballColor(i) * value;
+			fieldSample._gradient += d * (-6.0 * u_kernelScale * f * f / (u_kernelRadius * u_kernelRadius));
+		}
+	}
+
+	return fieldSample;
+}
+
+//---------------------------------------------------------------------------
+/// Samples the inverse square metaball field with the Barnes-Hut
+/// approximation; distant octree nodes are evaluated as a single metaball.
+/// @param[in]	pos		World space position.
+/// @param[in]	color	Set to true to calculate the color sum.
+/// @return				MetaballFieldSample object with the result value and color sum.
+//---------------------------------------------------------------------------
+MetaballFieldSample TreeMetaballField(vec3 pos, bool color)
+{
+	MetaballFieldSample fieldSample;
+	fieldSample._value = 0.0;
+	fieldSample._color = vec3(0.0);
+	fieldSample._gradient = vec3(0.0);
+
+	// stackless traversal; _next skips the subtree of a node
+	int i = 0;
+	while(i < u_octreeNodeCnt)
+	{
+		vec4 centerRadius = texelFetch(u_octreeNodes, i * 3);
+		vec4 links = texelFetch(u_octreeNodes, i * 3 + 2);
+
+		vec3 d = pos - centerRadius.xyz;
+		float dist = length(d);
+
+		// far node: a single metaball at the mean position
+		if(centerRadius.w < u_openingAngle * dist)
+		{
+			vec4 colorCount = texelFetch(u_octreeNodes, i * 3 + 1);
+			float invSq = 1.0 / dot(d, d);
+			fieldSample._value += colorCount.w * invSq;
+
+			if(color == true)
+			{
+				fieldSample._color += colorCount.xyz / dist;
+				fieldSample._gradient += d * (-2.0 * colorCount.w * invSq * invSq);
+			}
+
+			i = int(links.x);
+			continue;
+		}
+
+		// near inner node: visit the children
+		if(links.z == 0.0)
+		{
+			++i;
+			continue;
+		}
 
-			float dist = length(pos - metaballCenter);
-			float factor = 1.0/dist;
+		// near leaf: evaluate the metaballs
+		int first = int(links.y);
+		int last = first + int(links.z);
 
-			fieldSample._color += (metaballColor * factor);
+		for(int k = first; k < last; ++k)
+		{
+			int index = texelFetch(u_octreeIndices, k).x;
+			vec3 e = pos - GetMetaballPos(index);
+			float invSq = 1.0 / dot(e, e);
+			fieldSample._value += invSq;
+
+			if(color == true)
+			{
+				fieldSample._color += GetMetaballColor(index) * sqrt(invSq);
+				fieldSample._gradient += e * (-2.0 * invSq * invSq);
+			}
 		}
+
+		i = int(links.x);
 	}
 
-	
-	if(u_noise == 1)
-		fieldSample._value += GetRandomFieldValue(pos);
+	return fieldSample;
+}
+
+//---------------------------------------------------------------------------
+/// Signed distance to the metaball spheres, joined with the polynomial
+/// smooth minimum. The smooth minimum keeps the distance bound of the
+/// spheres, so the field can be sphere traced.
+/// @param[in]	pos		World space position.
+/// @param[in]	color	Set to true to blend the colors and the gradient.
+/// @return				MetaballFieldSample object with the distance, color and gradient.
+//---------------------------------------------------------------------------
+MetaballFieldSample SmoothMinField(vec3 pos, bool color)
+{
+	MetaballFieldSample fieldSample;
+	fieldSample._value = 1e10;	// farther than any surface of the scene
+	fieldSample._color = vec3(0.0);
+	fieldSample._gradient = vec3(0.0);
+
+	float k = u_blendDistance;
+
+	for(int i = 0; i < u_objectCnt && i < OBJECT_LOOP_MAX; ++i)
+	{
+		vec3 e = pos - GetMetaballPos(i);
+		float len = length(e);
+		float dist = len - SDF_SPHERE_RADIUS;
+
+		// https://iquilezles.org/articles/smin/
+		float h = clamp(0.5 + 0.5 * (fieldSample._value - dist) / k, 0.0, 1.0);
+		float g = 1.0 - h;
+
+		// not mix(), which may evaluate x + (y - x) h and lose the distance
+		// against the initial value
+		fieldSample._value = fieldSample._value * g + dist * h - k * h * g;
+
+		// the derivatives of h cancel out
+		if(color == true)
+		{
+			fieldSample._color = fieldSample._color * g + GetMetaballColor(i) * h;
+			fieldSample._gradient = fieldSample._gradient * g + (e / len) * h;
+		}
+	}
+
+	return fieldSample;
+}
+
+//---------------------------------------------------------------------------
+/// Sets g_tile for a primary ray; call with -1 before sampling in other
+/// directions.
+/// @param[in]	viewPlanePos	Start position of the primary ray on the view plane.
+//---------------------------------------------------------------------------
+void SetPrimaryRayTile(vec3 viewPlanePos)
+{
+	g_tile = -1;
+
+	if(u_fieldKernel != KERNEL_WYVILL)
+		return;
+
+	ivec2 t = ivec2(floor((viewPlanePos.xy - u_tileOrigin.xy) / u_tileSize));
+
+	if(t.x >= 0 && t.y >= 0 && t.x < u_tileCountX && t.y < u_tileCountY)
+		g_tile = t.y * u_tileCountX + t.x;
+}
+
+//---------------------------------------------------------------------------
+/// Samples the density volume like DensityVolume::Sample().
+/// @param[in]	pos		World space position.
+/// @param[in]	color	Set to true to calculate the color and the gradient.
+/// @return				MetaballFieldSample object with the interpolated value.
+//---------------------------------------------------------------------------
+MetaballFieldSample DensityVolumeField(vec3 pos, bool color)
+{
+	MetaballFieldSample fieldSample;
+
+	vec4 voxel = texture(u_densityVolume, (pos - u_densityVolumeMin) / u_densityVolumeExtent);
+	fieldSample._value = voxel.a;
+	fieldSample._color = voxel.rgb;
+	fieldSample._gradient = vec3(0.0);
 
 	if(color == true)
-		fieldSample._color = normalize(fieldSample._color);
-	
+	{
+		// central differences one voxel apart
+		vec3 h = u_densityVolumeExtent / float(u_densityVolumeSize);
+
+		for(int a = 0; a < 3; ++a)
+		{
+			vec3 offset = vec3(0.0);
+			offset[a] = h[a];
+
+			float forward = texture(u_densityVolume, (pos + offset - u_densityVolumeMin) / u_densityVolumeExtent).a;
+			float backward = texture(u_densityVolume, (pos - offset - u_densityVolumeMin) / u_densityVolumeExtent).a;
+			fieldSample._gradient[a] = (forward - backward) / (2.0 * h[a]);
+		}
+
+		float len = length(fieldSample._color);
+		if(len > 0.0)
+			fieldSample._color /= len;
+	}
+
 	return fieldSample;
 }
 
 //---------------------------------------------------------------------------
-/// Calculates a normal vector for the given position the the metaball field.
+/// Number of voxels per edge of a brick of the density volume, see
+/// DENSITY_BRICK_SIZE in densityvolume.h.
+//---------------------------------------------------------------------------
+const int DENSITY_BRICK_SIZE = 8;
+
+//---------------------------------------------------------------------------
+/// Returns how far a ray stays in an empty brick of the density volume like
+/// DensityVolume::GetEmptySpan(); the red channel of its voxels is negative.
+/// @param[in]	pos		Ray origin in world space.
+/// @param[in]	dir		Ray direction; the unit of the result.
+/// @return				The ray parameter where the ray leaves the brick; 0 if
+///						the brick is stored or outside of the grid.
+//---------------------------------------------------------------------------
+float DensityVolumeEmptySpan(vec3 pos, vec3 dir)
+{
+	vec3 voxelSize = u_densityVolumeExtent / float(u_densityVolumeSize);
+	ivec3 voxel = ivec3(floor((pos - u_densityVolumeMin) / voxelSize));
+
+	if(any(lessThan(voxel, ivec3(0))) || any(greaterThanEqual(voxel, ivec3(u_densityVolumeSize))))
+		return 0.0;
+
+	if(texelFetch(u_densityVolume, voxel, 0).r >= 0.0)
+		return 0.0;
+
+	// exit of the ray from the box of the brick
+	vec3 lo = u_densityVolumeMin + vec3(voxel / DENSITY_BRICK_SIZE * DENSITY_BRICK_SIZE) * voxelSize;
+	vec3 hi = lo + voxelSize * float(DENSITY_BRICK_SIZE);
+	vec3 exit = max((lo - pos) / dir, (hi - pos) / dir);
+
+	return max(min(min(exit.x, exit.y), exit.z), 0.0);
+}
+
+//---------------------------------------------------------------------------
+/// Samples the world metaball field.
 /// @param[in]	pos		World space position.
-/// @param[in]	value	The value at the world space position.
-/// @return				The normal vector.
+/// @param[in]	color	Set to true to calculate the interpolate color.
+/// @return				MetaballFieldSample object with the result value and optional color.
 //---------------------------------------------------------------------------
-vec3 MetaballNormal(vec3 pos, float value)
+MetaballFieldSample MetaballField(vec3 pos, bool color)
 {
-	float d = -0.01;
-	float ff = value;
-	float fx = MetaballField(vec3(pos.x + d, pos.y, pos.z), false)._value;
-	float fy = MetaballField(vec3(pos.x, pos.y + d, pos.z), false)._value;
-	float fz = MetaballField(vec3(pos.x, pos.y, pos.z + d), false)._value;
+	MetaballFieldSample fieldSample;
+	fieldSample._value = 0.0;
+	fieldSample._color = vec3(0.0);
+	fieldSample._gradient = vec3(0.0);
+
+	if(u_densityVolumeSize > 0)
+		return DensityVolumeField(pos, color);
+
+	if(u_fieldKernel == KERNEL_WYVILL)
+	{
+		fieldSample = CompactMetaballField(pos, color);
+	}
+	else if(u_fieldKernel == KERNEL_SMOOTH_MIN)
+	{
+		fieldSample = SmoothMinField(pos, color);
+	}
+	else if(u_openingAngle > 0.0)
+	{
+		fieldSample = TreeMetaballField(pos, color);
+	}
+	else
+	{
+		for(int i = 0; i < u_objectCnt && i < OBJECT_LOOP_MAX; ++i)
+		{
+			vec3 metaballCenter = GetMetaballPos(i);
+			float value = MetaballFunction(pos, metaballCenter);
+			fieldSample._value += value;
 
-	vec3 normal = normalize(vec3(fx - ff, fy - ff, fz - ff));
+			if(color == true)
+			{
+				vec3 metaballColor = GetMetaballColor(i);
 
-	return normal;
+				float factor = sqrt(value);
+
+				fieldSample._color += (metaballColor * factor);
+
+				// d/dpos 1/|pos - center|^2 = -2 (pos - center) / |pos - center|^4
+				fieldSample._gradient += (pos - metaballCenter) * (-2.0 * value * value);
+			}
+		}
+	}
+	
+	// the noise would break the distance bound of the smooth minimum
+	if(u_noise == 1 && u_fieldKernel != KERNEL_SMOOTH_MIN)
+	{
+		vec3 noiseGradient;
+		fieldSample._value += GetRandomFieldValue(pos, color, noiseGradient);
+		fieldSample._gradient += noiseGradient;
+	}
+
+	if(color == true)
+		fieldSample._color = normalize(fieldSample._color);
+	
+	return fieldSample;
 }
 
 //---------------------------------------------------------------------------
@@ -236,13 +745,18 @@ SampleGlobalResult SampleMetaballMode(vec3 pos, bool fastMode)
 	res._inside = false;
 
 	MetaballFieldSample fieldSample = MetaballField(pos, !fastMode);
+	res._value = fieldSample._value;
+
+	bool distanceField = u_fieldKernel == KERNEL_SMOOTH_MIN;
+	bool inside = distanceField ? fieldSample._value <= SDF_HIT_DISTANCE : fieldSample._value >= METABALL_THRESHOLD;
 	
-	if(fieldSample._value >= METABALL_THRESHOLD)
+	if(inside)
 	{
 		vec3 normal = vec3(0);
 
+		// the field decreases towards the outside, the distance increases
 		if(fastMode == false)
-			normal = MetaballNormal(pos, fieldSample._value);
+			normal = normalize(distanceField ? fieldSample._gradient : -fieldSample._gradient);
 
 		res._inside = true;
 		res._normal = normal;
@@ -266,67 +780,453 @@ SampleGlobalResult SampleGlobalSpace(vec3 worldPos, bool fastMode)
 
 
 // ----------------------------------------------------------------------
-/// Samples space until a surface was found.
+/// Intersects a ray with the field bounds.
+/// @param[in]	start		The ray origin.
+/// @param[in]	dir			The ray direction; need not be normalized.
+/// @param[out]	interval	Ray parameters where the ray enters and leaves the bounds.
+/// @return					False if the ray misses the bounds.
+// ----------------------------------------------------------------------
+bool ClipToBounds(vec3 start, vec3 dir, out vec2 interval)
+{
+	// avoid the division by zero of axis parallel rays
+	vec3 d = mix(dir, vec3(1e-8), lessThan(abs(dir), vec3(1e-8)));
+
+	vec3 t0 = (u_boundsMin - start) / d;
+	vec3 t1 = (u_boundsMax - start) / d;
+	vec3 tMin = min(t0, t1);
+	vec3 tMax = max(t0, t1);
+
+	interval.x = max(max(tMin.x, tMin.y), max(tMin.z, 0.0));
+	interval.y = min(min(tMax.x, tMax.y), tMax.z);
+
+	return interval.x <= interval.y;
+}
+
+// ----------------------------------------------------------------------
+/// Number of field evaluations refining a surface hit in SampleToSurface().
+// ----------------------------------------------------------------------
+const int SURFACE_REFINE_STEPS = 6;
+
+// ----------------------------------------------------------------------
+/// Maximum number of sphere tracing steps with KERNEL_SMOOTH_MIN.
+// ----------------------------------------------------------------------
+const int SPHERE_TRACE_STEPS = 64;
+
+// ----------------------------------------------------------------------
+/// Sphere traces the distance field of KERNEL_SMOOTH_MIN; each step
+/// advances by the distance to the closest surface.
+/// @param[in]	startPos	Ray origin.
+/// @param[in]	sampleStep	Ray direction; the unit of the ray parameters.
+/// @param[in]	tEnter		Ray parameter where the tracing starts.
+/// @param[in]	tEnd		Ray parameter where the tracing stops.
+/// @return					A SampleGlobalResult object. res._inside is false if no surface was found.
+// ----------------------------------------------------------------------
+SampleGlobalResult SphereTrace(vec3 startPos, vec3 sampleStep, float tEnter, float tEnd)
+{
+	SampleGlobalResult res;
+	res._inside = false;
+	res._value = 0.0;
+
+	float stepLength = length(sampleStep);
+	float t = tEnter;
+
+	for(int i = 0; i < SPHERE_TRACE_STEPS && t <= tEnd; ++i)
+	{
+		vec3 pos = startPos + sampleStep * t;
+
+		res = SampleGlobalSpace(pos, true);
+		if(res._inside)
+			return SampleGlobalSpace(pos, false);
+
+		t += res._value / stepLength;
+	}
+
+	return res;
+}
+
+// ----------------------------------------------------------------------
+/// Refines the bracket [outside, inside] of a surface hit with the Illinois
+/// variant of the false position method.
+/// @param[in]	outsidePos		Position outside of the surface.
+/// @param[in]	insidePos		Position inside of the surface.
+/// @param[in]	outsideField	Field value at outsidePos.
+/// @param[in]	insideField		Field value at insidePos.
+/// @return						The full sample at the inside end.
+// ----------------------------------------------------------------------
+SampleGlobalResult RefineSurface(vec3 outsidePos, vec3 insidePos, float outsideField, float insideField)
+{
+	float outsideValue = outsideField - METABALL_THRESHOLD;
+	float insideValue = insideField - METABALL_THRESHOLD;
+	int side = 0;
+
+	for(int i = 0; i < SURFACE_REFINE_STEPS; ++i)
+	{
+		float t = outsideValue / (outsideValue - insideValue);
+		vec3 pos = mix(outsidePos, insidePos, t);
+		float value = SampleGlobalSpace(pos, true)._value - METABALL_THRESHOLD;
+
+		if(value >= 0.0)
+		{
+			insidePos = pos;
+			insideValue = value;
+			if(side == 1)
+				outsideValue *= 0.5;
+			side = 1;
+		}
+		else
+		{
+			outsidePos = pos;
+			outsideValue = value;
+			if(side == -1)
+				insideValue *= 0.5;
+			side = -1;
+		}
+	}
+
+	return SampleGlobalSpace(insidePos, false);
+}
+
+// ----------------------------------------------------------------------
+/// Maximum number of interval tests and samples of one ray with
+/// u_intervalRays.
+// ----------------------------------------------------------------------
+const int INTERVAL_TRACE_STEPS = 256;
+
+// ----------------------------------------------------------------------
+/// Width in sample steps below which intervals are sampled instead of split.
+// ----------------------------------------------------------------------
+const float INTERVAL_MIN_WIDTH = 1.0;
+
+// ----------------------------------------------------------------------
+/// Upper bound of the exact metaball field on a ray interval. Along the ray
+/// each inverse square term is 1 / (a t^2 + b t + c); its maximum on the
+/// interval is at the point closest to the metaball, as for the Wyvill
+/// kernel. With a radius the bound holds for the capsule around the interval.
+/// @param[in]	startPos	Ray origin.
+/// @param[in]	sampleStep	Ray direction; the unit of the ray parameters.
+/// @param[in]	t0			Start of the interval.
+/// @param[in]	t1			End of the interval.
+/// @param[in]	radius		Capsule radius in world units; 0 for the ray.
+/// @return					The upper bound, including the noise amplitude.
+// ----------------------------------------------------------------------
+float FieldUpperBound(vec3 startPos, vec3 sampleStep, float t0, float t1, float radius)
+{
+	vec3 a = startPos + sampleStep * t0;
+	vec3 segment = sampleStep * (t1 - t0);
+	float invSq = 1.0 / dot(segment, segment);
+	float invRadiusSq = 1.0 / (u_kernelRadius * u_kernelRadius);
+
+	float bound = 0.0;
+
+	for(int i = 0; i < u_objectCnt && i < OBJECT_LOOP_MAX; ++i)
+	{
+		vec3 e = GetMetaballPos(i) - a;
+		float s = clamp(dot(e, segment) * invSq, 0.0, 1.0);
+		vec3 d = e - segment * s;
+
+		float distSq = dot(d, d);
+		if(radius > 0.0)
+		{
+			float dist = max(sqrt(distSq) - radius, 0.0);
+			distSq = dist * dist;
+		}
+
+		if(u_fieldKernel == KERNEL_WYVILL)
+		{
+			float f = 1.0 - distSq * invRadiusSq;
+			if(f > 0.0)
+				bound += u_kernelScale * f * f * f;
+		}
+		else
+			bound += 1.0 / distSq;
+	}
+
+	if(u_noise == 1)
+		bound += NOISE_FIELD_AMPLITUDE;
+
+	return bound;
+}
+
+// ----------------------------------------------------------------------
+/// Finds the first surface hit of the exact inverse square field. Intervals
+/// whose field bound stays below METABALL_THRESHOLD are skipped and grow,
+/// others are halved down to INTERVAL_MIN_WIDTH and sampled at their end.
+/// Features thicker than INTERVAL_MIN_WIDTH sample steps are never missed.
+/// Stops after INTERVAL_TRACE_STEPS, e.g. in the wide undecided band of the
+/// noise; the caller marches the rest of the ray.
+/// @param[in]		startPos	Ray origin.
+/// @param[in]		sampleStep	Ray direction; the unit of the ray parameters.
+/// @param[in,out]	t			Ray parameter where the search starts; where it stopped, outside the surface, if no surface was found.
+/// @param[in]		tEnd		Ray parameter where the search stops.
+/// @return						A SampleGlobalResult object. res._inside is false if no surface was found before t.
+// ----------------------------------------------------------------------
+SampleGlobalResult IntervalTrace(vec3 startPos, vec3 sampleStep, inout float t, float tEnd)
+{
+	SampleGlobalResult res;
+	res._inside = false;
+	res._value = 0.0;
+
+	if(SampleGlobalSpace(startPos + sampleStep * t, true)._inside)
+		return SampleGlobalSpace(startPos + sampleStep * t, false);
+
+	// the big step of the linear search
+	float width = 10.0;
+
+	for(int i = 0; i < INTERVAL_TRACE_STEPS && t < tEnd; ++i)
+	{
+		float t1 = min(t + width, tEnd);
+
+		if(FieldUpperBound(startPos, sampleStep, t, t1, 0.0) < METABALL_THRESHOLD)
+		{
+			t = t1;
+			width *= 2.0;
+			continue;
+		}
+
+		if(t1 - t > INTERVAL_MIN_WIDTH)
+		{
+			width = (t1 - t) * 0.5;
+			continue;
+		}
+
+		vec3 outsidePos = startPos + sampleStep * t;
+		vec3 insidePos = startPos + sampleStep * t1;
+		res = SampleGlobalSpace(insidePos, true);
+
+		// the start of the interval is outside but not necessarily sampled
+		if(res._inside)
+			return RefineSurface(outsidePos, insidePos, SampleGlobalSpace(outsidePos, true)._value, res._value);
+
+		t = t1;
+		width = INTERVAL_MIN_WIDTH * 2.0;
+	}
+
+	res._inside = false;
+	return res;
+}
+
+// ----------------------------------------------------------------------
+/// Samples space until a surface was found. Steps at ten times sampleStep
+/// inside the field bounds; the hit is refined between the last two samples.
+/// The distance field of KERNEL_SMOOTH_MIN is sphere traced instead, the
+/// exact inverse square field is bounded on intervals if u_intervalRays is 1.
 /// @param[in]	startPos	Sampling start position.
 /// @param[in]	sampleStep	A sampling step.
 /// @return					A SampleGlobalResult object. res._inside is false if no surface was found.
 // ----------------------------------------------------------------------
 SampleGlobalResult SampleToSurface(vec3 startPos, vec3 sampleStep, int count)
 {
+	SampleGlobalResult res;
+	res._inside = false;
+	res._value = 0.0;
+
+	// in units of sampleStep
+	vec2 interval;
+	if(ClipToBounds(startPos, sampleStep, interval) == false)
+		return res;
+
+	if(u_fieldKernel == KERNEL_SMOOTH_MIN)
+		return SphereTrace(startPos, sampleStep, interval.x, min(interval.y, float(count)));
+
+	float tEnd = min(interval.y, float(count));
+
+	// the bound only holds for the exact field
+	if(u_intervalRays == 1 && u_fieldKernel == KERNEL_INVERSE_SQUARE && u_openingAngle <= 0.0 && u_densityVolumeSize == 0)
+	{
+		res = IntervalTrace(startPos, sampleStep, interval.x, tEnd);
+
+		// out of steps; the linear search continues where it stopped
+		if(res._inside || interval.x >= tEnd)
+			return res;
+	}
+
 	vec3 bigStep = sampleStep * 10.0;
-	int bigCount = int(float(count) * .1);
+	int bigCount = int(ceil((tEnd - interval.x) * .1));
+	vec3 clipStart = startPos + sampleStep * interval.x;
 
-	vec3 currentPos = startPos + bigStep;
+	vec3 lastPos = clipStart;
+	vec3 currentPos = clipStart + bigStep;
 
-	SampleGlobalResult res;
+	SampleGlobalResult lastRes = res;
 
 	for(int i = 0; i < bigCount; ++i)
 	{
+		lastRes = res;
 		res = SampleGlobalSpace(currentPos, true);
 		if(res._inside)
 		{
 			break;
 		}
 
+		lastPos = currentPos;
 		currentPos = currentPos + bigStep;
+
+		// empty bricks of the density volume hold no surface
+		if(u_densityVolumeSize > 0)
+		{
+			float span = DensityVolumeEmptySpan(lastPos, sampleStep) * 0.1;
+			if(span >= 2.0)
+			{
+				int skip = int(span);
+				currentPos = lastPos + bigStep * float(skip);
+				i += skip - 1;
+			}
+		}
 	}
 
 	if(res._inside == false)
 		return res;
 
-	// refine in the other direction
+	// the start position was not sampled
+	if(lastPos == clipStart)
+	{
+		lastRes = SampleGlobalSpace(clipStart, true);
+		if(lastRes._inside)
+			return SampleGlobalSpace(clipStart, false);
+	}
+
+	return RefineSurface(lastPos, currentPos, lastRes._value, res._value);
+}
+
+// ----------------------------------------------------------------------
+/// Distance in world units a reprojected ray starts in front of the previous
+/// hit, in addition to the center displacement.
+// ----------------------------------------------------------------------
+const float REPROJECTION_MARGIN = 0.1;
 
-	vec3 foundPosition = currentPos;
+// ----------------------------------------------------------------------
+/// Returns where a primary ray can start, given the hit of the previous frame.
+/// The field is checked with FieldUpperBound() up to the start. A previous
+/// miss skips the whole ray if the bound stays below the threshold. The
+/// distance field is always marched in full: u_displacement only bounds its
+/// change at the previous hit, not along the skipped segment.
+/// @param[in]	startPos	Ray origin on the view plane.
+/// @param[in]	sampleStep	Ray direction; the unit of the result.
+/// @param[in]	count		The number of steps of the ray.
+/// @param[in]	previousHit	Distance of the previous hit to the view plane; negative for none.
+/// @return					The ray parameter to start at; 0 for a full march, count if there is no hit.
+// ----------------------------------------------------------------------
+float GetRayStart(vec3 startPos, vec3 sampleStep, int count, float previousHit)
+{
+	if(u_displacement < 0.0)
+		return 0.0;
 
-	vec3 reverseDirection = -sampleStep;
+	// the bound does not hold for the approximation and the baked field
+	bool bounded = u_densityVolumeSize == 0 && (u_fieldKernel == KERNEL_WYVILL || (u_fieldKernel == KERNEL_INVERSE_SQUARE && u_openingAngle <= 0.0));
 
-	SampleGlobalResult lastResut = res;
-	
+	if(previousHit < 0.0)
+	{
+		if(bounded && FieldUpperBound(startPos, sampleStep, 0.0, float(count), 0.0) < METABALL_THRESHOLD)
+			return float(count);
+
+		return 0.0;
+	}
 
-	currentPos = currentPos + reverseDirection;
+	float startDistance = previousHit - u_displacement - REPROJECTION_MARGIN;
+	if(startDistance <= 0.0)
+		return 0.0;
 
-	bool foundNewPoint = false;
+	float t = startDistance / length(sampleStep);
+
+	if(bounded && FieldUpperBound(startPos, sampleStep, 0.0, t, 0.0) < METABALL_THRESHOLD)
+		return t;
+
+	// e.g. a metaball moved in front of the previous hit
+	return 0.0;
+}
 
-	for(int i = 0; i < count; ++i)
+// ----------------------------------------------------------------------
+/// Number and length of the steps of the primary rays, see volume_body.glsl.
+// ----------------------------------------------------------------------
+const int PRIMARY_RAY_STEPS = 200;
+const float PRIMARY_RAY_STEP = 0.01;
+
+// ----------------------------------------------------------------------
+/// Maximum number of bound tests or distance samples of one cone.
+// ----------------------------------------------------------------------
+const int CONE_MARCH_STEPS = 64;
+
+// ----------------------------------------------------------------------
+/// Length in world units below which ConeMarch() stops splitting intervals.
+// ----------------------------------------------------------------------
+const float CONE_MIN_WIDTH = 0.02;
+
+// ----------------------------------------------------------------------
+/// Marches the primary rays of a rectangle on the view plane at once. Every
+/// ray stays within a cone around the ray through the center; the field is
+/// bounded on the cone, the distance field sampled on its axis. Not supported
+/// by the Barnes-Hut approximation.
+/// @param[in]	center		Center of the rectangle in world space.
+/// @param[in]	halfX		Half the first edge of the rectangle.
+/// @param[in]	halfY		Half the second edge of the rectangle.
+/// @param[in]	start		Distance along the rays known to be empty, e.g. of a larger rectangle.
+/// @return					The distance from the view plane along each ray of the rectangle up to which no ray hits the surface.
+// ----------------------------------------------------------------------
+float ConeMarch(vec3 center, vec3 halfX, vec3 halfY, float start)
+{
+	float end = float(PRIMARY_RAY_STEPS) * PRIMARY_RAY_STEP;
+	vec3 axis = normalize(center - u_camPos);
+
+	// at distance s the rays are at most radius + spread * s away from the
+	// axis; both are largest at the corners
+	vec3 corners[4] = vec3[4](halfX + halfY, halfX - halfY, -halfX + halfY, -halfX - halfY);
+	float radius = 0.0;
+	float spread = 0.0;
+
+	for(int i = 0; i < 4; ++i)
 	{
-		res = SampleGlobalSpace(currentPos, true);
-		if(res._inside)
+		vec3 dir = normalize(center + corners[i] - u_camPos);
+		radius = max(radius, length(corners[i]));
+		spread = max(spread, length(dir - axis));
+	}
+
+	// the bounds hold for the centers, not for the interpolated field
+	if(u_densityVolumeSize > 0)
+		return start;
+
+	float s = start;
+
+	if(u_fieldKernel == KERNEL_SMOOTH_MIN)
+	{
+		for(int i = 0; i < CONE_MARCH_STEPS && s < end; ++i)
 		{
-			//lastResut = res;
-			foundPosition = currentPos;
+			float clearance = MetaballField(center + axis * s, false)._value - (radius + spread * s);
+
+			if(clearance < SDF_HIT_DISTANCE)
+				break;
+
+			// the rays approach the sample point by up to 1 + spread
+			s += clearance / (1.0 + spread);
 		}
-		else
+
+		return min(s, end);
+	}
+
+	// the bound does not hold for the approximation
+	if(u_fieldKernel == KERNEL_INVERSE_SQUARE && u_openingAngle > 0.0)
+		return start;
+
+	// the big step of the linear search
+	float width = PRIMARY_RAY_STEP * 10.0;
+
+	for(int i = 0; i < CONE_MARCH_STEPS && s < end; ++i)
+	{
+		float s1 = min(s + width, end);
+
+		if(FieldUpperBound(center, axis, s, s1, radius + spread * s1) < METABALL_THRESHOLD)
 		{
-			break;
+			s = s1;
+			width *= 2.0;
+			continue;
 		}
 
-		currentPos = currentPos + reverseDirection;
-	}
+		if(s1 - s <= CONE_MIN_WIDTH)
+			break;
 
-	
-	lastResut = SampleGlobalSpace(foundPosition, false);
+		width = (s1 - s) * 0.5;
+	}
 
-	return lastResut;
+	return s;
 }
 
 // ----------------------------------------------------------------------
@@ -364,11 +1264,32 @@ float FresnelFx(vec3 normal, vec3 pos)
 	return fresnel;
 }
 
+//---------------------------------------------------------------------------
+/// Looks up the depth of the surface in the shadow map, see
+/// ShadowMap::IsShadowed().
+//---------------------------------------------------------------------------
+bool ShadowMapLookup(vec3 pos)
+{
+	vec3 rel = pos - u_shadowOrigin;
+	vec2 texel = vec2(dot(rel, u_shadowAxisU), dot(rel, u_shadowAxisV));
+
+	// nothing outside of the bounds
+	if(any(lessThan(texel, vec2(0.0))) || any(greaterThanEqual(texel, vec2(u_shadowMapSize))))
+		return false;
+
+	float depth = -dot(rel, GetLightDir());
+
+	return texelFetch(u_shadowMap, ivec2(texel), 0).r < depth - u_shadowBias;
+}
+
 bool HardShadow(vec3 pos)
 {
 	if(pos.y > 2.0)
 		return false;
 
+	if(u_shadowMapSize > 0)
+		return ShadowMapLookup(pos);
+
 	vec3 sampleDirection = GetLightDir();
 	float scale = 0.05;
 	vec3 sampleStep = sampleDirection * scale; 
@@ -418,22 +1339,29 @@ vec3 VolumeLight(vec3 pos)
 
 	count = count * .5;
 
-	// up
-	vec3 sampleDirLight = GetLightDir() * 0.02;
-
-	for(int i = 0; i < 100; ++i)
+	// up; the light volume stores the same march for the voxel centers
+	if(u_lightVolumeSize > 0)
 	{
-		SampleGlobalResult res = SampleGlobalSpace(currentPos, true);
+		count += texture(u_lightVolume, (currentPos - u_lightVolumeMin) / u_lightVolumeExtent).r;
+	}
+	else
+	{
+		vec3 sampleDirLight = GetLightDir() * 0.02;
 
-		if(res._inside)
+		for(int i = 0; i < 100; ++i)
 		{
-			count++;
-		}
+			SampleGlobalResult res = SampleGlobalSpace(currentPos, true);
 
-		if(res._pos.y > 2.0)
-			break;
+			if(res._inside)
+			{
+				count++;
+			}
+
+			if(res._pos.y > 2.0)
+				break;
 
-		currentPos = currentPos + sampleDirLight;
+			currentPos = currentPos + sampleDirLight;
+		}
 	}
 
 	float value = count * 0.01;
@@ -571,3 +1499,52 @@ vec3 ErrorToColor(SampleGlobalResult res)
 
 	return vec3(1.0,0.0,1.0);	// pink
 }
+
+//---------------------------------------------------------------------------
+/// Searches the surface along the primary ray of the fragment; starts after
+/// the hit of the previous frame and the distance of the cone prepass.
+/// @param[in]	startPos	Fragment position on the view plane.
+/// @param[out]	hitDistance	Distance of the hit to the view plane; -1 for none.
+/// @return		The surface sample.
+//---------------------------------------------------------------------------
+SampleGlobalResult PrimaryRaySurface(vec3 startPos, out float hitDistance)
+{
+	vec3 sampleDirection = normalize(startPos - u_camPos);
+	vec3 sampleStep = sampleDirection * PRIMARY_RAY_STEP;
+
+	// skip the part of the ray the surface cannot have reached
+	int count = PRIMARY_RAY_STEPS;
+	float previousHit = texelFetch(u_prevHitDistance, ivec2(gl_FragCoord.xy), 0).r;
+	float tStart = GetRayStart(startPos, sampleStep, count, previousHit);
+
+	if(u_coneScale > 0)
+	{
+		float coneDistance = texelFetch(u_coneDistance, ivec2(gl_FragCoord.xy) / u_coneScale, 0).r;
+		tStart = max(tStart, coneDistance / PRIMARY_RAY_STEP);
+	}
+
+	// the tile is only valid along the primary ray; shadows and lighting
+	// sample other directions
+	SetPrimaryRayTile(startPos);
+	SampleGlobalResult res = SampleToSurface(startPos + sampleStep * tStart, sampleStep, count - int(tStart));
+	g_tile = -1;
+
+	hitDistance = res._inside ? length(res._pos - startPos) : -1.0;
+
+	return res;
+}
+
+//---------------------------------------------------------------------------
+/// Searches the surface straight up from the ground.
+/// @param[in]	worldPos	Fragment position on the ground plane.
+/// @return		The surface sample.
+//---------------------------------------------------------------------------
+SampleGlobalResult GroundRaySurface(vec3 worldPos)
+{
+	vec3 sampleDirection = vec3(0.0,1.0,0.0);
+	vec3 sampleStep = sampleDirection * 0.01;
+
+	vec3 startPos = worldPos + sampleStep;
+
+	return SampleToSurface(startPos, sampleStep, 400);
+}
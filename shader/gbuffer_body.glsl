@@ -0,0 +1,39 @@
+//---------------------------------------------------------------------------
+/// Geometry pass of the deferred shading, see SceneSettings::_deferredShading.
+/// Stores the surface of the primary ray, or of the ray up from the ground if
+/// u_gbufferGround is 1, for the shading pass in deferred_body.glsl.
+//---------------------------------------------------------------------------
+uniform int u_gbufferGround;
+
+//---------------------------------------------------------------------------
+/// vFragColor holds the hit position and the brightness of the surface;
+/// 0 for no surface. vHitDistance is read as u_prevHitDistance in the next
+/// frame, see volume_body.glsl.
+//---------------------------------------------------------------------------
+layout(location = 1) out float vHitDistance;
+layout(location = 2) out vec4 vNormal;	// normal, error code
+layout(location = 3) out vec4 vColor;	// color
+
+void main()
+{
+	SampleGlobalResult res;
+	float brightness;
+
+	if(u_gbufferGround == 1)
+	{
+		res = GroundRaySurface(s_worldSpacePos.xyz);
+		vHitDistance = -1.0;
+		brightness = 0.3;
+	}
+	else
+	{
+		float hitDistance;
+		res = PrimaryRaySurface(s_worldSpacePos.xyz, hitDistance);
+		vHitDistance = hitDistance;
+		brightness = 1.0;
+	}
+
+	vFragColor = vec4(res._pos, res._inside ? brightness : 0.0);
+	vNormal = vec4(res._normal, float(res._error));
+	vColor = vec4(res._color, 1.0);
+}
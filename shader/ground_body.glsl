@@ -1,12 +1,23 @@
+
+//---------------------------------------------------------------------------
+/// Ground color below the field, see GroundMap in groundmap.h. The map
+/// covers the footprint at u_groundMapMin.xz with the edges
+/// u_groundMapExtent.xz; u_groundMapSize is 0 to march up instead.
+//---------------------------------------------------------------------------
+uniform sampler2D u_groundMap;
+uniform int u_groundMapSize;
+uniform vec3 u_groundMapMin;
+uniform vec3 u_groundMapExtent;
+
 void main()
 {
-	vec3 startPos = s_worldSpacePos.xyz;
-	vec3 sampleDirection = vec3(0.0,1.0,0.0);
-	vec3 sampleStep = sampleDirection * 0.01;
-
-	startPos = startPos +  sampleStep;
+	if(u_groundMapSize > 0)
+	{
+		vFragColor = texture(u_groundMap, (s_worldSpacePos.xz - u_groundMapMin.xz) / u_groundMapExtent.xz);
+		return;
+	}
 
-	SampleGlobalResult res = SampleToSurface(startPos, sampleStep, 400);
+	SampleGlobalResult res = GroundRaySurface(s_worldSpacePos.xyz);
 
 	vec4 newResult;
 	vec4 _base = vec4(0.5,0.5,0.5,1.0);
@@ -0,0 +1,53 @@
+
+// ----------------------------------------------------------------------
+/// Sample spacing and length of the march toward the light, see
+/// lightvolume.h.
+// ----------------------------------------------------------------------
+const float LIGHT_VOLUME_SAMPLE_STEP = 0.02;
+const float LIGHT_VOLUME_LENGTH = 2.0;
+
+//---------------------------------------------------------------------------
+/// The pass of LightVolume: 0 samples the occupancy of the field, 1
+/// integrates the occupancy u_lightDensity toward the light with steps of
+/// u_lightVolumeStep.
+//---------------------------------------------------------------------------
+uniform int u_lightVolumePass;
+uniform sampler3D u_lightDensity;
+uniform float u_lightVolumeStep;
+
+void main()
+{
+	// the view plane is stretched over one slice of the grid
+	vec3 center = s_worldSpacePos.xyz;
+
+	if(u_lightVolumePass == 0)
+	{
+		SampleGlobalResult res = SampleGlobalSpace(center, true);
+		vFragColor = vec4(res._inside ? 1.0 : 0.0, 0.0, 0.0, 0.0);
+		return;
+	}
+
+	// the field is empty behind the bounds
+	vec3 lightDir = GetLightDir();
+	vec3 boundsMax = u_lightVolumeMin + u_lightVolumeExtent;
+	float len = LIGHT_VOLUME_LENGTH;
+
+	for(int a = 0; a < 3; ++a)
+	{
+		if(lightDir[a] > 1e-8)
+			len = min(len, (boundsMax[a] - center[a]) / lightDir[a]);
+		else if(lightDir[a] < -1e-8)
+			len = min(len, (u_lightVolumeMin[a] - center[a]) / lightDir[a]);
+	}
+
+	int steps = int(ceil(len / u_lightVolumeStep));
+	float sum = 0.0;
+
+	for(int i = 0; i < steps; ++i)
+	{
+		vec3 pos = center + lightDir * (u_lightVolumeStep * float(i));
+		sum += texture(u_lightDensity, (pos - u_lightVolumeMin) / u_lightVolumeExtent).r;
+	}
+
+	vFragColor = vec4(sum * u_lightVolumeStep / LIGHT_VOLUME_SAMPLE_STEP, 0.0, 0.0, 0.0);
+}
@@ -0,0 +1,28 @@
+
+// ----------------------------------------------------------------------
+/// Length of the steps of the shadow rays and depth of a texel without a
+/// hit, see shadowmap.h.
+// ----------------------------------------------------------------------
+const float SHADOW_MAP_STEP = 0.05;
+const float SHADOW_MAP_NO_HIT = 1e10;
+
+//---------------------------------------------------------------------------
+/// Number of steps of the shadow rays, see ShadowMap::GetRayLength().
+//---------------------------------------------------------------------------
+uniform int u_shadowSteps;
+
+void main()
+{
+	// the view plane is stretched over the map; the rays run away from the
+	// light, see ShadowMap::GetRayStart()
+	vec3 startPos = s_worldSpacePos.xyz;
+	vec3 sampleStep = -GetLightDir() * SHADOW_MAP_STEP;
+
+	float depth = SHADOW_MAP_NO_HIT;
+
+	SampleGlobalResult res = SampleToSurface(startPos, sampleStep, u_shadowSteps);
+	if(res._inside)
+		depth = length(res._pos - startPos);
+
+	vFragColor = vec4(depth, 0.0, 0.0, 0.0);
+}
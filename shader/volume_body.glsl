@@ -1,14 +1,18 @@
+//---------------------------------------------------------------------------
+/// Distance of the hit to the view plane; -1 for none. Read as
+/// u_prevHitDistance in the next frame.
+//---------------------------------------------------------------------------
+layout(location = 1) out float vHitDistance;
+
 
 void main()
 {
 	vec4 newResult;
 
+	float hitDistance;
+	SampleGlobalResult res = PrimaryRaySurface(s_worldSpacePos.xyz, hitDistance);
 
-	vec3 startPos = s_worldSpacePos.xyz;
-	vec3 sampleDirection = normalize(s_worldSpacePos.xyz - u_camPos);
-	vec3 sampleStep = sampleDirection * 0.01; 
-
-	SampleGlobalResult res = SampleToSurface(startPos, sampleStep, 200);
+	vHitDistance = hitDistance;
 
 	if(HasError(res))
 	{
@@ -23,4 +27,4 @@ void main()
 	}
 
 	vFragColor = newResult;
-}
\ No newline at end of file
+}
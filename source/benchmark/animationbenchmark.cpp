@@ -0,0 +1,159 @@
+#include "scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <glm/gtx/color_space.hpp>
+
+/// Number of animated objects per step, see Measure(); at least 10 steps are
+/// timed per configuration.
+static constexpr auto BENCHMARK_OBJECT_STEPS = 10000000u;
+
+//---------------------------------------------------------------------------
+/// The scalar animation of ObjectArray::Animation() before it was
+/// vectorized, for comparison: one object after the other with std::sin(),
+/// std::cos() and glm::length().
+//---------------------------------------------------------------------------
+class ReferenceAnimation
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    /// @param[in]  count   The number of objects.
+    //---------------------------------------------------------------------------
+    explicit ReferenceAnimation(unsigned int count)
+        : _pos(count, glm::vec3(0.0f)), _colors(count),
+          _userObject(10.0f, 10.0f, Z_POS), _countChanged(true)
+    {
+    }
+
+    //---------------------------------------------------------------------------
+    /// Animates the objects.
+    /// @param[in]  step    The current animation step.
+    //---------------------------------------------------------------------------
+    void Animation(float step)
+    {
+        const auto count   = int(_pos.size());
+        auto       hue     = 180.0f;
+        const auto hueStep = 360.0f / float(count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (_countChanged)
+            {
+                const glm::vec3 hsv(std::fmod(hue, 360.0f), 1.0f, 1.0f);
+                _colors[i] = glm::rgbColor(hsv);
+                hue += hueStep;
+            }
+
+            const auto distance = _userObject - _pos[i];
+
+            if (glm::length(distance) < 0.2f)
+            {
+                _pos[i] += distance * 0.5f;
+                continue;
+            }
+
+            const auto offset = (step * .01f) + 6.28f / float(count) * i;
+            const glm::vec3 target(std::sin(offset) * 2.0f,
+                                   (std::cos(offset) * 0.7f) + 0.25f, Z_POS);
+
+            _pos[i] += (target - _pos[i]) * 0.1f;
+        }
+
+        _countChanged = false;
+    }
+
+    //---------------------------------------------------------------------------
+    /// Returns the position of an object.
+    /// @param[in]  i       The object index.
+    /// @return             The position.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetPosition(int i) const
+    {
+        return _pos[i];
+    }
+
+private:
+    std::vector<glm::vec3> _pos;          ///< position information.
+    std::vector<glm::vec3> _colors;       ///< color information.
+    glm::vec3              _userObject;   ///< position of the user object.
+    bool                   _countChanged; ///< True before the first step.
+};
+
+//---------------------------------------------------------------------------
+/// Animates the given objects and measures the time per step.
+/// @param[in]  animate     Animates one step.
+/// @param[in]  count       The number of objects.
+/// @return                 The time per step in milliseconds.
+//---------------------------------------------------------------------------
+template <typename F>
+static double Measure(F&& animate, unsigned int count)
+{
+    const auto steps = std::max(BENCHMARK_OBJECT_STEPS / count, 10u);
+
+    // the first step sets the colors
+    animate(0.0f);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (auto step = 1u; step <= steps; ++step)
+        animate(float(step));
+
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() /
+           steps;
+}
+
+//---------------------------------------------------------------------------
+/// Compares the scalar animation with ObjectArray::Animation() in both
+/// layouts, on one thread and on all cores, from 100 to a million objects.
+/// Reports the largest position difference to the scalar animation.
+//---------------------------------------------------------------------------
+int main()
+{
+    std::printf("%-8s %12s %12s %12s %12s %10s\n", "objects", "scalar ms",
+                "aos ms", "soa ms", "soa mt ms", "max diff");
+
+    for (auto count : {100u, 1000u, 10000u, 100000u, 1000000u})
+    {
+        ReferenceAnimation reference(count);
+        ObjectArray        aos(ObjectLayout::AOS, count);
+        ObjectArray        soa(ObjectLayout::SOA, count);
+        ObjectArray        multi(ObjectLayout::SOA, count);
+
+        multi.SetThreadCount(0);
+
+        for (auto* objects : {&aos, &soa, &multi})
+        {
+            for (auto i = 0u; i < count; ++i)
+                objects->AddObject();
+
+            objects->SetDynamicObject(10.0f, 10.0f);
+        }
+
+        const auto referenceTime = Measure(
+            [&](float step) { reference.Animation(step); }, count);
+        const auto aosTime =
+            Measure([&](float step) { aos.Animation(step); }, count);
+        const auto soaTime =
+            Measure([&](float step) { soa.Animation(step); }, count);
+        const auto multiTime =
+            Measure([&](float step) { multi.Animation(step); }, count);
+
+        auto maxDiff = 0.0f;
+        for (auto i = 0; i < int(count); ++i)
+        {
+            const auto diff = reference.GetPosition(i) - soa.GetPosition(i);
+            maxDiff         = std::max({maxDiff, std::fabs(diff.x),
+                                        std::fabs(diff.y), std::fabs(diff.z)});
+        }
+
+        std::printf("%-8u %12.4f %12.4f %12.4f %12.4f %10.2e\n", count,
+                    referenceTime, aosTime, soaTime, multiTime, maxDiff);
+    }
+
+    return EXIT_SUCCESS;
+}
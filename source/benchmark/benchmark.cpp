@@ -0,0 +1,130 @@
+#include "cpurenderer.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/// Image size of the benchmark; a quarter of the OpenGL window per edge.
+static constexpr auto BENCHMARK_WIDTH  = 320u;
+static constexpr auto BENCHMARK_HEIGHT = 180u;
+
+/// Number of timed frames per configuration; the median is reported.
+static constexpr auto BENCHMARK_FRAMES = 5;
+
+//---------------------------------------------------------------------------
+/// Creates the default scene of RenderEngine::CreateScene() and animates it
+/// until the objects reached their orbit.
+//---------------------------------------------------------------------------
+static void CreateScene(ObjectArray& objects, unsigned int count)
+{
+    for (auto i = 0u; i < count; ++i)
+        objects.AddObject();
+
+    objects.SetDynamicObject(10.0f, 10.0f);
+
+    for (auto step = 0; step < 100; ++step)
+        objects.Animation(float(step));
+}
+
+//---------------------------------------------------------------------------
+/// Renders the scene BENCHMARK_FRAMES times.
+/// @param[in]  renderer    The renderer.
+/// @param[in]  objects     The scene objects.
+/// @param[in]  settings    The scene settings.
+/// @param[out] rgba        The image of the last frame.
+/// @return                 The median frame time in milliseconds; negative
+/// if an error occurred.
+//---------------------------------------------------------------------------
+static double Measure(CpuRenderer& renderer, const ObjectArray& objects,
+                      const SceneSettings& settings, std::vector<float>& rgba)
+{
+    std::vector<double> times;
+
+    for (auto frame = 0; frame < BENCHMARK_FRAMES; ++frame)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        if (IsFalse(renderer.Render(objects, settings, 99.0f, BENCHMARK_WIDTH,
+                                    BENCHMARK_HEIGHT, rgba.data()),
+                    MSG_INFO("Could not render frame.")))
+            return -1.0;
+
+        const auto end = std::chrono::steady_clock::now();
+        times.push_back(
+            std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+//---------------------------------------------------------------------------
+/// Compares the generic CPU shaders with the shaders specialized per shading
+/// mode, noise and object bucket, see GetCpuShaders(). Renders single
+/// threaded so that the times do not depend on the scheduler.
+//---------------------------------------------------------------------------
+int main()
+{
+    CpuRenderer renderer;
+    if (IsFalse(renderer.Init(), MSG_INFO("Could not start renderer.")))
+        return EXIT_FAILURE;
+
+    renderer.SetThreadCount(1);
+
+    const auto pixelCount = size_t(BENCHMARK_WIDTH) * BENCHMARK_HEIGHT * 4;
+
+    std::vector<float> generic(pixelCount);
+    std::vector<float> specialized(pixelCount);
+
+    std::printf("%-8s %-6s %-6s %-8s %12s %12s %8s\n", "kernel", "mode",
+                "noise", "objects", "generic ms", "special ms", "gain");
+
+    const char* kernelNames[] = {"inv-sq", "wyvill", "smin"};
+
+    for (auto kernel : {MetaballKernel::INVERSE_SQUARE, MetaballKernel::WYVILL,
+                        MetaballKernel::SMOOTH_MIN})
+    {
+        for (auto count : {6u, 20u, 40u})
+        {
+            ObjectArray objects;
+            CreateScene(objects, count);
+
+            for (auto mode : {0u, 2u, 5u, 6u})
+            {
+                for (auto noise : {NoiseMode::NO_NOISE, NoiseMode::NOISE})
+                {
+                    SceneSettings settings{};
+                    settings._renderMode = mode;
+                    settings._noise      = noise;
+                    settings._kernel     = kernel;
+
+                    renderer.SetSpecialization(false);
+                    const auto genericTime =
+                        Measure(renderer, objects, settings, generic);
+
+                    renderer.SetSpecialization(true);
+                    const auto specializedTime =
+                        Measure(renderer, objects, settings, specialized);
+
+                    if (genericTime < 0.0 || specializedTime < 0.0)
+                        return EXIT_FAILURE;
+
+                    if (IsFalse(generic == specialized,
+                                MSG_INFO("Specialized image differs.")))
+                        return EXIT_FAILURE;
+
+                    std::printf("%-8s %-6u %-6s %-8u %12.1f %12.1f %7.1f%%\n",
+                                kernelNames[unsigned(kernel)], mode,
+                                noise == NoiseMode::NOISE ? "on" : "off",
+                                count, genericTime, specializedTime,
+                                (genericTime / specializedTime - 1.0) *
+                                    100.0);
+                }
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
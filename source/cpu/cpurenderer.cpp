@@ -0,0 +1,573 @@
+#include "cpurenderer.h"
+
+#include "cpushader.h"
+#include "log.h"
+#include "noise.h"
+#include "parallel.h"
+
+#include <cmath>
+
+// camera and planes; must match RenderEngine::CreateScene()
+static const glm::vec3  CAM_POS{0.0f, 0.0f, 2.0f};
+static const glm::vec3  CAM_TARGET{0.0f, 0.0f, 0.0f};
+static const glm::vec3  CAM_UP{0.0f, 1.0f, 0.0f};
+static constexpr auto   FOV_Y     = 1.0f;
+static constexpr auto   ASPECT    = 1280.0f / 720.0f;
+static constexpr auto   FAR_PLANE = 5.0f;
+
+//---------------------------------------------------------------------------
+/// A rectangle in world space, spanned by two edges.
+//---------------------------------------------------------------------------
+struct Quad
+{
+    glm::vec3 _origin;
+    glm::vec3 _u;
+    glm::vec3 _v;
+};
+
+// view plane: translate(-2, -0.75, 0) * scale(4, 2, 2)
+static const Quad VIEW_PLANE{{-2.0f, -0.75f, 0.0f},
+                             {4.0f, 0.0f, 0.0f},
+                             {0.0f, 2.0f, 0.0f}};
+
+// ground plane: translate(-3, -1.5, -2) * scale(10, 2, 2) * rotateX(90)
+static const Quad GROUND_PLANE{{-3.0f, -1.5f, -2.0f},
+                               {10.0f, 0.0f, 0.0f},
+                               {0.0f, 0.0f, 2.0f}};
+
+//---------------------------------------------------------------------------
+/// Intersects a ray with the plane of a quad.
+/// @param[in]  quad    The quad.
+/// @param[in]  origin  The ray origin.
+/// @param[in]  dir     The ray direction.
+/// @param[out] t       The distance to the hit point, in units of dir.
+/// @return             True if the plane is hit.
+//---------------------------------------------------------------------------
+static bool IntersectPlane(const Quad& quad, const glm::vec3& origin,
+                           const glm::vec3& dir, float& t)
+{
+    const auto normal = glm::cross(quad._u, quad._v);
+    const auto denom  = glm::dot(normal, dir);
+
+    if (std::fabs(denom) < 1e-8f)
+        return false;
+
+    t = glm::dot(normal, quad._origin - origin) / denom;
+    return t > 0.0f;
+}
+
+//---------------------------------------------------------------------------
+/// Intersects a ray with a quad.
+/// @param[in]  quad    The quad.
+/// @param[in]  origin  The ray origin.
+/// @param[in]  dir     The ray direction.
+/// @param[out] t       The distance to the hit point, in units of dir.
+/// @return             True if the quad is hit.
+//---------------------------------------------------------------------------
+static bool IntersectQuad(const Quad& quad, const glm::vec3& origin,
+                          const glm::vec3& dir, float& t)
+{
+    if (!IntersectPlane(quad, origin, dir, t))
+        return false;
+
+    const auto local = origin + dir * t - quad._origin;
+    const auto a     = glm::dot(local, quad._u) / glm::dot(quad._u, quad._u);
+    const auto b     = glm::dot(local, quad._v) / glm::dot(quad._v, quad._v);
+
+    return a >= 0.0f && a <= 1.0f && b >= 0.0f && b <= 1.0f;
+}
+
+//---------------------------------------------------------------------------
+/// Blends the source color over the destination like
+/// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).
+//---------------------------------------------------------------------------
+static glm::vec4 Blend(const glm::vec4& src, const glm::vec4& dst)
+{
+    const auto a = src.w;
+    return src * a + dst * (1.0f - a);
+}
+
+CpuRenderer::CpuRenderer()
+{
+    _threadCount = 0;
+    _simdLevel   = GetSupportedSimdLevel();
+    _specialize  = true;
+}
+
+CpuRenderer::~CpuRenderer() = default;
+
+bool CpuRenderer::Init()
+{
+    if (IsFalse(LoadNoiseData(GetNoiseParams(0), _threadCount, _assetCache,
+                              _noiseData),
+                MSG_INFO("Could not create noise data.")))
+        return false;
+
+    return true;
+}
+
+void CpuRenderer::SetCacheDirectory(const std::string& directory)
+{
+    _assetCache.SetDirectory(directory);
+}
+
+void CpuRenderer::SetThreadCount(unsigned int count)
+{
+    _threadCount = count;
+}
+
+void CpuRenderer::SetSimdLevel(SimdLevel level)
+{
+    _simdLevel = level;
+}
+
+void CpuRenderer::SetSpecialization(bool enable)
+{
+    _specialize = enable;
+}
+
+bool CpuRenderer::Render(const ObjectArray&   objects,
+                         const SceneSettings& settings, float animation,
+                         unsigned int width, unsigned int height,
+                         float* rgba)
+{
+    if (IsNullptr(rgba, MSG_INFO("Invalid buffer.")))
+        return false;
+    if (IsNull(width, MSG_INFO("Invalid width.")))
+        return false;
+    if (IsNull(height, MSG_INFO("Invalid height.")))
+        return false;
+    if (IsNullptr(_noiseData._texels, MSG_INFO("Renderer not prepared.")))
+        return false;
+
+    // the noise follows the settings; generated again only if they changed
+    const auto noiseParams = GetNoiseParams(settings._noiseVolumeSize);
+    if (noiseParams != _noiseData._params)
+    {
+        if (IsFalse(LoadNoiseData(noiseParams, _threadCount, _assetCache,
+                                  _noiseData),
+                    MSG_INFO("Could not create noise data.")))
+            return false;
+    }
+
+    const auto compactKernel = settings._kernel == MetaballKernel::WYVILL;
+
+    if (compactKernel)
+    {
+        if (IsFalse(settings._kernelRadius * settings._kernelRadius >
+                        1.0f / METABALL_THRESHOLD,
+                    MSG_INFO("Kernel radius too small.")))
+            return false;
+        if (IsFalse(_grid.Build(objects, settings._kernelRadius),
+                    MSG_INFO("Could not build grid.")))
+            return false;
+
+        const glm::vec2 planeSize(VIEW_PLANE._u.x, VIEW_PLANE._v.y);
+        if (IsFalse(_tiles.Build(objects, settings._kernelRadius, CAM_POS,
+                                 VIEW_PLANE._origin, planeSize),
+                    MSG_INFO("Could not build tiles.")))
+            return false;
+    }
+
+    if (settings._kernel == MetaballKernel::SMOOTH_MIN)
+    {
+        if (IsFalse(settings._blendDistance > 0.0f,
+                    MSG_INFO("Blend distance too small.")))
+            return false;
+    }
+
+    const auto openingAngle =
+        settings._kernel == MetaballKernel::INVERSE_SQUARE
+            ? settings._openingAngle
+            : 0.0f;
+
+    if (openingAngle > 0.0f)
+    {
+        if (IsFalse(_octree.Build(objects), MSG_INFO("Could not build octree.")))
+            return false;
+    }
+
+    MetaballCenters    centers;
+    std::vector<float> centerData;
+
+    if (objects.GetLayout() == ObjectLayout::SOA)
+    {
+        // zero-copy
+        centers._x     = objects.GetComponentData(ObjectComponent::X)._data;
+        centers._y     = objects.GetComponentData(ObjectComponent::Y)._data;
+        centers._z     = objects.GetComponentData(ObjectComponent::Z)._data;
+        centers._r     = objects.GetComponentData(ObjectComponent::R)._data;
+        centers._g     = objects.GetComponentData(ObjectComponent::G)._data;
+        centers._b     = objects.GetComponentData(ObjectComponent::B)._data;
+        centers._count = objects.GetObjectCount();
+    }
+    else
+    {
+        // gather the centers into structure-of-arrays form
+        const auto  count     = objects.GetObjectCount();
+        const auto* positions = objects.GetPositionData();
+        const auto* colors    = objects.GetColorData();
+        centerData.resize(size_t(count) * 6);
+
+        for (auto i = 0u; i < count; ++i)
+        {
+            for (auto c = 0u; c < 3; ++c)
+            {
+                centerData[c * count + i]       = positions[i][c];
+                centerData[(c + 3) * count + i] = colors[i][c];
+            }
+        }
+
+        centers._x     = centerData.data();
+        centers._y     = centers._x + count;
+        centers._z     = centers._y + count;
+        centers._r     = centers._z + count;
+        centers._g     = centers._r + count;
+        centers._b     = centers._g + count;
+        centers._count = count;
+    }
+
+    // selected once per frame, not per sample
+    const auto objectBucket =
+        _specialize ? GetObjectBucket(centers._count) : 0u;
+    const auto shaders =
+        _specialize ? GetCpuShaders(settings._renderMode, settings.GetNoise(),
+                                    objectBucket)
+                    : CpuShaders();
+
+    CpuUniforms u;
+    u._camPos       = CAM_POS;
+    u._noiseTexture = &_noiseData;
+    u._noise        = settings.GetNoise();
+    u._animation    = animation;
+    u._shadingMode  = settings._renderMode;
+    u._centers      = centers;
+    u._fieldKernel  = GetFieldKernel(_simdLevel, objectBucket);
+    u._kernel       = settings._kernel;
+    u._kernelRadius = settings._kernelRadius;
+    u._kernelScale  = compactKernel ? GetWyvillScale(settings._kernelRadius)
+                                    : 0.0f;
+    u._grid         = &_grid;
+    u._tiles        = &_tiles;
+    u._tile         = -1;
+    u._octree       = &_octree;
+    u._openingAngle = openingAngle;
+
+    u._blendDistance = settings._blendDistance;
+    u._intervalRays  = settings._intervalRays;
+
+    GetFieldBounds(objects, settings, u._boundsMin, u._boundsMax);
+
+    // hit distances of the previous frame
+    const auto pixelCount = size_t(width) * height;
+    if (_hitDistance.size() != pixelCount)
+    {
+        _history.Reset();
+        _hitDistance.assign(pixelCount, -1.0f);
+    }
+
+    u._displacement  = _history.Update(objects, settings);
+    u._densityVolume = nullptr;
+
+    // the field baked into voxels; every later pass samples the voxels
+    if (settings._densityVolumeSize > 0)
+    {
+        if (IsFalse(_densityVolume.Update(u._boundsMin, u._boundsMax, objects,
+                                          settings, animation),
+                    MSG_INFO("Could not update density volume.")))
+            return false;
+
+        const auto& bricks = _densityVolume.GetDirtyBricks();
+
+        auto bakeBrick = [&](unsigned int i)
+        {
+            auto x0 = 0u, y0 = 0u, z0 = 0u;
+            _densityVolume.GetBrickOrigin(bricks[i], x0, y0, z0);
+
+            for (auto z = z0; z < z0 + DENSITY_BRICK_SIZE; ++z)
+            {
+                for (auto y = y0; y < y0 + DENSITY_BRICK_SIZE; ++y)
+                {
+                    for (auto x = x0; x < x0 + DENSITY_BRICK_SIZE; ++x)
+                    {
+                        const auto sample = MetaballField(
+                            u, _densityVolume.GetVoxelCenter(x, y, z), true);
+                        _densityVolume.SetVoxel(x, y, z, sample._value,
+                                                sample._color);
+                    }
+                }
+            }
+        };
+
+        ParallelFor(unsigned(bricks.size()), _threadCount, bakeBrick);
+
+        u._densityVolume = &_densityVolume;
+    }
+
+    u._shadowMap = nullptr;
+
+    // depth of the surface seen from the light; replaces the shadow rays
+    if (settings._shadowMapSize > 0)
+    {
+        const auto lightDir = glm::normalize(LIGHT_VECTOR);
+
+        if (IsFalse(_shadowMap.Fit(u._boundsMin, u._boundsMax, lightDir,
+                                   settings._shadowMapSize),
+                    MSG_INFO("Could not fit shadow map.")))
+            return false;
+
+        const auto sampleStep = -lightDir * SHADOW_MAP_STEP;
+        const auto steps =
+            int(std::ceil(_shadowMap.GetRayLength() / SHADOW_MAP_STEP));
+
+        auto shadowRow = [&](unsigned int y)
+        {
+            for (auto x = 0u; x < settings._shadowMapSize; ++x)
+            {
+                const auto startPos = _shadowMap.GetRayStart(x, y);
+                const auto res =
+                    SampleToSurface(u, startPos, sampleStep, steps);
+
+                if (res._inside)
+                    _shadowMap.SetDepth(x, y,
+                                        glm::length(res._pos - startPos));
+            }
+        };
+
+        ParallelFor(settings._shadowMapSize, _threadCount, shadowRow);
+
+        u._shadowMap = &_shadowMap;
+    }
+
+    // absorption toward the light; replaces the marches of the volume light
+    u._lightVolume = nullptr;
+
+    if (settings._lightVolumeSize > 0)
+    {
+        const auto size = settings._lightVolumeSize;
+
+        if (IsFalse(_lightVolume.Fit(u._boundsMin, u._boundsMax,
+                                     glm::normalize(LIGHT_VECTOR), size),
+                    MSG_INFO("Could not fit light volume.")))
+            return false;
+
+        auto densitySlice = [&](unsigned int z)
+        {
+            for (auto y = 0u; y < size; ++y)
+            {
+                for (auto x = 0u; x < size; ++x)
+                {
+                    const auto pos = _lightVolume.GetVoxelCenter(x, y, z);
+                    _lightVolume.SetDensity(x, y, z,
+                                            LightVolumeDensity(u, pos));
+                }
+            }
+        };
+
+        ParallelFor(size, _threadCount, densitySlice);
+        ParallelFor(size, _threadCount,
+                    [&](unsigned int z) { _lightVolume.Integrate(z); });
+
+        u._lightVolume = &_lightVolume;
+    }
+
+    // the ground below the field; replaces the marches up the ground
+    u._groundMap = nullptr;
+
+    if (settings._groundMapSize > 0)
+    {
+        const auto size = settings._groundMapSize;
+
+        if (IsFalse(_groundMap.Fit(u._boundsMin, u._boundsMax, size),
+                    MSG_INFO("Could not fit ground map.")))
+            return false;
+
+        auto groundRow = [&](unsigned int y)
+        {
+            for (auto x = 0u; x < size; ++x)
+                _groundMap.SetColor(
+                    x, y,
+                    shaders._groundShader(u, _groundMap.GetTexelCenter(x, y)));
+        };
+
+        ParallelFor(size, _threadCount, groundRow);
+
+        u._groundMap = &_groundMap;
+    }
+
+    // camera basis
+    const auto forward = glm::normalize(CAM_TARGET - CAM_POS);
+    const auto right   = glm::normalize(glm::cross(forward, CAM_UP));
+    const auto up      = glm::cross(right, forward);
+
+    const auto tanY = std::tan(FOV_Y * 0.5f);
+    const auto tanX = tanY * ASPECT;
+
+    const auto widthF  = float(width);
+    const auto heightF = float(height);
+
+    // ray through a position in pixels; the top left corner is (0, 0)
+    auto pixelRay = [&](float x, float y)
+    {
+        const auto ndcX = (2.0f * x / widthF) - 1.0f;
+        const auto ndcY = 1.0f - (2.0f * y / heightF);
+        return forward + right * (ndcX * tanX) + up * (ndcY * tanY);
+    };
+
+    // cone prepass from coarse to fine tiles; each level starts at the
+    // distances of the level before
+    auto coneTileSize = 0u;
+    auto coneTilesX   = 0u;
+
+    for (const auto tileSize : CONE_TILE_SIZES)
+    {
+        if (!settings._conePrepass)
+            break;
+
+        const auto tilesX = (width + tileSize - 1) / tileSize;
+        const auto tilesY = (height + tileSize - 1) / tileSize;
+
+        _coneScratch.swap(_coneDistance);
+        _coneDistance.assign(size_t(tilesX) * tilesY, 0.0f);
+
+        auto marchRow = [&](unsigned int ty)
+        {
+            const auto y0 = float(ty * tileSize);
+            const auto y1 = float(glm::min((ty + 1) * tileSize, height));
+
+            for (auto tx = 0u; tx < tilesX; ++tx)
+            {
+                const auto x0 = float(tx * tileSize);
+                const auto x1 = float(glm::min((tx + 1) * tileSize, width));
+
+                // the corners on the view plane
+                auto t00 = 0.0f, t10 = 0.0f, t01 = 0.0f;
+                const auto d00 = pixelRay(x0, y0);
+                const auto d10 = pixelRay(x1, y0);
+                const auto d01 = pixelRay(x0, y1);
+                if (!IntersectPlane(VIEW_PLANE, CAM_POS, d00, t00) ||
+                    !IntersectPlane(VIEW_PLANE, CAM_POS, d10, t10) ||
+                    !IntersectPlane(VIEW_PLANE, CAM_POS, d01, t01))
+                    continue;
+
+                const auto p00 = CAM_POS + d00 * t00;
+                const auto p10 = CAM_POS + d10 * t10;
+                const auto p01 = CAM_POS + d01 * t01;
+
+                auto start = 0.0f;
+                if (coneTileSize != 0)
+                {
+                    const auto px = tx * tileSize / coneTileSize;
+                    const auto py = ty * tileSize / coneTileSize;
+                    start = _coneScratch[size_t(py) * coneTilesX + px];
+                }
+
+                _coneDistance[size_t(ty) * tilesX + tx] =
+                    ConeMarch(u, (p10 + p01) * 0.5f, (p10 - p00) * 0.5f,
+                              (p01 - p00) * 0.5f, start);
+            }
+        };
+
+        ParallelFor(tilesY, _threadCount, marchRow);
+
+        coneTileSize = tileSize;
+        coneTilesX   = tilesX;
+    }
+
+    auto coneDistanceAt = [&](unsigned int x, unsigned int y)
+    {
+        if (coneTileSize == 0)
+            return 0.0f;
+
+        return _coneDistance[size_t(y / coneTileSize) * coneTilesX +
+                             x / coneTileSize];
+    };
+
+    // geometry pass of the deferred shading; the ground map replaces the
+    // rays up from the ground as in the forward pass
+    const auto deferred = settings._deferredShading;
+
+    if (deferred)
+    {
+        _gbuffer.assign(pixelCount, GBufferTexel());
+
+        auto geometryRow = [&](unsigned int y)
+        {
+            for (auto x = 0u; x < width; ++x)
+            {
+                const auto dir   = pixelRay(float(x) + 0.5f, float(y) + 0.5f);
+                const auto index = size_t(y) * width + x;
+
+                auto t = 0.0f;
+                if (IntersectQuad(VIEW_PLANE, CAM_POS, dir, t) &&
+                    t <= FAR_PLANE)
+                {
+                    auto& hit       = _hitDistance[index];
+                    _gbuffer[index] = shaders._volumeGeometry(
+                        u, CAM_POS + dir * t, coneDistanceAt(x, y), hit, hit);
+                }
+                else if (!u._groundMap &&
+                         IntersectQuad(GROUND_PLANE, CAM_POS, dir, t) &&
+                         t <= FAR_PLANE)
+                {
+                    _gbuffer[index] =
+                        shaders._groundGeometry(u, CAM_POS + dir * t);
+                }
+            }
+        };
+
+        ParallelFor(height, _threadCount, geometryRow);
+    }
+
+    auto renderRow = [&](unsigned int y)
+    {
+        for (auto x = 0u; x < width; ++x)
+        {
+            const auto dir   = pixelRay(float(x) + 0.5f, float(y) + 0.5f);
+            const auto index = size_t(y) * width + x;
+
+            // the view plane is drawn first and occludes the ground
+            glm::vec4 color(0.0f, 0.0f, 0.0f, 1.0f);
+
+            auto t = 0.0f;
+            if (IntersectQuad(VIEW_PLANE, CAM_POS, dir, t) && t <= FAR_PLANE)
+            {
+                if (deferred)
+                {
+                    color = shaders._deferredShader(u, _gbuffer[index]);
+                }
+                else
+                {
+                    auto&      hit      = _hitDistance[index];
+                    const auto fragment = shaders._volumeShader(
+                        u, CAM_POS + dir * t, coneDistanceAt(x, y), hit, hit);
+                    color = Blend(fragment, color);
+                }
+            }
+            else if (IntersectQuad(GROUND_PLANE, CAM_POS, dir, t) &&
+                     t <= FAR_PLANE)
+            {
+                if (deferred && !u._groundMap)
+                {
+                    color = shaders._deferredShader(u, _gbuffer[index]);
+                }
+                else
+                {
+                    const auto fragment =
+                        shaders._groundShader(u, CAM_POS + dir * t);
+                    color = Blend(fragment, color);
+                }
+            }
+
+            auto* pixel = rgba + (size_t(y) * width + x) * 4;
+            pixel[0]    = glm::clamp(color.x, 0.0f, 1.0f);
+            pixel[1]    = glm::clamp(color.y, 0.0f, 1.0f);
+            pixel[2]    = glm::clamp(color.z, 0.0f, 1.0f);
+            pixel[3]    = 1.0f;
+        }
+    };
+
+    ParallelFor(height, _threadCount, renderRow);
+
+    return true;
+}
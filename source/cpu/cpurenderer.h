@@ -0,0 +1,116 @@
+#ifndef VOLUME_DEMO_CPURENDERER_H__
+#define VOLUME_DEMO_CPURENDERER_H__
+
+#include "assetcache.h"
+#include "cpushader.h"
+#include "densityvolume.h"
+#include "fieldkernel.h"
+#include "groundmap.h"
+#include "lightvolume.h"
+#include "noise.h"
+#include "octree.h"
+#include "reprojection.h"
+#include "scene.h"
+#include "shadowmap.h"
+#include "spatialgrid.h"
+#include "tilelists.h"
+#include <vector>
+
+//---------------------------------------------------------------------------
+/// Headless, multithreaded CPU implementation of the RenderEngine pipeline.
+/// Renders the view plane and the ground plane with the same camera and
+/// shading as the OpenGL shaders, without requiring an OpenGL context.
+//---------------------------------------------------------------------------
+class CpuRenderer
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    CpuRenderer();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~CpuRenderer();
+
+    //---------------------------------------------------------------------------
+    /// Prepares the renderer; creates the noise data, or maps it from the
+    /// cache directory.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Init();
+
+    //---------------------------------------------------------------------------
+    /// Sets the directory of the asset cache, see AssetCache. Call it before
+    /// Init(); by default the noise is generated without a cache.
+    /// @param[in]  directory   The directory; empty disables the cache.
+    //---------------------------------------------------------------------------
+    void SetCacheDirectory(const std::string& directory);
+
+    //---------------------------------------------------------------------------
+    /// Sets the number of worker threads.
+    /// @param[in]  count   The number of threads. 0 to use all cores.
+    //---------------------------------------------------------------------------
+    void SetThreadCount(unsigned int count);
+
+    //---------------------------------------------------------------------------
+    /// Sets the instruction set of the field kernel. By default the best
+    /// instruction set supported by the CPU is used.
+    /// @param[in]  level   The instruction set.
+    //---------------------------------------------------------------------------
+    void SetSimdLevel(SimdLevel level);
+
+    //---------------------------------------------------------------------------
+    /// Turns the shaders and field kernels specialized per frame on or off,
+    /// see GetCpuShaders(). On by default; off uses the generic shaders.
+    /// @param[in]  enable  True to use the specialized shaders.
+    //---------------------------------------------------------------------------
+    void SetSpecialization(bool enable);
+
+    //---------------------------------------------------------------------------
+    /// Renders the scene into the given buffer. The image always shows the
+    /// view of the 1280x720 OpenGL window, scaled to the given resolution.
+    /// With SceneSettings::_reprojection the primary rays start close to
+    /// the hits of the previous call, with SceneSettings::_conePrepass at
+    /// the distances of a coarse cone march. A shadow map replaces the
+    /// shadow rays if SceneSettings::_shadowMapSize is set, a light volume
+    /// the marches of the volume light if SceneSettings::_lightVolumeSize is
+    /// and a ground map the ground rays if SceneSettings::_groundMapSize is.
+    /// SceneSettings::_densityVolumeSize bakes the field into voxels first.
+    /// With SceneSettings::_deferredShading all surfaces are searched before
+    /// any is shaded; the image is the same.
+    /// @param[in]  objects     The scene objects.
+    /// @param[in]  settings    The scene settings.
+    /// @param[in]  animation   The animation time value.
+    /// @param[in]  width       The image width.
+    /// @param[in]  height      The image height.
+    /// @param[out] rgba        Buffer of width * height * 4 floats. Rows are
+    /// stored top to bottom; values are in the range [0, 1].
+    /// @return                 False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Render(const ObjectArray& objects, const SceneSettings& settings,
+                float animation, unsigned int width, unsigned int height,
+                float* rgba);
+
+private:
+    AssetCache                 _assetCache;    ///< see SetCacheDirectory().
+    NoiseData                  _noiseData;     ///< see SceneSettings.
+    unsigned int               _threadCount;   ///< number of worker threads.
+    SimdLevel                  _simdLevel;     ///< see SetSimdLevel().
+    bool                       _specialize;    ///< see SetSpecialization().
+    SpatialGrid                _grid;          ///< grid of the compact kernel.
+    Octree                     _octree;        ///< Barnes-Hut octree.
+    TileLists                  _tiles;         ///< tiles of the compact kernel.
+    ReprojectionHistory        _history;       ///< centers of the last frame.
+    std::vector<float>         _hitDistance;   ///< hits of the last frame.
+    std::vector<float>         _coneDistance;  ///< see ConeMarch().
+    std::vector<float>         _coneScratch;   ///< previous prepass level.
+    ShadowMap                  _shadowMap;     ///< depth seen from the light.
+    LightVolume                _lightVolume;   ///< absorption to the light.
+    GroundMap                  _groundMap;     ///< ground below the field.
+    DensityVolume              _densityVolume; ///< the field in voxels.
+    std::vector<GBufferTexel>  _gbuffer;       ///< surfaces of the frame.
+};
+
+#endif // VOLUME_DEMO_CPURENDERER_H__
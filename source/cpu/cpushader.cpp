@@ -0,0 +1,1240 @@
+#include "cpushader.h"
+#include "densityvolume.h"
+#include "groundmap.h"
+#include "lightvolume.h"
+#include "noise.h"
+#include "octree.h"
+#include "reprojection.h"
+#include "shadowmap.h"
+#include "spatialgrid.h"
+#include "tilelists.h"
+
+#include <cmath>
+#include <limits>
+
+//---------------------------------------------------------------------------
+/// Uniform values the shaders are specialized on, see GetCpuShaders(). A
+/// negative shading mode or noise value and an object bucket of 0 read the
+/// value from the uniforms at run time.
+//---------------------------------------------------------------------------
+template <int ShadingMode, int Noise, unsigned int ObjectBucket>
+struct Specialization
+{
+    /// Upper bound of the number of centers; 0 for none.
+    static constexpr auto OBJECT_BUCKET = ObjectBucket;
+
+    static unsigned int GetShadingMode(const CpuUniforms& u)
+    {
+        return ShadingMode < 0 ? u._shadingMode : unsigned(ShadingMode);
+    }
+
+    static bool HasNoise(const CpuUniforms& u)
+    {
+        return Noise < 0 ? u._noise == 1 : Noise == 1;
+    }
+};
+
+/// Reads every value from the uniforms.
+using GenericShader = Specialization<-1, -1, 0>;
+
+//---------------------------------------------------------------------------
+/// Returns the trip count of a loop over all centers.
+/// @param[in]  c       The centers.
+/// @return             The object bucket if set; the constant bound lets the
+/// compiler unroll the loop, which then breaks at the center count.
+//---------------------------------------------------------------------------
+template <class Spec> static unsigned int GetLoopCount(const MetaballCenters& c)
+{
+    return Spec::OBJECT_BUCKET > 0 ? Spec::OBJECT_BUCKET : c._count;
+}
+
+//---------------------------------------------------------------------------
+/// Returns the vector to the light source.
+//---------------------------------------------------------------------------
+static glm::vec3 GetLightDir()
+{
+    return glm::normalize(LIGHT_VECTOR);
+}
+
+//---------------------------------------------------------------------------
+/// Returns an animated value in the range [0, 1].
+//---------------------------------------------------------------------------
+static float GetAnimation01(const CpuUniforms& u, float timeFactor)
+{
+    return (std::sin(u._animation * timeFactor) + 1.0f) * .5f;
+}
+
+static float GetAnimation01Cos(const CpuUniforms& u, float timeFactor)
+{
+    return (std::cos(u._animation * timeFactor) + 1.0f) * .5f;
+}
+
+//---------------------------------------------------------------------------
+/// Returns the procedural noise added to the metaball field.
+/// @param[in]  u           The uniform values.
+/// @param[in]  worldPos    World space position.
+/// @param[out] gradient    Optional; the gradient of the noise value.
+/// @return                 The noise value.
+//---------------------------------------------------------------------------
+static float GetRandomFieldValue(const CpuUniforms& u,
+                                 const glm::vec3& worldPos,
+                                 glm::vec3*       gradient)
+{
+    const auto& noise = *u._noiseTexture;
+
+    if (noise._params._depth > 1)
+    {
+        // the volume spans the box [-2, 2]^3 and drifts along z; the
+        // animation blends between its two noises
+        const auto drift = glm::vec3(0.0f, 0.0f, u._animation * 0.002f);
+        const auto uvw   = (worldPos + glm::vec3(2.0f)) * 0.25f + drift;
+        const auto blend = GetAnimation01(u, 0.03f);
+
+        const auto value = SampleNoiseData(noise, uvw, blend, gradient);
+
+        // chain rule: duvw/dpos = 0.25
+        if (gradient)
+            *gradient *= 0.25f * 20.0f;
+
+        return (value * 20.0f) - 10.0f;
+    }
+
+    const auto z = (worldPos.z + 2.0f) * 0.5f;
+    auto       y = (worldPos.y + 1.0f) * 0.5f;
+    auto       x = (worldPos.x + 2.0f) * 0.25f;
+
+    const auto animY = GetAnimation01(u, 0.02f);
+    const auto animX = GetAnimation01Cos(u, 0.03f);
+
+    y = (y + z) * .5f * animY;
+    x = (x + z) * .5f * animX;
+
+    // the 2D slice is sampled at its center
+    glm::vec3  uvGradient;
+    const auto value = SampleNoiseData(noise, glm::vec3(x, y, 0.5f), 0.0f,
+                                       gradient ? &uvGradient : nullptr);
+
+    if (gradient)
+    {
+        // chain rule: dx/dpos = (0.125, 0, 0.25) * animX,
+        // dy/dpos = (0, 0.25, 0.25) * animY
+        const auto du = uvGradient.x * animX;
+        const auto dv = uvGradient.y * animY;
+        *gradient = glm::vec3(0.125f * du, 0.25f * dv, 0.25f * (du + dv)) *
+                    20.0f;
+    }
+
+    return (value * 20.0f) - 10.0f;
+}
+
+//---------------------------------------------------------------------------
+/// Sums the compact Wyvill kernel of the metaballs listed in the tile of the
+/// primary ray, or in the grid cell containing the sample point.
+/// @param[in]  u       The uniform values.
+/// @param[in]  pos     World space position.
+/// @param[in]  color   Set to true to sum the color contributions.
+/// @param[out] sample  The field value and color sum.
+//---------------------------------------------------------------------------
+static void CompactMetaballField(const CpuUniforms& u, const glm::vec3& pos,
+                                 bool color, MetaballFieldSample& sample)
+{
+    // primary rays only need the metaballs of their tile
+    auto        count   = 0u;
+    const auto* indices = u._tile >= 0 ? u._tiles->GetTile(u._tile, count)
+                                       : u._grid->FindCell(pos, count);
+
+    const auto  invRadiusSq = 1.0f / (u._kernelRadius * u._kernelRadius);
+    const auto& c           = u._centers;
+
+    for (auto k = 0u; k < count; ++k)
+    {
+        const auto i  = indices[k];
+        const auto dx = pos.x - c._x[i];
+        const auto dy = pos.y - c._y[i];
+        const auto dz = pos.z - c._z[i];
+        const auto f  = 1.0f - (dx * dx + dy * dy + dz * dz) * invRadiusSq;
+
+        if (f <= 0.0f)
+            continue;
+
+        const auto value = u._kernelScale * f * f * f;
+        sample._value += value;
+
+        // the kernel value also weights the color
+        if (color)
+        {
+            sample._color += glm::vec3(c._r[i], c._g[i], c._b[i]) * value;
+
+            // d/dp K f³ = K 3f² * (-2 (p - c) / R²)
+            const auto slope = -6.0f * u._kernelScale * f * f * invRadiusSq;
+            sample._gradient += glm::vec3(dx, dy, dz) * slope;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+/// Sums the inverse square kernel with the Barnes-Hut approximation; distant
+/// octree nodes are evaluated as a single metaball.
+/// @param[in]  u       The uniform values.
+/// @param[in]  pos     World space position.
+/// @param[in]  color   Set to true to sum the color contributions.
+/// @param[out] sample  The field value and color sum.
+//---------------------------------------------------------------------------
+static void TreeMetaballField(const CpuUniforms& u, const glm::vec3& pos,
+                              bool color, MetaballFieldSample& sample)
+{
+    const auto& nodes     = u._octree->GetNodes();
+    const auto* indices   = u._octree->GetIndices().data();
+    const auto  nodeCount = int(nodes.size());
+    const auto& c         = u._centers;
+
+    auto i = 0;
+    while (i < nodeCount)
+    {
+        const auto& node = nodes[i];
+        const auto  d    = pos - node._center;
+        const auto  dist = glm::length(d);
+
+        // far node: a single metaball at the mean position
+        if (node._radius < u._openingAngle * dist)
+        {
+            const auto inv = 1.0f / glm::dot(d, d);
+            sample._value += node._count * inv;
+
+            if (color)
+            {
+                sample._color += node._color / dist;
+                sample._gradient += d * (-2.0f * node._count * inv * inv);
+            }
+
+            i = int(node._next);
+            continue;
+        }
+
+        // near inner node: visit the children
+        if (node._leafCount == 0.0f)
+        {
+            ++i;
+            continue;
+        }
+
+        // near leaf: evaluate the metaballs
+        const auto first = int(node._first);
+        const auto last  = first + int(node._leafCount);
+
+        for (auto k = first; k < last; ++k)
+        {
+            const auto      index = indices[k];
+            const glm::vec3 e(pos.x - c._x[index], pos.y - c._y[index],
+                              pos.z - c._z[index]);
+
+            const auto inv = 1.0f / glm::dot(e, e);
+            sample._value += inv;
+
+            if (color)
+            {
+                sample._color += glm::vec3(c._r[index], c._g[index],
+                                           c._b[index]) /
+                                 glm::length(e);
+                sample._gradient += e * (-2.0f * inv * inv);
+            }
+        }
+
+        i = int(node._next);
+    }
+}
+
+//---------------------------------------------------------------------------
+/// Signed distance to the metaball spheres, joined with the polynomial
+/// smooth minimum. The smooth minimum keeps the distance bound of the
+/// spheres, so the field can be sphere traced.
+/// @param[in]  u       The uniform values.
+/// @param[in]  pos     World space position.
+/// @param[in]  color   Set to true to blend the colors and the gradient.
+/// @param[out] sample  The distance and the blended color and gradient.
+//---------------------------------------------------------------------------
+template <class Spec>
+static void SmoothMinField(const CpuUniforms& u, const glm::vec3& pos,
+                           bool color, MetaballFieldSample& sample)
+{
+    const auto& c = u._centers;
+    const auto  k = u._blendDistance;
+
+    // farther than any surface of the scene
+    sample._value = 1e10f;
+
+    for (auto i = 0u; i < GetLoopCount<Spec>(c); ++i)
+    {
+        if (Spec::OBJECT_BUCKET > 0 && i >= c._count)
+            break;
+
+        const glm::vec3 e(pos.x - c._x[i], pos.y - c._y[i], pos.z - c._z[i]);
+        const auto      length   = glm::length(e);
+        const auto      distance = length - SDF_SPHERE_RADIUS;
+
+        // https://iquilezles.org/articles/smin/
+        const auto h =
+            glm::clamp(0.5f + 0.5f * (sample._value - distance) / k, 0.0f,
+                       1.0f);
+        const auto g = 1.0f - h;
+
+        // not mix(), which may evaluate x + (y - x) h and lose the distance
+        // against the initial value
+        sample._value = sample._value * g + distance * h - k * h * g;
+
+        // the derivatives of h cancel out
+        if (color)
+        {
+            const glm::vec3 rgb(c._r[i], c._g[i], c._b[i]);
+            sample._color    = sample._color * g + rgb * h;
+            sample._gradient = sample._gradient * g + (e / length) * h;
+        }
+    }
+}
+
+template <class Spec>
+MetaballFieldSample MetaballField(const CpuUniforms& u, const glm::vec3& pos,
+                                  bool color)
+{
+    MetaballFieldSample fieldSample;
+
+    if (u._densityVolume)
+    {
+        fieldSample._value = u._densityVolume->Sample(
+            pos, color ? &fieldSample._gradient : nullptr,
+            color ? &fieldSample._color : nullptr);
+        return fieldSample;
+    }
+
+    // https://en.wikipedia.org/wiki/Metaballs
+    if (u._kernel == MetaballKernel::WYVILL)
+        CompactMetaballField(u, pos, color, fieldSample);
+    else if (u._kernel == MetaballKernel::SMOOTH_MIN)
+        SmoothMinField<Spec>(u, pos, color, fieldSample);
+    else if (u._openingAngle > 0.0f)
+        TreeMetaballField(u, pos, color, fieldSample);
+    else
+        u._fieldKernel(u._centers, pos.x, pos.y, pos.z, color,
+                       fieldSample._value, &fieldSample._color[0],
+                       &fieldSample._gradient[0]);
+
+    // the noise would break the distance bound of the smooth minimum
+    if (Spec::HasNoise(u) && u._kernel != MetaballKernel::SMOOTH_MIN)
+    {
+        glm::vec3 noiseGradient;
+        fieldSample._value +=
+            GetRandomFieldValue(u, pos, color ? &noiseGradient : nullptr);
+
+        if (color)
+            fieldSample._gradient += noiseGradient;
+    }
+
+    if (color)
+        fieldSample._color = glm::normalize(fieldSample._color);
+
+    return fieldSample;
+}
+
+//---------------------------------------------------------------------------
+/// Samples the world space for metaballs.
+/// @param[in]  u           The uniform values.
+/// @param[in]  pos         World space position.
+/// @param[in]  fastMode    Set to true for fast calculation (without colors
+/// and normals).
+/// @return                 The sample result.
+//---------------------------------------------------------------------------
+template <class Spec>
+static SampleGlobalResult SampleMetaballMode(const CpuUniforms& u,
+                                             const glm::vec3& pos,
+                                             bool             fastMode)
+{
+    SampleGlobalResult res;
+
+    const auto fieldSample = MetaballField<Spec>(u, pos, !fastMode);
+    res._value             = fieldSample._value;
+
+    const auto distanceField = u._kernel == MetaballKernel::SMOOTH_MIN;
+    const auto inside        = distanceField
+                                   ? fieldSample._value <= SDF_HIT_DISTANCE
+                                   : fieldSample._value >= METABALL_THRESHOLD;
+
+    if (inside)
+    {
+        glm::vec3 normal{0.0f};
+
+        // the field decreases towards the outside, the distance increases
+        if (fastMode == false)
+            normal = glm::normalize(distanceField ? fieldSample._gradient
+                                                  : -fieldSample._gradient);
+
+        res._inside = true;
+        res._normal = normal;
+        res._pos    = pos;
+        res._color  = fieldSample._color;
+    }
+
+    return res;
+}
+
+template <class Spec>
+static SampleGlobalResult SampleGlobalSpace(const CpuUniforms& u,
+                                            const glm::vec3&   worldPos,
+                                            bool               fastMode)
+{
+    return SampleMetaballMode<Spec>(u, worldPos, fastMode);
+}
+
+//---------------------------------------------------------------------------
+/// Intersects a ray with the field bounds.
+/// @param[in]  u       The uniform values.
+/// @param[in]  start   The ray origin.
+/// @param[in]  dir     The ray direction; need not be normalized.
+/// @param[out] tEnter  Ray parameter where the ray enters the bounds.
+/// @param[out] tExit   Ray parameter where the ray leaves the bounds.
+/// @return             False if the ray misses the bounds.
+//---------------------------------------------------------------------------
+static bool ClipToBounds(const CpuUniforms& u, const glm::vec3& start,
+                         const glm::vec3& dir, float& tEnter, float& tExit)
+{
+    tEnter = 0.0f;
+    tExit  = std::numeric_limits<float>::max();
+
+    for (auto a = 0; a < 3; ++a)
+    {
+        // avoid the division by zero of axis parallel rays
+        const auto d  = std::fabs(dir[a]) < 1e-8f ? 1e-8f : dir[a];
+        const auto t0 = (u._boundsMin[a] - start[a]) / d;
+        const auto t1 = (u._boundsMax[a] - start[a]) / d;
+        tEnter        = glm::max(tEnter, glm::min(t0, t1));
+        tExit         = glm::min(tExit, glm::max(t0, t1));
+    }
+
+    return tEnter <= tExit;
+}
+
+//---------------------------------------------------------------------------
+/// Sphere traces the distance field of MetaballKernel::SMOOTH_MIN; each step
+/// advances by the distance to the closest surface.
+/// @param[in]  u           The uniform values.
+/// @param[in]  startPos    Ray origin.
+/// @param[in]  sampleStep  Ray direction; the unit of the ray parameters.
+/// @param[in]  tEnter      Ray parameter where the tracing starts.
+/// @param[in]  tEnd        Ray parameter where the tracing stops.
+/// @return                 The result; _inside is false if no surface was
+/// found.
+//---------------------------------------------------------------------------
+template <class Spec>
+static SampleGlobalResult SphereTrace(const CpuUniforms& u,
+                                      const glm::vec3&   startPos,
+                                      const glm::vec3& sampleStep,
+                                      float tEnter, float tEnd)
+{
+    const auto stepLength = glm::length(sampleStep);
+
+    SampleGlobalResult res;
+    auto               t = tEnter;
+
+    for (auto i = 0; i < SPHERE_TRACE_STEPS && t <= tEnd; ++i)
+    {
+        const auto pos = startPos + sampleStep * t;
+
+        res = SampleGlobalSpace<Spec>(u, pos, true);
+        if (res._inside)
+            return SampleGlobalSpace<Spec>(u, pos, false);
+
+        t += res._value / stepLength;
+    }
+
+    return res;
+}
+
+//---------------------------------------------------------------------------
+/// Refines the bracket [outside, inside] of a surface hit with the Illinois
+/// variant of the false position method.
+/// @param[in]  u               The uniform values.
+/// @param[in]  outsidePos      Position outside of the surface.
+/// @param[in]  insidePos       Position inside of the surface.
+/// @param[in]  outsideField    Field value at outsidePos.
+/// @param[in]  insideField     Field value at insidePos.
+/// @return                     The full sample at the inside end.
+//---------------------------------------------------------------------------
+template <class Spec>
+static SampleGlobalResult RefineSurface(const CpuUniforms& u,
+                                        glm::vec3          outsidePos,
+                                        glm::vec3          insidePos,
+                                        float outsideField, float insideField)
+{
+    auto outsideValue = outsideField - METABALL_THRESHOLD;
+    auto insideValue  = insideField - METABALL_THRESHOLD;
+    auto side         = 0;
+
+    for (auto i = 0; i < SURFACE_REFINE_STEPS; ++i)
+    {
+        const auto t   = outsideValue / (outsideValue - insideValue);
+        const auto pos = glm::mix(outsidePos, insidePos, t);
+        const auto value =
+            SampleGlobalSpace<Spec>(u, pos, true)._value - METABALL_THRESHOLD;
+
+        if (value >= 0.0f)
+        {
+            insidePos   = pos;
+            insideValue = value;
+            if (side == 1)
+                outsideValue *= 0.5f;
+            side = 1;
+        }
+        else
+        {
+            outsidePos   = pos;
+            outsideValue = value;
+            if (side == -1)
+                insideValue *= 0.5f;
+            side = -1;
+        }
+    }
+
+    return SampleGlobalSpace<Spec>(u, insidePos, false);
+}
+
+//---------------------------------------------------------------------------
+/// Upper bound of the exact metaball field on a ray interval. Along the ray
+/// each inverse square term is 1 / (a t^2 + b t + c); its maximum on the
+/// interval is at the point closest to the metaball, as for the Wyvill
+/// kernel. With a radius the bound holds for the capsule around the interval.
+/// @param[in]  u           The uniform values.
+/// @param[in]  startPos    Ray origin.
+/// @param[in]  sampleStep  Ray direction; the unit of the ray parameters.
+/// @param[in]  t0          Start of the interval.
+/// @param[in]  t1          End of the interval.
+/// @param[in]  radius      Capsule radius in world units; 0 for the ray.
+/// @return                 The upper bound, including the noise amplitude.
+//---------------------------------------------------------------------------
+template <class Spec>
+static float FieldUpperBound(const CpuUniforms& u, const glm::vec3& startPos,
+                             const glm::vec3& sampleStep, float t0, float t1,
+                             float radius)
+{
+    const auto& c       = u._centers;
+    const auto  a       = startPos + sampleStep * t0;
+    const auto  segment = sampleStep * (t1 - t0);
+    const auto  invSq   = 1.0f / glm::dot(segment, segment);
+
+    const auto invRadiusSq = 1.0f / (u._kernelRadius * u._kernelRadius);
+
+    auto bound = 0.0f;
+
+    for (auto i = 0u; i < GetLoopCount<Spec>(c); ++i)
+    {
+        if (Spec::OBJECT_BUCKET > 0 && i >= c._count)
+            break;
+
+        const glm::vec3 e(c._x[i] - a.x, c._y[i] - a.y, c._z[i] - a.z);
+        const auto s = glm::clamp(glm::dot(e, segment) * invSq, 0.0f, 1.0f);
+        const auto d = e - segment * s;
+
+        auto distSq = glm::dot(d, d);
+        if (radius > 0.0f)
+        {
+            const auto dist = glm::max(std::sqrt(distSq) - radius, 0.0f);
+            distSq          = dist * dist;
+        }
+
+        if (u._kernel == MetaballKernel::WYVILL)
+        {
+            const auto f = 1.0f - distSq * invRadiusSq;
+            if (f > 0.0f)
+                bound += u._kernelScale * f * f * f;
+        }
+        else
+        {
+            bound += 1.0f / distSq;
+        }
+    }
+
+    if (Spec::HasNoise(u))
+        bound += NOISE_FIELD_AMPLITUDE;
+
+    return bound;
+}
+
+//---------------------------------------------------------------------------
+/// Finds the first surface hit of the exact inverse square field. Intervals
+/// whose field bound stays below METABALL_THRESHOLD are skipped and grow,
+/// others are halved down to INTERVAL_MIN_WIDTH and sampled at their end.
+/// Features thicker than INTERVAL_MIN_WIDTH sample steps are never missed.
+/// Stops after INTERVAL_TRACE_STEPS, e.g. in the wide undecided band of the
+/// noise; the caller marches the rest of the ray.
+/// @param[in]     u            The uniform values.
+/// @param[in]     startPos     Ray origin.
+/// @param[in]     sampleStep   Ray direction; the unit of the ray parameters.
+/// @param[in,out] t            Ray parameter where the search starts; where
+/// it stopped, outside the surface, if no surface was found.
+/// @param[in]     tEnd         Ray parameter where the search stops.
+/// @return                     The result; _inside is false if no surface
+/// was found before t.
+//---------------------------------------------------------------------------
+template <class Spec>
+static SampleGlobalResult IntervalTrace(const CpuUniforms& u,
+                                        const glm::vec3&   startPos,
+                                        const glm::vec3& sampleStep, float& t,
+                                        float tEnd)
+{
+    if (SampleGlobalSpace<Spec>(u, startPos + sampleStep * t, true)._inside)
+        return SampleGlobalSpace<Spec>(u, startPos + sampleStep * t, false);
+
+    // the big step of the linear search
+    auto width = 10.0f;
+
+    for (auto i = 0; i < INTERVAL_TRACE_STEPS && t < tEnd; ++i)
+    {
+        const auto t1 = glm::min(t + width, tEnd);
+
+        if (FieldUpperBound<Spec>(u, startPos, sampleStep, t, t1, 0.0f) <
+            METABALL_THRESHOLD)
+        {
+            t = t1;
+            width *= 2.0f;
+            continue;
+        }
+
+        if (t1 - t > INTERVAL_MIN_WIDTH)
+        {
+            width = (t1 - t) * 0.5f;
+            continue;
+        }
+
+        const auto outsidePos = startPos + sampleStep * t;
+        const auto insidePos  = startPos + sampleStep * t1;
+        const auto res        = SampleGlobalSpace<Spec>(u, insidePos, true);
+
+        // the start of the interval is outside but not necessarily sampled
+        if (res._inside)
+        {
+            const auto outside = SampleGlobalSpace<Spec>(u, outsidePos, true);
+            return RefineSurface<Spec>(u, outsidePos, insidePos,
+                                       outside._value, res._value);
+        }
+
+        t     = t1;
+        width = INTERVAL_MIN_WIDTH * 2.0f;
+    }
+
+    return SampleGlobalResult();
+}
+
+template <class Spec>
+SampleGlobalResult SampleToSurface(const CpuUniforms& u,
+                                   const glm::vec3&   startPos,
+                                   const glm::vec3& sampleStep, int count)
+{
+    SampleGlobalResult res;
+
+    // in units of sampleStep
+    auto tEnter = 0.0f;
+    auto tExit  = 0.0f;
+    if (ClipToBounds(u, startPos, sampleStep, tEnter, tExit) == false)
+        return res;
+
+    if (u._kernel == MetaballKernel::SMOOTH_MIN)
+        return SphereTrace<Spec>(u, startPos, sampleStep, tEnter,
+                                 glm::min(tExit, float(count)));
+
+    const auto tEnd = glm::min(tExit, float(count));
+
+    // the bound only holds for the exact field
+    if (u._intervalRays && u._kernel == MetaballKernel::INVERSE_SQUARE &&
+        u._openingAngle <= 0.0f && !u._densityVolume)
+    {
+        res = IntervalTrace<Spec>(u, startPos, sampleStep, tEnter, tEnd);
+
+        // out of steps; the linear search continues where it stopped
+        if (res._inside || tEnter >= tEnd)
+            return res;
+    }
+
+    const auto bigStep   = sampleStep * 10.0f;
+    const auto bigCount  = int(std::ceil((tEnd - tEnter) * .1f));
+    const auto clipStart = startPos + sampleStep * tEnter;
+
+    auto lastPos    = clipStart;
+    auto currentPos = clipStart + bigStep;
+
+    SampleGlobalResult lastRes;
+
+    for (auto i = 0; i < bigCount; ++i)
+    {
+        lastRes = res;
+        res     = SampleGlobalSpace<Spec>(u, currentPos, true);
+        if (res._inside)
+            break;
+
+        lastPos    = currentPos;
+        currentPos = currentPos + bigStep;
+
+        // the rest of an empty brick is outside as well
+        if (u._densityVolume)
+        {
+            const auto span =
+                u._densityVolume->GetEmptySpan(lastPos, sampleStep) * 0.1f;
+
+            if (span >= 2.0f)
+            {
+                const auto skip = int(span);
+                currentPos      = lastPos + bigStep * float(skip);
+                i += skip - 1;
+            }
+        }
+    }
+
+    if (res._inside == false)
+        return res;
+
+    // the start position was not sampled
+    if (lastPos == clipStart)
+    {
+        lastRes = SampleGlobalSpace<Spec>(u, clipStart, true);
+        if (lastRes._inside)
+            return SampleGlobalSpace<Spec>(u, clipStart, false);
+    }
+
+    return RefineSurface<Spec>(u, lastPos, currentPos, lastRes._value,
+                               res._value);
+}
+
+// ----------------------------------------------------------------------
+/// Shading utility
+// ----------------------------------------------------------------------
+
+static float LambertianLighting(const glm::vec3& normal,
+                                const glm::vec3& lightDir)
+{
+    const auto diffuse = glm::dot(lightDir, normal);
+    return glm::max(diffuse, 0.0f);
+}
+
+static float PhongSpecular(const CpuUniforms& u, const glm::vec3& normal,
+                           const glm::vec3& lightDir, const glm::vec3& pos)
+{
+    const auto& N = normal;
+    const auto& L = lightDir;
+
+    const auto R = glm::normalize(-glm::reflect(L, N));
+    const auto E = glm::normalize(u._camPos - pos);
+
+    const auto specular = std::pow(glm::max(glm::dot(R, E), 0.0f), 40.0f);
+    return glm::max(specular, 0.0f);
+}
+
+static float FresnelFx(const CpuUniforms& u, const glm::vec3& normal,
+                       const glm::vec3& pos)
+{
+    const auto fresnel = glm::dot(normal, glm::normalize(u._camPos - pos));
+    return 1.0f - fresnel;
+}
+
+template <class Spec>
+static bool HardShadow(const CpuUniforms& u, glm::vec3 pos)
+{
+    if (pos.y > 2.0f)
+        return false;
+
+    if (u._shadowMap)
+        return u._shadowMap->IsShadowed(pos);
+
+    const auto sampleDirection = GetLightDir();
+    const auto scale           = 0.05f;
+    const auto sampleStep      = sampleDirection * scale;
+    pos                        = pos + sampleStep;
+
+    const auto steps = int((2.5f - pos.y) / scale);
+
+    const auto res = SampleToSurface<Spec>(u, pos, sampleStep, steps);
+
+    return res._inside;
+}
+
+template <class Spec>
+static glm::vec3 VolumeLight(const CpuUniforms& u, const glm::vec3& pos)
+{
+    // sample out
+
+    const auto sampleDir = glm::normalize(pos - u._camPos) * 0.02f;
+
+    auto currentPos = pos + sampleDir;
+    auto count      = 0.0f;
+
+    for (auto i = 0; i < 50; ++i)
+    {
+        const auto res = SampleGlobalSpace<Spec>(u, currentPos, true);
+
+        if (res._inside)
+            count++;
+        else
+            break;
+
+        currentPos = currentPos + sampleDir;
+    }
+
+    count = count * .5f;
+
+    // up; the light volume stores the same march for the voxel centers
+    if (u._lightVolume)
+    {
+        count += u._lightVolume->GetSampleCount(currentPos);
+    }
+    else
+    {
+        const auto sampleDirLight = GetLightDir() * LIGHT_VOLUME_SAMPLE_STEP;
+
+        for (auto i = 0; i < 100; ++i)
+        {
+            const auto res = SampleGlobalSpace<Spec>(u, currentPos, true);
+
+            if (res._inside)
+                count++;
+
+            // _pos is only set for samples inside the field
+            if (res._pos.y > 2.0f)
+                break;
+
+            currentPos = currentPos + sampleDirLight;
+        }
+    }
+
+    const auto value = count * 0.01f;
+
+    const auto red   = glm::clamp(1.0f - (value * 1.0f), 0.0f, 1.0f);
+    const auto green = glm::clamp(1.0f - (value * 4.0f), 0.0f, 1.0f);
+    const auto blue  = glm::clamp(1.0f - (value * 9.0f), 0.0f, 1.0f);
+
+    return glm::vec3(red, green, blue);
+}
+
+float LightVolumeDensity(const CpuUniforms& u, const glm::vec3& pos)
+{
+    const auto res = SampleGlobalSpace<GenericShader>(u, pos, true);
+    return res._inside ? 1.0f : 0.0f;
+}
+
+template <class Spec>
+glm::vec3 FinalCompositing(const CpuUniforms& u, const SampleGlobalResult& res)
+{
+    const glm::vec3 errorColor(1.0f, 0.0f, 1.0f);
+
+    if (res._inside == false)
+        return errorColor;
+
+    const auto& normal   = res._normal;
+    const auto  lightDir = GetLightDir();
+    const auto& pos      = res._pos;
+
+    switch (Spec::GetShadingMode(u))
+    {
+    case 1:
+        return normal;
+    case 2:
+        return glm::vec3(LambertianLighting(normal, lightDir));
+    case 3:
+        return glm::vec3(PhongSpecular(u, normal, lightDir, pos));
+    case 4:
+        return glm::vec3(FresnelFx(u, normal, pos));
+    case 5:
+        return glm::vec3(HardShadow<Spec>(u, pos) ? 0.0f : 1.0f);
+    case 6:
+        return VolumeLight<Spec>(u, pos);
+    case 7:
+        return res._color;
+    case 8:
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+    case 9:
+    {
+        const glm::vec3 baseColor(0.5f, 0.0f, 0.0f);
+        const auto      light       = LambertianLighting(normal, lightDir);
+        const auto      specular    = PhongSpecular(u, normal, lightDir, pos);
+        const auto      fresnel     = FresnelFx(u, normal, pos);
+        const auto      volumeLight = VolumeLight<Spec>(u, pos);
+        const auto      shadow      = HardShadow<Spec>(u, pos) ? 0.0f : 1.0f;
+
+        auto color = baseColor * light * shadow + (specular * shadow) +
+                     (volumeLight * 0.3f);
+        color += (fresnel * 0.6f * baseColor);
+        color += (baseColor * 0.1f);
+        return color;
+    }
+    case 0:
+    {
+        const auto light    = LambertianLighting(normal, lightDir);
+        const auto specular = PhongSpecular(u, normal, lightDir, pos);
+        const auto fresnel  = FresnelFx(u, normal, pos);
+        const auto shadow   = HardShadow<Spec>(u, pos) ? 0.0f : 1.0f;
+
+        auto color = res._color * light * shadow + (specular * shadow);
+        color += (fresnel * 0.6f * res._color);
+        color += (res._color * 0.1f);
+        return color;
+    }
+    default:
+        break;
+    }
+
+    // error
+    return errorColor;
+}
+
+//---------------------------------------------------------------------------
+/// Returns a color value based on the error value in the given result object.
+//---------------------------------------------------------------------------
+static glm::vec3 ErrorToColor(const SampleGlobalResult& res)
+{
+    if (res._error == ERROR_UNKNOWN)
+        return glm::vec3(1.0f, 0.0f, 0.0f); // red
+
+    if (res._error == ERROR_ILLEGALMODE)
+        return glm::vec3(1.0f, 1.0f, 0.0f); // yellow
+
+    return glm::vec3(1.0f, 0.0f, 1.0f); // pink
+}
+
+//---------------------------------------------------------------------------
+/// Returns where a primary ray can start, given the hit of the previous frame.
+/// The field is checked with FieldUpperBound() up to the start. A previous
+/// miss skips the whole ray if the bound stays below the threshold. The
+/// distance field is always marched in full: the displacement only bounds
+/// its change at the previous hit, not along the skipped segment.
+/// @param[in]  u           The uniform values.
+/// @param[in]  startPos    Ray origin on the view plane.
+/// @param[in]  sampleStep  Ray direction; the unit of the result.
+/// @param[in]  count       The number of steps of the ray.
+/// @param[in]  previousHit Distance of the previous hit to the view plane;
+/// negative for none.
+/// @return                 The ray parameter to start at; 0 for a full march,
+/// count if there is no hit.
+//---------------------------------------------------------------------------
+template <class Spec>
+static float GetRayStart(const CpuUniforms& u, const glm::vec3& startPos,
+                         const glm::vec3& sampleStep, int count,
+                         float previousHit)
+{
+    if (u._displacement < 0.0f)
+        return 0.0f;
+
+    // the bound does not hold for the approximation and the baked field
+    const auto bounded =
+        !u._densityVolume &&
+        (u._kernel == MetaballKernel::WYVILL ||
+         (u._kernel == MetaballKernel::INVERSE_SQUARE &&
+          u._openingAngle <= 0.0f));
+
+    if (previousHit < 0.0f)
+    {
+        if (bounded && FieldUpperBound<Spec>(u, startPos, sampleStep, 0.0f,
+                                             float(count),
+                                             0.0f) < METABALL_THRESHOLD)
+            return float(count);
+
+        return 0.0f;
+    }
+
+    const auto distance =
+        previousHit - u._displacement - REPROJECTION_MARGIN;
+    if (distance <= 0.0f)
+        return 0.0f;
+
+    const auto t = distance / glm::length(sampleStep);
+
+    if (bounded && FieldUpperBound<Spec>(u, startPos, sampleStep, 0.0f, t,
+                                         0.0f) < METABALL_THRESHOLD)
+        return t;
+
+    // e.g. a metaball moved in front of the previous hit
+    return 0.0f;
+}
+
+float ConeMarch(const CpuUniforms& u, const glm::vec3& center,
+                const glm::vec3& halfX, const glm::vec3& halfY, float start)
+{
+    const auto end  = PRIMARY_RAY_STEPS * PRIMARY_RAY_STEP;
+    const auto axis = glm::normalize(center - u._camPos);
+
+    // at distance s the rays are at most radius + spread * s away from the
+    // axis; both are largest at the corners
+    auto radius = 0.0f;
+    auto spread = 0.0f;
+
+    for (const auto& corner : {halfX + halfY, halfX - halfY, -halfX + halfY,
+                               -halfX - halfY})
+    {
+        const auto dir = glm::normalize(center + corner - u._camPos);
+        radius         = glm::max(radius, glm::length(corner));
+        spread         = glm::max(spread, glm::length(dir - axis));
+    }
+
+    // the bounds hold for the centers, not for the interpolated field
+    if (u._densityVolume)
+        return start;
+
+    auto s = start;
+
+    if (u._kernel == MetaballKernel::SMOOTH_MIN)
+    {
+        for (auto i = 0; i < CONE_MARCH_STEPS && s < end; ++i)
+        {
+            const auto pos       = center + axis * s;
+            const auto distance  = MetaballField(u, pos, false)._value;
+            const auto clearance = distance - (radius + spread * s);
+
+            if (clearance < SDF_HIT_DISTANCE)
+                break;
+
+            // the rays approach the sample point by up to 1 + spread
+            s += clearance / (1.0f + spread);
+        }
+
+        return glm::min(s, end);
+    }
+
+    // the bound does not hold for the approximation
+    if (u._kernel == MetaballKernel::INVERSE_SQUARE && u._openingAngle > 0.0f)
+        return start;
+
+    // the big step of the linear search
+    auto width = PRIMARY_RAY_STEP * 10.0f;
+
+    for (auto i = 0; i < CONE_MARCH_STEPS && s < end; ++i)
+    {
+        const auto s1 = glm::min(s + width, end);
+
+        const auto bound = FieldUpperBound<GenericShader>(
+            u, center, axis, s, s1, radius + spread * s1);
+
+        if (bound < METABALL_THRESHOLD)
+        {
+            s = s1;
+            width *= 2.0f;
+            continue;
+        }
+
+        if (s1 - s <= CONE_MIN_WIDTH)
+            break;
+
+        width = (s1 - s) * 0.5f;
+    }
+
+    return s;
+}
+
+template <class Spec>
+GBufferTexel VolumeGeometry(const CpuUniforms& u, const glm::vec3& worldPos,
+                            float coneDistance, float previousHit,
+                            float& hitDistance)
+{
+    const auto& startPos        = worldPos;
+    const auto  sampleDirection = glm::normalize(worldPos - u._camPos);
+    const auto  sampleStep      = sampleDirection * PRIMARY_RAY_STEP;
+
+    // skip the part of the ray the surface cannot have reached
+    const auto count  = PRIMARY_RAY_STEPS;
+    const auto tStart =
+        glm::max(GetRayStart<Spec>(u, startPos, sampleStep, count, previousHit),
+                 coneDistance / PRIMARY_RAY_STEP);
+
+    // the tile is only valid along the primary ray; shadows and lighting
+    // sample other directions
+    auto tileUniforms = u;
+    if (u._kernel == MetaballKernel::WYVILL)
+        tileUniforms._tile = u._tiles->FindTile(worldPos);
+
+    GBufferTexel texel;
+    texel._surface =
+        SampleToSurface<Spec>(tileUniforms, startPos + sampleStep * tStart,
+                              sampleStep, count - int(tStart));
+    texel._brightness = texel._surface._inside ? 1.0f : 0.0f;
+
+    hitDistance = texel._surface._inside
+                      ? glm::length(texel._surface._pos - startPos)
+                      : -1.0f;
+
+    return texel;
+}
+
+template <class Spec>
+GBufferTexel GroundGeometry(const CpuUniforms& u, const glm::vec3& worldPos)
+{
+    const glm::vec3 sampleDirection(0.0f, 1.0f, 0.0f);
+    const auto      sampleStep = sampleDirection * 0.01f;
+    const auto      startPos   = worldPos + sampleStep;
+
+    GBufferTexel texel;
+    texel._surface    = SampleToSurface<Spec>(u, startPos, sampleStep, 400);
+    texel._brightness = texel._surface._inside ? .3f : 0.0f;
+
+    return texel;
+}
+
+template <class Spec>
+glm::vec4 DeferredShader(const CpuUniforms& u, const GBufferTexel& texel)
+{
+    if (texel._surface._error != ERROR_NONE)
+        return glm::vec4(ErrorToColor(texel._surface), 1.0f);
+
+    // the background
+    if (texel._brightness == 0.0f)
+        return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    return glm::vec4(
+        FinalCompositing<Spec>(u, texel._surface) * texel._brightness, 1.0f);
+}
+
+template <class Spec>
+glm::vec4 VolumeShader(const CpuUniforms& u, const glm::vec3& worldPos,
+                       float coneDistance, float previousHit,
+                       float& hitDistance)
+{
+    const auto texel = VolumeGeometry<Spec>(u, worldPos, coneDistance,
+                                            previousHit, hitDistance);
+
+    // transparent; the background shows through
+    if (texel._surface._error == ERROR_NONE && texel._brightness == 0.0f)
+        return glm::vec4(0.0f);
+
+    return DeferredShader<Spec>(u, texel);
+}
+
+template <class Spec>
+glm::vec4 GroundShader(const CpuUniforms& u, const glm::vec3& worldPos)
+{
+    if (u._groundMap)
+        return u._groundMap->GetColor(worldPos);
+
+    return DeferredShader<Spec>(u, GroundGeometry<Spec>(u, worldPos));
+}
+
+MetaballFieldSample MetaballField(const CpuUniforms& u, const glm::vec3& pos,
+                                  bool color)
+{
+    return MetaballField<GenericShader>(u, pos, color);
+}
+
+SampleGlobalResult SampleToSurface(const CpuUniforms& u,
+                                   const glm::vec3&   startPos,
+                                   const glm::vec3& sampleStep, int count)
+{
+    return SampleToSurface<GenericShader>(u, startPos, sampleStep, count);
+}
+
+glm::vec3 FinalCompositing(const CpuUniforms& u, const SampleGlobalResult& res)
+{
+    return FinalCompositing<GenericShader>(u, res);
+}
+
+glm::vec4 VolumeShader(const CpuUniforms& u, const glm::vec3& worldPos,
+                       float coneDistance, float previousHit,
+                       float& hitDistance)
+{
+    return VolumeShader<GenericShader>(u, worldPos, coneDistance, previousHit,
+                                       hitDistance);
+}
+
+glm::vec4 GroundShader(const CpuUniforms& u, const glm::vec3& worldPos)
+{
+    return GroundShader<GenericShader>(u, worldPos);
+}
+
+GBufferTexel VolumeGeometry(const CpuUniforms& u, const glm::vec3& worldPos,
+                            float coneDistance, float previousHit,
+                            float& hitDistance)
+{
+    return VolumeGeometry<GenericShader>(u, worldPos, coneDistance,
+                                         previousHit, hitDistance);
+}
+
+GBufferTexel GroundGeometry(const CpuUniforms& u, const glm::vec3& worldPos)
+{
+    return GroundGeometry<GenericShader>(u, worldPos);
+}
+
+glm::vec4 DeferredShader(const CpuUniforms& u, const GBufferTexel& texel)
+{
+    return DeferredShader<GenericShader>(u, texel);
+}
+
+//---------------------------------------------------------------------------
+/// Returns the shaders of the given specialization.
+//---------------------------------------------------------------------------
+template <int ShadingMode, int Noise, unsigned int ObjectBucket>
+static CpuShaders MakeCpuShaders()
+{
+    using Spec = Specialization<ShadingMode, Noise, ObjectBucket>;
+
+    CpuShaders shaders;
+    shaders._volumeShader   = VolumeShader<Spec>;
+    shaders._groundShader   = GroundShader<Spec>;
+    shaders._volumeGeometry = VolumeGeometry<Spec>;
+    shaders._groundGeometry = GroundGeometry<Spec>;
+    shaders._deferredShader = DeferredShader<Spec>;
+    return shaders;
+}
+
+//---------------------------------------------------------------------------
+/// Selects the object bucket of the shaders.
+//---------------------------------------------------------------------------
+template <int ShadingMode, int Noise>
+static CpuShaders SelectObjectBucket(unsigned int objectBucket)
+{
+    switch (objectBucket)
+    {
+    case SMALL_OBJECT_BUCKET:
+        return MakeCpuShaders<ShadingMode, Noise, SMALL_OBJECT_BUCKET>();
+    case LARGE_OBJECT_BUCKET:
+        return MakeCpuShaders<ShadingMode, Noise, LARGE_OBJECT_BUCKET>();
+    default:
+        break;
+    }
+
+    return MakeCpuShaders<ShadingMode, Noise, 0>();
+}
+
+//---------------------------------------------------------------------------
+/// Selects the noise value and the object bucket of the shaders.
+//---------------------------------------------------------------------------
+template <int ShadingMode>
+static CpuShaders SelectNoise(unsigned int noise, unsigned int objectBucket)
+{
+    if (noise == 1)
+        return SelectObjectBucket<ShadingMode, 1>(objectBucket);
+
+    return SelectObjectBucket<ShadingMode, 0>(objectBucket);
+}
+
+CpuShaders GetCpuShaders(unsigned int shadingMode, unsigned int noise,
+                         unsigned int objectBucket)
+{
+    switch (shadingMode)
+    {
+    case 0:
+        return SelectNoise<0>(noise, objectBucket);
+    case 1:
+        return SelectNoise<1>(noise, objectBucket);
+    case 2:
+        return SelectNoise<2>(noise, objectBucket);
+    case 3:
+        return SelectNoise<3>(noise, objectBucket);
+    case 4:
+        return SelectNoise<4>(noise, objectBucket);
+    case 5:
+        return SelectNoise<5>(noise, objectBucket);
+    case 6:
+        return SelectNoise<6>(noise, objectBucket);
+    case 7:
+        return SelectNoise<7>(noise, objectBucket);
+    case 8:
+        return SelectNoise<8>(noise, objectBucket);
+    case 9:
+        return SelectNoise<9>(noise, objectBucket);
+    default:
+        break;
+    }
+
+    // the generic shaders return the error color
+    return CpuShaders();
+}
@@ -0,0 +1,292 @@
+#ifndef VOLUME_DEMO_CPUSHADER_H__
+#define VOLUME_DEMO_CPUSHADER_H__
+
+#include "fieldkernel.h"
+#include "glm/glm.hpp"
+#include "scene.h"
+
+class DensityVolume;
+class GroundMap;
+class LightVolume;
+struct NoiseData;
+class Octree;
+class ShadowMap;
+class SpatialGrid;
+class TileLists;
+
+// CPU implementation of shader/fragment_head.glsl, shader/volume_body.glsl and
+// shader/ground_body.glsl. The functions mirror their GLSL counterparts; keep
+// both in sync.
+
+//---------------------------------------------------------------------------
+/// CPU counterpart of the fragment shader uniform variables.
+//---------------------------------------------------------------------------
+struct CpuUniforms
+{
+    glm::vec3            _camPos;        ///< camera position in world space.
+    const NoiseData*     _noiseTexture;  ///< slice or volume, see noise.h.
+    unsigned int         _noise;         ///< noise effect on (1) or off (0).
+    float                _animation;     ///< animation time value.
+    unsigned int         _shadingMode;   ///< shading mode.
+    MetaballCenters      _centers;       ///< metaball influencer.
+    FieldKernel          _fieldKernel;   ///< kernel evaluating the centers.
+    MetaballKernel       _kernel;        ///< metaball function.
+    float                _kernelRadius;  ///< radius of the compact kernel.
+    float                _kernelScale;   ///< scale of the compact kernel.
+    const SpatialGrid*   _grid;          ///< grid for the compact kernel.
+    const TileLists*     _tiles;         ///< tiles for the compact kernel.
+    int                  _tile;          ///< tile of the primary ray; or -1.
+    const Octree*        _octree;        ///< tree for the approximation.
+    float                _openingAngle;  ///< 0 to evaluate every metaball.
+    bool                 _intervalRays;  ///< interval root finding on/off.
+    float                _displacement;  ///< see ReprojectionHistory.
+    const ShadowMap*     _shadowMap;     ///< nullptr to march shadow rays.
+    const LightVolume*   _lightVolume;   ///< nullptr to march to the light.
+    const GroundMap*     _groundMap;     ///< nullptr to march up the ground.
+    const DensityVolume* _densityVolume; ///< nullptr to sum the centers.
+    float                _blendDistance; ///< blend of the smooth minimum.
+    glm::vec3            _boundsMin;     ///< see GetFieldBounds().
+    glm::vec3            _boundsMax;     ///< see GetFieldBounds().
+};
+
+// error codes for SampleGlobalResult::_error
+static constexpr auto ERROR_NONE        = 0;
+static constexpr auto ERROR_UNKNOWN     = 1;
+static constexpr auto ERROR_ILLEGALMODE = 2;
+
+/// Number of field evaluations refining a surface hit in SampleToSurface().
+static constexpr auto SURFACE_REFINE_STEPS = 6;
+
+/// Maximum number of interval tests and samples of one ray, see
+/// SceneSettings::_intervalRays.
+static constexpr auto INTERVAL_TRACE_STEPS = 256;
+
+/// Width in sample steps below which intervals are sampled instead of split.
+static constexpr auto INTERVAL_MIN_WIDTH = 1.0f;
+
+/// Maximum number of sphere tracing steps with MetaballKernel::SMOOTH_MIN.
+static constexpr auto SPHERE_TRACE_STEPS = 64;
+
+/// Distance below which sphere tracing counts as a surface hit.
+static constexpr auto SDF_HIT_DISTANCE = 1e-3f;
+
+/// Number and length of the steps of the primary rays, see VolumeShader().
+static constexpr auto PRIMARY_RAY_STEPS = 200;
+static constexpr auto PRIMARY_RAY_STEP  = 0.01f;
+
+/// Maximum number of bound tests or distance samples of one cone, see
+/// ConeMarch().
+static constexpr auto CONE_MARCH_STEPS = 64;
+
+/// Length in world units below which ConeMarch() stops splitting intervals.
+static constexpr auto CONE_MIN_WIDTH = 0.02f;
+
+//---------------------------------------------------------------------------
+/// Structure storing data from sampling space.
+//---------------------------------------------------------------------------
+struct SampleGlobalResult
+{
+    bool      _inside = false; ///< true if sample point is "inside".
+    glm::vec3 _normal{0.0f};   ///< normal vector
+    glm::vec3 _color{0.0f};    ///< color
+    int       _error = ERROR_NONE; ///< error code
+    glm::vec3 _pos{0.0f};          ///< world space position
+    float     _value = 0.0f;       ///< field value; also set if not inside.
+};
+
+//---------------------------------------------------------------------------
+/// Result of a metaball field evaluation.
+//---------------------------------------------------------------------------
+struct MetaballFieldSample
+{
+    float     _value = 0.0f;
+    glm::vec3 _color{0.0f};
+    glm::vec3 _gradient{0.0f};
+};
+
+//---------------------------------------------------------------------------
+/// Samples the world metaball field. The color and the analytic gradient are
+/// computed in the same pass over the metaballs. With a density volume the
+/// baked field is interpolated instead; it includes the noise.
+/// @param[in]  u       The uniform values.
+/// @param[in]  pos     World space position.
+/// @param[in]  color   Set to true to calculate the interpolated color and
+/// the gradient.
+/// @return             The field value and the optional color and gradient;
+/// the signed distance with MetaballKernel::SMOOTH_MIN.
+//---------------------------------------------------------------------------
+MetaballFieldSample MetaballField(const CpuUniforms& u, const glm::vec3& pos,
+                                  bool color);
+
+//---------------------------------------------------------------------------
+/// Samples space until a surface was found. Steps at ten times sampleStep
+/// inside the field bounds; the hit is refined between the last two samples.
+/// The distance field of MetaballKernel::SMOOTH_MIN is sphere traced instead,
+/// the exact inverse square field is bounded on intervals if
+/// CpuUniforms::_intervalRays is set.
+/// @param[in]  u           The uniform values.
+/// @param[in]  startPos    Sampling start position.
+/// @param[in]  sampleStep  A sampling step.
+/// @param[in]  count       The maximum number of steps.
+/// @return                 The result; _inside is false if no surface was
+/// found.
+//---------------------------------------------------------------------------
+SampleGlobalResult SampleToSurface(const CpuUniforms& u,
+                                   const glm::vec3&   startPos,
+                                   const glm::vec3& sampleStep, int count);
+
+//---------------------------------------------------------------------------
+/// Samples the occupancy of the field at a voxel center of the light volume
+/// (light_volume_body.glsl).
+/// @param[in]  u       The uniform values.
+/// @param[in]  pos     World space position.
+/// @return             1 inside the field, else 0.
+//---------------------------------------------------------------------------
+float LightVolumeDensity(const CpuUniforms& u, const glm::vec3& pos);
+
+//---------------------------------------------------------------------------
+/// Shades the given surface sample according to the shading mode.
+/// @param[in]  u       The uniform values.
+/// @param[in]  res     The surface sample.
+/// @return             The color.
+//---------------------------------------------------------------------------
+glm::vec3 FinalCompositing(const CpuUniforms& u, const SampleGlobalResult& res);
+
+//---------------------------------------------------------------------------
+/// Marches the primary rays of a rectangle on the view plane at once
+/// (cone_body.glsl). Every ray stays within a cone around the ray through
+/// the center; the field is bounded on the cone, the distance field sampled
+/// on its axis. Not supported by the Barnes-Hut approximation and the
+/// density volume.
+/// @param[in]  u           The uniform values.
+/// @param[in]  center      Center of the rectangle in world space.
+/// @param[in]  halfX       Half the first edge of the rectangle.
+/// @param[in]  halfY       Half the second edge of the rectangle.
+/// @param[in]  start       Distance along the rays known to be empty, e.g.
+/// the result of a larger rectangle containing this one.
+/// @return                 The distance from the view plane along each ray
+/// of the rectangle up to which no ray hits the surface.
+//---------------------------------------------------------------------------
+float ConeMarch(const CpuUniforms& u, const glm::vec3& center,
+                const glm::vec3& halfX, const glm::vec3& halfY, float start);
+
+//---------------------------------------------------------------------------
+/// Fragment program of the view plane (volume_body.glsl).
+/// @param[in]  u           The uniform values.
+/// @param[in]  worldPos    Fragment position in world space.
+/// @param[in]  coneDistance Distance along the ray without a hit, see
+/// ConeMarch().
+/// @param[in]  previousHit Hit distance of the pixel in the previous frame;
+/// negative for none.
+/// @param[out] hitDistance Distance of the hit to the view plane; negative
+/// if the ray missed.
+/// @return                 The fragment color.
+//---------------------------------------------------------------------------
+glm::vec4 VolumeShader(const CpuUniforms& u, const glm::vec3& worldPos,
+                       float coneDistance, float previousHit,
+                       float& hitDistance);
+
+//---------------------------------------------------------------------------
+/// Fragment program of the ground plane (ground_body.glsl).
+/// @param[in]  u           The uniform values.
+/// @param[in]  worldPos    Fragment position in world space.
+/// @return                 The fragment color.
+//---------------------------------------------------------------------------
+glm::vec4 GroundShader(const CpuUniforms& u, const glm::vec3& worldPos);
+
+//---------------------------------------------------------------------------
+/// Texel of the G-buffer of the deferred shading (gbuffer_body.glsl).
+//---------------------------------------------------------------------------
+struct GBufferTexel
+{
+    SampleGlobalResult _surface; ///< surface found by the ray.
+
+    /// Scale of the shaded color; 1 for the view plane, 0.3 for the ground
+    /// and 0 for no surface.
+    float _brightness = 0.0f;
+};
+
+//---------------------------------------------------------------------------
+/// Geometry pass of the view plane (gbuffer_body.glsl); the search of
+/// VolumeShader() without the shading.
+/// @param[in]  u           The uniform values.
+/// @param[in]  worldPos    Fragment position in world space.
+/// @param[in]  coneDistance Distance along the ray without a hit, see
+/// ConeMarch().
+/// @param[in]  previousHit Hit distance of the pixel in the previous frame;
+/// negative for none.
+/// @param[out] hitDistance Distance of the hit to the view plane; negative
+/// if the ray missed.
+/// @return                 The G-buffer texel.
+//---------------------------------------------------------------------------
+GBufferTexel VolumeGeometry(const CpuUniforms& u, const glm::vec3& worldPos,
+                            float coneDistance, float previousHit,
+                            float& hitDistance);
+
+//---------------------------------------------------------------------------
+/// Geometry pass of the ground plane (gbuffer_body.glsl); the search of
+/// GroundShader() without the shading. Ignores the ground map.
+/// @param[in]  u           The uniform values.
+/// @param[in]  worldPos    Fragment position in world space.
+/// @return                 The G-buffer texel.
+//---------------------------------------------------------------------------
+GBufferTexel GroundGeometry(const CpuUniforms& u, const glm::vec3& worldPos);
+
+//---------------------------------------------------------------------------
+/// Shading pass of the deferred shading (deferred_body.glsl).
+/// @param[in]  u           The uniform values.
+/// @param[in]  texel       The G-buffer texel of the fragment.
+/// @return                 The fragment color; opaque black for no surface.
+//---------------------------------------------------------------------------
+glm::vec4 DeferredShader(const CpuUniforms& u, const GBufferTexel& texel);
+
+/// Signatures of VolumeShader(), GroundShader(), VolumeGeometry(),
+/// GroundGeometry() and DeferredShader().
+using VolumeShaderFunction = glm::vec4 (*)(const CpuUniforms& u,
+                                           const glm::vec3& worldPos,
+                                           float            coneDistance,
+                                           float            previousHit,
+                                           float&           hitDistance);
+using GroundShaderFunction = glm::vec4 (*)(const CpuUniforms& u,
+                                           const glm::vec3& worldPos);
+using VolumeGeometryFunction = GBufferTexel (*)(const CpuUniforms& u,
+                                                const glm::vec3& worldPos,
+                                                float coneDistance,
+                                                float previousHit,
+                                                float& hitDistance);
+using GroundGeometryFunction = GBufferTexel (*)(const CpuUniforms& u,
+                                                const glm::vec3& worldPos);
+using DeferredShaderFunction = glm::vec4 (*)(const CpuUniforms&  u,
+                                             const GBufferTexel& texel);
+
+//---------------------------------------------------------------------------
+/// Fragment programs of the view plane and the ground plane and of the
+/// deferred shading, compiled for fixed uniform values; see GetCpuShaders().
+/// Defaults to the generic programs.
+//---------------------------------------------------------------------------
+struct CpuShaders
+{
+    VolumeShaderFunction   _volumeShader   = VolumeShader;   ///< view plane.
+    GroundShaderFunction   _groundShader   = GroundShader;   ///< ground.
+    VolumeGeometryFunction _volumeGeometry = VolumeGeometry; ///< view plane.
+    GroundGeometryFunction _groundGeometry = GroundGeometry; ///< ground.
+    DeferredShaderFunction _deferredShader = DeferredShader; ///< shading.
+};
+
+//---------------------------------------------------------------------------
+/// Returns the fragment programs specialized for the given shading mode,
+/// noise value and object bucket. The specialization drops the shading code
+/// of the other modes and the noise test, and bounds the loops over the
+/// centers at compile time. The programs ignore CpuUniforms::_shadingMode
+/// and CpuUniforms::_noise; the object bucket must hold the center count.
+/// The field kernel is not part of the specialization, see GetFieldKernel().
+/// @param[in]  shadingMode     The shading mode.
+/// @param[in]  noise           Noise effect on (1) or off (0).
+/// @param[in]  objectBucket    See GetObjectBucket(); 0 for no bound.
+/// @return                     The programs; the generic ones for an
+/// unknown shading mode.
+//---------------------------------------------------------------------------
+CpuShaders GetCpuShaders(unsigned int shadingMode, unsigned int noise,
+                         unsigned int objectBucket);
+
+#endif // VOLUME_DEMO_CPUSHADER_H__
@@ -0,0 +1,403 @@
+#include "fieldkernel.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||             \
+    defined(_M_IX86)
+#define VOLUME_DEMO_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows intrinsics without compiler flags; GCC and Clang need the
+// target attribute so that the rest of the library keeps the baseline ISA.
+#if defined(VOLUME_DEMO_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+//---------------------------------------------------------------------------
+/// Returns the trip count of the center loop of a kernel.
+/// @param[in]  count   The number of centers.
+/// @return             The object bucket if set; the constant bound lets the
+/// compiler unroll the loop, which then breaks at count.
+//---------------------------------------------------------------------------
+template <unsigned int ObjectBucket>
+static unsigned int GetLoopCount(unsigned int count)
+{
+    return ObjectBucket > 0 ? ObjectBucket : count;
+}
+
+//---------------------------------------------------------------------------
+/// Scalar kernel; same order of operations as MetaballField() in
+/// fragment_head.glsl.
+//---------------------------------------------------------------------------
+template <unsigned int ObjectBucket>
+static void FieldKernelScalar(const MetaballCenters& centers, float x, float y,
+                              float z, bool color, float& value, float* rgb,
+                              float* gradient)
+{
+    auto sum = 0.0f;
+    auto r   = 0.0f;
+    auto g   = 0.0f;
+    auto b   = 0.0f;
+    auto gx  = 0.0f;
+    auto gy  = 0.0f;
+    auto gz  = 0.0f;
+
+    for (auto i = 0u; i < GetLoopCount<ObjectBucket>(centers._count); ++i)
+    {
+        if (ObjectBucket > 0 && i >= centers._count)
+            break;
+
+        const auto dx = x - centers._x[i];
+        const auto dy = y - centers._y[i];
+        const auto dz = z - centers._z[i];
+        const auto d2 = dx * dx + dy * dy + dz * dz;
+
+        const auto inv = 1.0f / d2;
+        sum += inv;
+
+        if (color)
+        {
+            const auto factor = 1.0f / std::sqrt(d2);
+            r += centers._r[i] * factor;
+            g += centers._g[i] * factor;
+            b += centers._b[i] * factor;
+
+            const auto slope = inv * inv;
+            gx += dx * slope;
+            gy += dy * slope;
+            gz += dz * slope;
+        }
+    }
+
+    value = sum;
+
+    if (color)
+    {
+        rgb[0] = r;
+        rgb[1] = g;
+        rgb[2] = b;
+
+        gradient[0] = -2.0f * gx;
+        gradient[1] = -2.0f * gy;
+        gradient[2] = -2.0f * gz;
+    }
+}
+
+#ifdef VOLUME_DEMO_X86
+
+TARGET_AVX2 static float HorizontalSum(__m256 v)
+{
+    const auto low  = _mm256_castps256_ps128(v);
+    const auto high = _mm256_extractf128_ps(v, 1);
+    auto       sum  = _mm_add_ps(low, high);
+    sum             = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum             = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+//---------------------------------------------------------------------------
+/// AVX2 kernel; evaluates eight centers per instruction.
+//---------------------------------------------------------------------------
+template <unsigned int ObjectBucket>
+TARGET_AVX2 static void FieldKernelAVX2(const MetaballCenters& centers,
+                                        float x, float y, float z, bool color,
+                                        float& value, float* rgb,
+                                        float* gradient)
+{
+    const auto px    = _mm256_set1_ps(x);
+    const auto py    = _mm256_set1_ps(y);
+    const auto pz    = _mm256_set1_ps(z);
+    const auto one   = _mm256_set1_ps(1.0f);
+    const auto lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    auto sum = _mm256_setzero_ps();
+    auto r   = _mm256_setzero_ps();
+    auto g   = _mm256_setzero_ps();
+    auto b   = _mm256_setzero_ps();
+    auto gx  = _mm256_setzero_ps();
+    auto gy  = _mm256_setzero_ps();
+    auto gz  = _mm256_setzero_ps();
+
+    const auto count = int(centers._count);
+
+    for (auto i = 0; i < int(GetLoopCount<ObjectBucket>(count)); i += 8)
+    {
+        if (ObjectBucket > 0 && i >= count)
+            break;
+
+        // mask lanes past the end
+        const auto remaining = _mm256_set1_epi32(count - i);
+        const auto mask      = _mm256_cmpgt_epi32(remaining, lanes);
+        const auto maskF     = _mm256_castsi256_ps(mask);
+
+        const auto cx = _mm256_maskload_ps(centers._x + i, mask);
+        const auto cy = _mm256_maskload_ps(centers._y + i, mask);
+        const auto cz = _mm256_maskload_ps(centers._z + i, mask);
+
+        const auto dx = _mm256_sub_ps(px, cx);
+        const auto dy = _mm256_sub_ps(py, cy);
+        const auto dz = _mm256_sub_ps(pz, cz);
+
+        auto d2 = _mm256_mul_ps(dx, dx);
+        d2      = _mm256_add_ps(d2, _mm256_mul_ps(dy, dy));
+        d2      = _mm256_add_ps(d2, _mm256_mul_ps(dz, dz));
+
+        const auto inv = _mm256_div_ps(one, d2);
+        sum            = _mm256_add_ps(sum, _mm256_and_ps(inv, maskF));
+
+        if (color)
+        {
+            auto factor = _mm256_div_ps(one, _mm256_sqrt_ps(d2));
+            factor      = _mm256_and_ps(factor, maskF);
+
+            const auto cr = _mm256_maskload_ps(centers._r + i, mask);
+            const auto cg = _mm256_maskload_ps(centers._g + i, mask);
+            const auto cb = _mm256_maskload_ps(centers._b + i, mask);
+
+            r = _mm256_add_ps(r, _mm256_mul_ps(cr, factor));
+            g = _mm256_add_ps(g, _mm256_mul_ps(cg, factor));
+            b = _mm256_add_ps(b, _mm256_mul_ps(cb, factor));
+
+            const auto slope = _mm256_and_ps(_mm256_mul_ps(inv, inv), maskF);
+
+            gx = _mm256_add_ps(gx, _mm256_mul_ps(dx, slope));
+            gy = _mm256_add_ps(gy, _mm256_mul_ps(dy, slope));
+            gz = _mm256_add_ps(gz, _mm256_mul_ps(dz, slope));
+        }
+    }
+
+    value = HorizontalSum(sum);
+
+    if (color)
+    {
+        rgb[0] = HorizontalSum(r);
+        rgb[1] = HorizontalSum(g);
+        rgb[2] = HorizontalSum(b);
+
+        gradient[0] = -2.0f * HorizontalSum(gx);
+        gradient[1] = -2.0f * HorizontalSum(gy);
+        gradient[2] = -2.0f * HorizontalSum(gz);
+    }
+}
+
+TARGET_AVX512 static float HorizontalSum(__m512 v)
+{
+    // masked extracts; the unmasked ones, which _mm512_castps512_ps256() and
+    // _mm512_reduce_add_ps() use too, start from an undefined register that
+    // GCC reports as uninitialized with -Wall
+    const auto d    = _mm512_castps_pd(v);
+    const auto low  = _mm512_maskz_extractf64x4_pd(0xFF, d, 0);
+    const auto high = _mm512_maskz_extractf64x4_pd(0xFF, d, 1);
+    return HorizontalSum(
+        _mm256_add_ps(_mm256_castpd_ps(low), _mm256_castpd_ps(high)));
+}
+
+//---------------------------------------------------------------------------
+/// AVX-512 kernel; evaluates sixteen centers per instruction.
+//---------------------------------------------------------------------------
+template <unsigned int ObjectBucket>
+TARGET_AVX512 static void FieldKernelAVX512(const MetaballCenters& centers,
+                                            float x, float y, float z,
+                                            bool color, float& value,
+                                            float* rgb, float* gradient)
+{
+    const auto px  = _mm512_set1_ps(x);
+    const auto py  = _mm512_set1_ps(y);
+    const auto pz  = _mm512_set1_ps(z);
+    const auto one = _mm512_set1_ps(1.0f);
+
+    auto sum = _mm512_setzero_ps();
+    auto r   = _mm512_setzero_ps();
+    auto g   = _mm512_setzero_ps();
+    auto b   = _mm512_setzero_ps();
+    auto gx  = _mm512_setzero_ps();
+    auto gy  = _mm512_setzero_ps();
+    auto gz  = _mm512_setzero_ps();
+
+    const auto count = centers._count;
+
+    for (auto i = 0u; i < GetLoopCount<ObjectBucket>(count); i += 16)
+    {
+        if (ObjectBucket > 0 && i >= count)
+            break;
+
+        // mask lanes past the end
+        const auto remaining = count - i;
+        const auto mask      = remaining >= 16
+                                   ? __mmask16(0xFFFF)
+                                   : __mmask16((1u << remaining) - 1u);
+
+        const auto cx = _mm512_maskz_loadu_ps(mask, centers._x + i);
+        const auto cy = _mm512_maskz_loadu_ps(mask, centers._y + i);
+        const auto cz = _mm512_maskz_loadu_ps(mask, centers._z + i);
+
+        const auto dx = _mm512_sub_ps(px, cx);
+        const auto dy = _mm512_sub_ps(py, cy);
+        const auto dz = _mm512_sub_ps(pz, cz);
+
+        auto d2 = _mm512_mul_ps(dx, dx);
+        d2      = _mm512_add_ps(d2, _mm512_mul_ps(dy, dy));
+        d2      = _mm512_add_ps(d2, _mm512_mul_ps(dz, dz));
+
+        const auto inv = _mm512_div_ps(one, d2);
+        sum            = _mm512_mask_add_ps(sum, mask, sum, inv);
+
+        if (color)
+        {
+            // masked like the loads; the lanes past the end are not added
+            const auto factor =
+                _mm512_div_ps(one, _mm512_maskz_sqrt_ps(mask, d2));
+
+            const auto cr = _mm512_maskz_loadu_ps(mask, centers._r + i);
+            const auto cg = _mm512_maskz_loadu_ps(mask, centers._g + i);
+            const auto cb = _mm512_maskz_loadu_ps(mask, centers._b + i);
+
+            r = _mm512_mask_add_ps(r, mask, r, _mm512_mul_ps(cr, factor));
+            g = _mm512_mask_add_ps(g, mask, g, _mm512_mul_ps(cg, factor));
+            b = _mm512_mask_add_ps(b, mask, b, _mm512_mul_ps(cb, factor));
+
+            const auto slope = _mm512_mul_ps(inv, inv);
+
+            gx = _mm512_mask_add_ps(gx, mask, gx, _mm512_mul_ps(dx, slope));
+            gy = _mm512_mask_add_ps(gy, mask, gy, _mm512_mul_ps(dy, slope));
+            gz = _mm512_mask_add_ps(gz, mask, gz, _mm512_mul_ps(dz, slope));
+        }
+    }
+
+    value = HorizontalSum(sum);
+
+    if (color)
+    {
+        rgb[0] = HorizontalSum(r);
+        rgb[1] = HorizontalSum(g);
+        rgb[2] = HorizontalSum(b);
+
+        gradient[0] = -2.0f * HorizontalSum(gx);
+        gradient[1] = -2.0f * HorizontalSum(gy);
+        gradient[2] = -2.0f * HorizontalSum(gz);
+    }
+}
+
+#ifdef _MSC_VER
+//---------------------------------------------------------------------------
+/// Checks the CPUID feature bits and the OS support of the register state.
+//---------------------------------------------------------------------------
+static SimdLevel DetectSimdLevel()
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return SimdLevel::SCALAR;
+
+    __cpuid(info, 1);
+    const auto osxsave = (info[2] & (1 << 27)) != 0;
+    const auto avx     = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx)
+        return SimdLevel::SCALAR;
+
+    const auto xcr0 = _xgetbv(0);
+    if ((xcr0 & 0x6) != 0x6)
+        return SimdLevel::SCALAR;
+
+    __cpuidex(info, 7, 0);
+    const auto avx2    = (info[1] & (1 << 5)) != 0;
+    const auto avx512f = (info[1] & (1 << 16)) != 0;
+
+    if (avx512f && (xcr0 & 0xE6) == 0xE6)
+        return SimdLevel::AVX512;
+    if (avx2)
+        return SimdLevel::AVX2;
+
+    return SimdLevel::SCALAR;
+}
+#else
+static SimdLevel DetectSimdLevel()
+{
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+
+    return SimdLevel::SCALAR;
+}
+#endif
+
+#else
+
+static SimdLevel DetectSimdLevel()
+{
+    return SimdLevel::SCALAR;
+}
+
+#endif // VOLUME_DEMO_X86
+
+SimdLevel GetSupportedSimdLevel()
+{
+    static const auto level = DetectSimdLevel();
+    return level;
+}
+
+//---------------------------------------------------------------------------
+/// Returns the kernel for the given instruction set and object bucket.
+//---------------------------------------------------------------------------
+template <unsigned int ObjectBucket>
+static FieldKernel GetBucketKernel(SimdLevel level)
+{
+    const auto supported = GetSupportedSimdLevel();
+    if (unsigned(level) > unsigned(supported))
+        level = supported;
+
+#ifdef VOLUME_DEMO_X86
+    switch (level)
+    {
+    case SimdLevel::AVX512:
+        return FieldKernelAVX512<ObjectBucket>;
+    case SimdLevel::AVX2:
+        return FieldKernelAVX2<ObjectBucket>;
+    default:
+        break;
+    }
+#endif
+
+    return FieldKernelScalar<ObjectBucket>;
+}
+
+unsigned int GetObjectBucket(unsigned int count)
+{
+    if (count <= SMALL_OBJECT_BUCKET)
+        return SMALL_OBJECT_BUCKET;
+    if (count <= LARGE_OBJECT_BUCKET)
+        return LARGE_OBJECT_BUCKET;
+
+    return 0;
+}
+
+FieldKernel GetFieldKernel(SimdLevel level)
+{
+    return GetBucketKernel<0>(level);
+}
+
+FieldKernel GetFieldKernel(SimdLevel level, unsigned int objectBucket)
+{
+    switch (objectBucket)
+    {
+    case SMALL_OBJECT_BUCKET:
+        return GetBucketKernel<SMALL_OBJECT_BUCKET>(level);
+    case LARGE_OBJECT_BUCKET:
+        return GetBucketKernel<LARGE_OBJECT_BUCKET>(level);
+    default:
+        break;
+    }
+
+    return GetBucketKernel<0>(level);
+}
@@ -0,0 +1,91 @@
+#ifndef VOLUME_DEMO_FIELDKERNEL_H__
+#define VOLUME_DEMO_FIELDKERNEL_H__
+
+//---------------------------------------------------------------------------
+/// Structure-of-arrays view of the metaball centers and colors.
+//---------------------------------------------------------------------------
+struct MetaballCenters
+{
+    const float* _x     = nullptr; ///< x-coordinates.
+    const float* _y     = nullptr; ///< y-coordinates.
+    const float* _z     = nullptr; ///< z-coordinates.
+    const float* _r     = nullptr; ///< red color components.
+    const float* _g     = nullptr; ///< green color components.
+    const float* _b     = nullptr; ///< blue color components.
+    unsigned int _count = 0;       ///< number of centers.
+};
+
+//---------------------------------------------------------------------------
+/// Instruction sets of the field kernels.
+//---------------------------------------------------------------------------
+enum class SimdLevel : unsigned int
+{
+    SCALAR = 0,
+    AVX2   = 1,
+    AVX512 = 2
+};
+
+//---------------------------------------------------------------------------
+/// Evaluates the 1/r^2 metaball function of all centers at one sample point.
+/// The gradient uses the closed form -2 (p - c) / r^4.
+/// The kernels sum in a different order than the GLSL loop; the result
+/// matches the scalar kernel within a relative error of
+/// FIELD_KERNEL_TOLERANCE.
+/// @param[in]  centers     The metaball centers.
+/// @param[in]  x           Sample point x-coordinate.
+/// @param[in]  y           Sample point y-coordinate.
+/// @param[in]  z           Sample point z-coordinate.
+/// @param[in]  color       Set to true to sum the color contributions and
+/// the gradient.
+/// @param[out] value       The field value.
+/// @param[out] rgb         The (not normalized) color sum; only written if
+/// color is true.
+/// @param[out] gradient    The gradient of the field value; only written if
+/// color is true.
+//---------------------------------------------------------------------------
+using FieldKernel = void (*)(const MetaballCenters& centers, float x, float y,
+                             float z, bool color, float& value, float* rgb,
+                             float* gradient);
+
+/// Relative tolerance of the SIMD kernels compared to the scalar kernel.
+static constexpr auto FIELD_KERNEL_TOLERANCE = 1e-5f;
+
+/// Object buckets of the specialized kernels; the bucket is an upper bound
+/// of the center count known at compile time, see GetObjectBucket().
+static constexpr auto SMALL_OBJECT_BUCKET = 8u;
+static constexpr auto LARGE_OBJECT_BUCKET = 32u;
+
+//---------------------------------------------------------------------------
+/// Returns the best instruction set supported by the running CPU.
+/// @return             The instruction set.
+//---------------------------------------------------------------------------
+SimdLevel GetSupportedSimdLevel();
+
+//---------------------------------------------------------------------------
+/// Returns the field kernel for the given instruction set. Falls back to the
+/// best supported instruction set if the CPU does not support the requested
+/// one.
+/// @param[in]  level   The requested instruction set.
+/// @return             The kernel.
+//---------------------------------------------------------------------------
+FieldKernel GetFieldKernel(SimdLevel level);
+
+//---------------------------------------------------------------------------
+/// Returns the smallest object bucket holding the given number of centers.
+/// @param[in]  count   The number of centers.
+/// @return             SMALL_OBJECT_BUCKET or LARGE_OBJECT_BUCKET; 0 if the
+/// count exceeds both.
+//---------------------------------------------------------------------------
+unsigned int GetObjectBucket(unsigned int count);
+
+//---------------------------------------------------------------------------
+/// Returns the field kernel for the given instruction set, specialized for
+/// the given object bucket. The kernel must only be called with at most
+/// objectBucket centers.
+/// @param[in]  level           The requested instruction set.
+/// @param[in]  objectBucket    The object bucket; 0 for the generic kernel.
+/// @return                     The kernel.
+//---------------------------------------------------------------------------
+FieldKernel GetFieldKernel(SimdLevel level, unsigned int objectBucket);
+
+#endif // VOLUME_DEMO_FIELDKERNEL_H__
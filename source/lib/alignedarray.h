@@ -0,0 +1,93 @@
+#ifndef VOLUME_DEMO_ALIGNEDARRAY_H__
+#define VOLUME_DEMO_ALIGNEDARRAY_H__
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/// Number of floats processed per SIMD instruction by the widest kernel
+/// (AVX-512). Arrays consumed by SIMD kernels are padded to this width.
+static constexpr auto SIMD_WIDTH = 16u;
+
+/// Alignment in bytes of arrays consumed by SIMD kernels.
+static constexpr auto SIMD_ALIGNMENT = SIMD_WIDTH * sizeof(float);
+
+//---------------------------------------------------------------------------
+/// Allocator returning memory aligned to the given number of bytes.
+//---------------------------------------------------------------------------
+template <typename T, std::size_t ALIGNMENT> class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U> struct rebind
+    {
+        using other = AlignedAllocator<U, ALIGNMENT>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        const auto size = n * sizeof(T);
+        return static_cast<T*>(
+            ::operator new(size, std::align_val_t(ALIGNMENT)));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept
+    {
+        ::operator delete(p, std::align_val_t(ALIGNMENT));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const noexcept
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, ALIGNMENT>&) const noexcept
+    {
+        return false;
+    }
+};
+
+/// Float array aligned for SIMD loads.
+using AlignedFloatArray =
+    std::vector<float, AlignedAllocator<float, SIMD_ALIGNMENT>>;
+
+//---------------------------------------------------------------------------
+/// Rounds the given count up to a multiple of SIMD_WIDTH.
+/// @param[in]  count   The element count.
+/// @return             The padded count.
+//---------------------------------------------------------------------------
+inline unsigned int GetPaddedCount(unsigned int count)
+{
+    return ((count + SIMD_WIDTH - 1) / SIMD_WIDTH) * SIMD_WIDTH;
+}
+
+//---------------------------------------------------------------------------
+/// Read-only view of a contiguous float array.
+//---------------------------------------------------------------------------
+struct FloatSpan
+{
+    const float* _data = nullptr; ///< first element.
+    unsigned int _size = 0;       ///< number of elements.
+
+    const float* begin() const
+    {
+        return _data;
+    }
+
+    const float* end() const
+    {
+        return _data + _size;
+    }
+};
+
+#endif // VOLUME_DEMO_ALIGNEDARRAY_H__
@@ -0,0 +1,281 @@
+#include "assetcache.h"
+#include "log.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Identifies a cache file.
+static const char ASSET_CACHE_MAGIC[8] = {'V', 'D', 'A', 'S', 'S', 'E', 'T', 0};
+
+/// Alignment of the asset data in the file; the mapping starts at a page, so
+/// the data is aligned in memory too.
+static constexpr auto ASSET_DATA_ALIGNMENT = 64u;
+
+//---------------------------------------------------------------------------
+/// Start of a cache file; followed by the key and the data. The fields are
+/// stored in the byte order of the machine.
+//---------------------------------------------------------------------------
+struct AssetHeader
+{
+    char          _magic[8];   ///< ASSET_CACHE_MAGIC.
+    std::uint32_t _version;    ///< ASSET_CACHE_VERSION.
+    std::uint32_t _keySize;    ///< bytes of the key after the header.
+    std::uint64_t _dataOffset; ///< file offset of the data.
+    std::uint64_t _dataSize;   ///< bytes of the data.
+};
+
+MappedFile::MappedFile()
+{
+    _data    = nullptr;
+    _size    = 0;
+    _file    = nullptr;
+    _mapping = nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    auto file = CreateFileA(path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    auto mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    _data    = static_cast<const unsigned char*>(data);
+    _size    = size_t(size.QuadPart);
+    _file    = file;
+    _mapping = mapping;
+#else
+    const auto file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close(file);
+        return false;
+    }
+
+    const auto size = size_t(status.st_size);
+    const auto data = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+
+    // the mapping keeps the file
+    close(file);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    _data = static_cast<const unsigned char*>(data);
+    _size = size;
+#endif
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle(_mapping);
+    CloseHandle(_file);
+#else
+    munmap(const_cast<unsigned char*>(_data), _size);
+#endif
+
+    _data    = nullptr;
+    _size    = 0;
+    _file    = nullptr;
+    _mapping = nullptr;
+}
+
+const unsigned char* MappedFile::GetData() const
+{
+    return _data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return _size;
+}
+
+AssetCache::AssetCache() = default;
+
+void AssetCache::SetDirectory(const std::string& directory)
+{
+    _directory = directory;
+}
+
+std::string AssetCache::GetPath(const std::string&                name,
+                                const std::vector<unsigned char>& key) const
+{
+    if (_directory.empty())
+        return std::string();
+
+    // 64-bit FNV-1a; the header holds the full key
+    auto hash = std::uint64_t(14695981039346656037ull);
+    for (const auto byte : key)
+    {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+
+    char hex[17];
+    for (auto i = 0; i < 16; ++i)
+        hex[i] = "0123456789abcdef"[(hash >> (60 - i * 4)) & 15];
+    hex[16] = 0;
+
+    const auto file = name + "-" + hex + ".bin";
+    return (std::filesystem::path(_directory) / file).string();
+}
+
+bool AssetCache::Load(const std::string&                name,
+                      const std::vector<unsigned char>& key, MappedFile& file,
+                      const unsigned char*& data, size_t& size) const
+{
+    const auto path = GetPath(name, key);
+    if (path.empty() || !file.Open(path))
+        return false;
+
+    // anything but a complete file of this version and key is a miss
+    AssetHeader header;
+    auto        valid = file.GetSize() >= sizeof(header);
+
+    if (valid)
+    {
+        std::memcpy(&header, file.GetData(), sizeof(header));
+
+        valid = std::memcmp(header._magic, ASSET_CACHE_MAGIC,
+                            sizeof(ASSET_CACHE_MAGIC)) == 0 &&
+                header._version == ASSET_CACHE_VERSION &&
+                header._keySize == key.size() &&
+                sizeof(header) + key.size() <= file.GetSize() &&
+                header._dataOffset <= file.GetSize() &&
+                header._dataSize <= file.GetSize() - header._dataOffset;
+    }
+
+    if (valid && !key.empty())
+    {
+        valid = std::memcmp(file.GetData() + sizeof(header), key.data(),
+                            key.size()) == 0;
+    }
+
+    if (!valid)
+    {
+        file.Close();
+        return false;
+    }
+
+    data = file.GetData() + header._dataOffset;
+    size = size_t(header._dataSize);
+
+    return true;
+}
+
+bool AssetCache::Store(const std::string&                name,
+                       const std::vector<unsigned char>& key,
+                       const unsigned char* data, size_t size) const
+{
+    if (_directory.empty())
+        return false;
+
+    std::error_code error;
+    std::filesystem::create_directories(_directory, error);
+    if (IsFalse(!error, MSG_INFO("Could not create cache directory.")))
+        return false;
+
+    AssetHeader header;
+    std::memcpy(header._magic, ASSET_CACHE_MAGIC, sizeof(ASSET_CACHE_MAGIC));
+    header._version  = ASSET_CACHE_VERSION;
+    header._keySize  = std::uint32_t(key.size());
+    header._dataSize = size;
+
+    const auto end     = sizeof(header) + key.size();
+    const auto padding = (ASSET_DATA_ALIGNMENT - end % ASSET_DATA_ALIGNMENT) %
+                         ASSET_DATA_ALIGNMENT;
+    header._dataOffset = end + padding;
+
+    // unique per writer, so that nodes sharing the directory do not collide
+    const auto path   = GetPath(name, key);
+    const auto now    = std::chrono::steady_clock::now().time_since_epoch();
+    const auto thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    const auto writer = thread ^ size_t(now.count());
+    const auto temp   = path + "." + std::to_string(writer) + ".tmp";
+
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+
+        const char zeros[ASSET_DATA_ALIGNMENT] = {};
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(key.data()), key.size());
+        out.write(zeros, padding);
+        out.write(reinterpret_cast<const char*>(data), size);
+
+        if (IsFalse(out.good(), MSG_INFO("Could not write cache file.")))
+        {
+            out.close();
+            std::filesystem::remove(temp, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, path, error);
+    if (IsFalse(!error, MSG_INFO("Could not replace cache file.")))
+    {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+
+    return true;
+}
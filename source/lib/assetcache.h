@@ -0,0 +1,127 @@
+#ifndef VOLUME_DEMO_ASSETCACHE_H__
+#define VOLUME_DEMO_ASSETCACHE_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// Version of the cache file layout; files of other versions are misses.
+static constexpr auto ASSET_CACHE_VERSION = 1u;
+
+/// Cache directory of the OpenGL demo, relative to the working directory.
+static constexpr auto DEFAULT_ASSET_CACHE_DIRECTORY = "cache";
+
+//---------------------------------------------------------------------------
+/// A read-only memory mapping of a whole file. The pages are loaded on first
+/// access and shared with the file system cache; nothing is copied.
+//---------------------------------------------------------------------------
+class MappedFile
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    MappedFile();
+
+    //---------------------------------------------------------------------------
+    /// Destructor; unmaps the file.
+    //---------------------------------------------------------------------------
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    //---------------------------------------------------------------------------
+    /// Maps the given file; unmaps the previous one.
+    /// @param[in]  path    The file path.
+    /// @return             False if the file does not exist, is empty or
+    /// could not be mapped.
+    //---------------------------------------------------------------------------
+    bool Open(const std::string& path);
+
+    //---------------------------------------------------------------------------
+    /// Unmaps the file.
+    //---------------------------------------------------------------------------
+    void Close();
+
+    //---------------------------------------------------------------------------
+    /// Returns the mapped bytes.
+    /// @return             The first byte; nullptr if no file is mapped.
+    //---------------------------------------------------------------------------
+    const unsigned char* GetData() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the size of the mapped file.
+    /// @return             The size in bytes.
+    //---------------------------------------------------------------------------
+    size_t GetSize() const;
+
+private:
+    const unsigned char* _data;    ///< the mapped bytes.
+    size_t               _size;    ///< the file size.
+    void*                _file;    ///< file handle; Windows only.
+    void*                _mapping; ///< mapping handle; Windows only.
+};
+
+//---------------------------------------------------------------------------
+/// Directory of generated assets, e.g. noise volumes that take seconds to
+/// create. An asset is a binary file keyed by the parameters of its
+/// generator: the file name holds a hash of the key, the header the version,
+/// the full key and the data size, so that a collision or a truncated file
+/// is a miss. Assets are loaded by mapping the file, see MappedFile, and
+/// written to a temporary file first, so that render nodes sharing the
+/// directory never map a partial asset.
+//---------------------------------------------------------------------------
+class AssetCache
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor; the cache is disabled until SetDirectory() is called.
+    //---------------------------------------------------------------------------
+    AssetCache();
+
+    //---------------------------------------------------------------------------
+    /// Sets the cache directory; it is created by the first Store().
+    /// @param[in]  directory   The directory; empty disables the cache.
+    //---------------------------------------------------------------------------
+    void SetDirectory(const std::string& directory);
+
+    //---------------------------------------------------------------------------
+    /// Maps a cached asset.
+    /// @param[in]  name    The asset type, part of the file name.
+    /// @param[in]  key     The generator parameters.
+    /// @param[out] file    The mapping; keeps the data valid.
+    /// @param[out] data    The first byte of the asset data in the mapping.
+    /// @param[out] size    The size of the asset data in bytes.
+    /// @return             False on a cache miss.
+    //---------------------------------------------------------------------------
+    bool Load(const std::string& name, const std::vector<unsigned char>& key,
+              MappedFile& file, const unsigned char*& data,
+              size_t& size) const;
+
+    //---------------------------------------------------------------------------
+    /// Writes an asset; replaces an older file of the same key.
+    /// @param[in]  name    The asset type, part of the file name.
+    /// @param[in]  key     The generator parameters.
+    /// @param[in]  data    The asset data.
+    /// @param[in]  size    The size of the asset data in bytes.
+    /// @return             False if the cache is disabled or an error
+    /// occurred.
+    //---------------------------------------------------------------------------
+    bool Store(const std::string& name, const std::vector<unsigned char>& key,
+               const unsigned char* data, size_t size) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the file of an asset.
+    /// @param[in]  name    The asset type.
+    /// @param[in]  key     The generator parameters.
+    /// @return             The path; empty if the cache is disabled.
+    //---------------------------------------------------------------------------
+    std::string GetPath(const std::string&                name,
+                        const std::vector<unsigned char>& key) const;
+
+private:
+    std::string _directory; ///< see SetDirectory().
+};
+
+#endif // VOLUME_DEMO_ASSETCACHE_H__
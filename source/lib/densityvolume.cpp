@@ -0,0 +1,665 @@
+#include "densityvolume.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/// Space around the field bounds on every side of a new fit, relative to
+/// the bounds; moving objects stay inside for a while.
+static constexpr auto DENSITY_VOLUME_PADDING = 0.125f;
+
+/// A grid is refitted if it is larger than this factor times the bounds
+/// plus the padding on any axis.
+static constexpr auto DENSITY_VOLUME_SLACK = 1.25f;
+
+/// Voxels per edge of a stored brick: the brick and a copy of the first
+/// voxels of the bricks above it, so that every sample reads a single brick.
+static constexpr auto DENSITY_BRICK_STRIDE = DENSITY_BRICK_SIZE + 1;
+
+/// Voxels of a stored brick.
+static constexpr auto DENSITY_BRICK_VOXELS =
+    DENSITY_BRICK_STRIDE * DENSITY_BRICK_STRIDE * DENSITY_BRICK_STRIDE;
+
+/// Voxels around a brick that decide whether it is stored: a sample reads
+/// the voxels up to one voxel away, its central differences one more.
+static constexpr auto DENSITY_BRICK_MARGIN = 2.0f;
+
+DensityVolume::DensityVolume()
+{
+    _min             = glm::vec3(0.0f);
+    _extent          = glm::vec3(1.0f);
+    _scale           = glm::vec3(0.0f);
+    _size            = 0;
+    _emptyVoxel      = glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f);
+    _kernel          = MetaballKernel::INVERSE_SQUARE;
+    _kernelRadius    = 0.0f;
+    _blendDistance   = 0.0f;
+    _openingAngle    = 0.0f;
+    _noise           = 0;
+    _noiseVolumeSize = 0;
+    _animation       = 0.0f;
+    _valid           = false;
+}
+
+DensityVolume::~DensityVolume() = default;
+
+bool DensityVolume::Update(const glm::vec3&     boundsMin,
+                           const glm::vec3&     boundsMax,
+                           const ObjectArray&   objects,
+                           const SceneSettings& settings, float animation)
+{
+    const auto size = settings._densityVolumeSize;
+
+    if (IsNull(size, MSG_INFO("Invalid density volume size.")))
+        return false;
+    if (IsFalse(size % DENSITY_BRICK_SIZE == 0,
+                MSG_INFO("Density volume size is not a multiple of bricks.")))
+        return false;
+
+    const auto bricks     = size / DENSITY_BRICK_SIZE;
+    const auto brickCount = size_t(bricks) * bricks * bricks;
+    const auto count      = int(objects.GetObjectCount());
+    const auto noise      = settings.GetNoise();
+
+    const auto reset =
+        Fit(boundsMin, boundsMax, size) || _valid == false ||
+        int(_positions.size()) != count || settings._kernel != _kernel ||
+        settings._kernelRadius != _kernelRadius ||
+        settings._blendDistance != _blendDistance ||
+        settings._openingAngle != _openingAngle || noise != _noise ||
+        (noise == 1 && (animation != _animation ||
+                        settings._noiseVolumeSize != _noiseVolumeSize));
+
+    // a new grid starts with every brick empty
+    auto all = reset;
+    if (reset)
+    {
+        _slots.assign(brickCount, -1);
+        _freeSlots.clear();
+        _voxels.clear();
+    }
+
+    _brickMarks.assign(brickCount, all ? 1 : 0);
+    _positions.resize(size_t(count));
+    _colors.resize(size_t(count));
+
+    // a center reaches the voxels in its kernel radius at both positions
+    const auto compact = settings._kernel == MetaballKernel::WYVILL;
+    auto       moved   = all;
+
+    for (auto i = 0; i < count; ++i)
+    {
+        const auto pos   = objects.GetPosition(i);
+        const auto color = objects.GetColor(i);
+
+        if (!all && (pos != _positions[size_t(i)] ||
+                     color != _colors[size_t(i)]))
+        {
+            if (compact)
+            {
+                MarkSphere(_positions[size_t(i)], settings._kernelRadius);
+                MarkSphere(pos, settings._kernelRadius);
+            }
+            else
+            {
+                std::fill(_brickMarks.begin(), _brickMarks.end(), 1);
+                all = true;
+            }
+
+            moved = true;
+        }
+
+        _positions[size_t(i)] = pos;
+        _colors[size_t(i)]    = color;
+    }
+
+    if (moved)
+        FindOccupied(settings);
+
+    // the empty bricks are outside; a distance field is at least
+    // DENSITY_BRICK_MARGIN voxels away from the surface there
+    auto empty = 0.0f;
+    if (settings._kernel == MetaballKernel::SMOOTH_MIN)
+    {
+        const auto voxel = std::min(std::min(_extent.x, _extent.y), _extent.z) /
+                           float(size);
+        empty = voxel * DENSITY_BRICK_MARGIN;
+    }
+
+    _emptyVoxel = glm::vec4(-1.0f, 0.0f, 0.0f, empty);
+
+    _dirtyBricks.clear();
+    _clearedBricks.clear();
+
+    std::vector<unsigned char> changed(brickCount, 0);
+
+    for (auto b = 0u; b < unsigned(brickCount); ++b)
+    {
+        auto& slot = _slots[b];
+
+        if (_occupied[b])
+        {
+            // a new brick is baked whether or not a center moved
+            if (slot < 0)
+            {
+                if (_freeSlots.empty())
+                {
+                    slot = int(_voxels.size() / DENSITY_BRICK_VOXELS);
+                    _voxels.resize(_voxels.size() + DENSITY_BRICK_VOXELS);
+                }
+                else
+                {
+                    slot = _freeSlots.back();
+                    _freeSlots.pop_back();
+                }
+
+                _brickMarks[b] = 1;
+                changed[b]     = 1;
+            }
+
+            if (_brickMarks[b])
+                _dirtyBricks.push_back(b);
+        }
+        else if (slot >= 0 || reset)
+        {
+            if (slot >= 0)
+                _freeSlots.push_back(slot);
+
+            slot       = -1;
+            changed[b] = 1;
+            _clearedBricks.push_back(b);
+        }
+    }
+
+    // the apron of a stored brick follows the bricks above it; the bake of
+    // a dirty brick updates the aprons below it, see SetVoxel()
+    for (auto b = 0u; b < unsigned(brickCount); ++b)
+    {
+        if (_slots[b] < 0)
+            continue;
+
+        auto x = 0u, y = 0u, z = 0u;
+        GetBrickOrigin(b, x, y, z);
+
+        auto copy = false;
+        for (auto k = 0u; k < 8 && !copy; ++k)
+        {
+            const auto nx = x / DENSITY_BRICK_SIZE + (k & 1);
+            const auto ny = y / DENSITY_BRICK_SIZE + (k >> 1 & 1);
+            const auto nz = z / DENSITY_BRICK_SIZE + (k >> 2);
+
+            if (nx < bricks && ny < bricks && nz < bricks)
+                copy = changed[(size_t(nz) * bricks + ny) * bricks + nx] != 0;
+        }
+
+        if (copy)
+            CopyApron(b);
+    }
+
+    _kernel          = settings._kernel;
+    _kernelRadius    = settings._kernelRadius;
+    _blendDistance   = settings._blendDistance;
+    _openingAngle    = settings._openingAngle;
+    _noise           = noise;
+    _noiseVolumeSize = settings._noiseVolumeSize;
+    _animation       = animation;
+    _valid           = true;
+
+    return true;
+}
+
+void DensityVolume::Reset()
+{
+    _valid = false;
+}
+
+const std::vector<unsigned int>& DensityVolume::GetDirtyBricks() const
+{
+    return _dirtyBricks;
+}
+
+const std::vector<unsigned int>& DensityVolume::GetClearedBricks() const
+{
+    return _clearedBricks;
+}
+
+const glm::vec4& DensityVolume::GetEmptyVoxel() const
+{
+    return _emptyVoxel;
+}
+
+unsigned int DensityVolume::GetStoredBrickCount() const
+{
+    const auto slots = unsigned(_voxels.size() / DENSITY_BRICK_VOXELS);
+    return slots - unsigned(_freeSlots.size());
+}
+
+void DensityVolume::GetBrickOrigin(unsigned int brick, unsigned int& x,
+                                   unsigned int& y, unsigned int& z) const
+{
+    const auto bricks = GetBricksPerEdge();
+
+    x = brick % bricks * DENSITY_BRICK_SIZE;
+    y = brick / bricks % bricks * DENSITY_BRICK_SIZE;
+    z = brick / (bricks * bricks) * DENSITY_BRICK_SIZE;
+}
+
+unsigned int DensityVolume::GetBricksPerEdge() const
+{
+    return _size / DENSITY_BRICK_SIZE;
+}
+
+glm::vec3 DensityVolume::GetVoxelCenter(unsigned int x, unsigned int y,
+                                        unsigned int z) const
+{
+    const glm::vec3 voxel(float(x) + 0.5f, float(y) + 0.5f, float(z) + 0.5f);
+
+    return _min + voxel * _extent / float(_size);
+}
+
+void DensityVolume::SetVoxel(unsigned int x, unsigned int y, unsigned int z,
+                             float value, const glm::vec3& color)
+{
+    if (x >= _size || y >= _size || z >= _size)
+        return;
+
+    const auto finite = std::isfinite(color.x) && std::isfinite(color.y) &&
+                        std::isfinite(color.z);
+    const auto voxel  = glm::vec4(finite ? color : glm::vec3(0.0f), value);
+
+    const auto bricks = GetBricksPerEdge();
+    const auto b      = DENSITY_BRICK_SIZE;
+    const auto s      = DENSITY_BRICK_STRIDE;
+
+    // the brick of the voxel and, for its first voxels, the aprons of the
+    // bricks below; each in a different thread writes a different voxel
+    const unsigned int pos[3] = {x, y, z};
+
+    for (auto k = 0u; k < 8; ++k)
+    {
+        unsigned int brick[3];
+        unsigned int local[3];
+        auto         apron = true;
+
+        for (auto a = 0u; a < 3 && apron; ++a)
+        {
+            if ((k >> a & 1) == 0)
+            {
+                brick[a] = pos[a] / b;
+                local[a] = pos[a] % b;
+            }
+            else if (pos[a] % b == 0 && pos[a] >= b)
+            {
+                brick[a] = pos[a] / b - 1;
+                local[a] = b;
+            }
+            else
+            {
+                apron = false;
+            }
+        }
+
+        if (!apron)
+            continue;
+
+        const auto slot =
+            _slots[(size_t(brick[2]) * bricks + brick[1]) * bricks + brick[0]];
+        if (slot < 0)
+            continue;
+
+        _voxels[size_t(slot) * DENSITY_BRICK_VOXELS +
+                (local[2] * s + local[1]) * s + local[0]] = voxel;
+    }
+}
+
+float DensityVolume::Sample(const glm::vec3& pos, glm::vec3* gradient,
+                            glm::vec3* color) const
+{
+    if (_size == 0)
+        return 0.0f;
+
+    const auto voxel = Interpolate(pos);
+
+    if (color)
+    {
+        const glm::vec3 rgb(voxel.x, voxel.y, voxel.z);
+        const auto len = glm::length(rgb);
+        *color         = len > 0.0f ? rgb / len : rgb;
+    }
+
+    if (gradient)
+    {
+        // central differences one voxel apart
+        const auto h = _extent / float(_size);
+
+        for (auto a = 0; a < 3; ++a)
+        {
+            auto offset = glm::vec3(0.0f);
+            offset[a]   = h[a];
+
+            (*gradient)[a] =
+                (Interpolate(pos + offset).w - Interpolate(pos - offset).w) /
+                (2.0f * h[a]);
+        }
+    }
+
+    return voxel.w;
+}
+
+float DensityVolume::GetEmptySpan(const glm::vec3& pos,
+                                  const glm::vec3& dir) const
+{
+    if (_size == 0)
+        return 0.0f;
+
+    unsigned int voxel[3];
+    for (auto a = 0; a < 3; ++a)
+    {
+        const auto c = (pos[a] - _min[a]) * _scale[a];
+        if (!(c >= 0.0f && c < float(_size)))
+            return 0.0f;
+
+        voxel[a] = unsigned(c);
+    }
+
+    const auto brick = GetBrick(voxel[0], voxel[1], voxel[2]);
+    if (_slots[brick] >= 0)
+        return 0.0f;
+
+    glm::vec3 lo, hi;
+    GetBrickBox(brick, lo, hi);
+
+    auto span = std::numeric_limits<float>::max();
+    for (auto a = 0; a < 3; ++a)
+    {
+        if (dir[a] > 1e-8f)
+            span = std::min(span, (hi[a] - pos[a]) / dir[a]);
+        else if (dir[a] < -1e-8f)
+            span = std::min(span, (lo[a] - pos[a]) / dir[a]);
+    }
+
+    return span < std::numeric_limits<float>::max() ? span : 0.0f;
+}
+
+const glm::vec3& DensityVolume::GetMin() const
+{
+    return _min;
+}
+
+const glm::vec3& DensityVolume::GetExtent() const
+{
+    return _extent;
+}
+
+unsigned int DensityVolume::GetSize() const
+{
+    return _size;
+}
+
+bool DensityVolume::Fit(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                        unsigned int size)
+{
+    // an empty field keeps any grid
+    if (boundsMin.x > boundsMax.x || boundsMin.y > boundsMax.y ||
+        boundsMin.z > boundsMax.z)
+    {
+        if (_size == size)
+            return false;
+
+        _min    = glm::vec3(0.0f);
+        _extent = glm::vec3(1.0f);
+    }
+    else
+    {
+        const auto bounds = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+        const auto slack  = (1.0f + 2.0f * DENSITY_VOLUME_PADDING) *
+                           DENSITY_VOLUME_SLACK;
+
+        auto keep = _size == size;
+        for (auto a = 0; a < 3; ++a)
+        {
+            keep = keep && boundsMin[a] >= _min[a] &&
+                   boundsMax[a] <= _min[a] + _extent[a] &&
+                   _extent[a] <= bounds[a] * slack;
+        }
+
+        if (keep)
+            return false;
+
+        const auto padding = bounds * DENSITY_VOLUME_PADDING;
+        _min               = boundsMin - padding;
+        _extent            = bounds + padding * 2.0f;
+    }
+
+    _size  = size;
+    _scale = float(size) / _extent;
+
+    return true;
+}
+
+void DensityVolume::FindOccupied(const SceneSettings& settings)
+{
+    const auto bricks     = GetBricksPerEdge();
+    const auto brickCount = bricks * bricks * bricks;
+
+    _occupied.assign(brickCount, 0);
+
+    // the noise lowers the threshold by its amplitude
+    auto threshold = METABALL_THRESHOLD;
+    if (settings.GetNoise() == 1)
+        threshold -= NOISE_FIELD_AMPLITUDE;
+
+    const auto radius      = settings._kernelRadius;
+    const auto invRadiusSq = 1.0f / (radius * radius);
+    const auto scale       = GetWyvillScale(radius);
+
+    // the smooth minimum is at most a quarter of the blend distance below
+    // the distance to the nearest sphere
+    const auto sdfRadius =
+        SDF_SPHERE_RADIUS + settings._blendDistance * 0.25f;
+
+    const auto margin = _extent / float(_size) * DENSITY_BRICK_MARGIN;
+
+    for (auto b = 0u; b < brickCount; ++b)
+    {
+        glm::vec3 lo, hi;
+        GetBrickBox(b, lo, hi);
+
+        lo -= margin;
+        hi += margin;
+
+        auto bound = 0.0f;
+
+        for (const auto& center : _positions)
+        {
+            auto distSq = 0.0f;
+            for (auto a = 0; a < 3; ++a)
+            {
+                const auto d =
+                    center[a] - std::min(std::max(center[a], lo[a]), hi[a]);
+                distSq += d * d;
+            }
+
+            if (settings._kernel == MetaballKernel::SMOOTH_MIN)
+            {
+                if (distSq <= sdfRadius * sdfRadius)
+                    bound = threshold;
+            }
+            else if (settings._kernel == MetaballKernel::WYVILL)
+            {
+                const auto f = 1.0f - distSq * invRadiusSq;
+                if (f > 0.0f)
+                    bound += scale * f * f * f;
+            }
+            else
+            {
+                bound += distSq > 0.0f ? 1.0f / distSq : threshold;
+            }
+
+            if (bound >= threshold)
+                break;
+        }
+
+        _occupied[b] = bound >= threshold ? 1 : 0;
+    }
+}
+
+void DensityVolume::GetBrickBox(unsigned int brick, glm::vec3& lo,
+                                glm::vec3& hi) const
+{
+    auto x = 0u, y = 0u, z = 0u;
+    GetBrickOrigin(brick, x, y, z);
+
+    const auto voxel  = _extent / float(_size);
+    const auto origin = glm::vec3(float(x), float(y), float(z));
+
+    lo = _min + origin * voxel;
+    hi = lo + voxel * float(DENSITY_BRICK_SIZE);
+}
+
+unsigned int DensityVolume::GetBrick(unsigned int x, unsigned int y,
+                                     unsigned int z) const
+{
+    const auto bricks = GetBricksPerEdge();
+    const auto b      = DENSITY_BRICK_SIZE;
+
+    return (z / b * bricks + y / b) * bricks + x / b;
+}
+
+void DensityVolume::CopyApron(unsigned int brick)
+{
+    auto x0 = 0u, y0 = 0u, z0 = 0u;
+    GetBrickOrigin(brick, x0, y0, z0);
+
+    const auto b = DENSITY_BRICK_SIZE;
+    const auto s = DENSITY_BRICK_STRIDE;
+    auto*      v = &_voxels[size_t(_slots[brick]) * DENSITY_BRICK_VOXELS];
+
+    for (auto z = 0u; z < s; ++z)
+    {
+        for (auto y = 0u; y < s; ++y)
+        {
+            for (auto x = 0u; x < s; ++x)
+            {
+                if (x < b && y < b && z < b)
+                    continue;
+
+                // the voxels beyond the grid are never interpolated
+                const auto inside =
+                    x0 + x < _size && y0 + y < _size && z0 + z < _size;
+
+                v[(z * s + y) * s + x] =
+                    inside ? GetVoxel(x0 + x, y0 + y, z0 + z) : _emptyVoxel;
+            }
+        }
+    }
+}
+
+const glm::vec4& DensityVolume::GetVoxel(unsigned int x, unsigned int y,
+                                         unsigned int z) const
+{
+    const auto slot = _slots[GetBrick(x, y, z)];
+    if (slot < 0)
+        return _emptyVoxel;
+
+    const auto b     = DENSITY_BRICK_SIZE;
+    const auto s     = DENSITY_BRICK_STRIDE;
+    const auto local = ((z % b) * s + y % b) * s + x % b;
+
+    return _voxels[size_t(slot) * DENSITY_BRICK_VOXELS + local];
+}
+
+void DensityVolume::MarkSphere(const glm::vec3& center, float radius)
+{
+    const auto bricks = int(GetBricksPerEdge());
+    const auto voxel  = _extent / float(_size);
+
+    // bricks overlapping the bounding box of the sphere
+    int first[3];
+    int last[3];
+
+    for (auto a = 0; a < 3; ++a)
+    {
+        const auto brickSize = voxel[a] * float(DENSITY_BRICK_SIZE);
+        const auto origin    = _min[a] + voxel[a] * 0.5f;
+
+        first[a] = std::max(
+            int(std::floor((center[a] - radius - origin) / brickSize)), 0);
+        last[a] = std::min(
+            int(std::floor((center[a] + radius - origin) / brickSize)),
+            bricks - 1);
+    }
+
+    for (auto z = first[2]; z <= last[2]; ++z)
+    {
+        for (auto y = first[1]; y <= last[1]; ++y)
+        {
+            for (auto x = first[0]; x <= last[0]; ++x)
+            {
+                // the voxel centers of a brick span all but one voxel of it
+                const int brick[3] = {x, y, z};
+                auto      distSq   = 0.0f;
+
+                for (auto a = 0; a < 3; ++a)
+                {
+                    const auto lo = _min[a] + voxel[a] * 0.5f +
+                                    float(brick[a] * DENSITY_BRICK_SIZE) *
+                                        voxel[a];
+                    const auto hi =
+                        lo + float(DENSITY_BRICK_SIZE - 1) * voxel[a];
+                    const auto d =
+                        center[a] - std::min(std::max(center[a], lo), hi);
+                    distSq += d * d;
+                }
+
+                if (distSq < radius * radius)
+                    _brickMarks[(size_t(z) * bricks + y) * bricks + x] = 1;
+            }
+        }
+    }
+}
+
+glm::vec4 DensityVolume::Interpolate(const glm::vec3& pos) const
+{
+    // voxel coordinates of the centers, clamped to the outer centers
+    const auto maxCoord = float(_size - 1);
+    const auto b        = DENSITY_BRICK_SIZE;
+    const auto s        = DENSITY_BRICK_STRIDE;
+
+    unsigned int i[3];
+    unsigned int next[3];
+    float        w[3];
+
+    for (auto a = 0; a < 3; ++a)
+    {
+        auto c = (pos[a] - _min[a]) * _scale[a] - 0.5f;
+        c      = std::min(std::max(c, 0.0f), maxCoord);
+
+        i[a]    = unsigned(c);
+        next[a] = i[a] + 1 < _size ? 1 : 0;
+        w[a]    = c - float(i[a]);
+    }
+
+    // the upper corners are in the apron of the brick
+    const auto slot = _slots[GetBrick(i[0], i[1], i[2])];
+    if (slot < 0)
+        return _emptyVoxel;
+
+    const auto  local = ((i[2] % b) * s + i[1] % b) * s + i[0] % b;
+    const auto* v     = &_voxels[size_t(slot) * DENSITY_BRICK_VOXELS + local];
+
+    const auto dx = next[0];
+    const auto dy = next[1] * s;
+    const auto dz = next[2] * s * s;
+
+    auto lerp = [](const glm::vec4& a, const glm::vec4& c, float t)
+    { return a + (c - a) * t; };
+
+    const auto c00 = lerp(v[0], v[dx], w[0]);
+    const auto c10 = lerp(v[dy], v[dy + dx], w[0]);
+    const auto c01 = lerp(v[dz], v[dz + dx], w[0]);
+    const auto c11 = lerp(v[dz + dy], v[dz + dy + dx], w[0]);
+
+    return lerp(lerp(c00, c10, w[1]), lerp(c01, c11, w[1]), w[2]);
+}
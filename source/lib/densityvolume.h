@@ -0,0 +1,269 @@
+#ifndef VOLUME_DEMO_DENSITYVOLUME_H__
+#define VOLUME_DEMO_DENSITYVOLUME_H__
+
+#include "glm/glm.hpp"
+#include "scene.h"
+#include <vector>
+
+/// Default number of voxels per edge of the density volume, see
+/// SceneSettings::_densityVolumeSize.
+static constexpr auto DEFAULT_DENSITY_VOLUME_SIZE = 64u;
+
+/// Number of voxels per edge of a brick; the unit of the incremental bake
+/// and of the storage. The voxels per edge of the volume must be a multiple.
+static constexpr auto DENSITY_BRICK_SIZE = 8u;
+
+//---------------------------------------------------------------------------
+/// Metaball field baked into a voxel grid over the field bounds, including
+/// the noise. Each voxel stores the field value and the color at its center;
+/// the samples between the centers are interpolated, the normals taken from
+/// central differences. The cost of a sample does not depend on the number
+/// of metaballs.
+///
+/// The grid is baked in bricks of DENSITY_BRICK_SIZE voxels per edge. Update()
+/// compares the objects with the previous frame and lists the bricks whose
+/// voxels changed; the others keep their values. Only the compact Wyvill
+/// kernel limits the reach of a center: with the other kernels, the
+/// Barnes-Hut approximation or animated noise any change re-bakes the grid.
+///
+/// The grid is sparse. Only the bricks where the kernel bound of the centers
+/// reaches the surface within two voxels of the box are stored and baked,
+/// see GetFieldBounds(); the voxels of the other, empty bricks are
+/// GetEmptyVoxel(). No sample near the surface or its normal reads an empty
+/// voxel, so the empty bricks hold no surface and rays skip them, see
+/// GetEmptySpan().
+//---------------------------------------------------------------------------
+class DensityVolume
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    DensityVolume();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~DensityVolume();
+
+    //---------------------------------------------------------------------------
+    /// Fits the grid to the field bounds, finds the occupied bricks and
+    /// collects the bricks to bake, see GetDirtyBricks(). The fit is kept
+    /// while the bounds stay inside the grid and fill most of it, so that
+    /// moving objects do not re-bake every brick.
+    /// @param[in]  boundsMin   Lower corner of the field bounds.
+    /// @param[in]  boundsMax   Upper corner of the field bounds.
+    /// @param[in]  objects     The scene objects of the new frame.
+    /// @param[in]  settings    The scene settings of the new frame.
+    /// @param[in]  animation   The animation time value of the noise.
+    /// @return                 False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Update(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                const ObjectArray& objects, const SceneSettings& settings,
+                float animation);
+
+    //---------------------------------------------------------------------------
+    /// Forces a full bake in the next Update(), e.g. if the storage of the
+    /// voxels was lost.
+    //---------------------------------------------------------------------------
+    void Reset();
+
+    //---------------------------------------------------------------------------
+    /// Returns the bricks found by the last Update(); every voxel of these
+    /// must be set with SetVoxel() before the volume is sampled.
+    /// @return             The brick indices, x fastest.
+    //---------------------------------------------------------------------------
+    const std::vector<unsigned int>& GetDirtyBricks() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the bricks that turned empty in the last Update(), e.g. to set
+    /// the voxels of a copy of the grid to GetEmptyVoxel(). After a full bake
+    /// these are all empty bricks.
+    /// @return             The brick indices, x fastest.
+    //---------------------------------------------------------------------------
+    const std::vector<unsigned int>& GetClearedBricks() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the voxel of the empty bricks: a negative red channel marks
+    /// them, the field value is outside of every surface.
+    /// @return             The color and the field value.
+    //---------------------------------------------------------------------------
+    const glm::vec4& GetEmptyVoxel() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of bricks with voxel storage.
+    /// @return             The count.
+    //---------------------------------------------------------------------------
+    unsigned int GetStoredBrickCount() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the first voxel of a brick.
+    /// @param[in]  brick   The brick index.
+    /// @param[out] x       The voxel column.
+    /// @param[out] y       The voxel row.
+    /// @param[out] z       The voxel slice.
+    //---------------------------------------------------------------------------
+    void GetBrickOrigin(unsigned int brick, unsigned int& x, unsigned int& y,
+                        unsigned int& z) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of bricks per edge.
+    /// @return             The count; 0 before Update().
+    //---------------------------------------------------------------------------
+    unsigned int GetBricksPerEdge() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the center of a voxel.
+    /// @param[in]  x       The voxel column.
+    /// @param[in]  y       The voxel row.
+    /// @param[in]  z       The voxel slice.
+    /// @return             The center in world space.
+    //---------------------------------------------------------------------------
+    glm::vec3 GetVoxelCenter(unsigned int x, unsigned int y,
+                             unsigned int z) const;
+
+    //---------------------------------------------------------------------------
+    /// Stores the field of a voxel; ignored in an empty brick.
+    /// @param[in]  x       The voxel column.
+    /// @param[in]  y       The voxel row.
+    /// @param[in]  z       The voxel slice.
+    /// @param[in]  value   The field value at the center.
+    /// @param[in]  color   The normalized color at the center; stored as
+    /// black if it is not finite, e.g. outside of every compact kernel.
+    //---------------------------------------------------------------------------
+    void SetVoxel(unsigned int x, unsigned int y, unsigned int z, float value,
+                  const glm::vec3& color);
+
+    //---------------------------------------------------------------------------
+    /// Samples the baked field; interpolated between the voxel centers and
+    /// clamped to the grid.
+    /// @param[in]  pos         World space position.
+    /// @param[out] gradient    Optional; the gradient of the field.
+    /// @param[out] color       Optional; the normalized color.
+    /// @return                 The field value.
+    //---------------------------------------------------------------------------
+    float Sample(const glm::vec3& pos, glm::vec3* gradient,
+                 glm::vec3* color) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns how far a ray stays in the empty brick at its origin.
+    /// @param[in]  pos     Ray origin in world space.
+    /// @param[in]  dir     Ray direction; the unit of the result.
+    /// @return             The ray parameter where the ray leaves the brick;
+    /// 0 if the brick is stored or outside of the grid.
+    //---------------------------------------------------------------------------
+    float GetEmptySpan(const glm::vec3& pos, const glm::vec3& dir) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the lower corner of the grid.
+    /// @return             The position in world space.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetMin() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the edge lengths of the grid.
+    /// @return             The lengths in world units.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetExtent() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of voxels per edge.
+    /// @return             The size; 0 before Update().
+    //---------------------------------------------------------------------------
+    unsigned int GetSize() const;
+
+private:
+    //---------------------------------------------------------------------------
+    /// Fits the grid to the given bounds if they left it or shrank.
+    /// @param[in]  boundsMin   Lower corner of the field bounds.
+    /// @param[in]  boundsMax   Upper corner of the field bounds.
+    /// @param[in]  size        Number of voxels per edge.
+    /// @return                 True if the grid changed.
+    //---------------------------------------------------------------------------
+    bool Fit(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+             unsigned int size);
+
+    //---------------------------------------------------------------------------
+    /// Finds the bricks to store for the centers of the frame. The field bound
+    /// of a brick sums the kernel at the distance of every center to the box.
+    /// @param[in]  settings    The scene settings.
+    //---------------------------------------------------------------------------
+    void FindOccupied(const SceneSettings& settings);
+
+    //---------------------------------------------------------------------------
+    /// Returns the box covered by a brick.
+    /// @param[in]  brick   The brick index.
+    /// @param[out] lo      The lower corner in world space.
+    /// @param[out] hi      The upper corner in world space.
+    //---------------------------------------------------------------------------
+    void GetBrickBox(unsigned int brick, glm::vec3& lo, glm::vec3& hi) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the brick of a voxel.
+    /// @param[in]  x       The voxel column.
+    /// @param[in]  y       The voxel row.
+    /// @param[in]  z       The voxel slice.
+    /// @return             The brick index.
+    //---------------------------------------------------------------------------
+    unsigned int GetBrick(unsigned int x, unsigned int y, unsigned int z) const;
+
+    //---------------------------------------------------------------------------
+    /// Copies the first voxels of the bricks above a stored brick into its
+    /// apron, see DENSITY_BRICK_STRIDE.
+    /// @param[in]  brick   The brick index.
+    //---------------------------------------------------------------------------
+    void CopyApron(unsigned int brick);
+
+    //---------------------------------------------------------------------------
+    /// Returns a voxel, GetEmptyVoxel() in an empty brick.
+    /// @param[in]  x       The voxel column.
+    /// @param[in]  y       The voxel row.
+    /// @param[in]  z       The voxel slice.
+    /// @return             The color and the field value.
+    //---------------------------------------------------------------------------
+    const glm::vec4& GetVoxel(unsigned int x, unsigned int y,
+                              unsigned int z) const;
+
+    //---------------------------------------------------------------------------
+    /// Marks the bricks with voxel centers closer than radius to a point.
+    /// @param[in]  center  World space position.
+    /// @param[in]  radius  The reach in world units.
+    //---------------------------------------------------------------------------
+    void MarkSphere(const glm::vec3& center, float radius);
+
+    //---------------------------------------------------------------------------
+    /// Interpolates the voxels at the given position like a linearly
+    /// filtered texture clamped to the edge.
+    /// @param[in]  pos     World space position.
+    /// @return             The color and the field value.
+    //---------------------------------------------------------------------------
+    glm::vec4 Interpolate(const glm::vec3& pos) const;
+
+    glm::vec3    _min;        ///< lower corner of the grid.
+    glm::vec3    _extent;     ///< edge lengths of the grid.
+    glm::vec3    _scale;      ///< voxels per world unit.
+    unsigned int _size;       ///< voxels per edge.
+    glm::vec4    _emptyVoxel; ///< see GetEmptyVoxel().
+
+    std::vector<int>       _slots;     ///< storage slot per brick, or -1.
+    std::vector<int>       _freeSlots; ///< unused slots of _voxels.
+    std::vector<glm::vec4> _voxels;    ///< DENSITY_BRICK_VOXELS per slot.
+
+    std::vector<unsigned char> _brickMarks;    ///< 1 for a brick to bake.
+    std::vector<unsigned char> _occupied;      ///< 1 for a stored brick.
+    std::vector<unsigned int>  _dirtyBricks;   ///< see GetDirtyBricks().
+    std::vector<unsigned int>  _clearedBricks; ///< see GetClearedBricks().
+
+    std::vector<glm::vec3> _positions;       ///< centers of the baked frame.
+    std::vector<glm::vec3> _colors;          ///< colors of the baked frame.
+    MetaballKernel         _kernel;          ///< kernel of the baked frame.
+    float                  _kernelRadius;    ///< see SceneSettings.
+    float                  _blendDistance;   ///< see SceneSettings.
+    float                  _openingAngle;    ///< see SceneSettings.
+    unsigned int           _noise;           ///< see SceneSettings::GetNoise().
+    unsigned int           _noiseVolumeSize; ///< see SceneSettings.
+    float                  _animation;       ///< noise time of the baked frame.
+    bool                   _valid;           ///< false if nothing is baked.
+};
+
+#endif // VOLUME_DEMO_DENSITYVOLUME_H__
@@ -3,7 +3,12 @@
 
 #include "eventloop.h"
 #include "log.h"
+#include "densityvolume.h"
+#include "groundmap.h"
+#include "lightvolume.h"
+#include "noise.h"
 #include "renderengine.h"
+#include "shadowmap.h"
 #include <iostream>
 #include "window.h"
 
@@ -125,15 +130,117 @@ static void HandleEvents(bool& run, SceneSettings& settings, const MSG& msg)
 
         if (ch == 'N')
         {
-            // turn noise on/off
+            // cycle noise off, 2D noise slice and 3D noise volume
 
-            if (settings._noise == NoiseMode::NOISE)
-                settings._noise = NoiseMode::NO_NOISE;
+            if (settings._noise == NoiseMode::NO_NOISE)
+            {
+                settings._noise           = NoiseMode::NOISE;
+                settings._noiseVolumeSize = 0;
+            }
+            else if (settings._noiseVolumeSize == 0)
+            {
+                settings._noiseVolumeSize = DEFAULT_NOISE_VOLUME_SIZE;
+            }
             else
-                settings._noise = NoiseMode::NOISE;
+            {
+                settings._noise           = NoiseMode::NO_NOISE;
+                settings._noiseVolumeSize = 0;
+            }
 
             return;
         }
+        if (ch == 'K')
+        {
+            // switch metaball kernel
+
+            if (settings._kernel == MetaballKernel::INVERSE_SQUARE)
+                settings._kernel = MetaballKernel::WYVILL;
+            else if (settings._kernel == MetaballKernel::WYVILL)
+                settings._kernel = MetaballKernel::SMOOTH_MIN;
+            else
+                settings._kernel = MetaballKernel::INVERSE_SQUARE;
+
+            return;
+        }
+        if (ch == 'B')
+        {
+            // turn Barnes-Hut approximation on/off
+
+            if (settings._openingAngle > 0.0f)
+                settings._openingAngle = 0.0f;
+            else
+                settings._openingAngle = DEFAULT_OPENING_ANGLE;
+
+            return;
+        }
+        if (ch == 'I')
+        {
+            // turn interval root finding on/off
+            settings._intervalRays = !settings._intervalRays;
+            return;
+        }
+        if (ch == 'R')
+        {
+            // turn temporal reprojection on/off
+            settings._reprojection = !settings._reprojection;
+            return;
+        }
+        if (ch == 'C')
+        {
+            // turn cone prepass on/off
+            settings._conePrepass = !settings._conePrepass;
+            return;
+        }
+        if (ch == 'S')
+        {
+            // switch between shadow map and shadow rays
+
+            if (settings._shadowMapSize > 0)
+                settings._shadowMapSize = 0;
+            else
+                settings._shadowMapSize = DEFAULT_SHADOW_MAP_SIZE;
+
+            return;
+        }
+        if (ch == 'V')
+        {
+            // switch between light volume and marches toward the light
+
+            if (settings._lightVolumeSize > 0)
+                settings._lightVolumeSize = 0;
+            else
+                settings._lightVolumeSize = DEFAULT_LIGHT_VOLUME_SIZE;
+
+            return;
+        }
+        if (ch == 'G')
+        {
+            // switch between ground map and marches up the ground
+
+            if (settings._groundMapSize > 0)
+                settings._groundMapSize = 0;
+            else
+                settings._groundMapSize = DEFAULT_GROUND_MAP_SIZE;
+
+            return;
+        }
+        if (ch == 'X')
+        {
+            // switch between density volume and summing the metaballs
+
+            if (settings._densityVolumeSize > 0)
+                settings._densityVolumeSize = 0;
+            else
+                settings._densityVolumeSize = DEFAULT_DENSITY_VOLUME_SIZE;
+
+            return;
+        }
+        if (ch == 'F')
+        {
+            // toggle deferred shading
+            settings._deferredShading = !settings._deferredShading;
+            return;
+        }
         if (ch == 'D')
         {
             // remove last object
@@ -156,15 +263,28 @@ static void HandleEvents(bool& run, SceneSettings& settings, const MSG& msg)
 void RunLoop(RenderEngine& engine, OSWindow& window)
 {
     SceneSettings settings;
-    settings._renderMode     = 0;
-    settings._timeOff        = 0.0;
-    settings._timeStep       = true;
-    settings._dynamicObjectX = 0.0;
-    settings._dynamicObjectY = 0.0;
-    settings._noise          = NoiseMode::NO_NOISE;
-    settings._addObjectClick = false;
-    settings._removeObject   = false;
-    settings._addObject      = false;
+    settings._renderMode        = 0;
+    settings._timeOff           = 0.0;
+    settings._timeStep          = true;
+    settings._dynamicObjectX    = 0.0;
+    settings._dynamicObjectY    = 0.0;
+    settings._noise             = NoiseMode::NO_NOISE;
+    settings._addObjectClick    = false;
+    settings._removeObject      = false;
+    settings._addObject         = false;
+    settings._kernel            = MetaballKernel::INVERSE_SQUARE;
+    settings._kernelRadius      = DEFAULT_KERNEL_RADIUS;
+    settings._blendDistance     = DEFAULT_BLEND_DISTANCE;
+    settings._openingAngle      = 0.0f;
+    settings._intervalRays      = false;
+    settings._reprojection      = true;
+    settings._conePrepass       = true;
+    settings._shadowMapSize     = DEFAULT_SHADOW_MAP_SIZE;
+    settings._lightVolumeSize   = DEFAULT_LIGHT_VOLUME_SIZE;
+    settings._groundMapSize     = DEFAULT_GROUND_MAP_SIZE;
+    settings._deferredShading   = false;
+    settings._densityVolumeSize = 0;
+    settings._noiseVolumeSize   = 0;
 
     MSG  msg;
     auto run = true;
@@ -0,0 +1,60 @@
+#ifndef VOLUME_DEMO_FASTMATH_H__
+#define VOLUME_DEMO_FASTMATH_H__
+
+#include <cmath>
+
+/// Largest absolute argument of FastSinCos() within FAST_SINCOS_TOLERANCE.
+static constexpr auto FAST_SINCOS_RANGE = 8192.0f;
+
+/// Maximum absolute error of FastSinCos() compared to std::sin and std::cos.
+static constexpr auto FAST_SINCOS_TOLERANCE = 1e-6f;
+
+//---------------------------------------------------------------------------
+/// Returns the sine and the cosine of an angle. The angle is reduced to
+/// [-pi/4, pi/4] around the closest multiple of pi/2, both polynomials are
+/// evaluated and the results are swapped and negated by the quadrant. There
+/// are no branches or calls, so that loops over this function vectorize.
+/// @param[in]  x       The angle in radians; |x| <= FAST_SINCOS_RANGE.
+/// @param[out] s       The sine.
+/// @param[out] c       The cosine.
+//---------------------------------------------------------------------------
+inline void FastSinCos(float x, float& s, float& c)
+{
+    /* see
+    S. L. Moshier, Cephes Mathematical Library, sinf.c, 1989.
+    */
+
+    // pi/2 in three parts; the products with the quadrant are exact
+    const auto pio2a = 1.5703125f;
+    const auto pio2b = 4.837512969970703125e-4f;
+    const auto pio2c = 7.54978995489188216e-8f;
+
+    const auto t = x * 0.636619772367581343f;
+    const auto j = int(t + std::copysign(0.5f, t));
+    const auto q = float(j);
+    const auto r = ((x - q * pio2a) - q * pio2b) - q * pio2c;
+    const auto z = r * r;
+
+    // minimax polynomials on [-pi/4, pi/4]
+    auto sp = -1.9515295891e-4f;
+    sp      = sp * z + 8.3321608736e-3f;
+    sp      = sp * z - 1.6666654611e-1f;
+
+    auto cp = 2.443315711809948e-5f;
+    cp      = cp * z - 1.388731625493765e-3f;
+    cp      = cp * z + 4.166664568298827e-2f;
+
+    const auto sr = r + r * z * sp;
+    const auto cr = 1.0f - 0.5f * z + z * z * cp;
+
+    // quadrant 1 and 3 swap sine and cosine, 2 and 3 negate the sine, 1 and
+    // 2 the cosine
+    const auto swap = (j & 1) != 0;
+    const auto ss   = swap ? cr : sr;
+    const auto cc   = swap ? sr : cr;
+
+    s = (j & 2) != 0 ? -ss : ss;
+    c = ((j + 1) & 2) != 0 ? -cc : cc;
+}
+
+#endif // VOLUME_DEMO_FASTMATH_H__
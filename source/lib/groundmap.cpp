@@ -0,0 +1,108 @@
+#include "groundmap.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+
+/// Color of the ground without a surface above it.
+static const glm::vec4 GROUND_BLACK{0.0f, 0.0f, 0.0f, 1.0f};
+
+GroundMap::GroundMap()
+{
+    _min    = glm::vec3(0.0f, GROUND_HEIGHT, 0.0f);
+    _extent = glm::vec3(1.0f);
+    _size   = 0;
+}
+
+GroundMap::~GroundMap() = default;
+
+bool GroundMap::Fit(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                    unsigned int size)
+{
+    if (IsNull(size, MSG_INFO("Invalid ground map size.")))
+        return false;
+
+    _size = size;
+    _colors.assign(size_t(size) * size, GROUND_BLACK);
+
+    // nothing above the ground
+    if (boundsMin.x > boundsMax.x || boundsMin.y > boundsMax.y ||
+        boundsMin.z > boundsMax.z)
+    {
+        _min    = glm::vec3(0.0f, GROUND_HEIGHT, 0.0f);
+        _extent = glm::vec3(1.0f);
+        return true;
+    }
+
+    _min    = glm::vec3(boundsMin.x, GROUND_HEIGHT, boundsMin.z);
+    _extent = glm::vec3(std::max(boundsMax.x - boundsMin.x, 1e-6f), 1.0f,
+                        std::max(boundsMax.z - boundsMin.z, 1e-6f));
+
+    return true;
+}
+
+glm::vec3 GroundMap::GetTexelCenter(unsigned int x, unsigned int y) const
+{
+    const auto u = (float(x) + 0.5f) / float(_size);
+    const auto v = (float(y) + 0.5f) / float(_size);
+
+    return glm::vec3(_min.x + u * _extent.x, GROUND_HEIGHT,
+                     _min.z + v * _extent.z);
+}
+
+void GroundMap::SetColor(unsigned int x, unsigned int y,
+                         const glm::vec4& color)
+{
+    if (x >= _size || y >= _size)
+        return;
+
+    _colors[size_t(y) * _size + x] = color;
+}
+
+glm::vec4 GroundMap::GetColor(const glm::vec3& pos) const
+{
+    if (_size == 0)
+        return GROUND_BLACK;
+
+    // texel coordinates of the centers; the border is black
+    const auto cx = (pos.x - _min.x) / _extent.x * float(_size) - 0.5f;
+    const auto cy = (pos.z - _min.z) / _extent.z * float(_size) - 0.5f;
+
+    if (cx <= -1.0f || cy <= -1.0f || cx >= float(_size) ||
+        cy >= float(_size))
+        return GROUND_BLACK;
+
+    const auto x0 = int(std::floor(cx));
+    const auto y0 = int(std::floor(cy));
+    const auto wx = cx - float(x0);
+    const auto wy = cy - float(y0);
+
+    const auto c0 = GetTexel(x0, y0) * (1.0f - wx) + GetTexel(x0 + 1, y0) * wx;
+    const auto c1 =
+        GetTexel(x0, y0 + 1) * (1.0f - wx) + GetTexel(x0 + 1, y0 + 1) * wx;
+
+    return c0 * (1.0f - wy) + c1 * wy;
+}
+
+const glm::vec3& GroundMap::GetMin() const
+{
+    return _min;
+}
+
+const glm::vec3& GroundMap::GetExtent() const
+{
+    return _extent;
+}
+
+unsigned int GroundMap::GetSize() const
+{
+    return _size;
+}
+
+glm::vec4 GroundMap::GetTexel(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= int(_size) || y >= int(_size))
+        return GROUND_BLACK;
+
+    return _colors[size_t(y) * _size + size_t(x)];
+}
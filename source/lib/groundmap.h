@@ -0,0 +1,102 @@
+#ifndef VOLUME_DEMO_GROUNDMAP_H__
+#define VOLUME_DEMO_GROUNDMAP_H__
+
+#include "glm/glm.hpp"
+#include <vector>
+
+/// Default number of texels per edge of the ground map, see
+/// SceneSettings::_groundMapSize.
+static constexpr auto DEFAULT_GROUND_MAP_SIZE = 128u;
+
+/// Height of the ground plane.
+static constexpr auto GROUND_HEIGHT = -1.5f;
+
+//---------------------------------------------------------------------------
+/// Color of the ground plane below the field. The ground shows the shaded
+/// underside of the surface straight above it; the rays up from the ground
+/// only hit the surface within the footprint of the field bounds. The map
+/// is fitted to the footprint every frame and stores the ground color at
+/// the texel centers; outside of the footprint the ground is black.
+//---------------------------------------------------------------------------
+class GroundMap
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    GroundMap();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~GroundMap();
+
+    //---------------------------------------------------------------------------
+    /// Fits the map to the footprint of the given bounds and clears it to
+    /// black. An empty box gives a black map.
+    /// @param[in]  boundsMin   Lower corner of the field bounds.
+    /// @param[in]  boundsMax   Upper corner of the field bounds.
+    /// @param[in]  size        Number of texels per edge.
+    /// @return                 False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Fit(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+             unsigned int size);
+
+    //---------------------------------------------------------------------------
+    /// Returns the center of a texel on the ground plane.
+    /// @param[in]  x       The texel column along the x axis.
+    /// @param[in]  y       The texel row along the z axis.
+    /// @return             The center in world space.
+    //---------------------------------------------------------------------------
+    glm::vec3 GetTexelCenter(unsigned int x, unsigned int y) const;
+
+    //---------------------------------------------------------------------------
+    /// Stores the ground color of a texel.
+    /// @param[in]  x       The texel column along the x axis.
+    /// @param[in]  y       The texel row along the z axis.
+    /// @param[in]  color   The color of the ground shader.
+    //---------------------------------------------------------------------------
+    void SetColor(unsigned int x, unsigned int y, const glm::vec4& color);
+
+    //---------------------------------------------------------------------------
+    /// Looks up the ground color; interpolated between the texel centers and
+    /// black beyond the outer texels.
+    /// @param[in]  pos     World space position on the ground plane.
+    /// @return             The color.
+    //---------------------------------------------------------------------------
+    glm::vec4 GetColor(const glm::vec3& pos) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the lower corner of the footprint; y is the ground height.
+    /// @return             The position in world space.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetMin() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the edge lengths of the footprint along x and z; y is 1.
+    /// @return             The lengths in world units.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetExtent() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of texels per edge.
+    /// @return             The size; 0 before Fit().
+    //---------------------------------------------------------------------------
+    unsigned int GetSize() const;
+
+private:
+    //---------------------------------------------------------------------------
+    /// Returns the color of a texel; black outside of the map.
+    /// @param[in]  x       The texel column.
+    /// @param[in]  y       The texel row.
+    /// @return             The color.
+    //---------------------------------------------------------------------------
+    glm::vec4 GetTexel(int x, int y) const;
+
+    glm::vec3              _min;    ///< lower corner of the footprint.
+    glm::vec3              _extent; ///< edge lengths of the footprint.
+    unsigned int           _size;   ///< texels per edge.
+    std::vector<glm::vec4> _colors; ///< color per texel, rows along z.
+};
+
+#endif // VOLUME_DEMO_GROUNDMAP_H__
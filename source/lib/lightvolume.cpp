@@ -0,0 +1,171 @@
+#include "lightvolume.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+
+LightVolume::LightVolume()
+{
+    _min      = glm::vec3(0.0f);
+    _extent   = glm::vec3(1.0f);
+    _lightDir = glm::vec3(0.0f, 1.0f, 0.0f);
+    _step     = LIGHT_VOLUME_SAMPLE_STEP;
+    _size     = 0;
+}
+
+LightVolume::~LightVolume() = default;
+
+bool LightVolume::Fit(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                      const glm::vec3& lightDir, unsigned int size)
+{
+    if (IsNull(size, MSG_INFO("Invalid light volume size.")))
+        return false;
+
+    _lightDir = lightDir;
+    _size     = size;
+
+    const auto voxelCount = size_t(size) * size * size;
+    _density.assign(voxelCount, 0.0f);
+    _counts.assign(voxelCount, 0.0f);
+
+    // nothing absorbs light
+    if (boundsMin.x > boundsMax.x || boundsMin.y > boundsMax.y ||
+        boundsMin.z > boundsMax.z)
+    {
+        _min    = glm::vec3(0.0f);
+        _extent = glm::vec3(1.0f);
+        _step   = LIGHT_VOLUME_SAMPLE_STEP;
+        return true;
+    }
+
+    _min    = boundsMin;
+    _extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+
+    // two samples per voxel along the shortest edge
+    const auto voxel = std::min({_extent.x, _extent.y, _extent.z}) /
+                       float(size);
+    _step = std::max(voxel * 0.5f, 1e-3f);
+
+    return true;
+}
+
+glm::vec3 LightVolume::GetVoxelCenter(unsigned int x, unsigned int y,
+                                      unsigned int z) const
+{
+    const glm::vec3 voxel(float(x) + 0.5f, float(y) + 0.5f, float(z) + 0.5f);
+
+    return _min + voxel * _extent / float(_size);
+}
+
+void LightVolume::SetDensity(unsigned int x, unsigned int y, unsigned int z,
+                             float density)
+{
+    if (x >= _size || y >= _size || z >= _size)
+        return;
+
+    _density[(size_t(z) * _size + y) * _size + x] = density;
+}
+
+void LightVolume::Integrate(unsigned int z)
+{
+    if (z >= _size)
+        return;
+
+    const auto boundsMax = _min + _extent;
+
+    for (auto y = 0u; y < _size; ++y)
+    {
+        for (auto x = 0u; x < _size; ++x)
+        {
+            const auto center = GetVoxelCenter(x, y, z);
+
+            // the field is empty behind the bounds
+            auto length = LIGHT_VOLUME_LENGTH;
+            for (auto a = 0; a < 3; ++a)
+            {
+                if (_lightDir[a] > 1e-8f)
+                    length = std::min(length, (boundsMax[a] - center[a]) /
+                                                  _lightDir[a]);
+                else if (_lightDir[a] < -1e-8f)
+                    length = std::min(length,
+                                      (_min[a] - center[a]) / _lightDir[a]);
+            }
+
+            const auto steps = int(std::ceil(length / _step));
+            auto       sum   = 0.0f;
+
+            for (auto i = 0; i < steps; ++i)
+                sum += Interpolate(_density,
+                                   center + _lightDir * (_step * float(i)));
+
+            _counts[(size_t(z) * _size + y) * _size + x] =
+                sum * _step / LIGHT_VOLUME_SAMPLE_STEP;
+        }
+    }
+}
+
+float LightVolume::GetSampleCount(const glm::vec3& pos) const
+{
+    if (_size == 0)
+        return 0.0f;
+
+    return Interpolate(_counts, pos);
+}
+
+const glm::vec3& LightVolume::GetMin() const
+{
+    return _min;
+}
+
+const glm::vec3& LightVolume::GetExtent() const
+{
+    return _extent;
+}
+
+float LightVolume::GetIntegrationStep() const
+{
+    return _step;
+}
+
+unsigned int LightVolume::GetSize() const
+{
+    return _size;
+}
+
+float LightVolume::Interpolate(const std::vector<float>& data,
+                               const glm::vec3&          pos) const
+{
+    // voxel coordinates of the centers, clamped to the outer centers
+    const auto maxCoord = float(_size - 1);
+
+    int   i0[3];
+    int   i1[3];
+    float w[3];
+
+    for (auto a = 0; a < 3; ++a)
+    {
+        auto c = (pos[a] - _min[a]) / _extent[a] * float(_size) - 0.5f;
+        c      = std::min(std::max(c, 0.0f), maxCoord);
+
+        i0[a] = int(c);
+        i1[a] = std::min(i0[a] + 1, int(_size) - 1);
+        w[a]  = c - float(i0[a]);
+    }
+
+    auto at = [&](int x, int y, int z)
+    { return data[(size_t(z) * _size + size_t(y)) * _size + size_t(x)]; };
+
+    const auto c00 = at(i0[0], i0[1], i0[2]) * (1.0f - w[0]) +
+                     at(i1[0], i0[1], i0[2]) * w[0];
+    const auto c10 = at(i0[0], i1[1], i0[2]) * (1.0f - w[0]) +
+                     at(i1[0], i1[1], i0[2]) * w[0];
+    const auto c01 = at(i0[0], i0[1], i1[2]) * (1.0f - w[0]) +
+                     at(i1[0], i0[1], i1[2]) * w[0];
+    const auto c11 = at(i0[0], i1[1], i1[2]) * (1.0f - w[0]) +
+                     at(i1[0], i1[1], i1[2]) * w[0];
+
+    const auto c0 = c00 * (1.0f - w[1]) + c10 * w[1];
+    const auto c1 = c01 * (1.0f - w[1]) + c11 * w[1];
+
+    return c0 * (1.0f - w[2]) + c1 * w[2];
+}
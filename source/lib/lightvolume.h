@@ -0,0 +1,130 @@
+#ifndef VOLUME_DEMO_LIGHTVOLUME_H__
+#define VOLUME_DEMO_LIGHTVOLUME_H__
+
+#include "glm/glm.hpp"
+#include <vector>
+
+/// Default number of voxels per edge of the light volume, see
+/// SceneSettings::_lightVolumeSize.
+static constexpr auto DEFAULT_LIGHT_VOLUME_SIZE = 32u;
+
+/// Sample spacing and length of the march toward the light of the volume
+/// light shading mode; the light volume counts samples in these units.
+static constexpr auto LIGHT_VOLUME_SAMPLE_STEP = 0.02f;
+static constexpr auto LIGHT_VOLUME_LENGTH      = 2.0f;
+
+//---------------------------------------------------------------------------
+/// Deep shadow grid of the volume light shading mode. The grid is fitted to
+/// the field bounds every frame. The occupancy of the field is sampled at
+/// the voxel centers, then integrated along the light direction: each voxel
+/// stores the number of samples inside the field a march of
+/// LIGHT_VOLUME_LENGTH toward the light would count. Outside of the bounds
+/// the field is empty.
+//---------------------------------------------------------------------------
+class LightVolume
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    LightVolume();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~LightVolume();
+
+    //---------------------------------------------------------------------------
+    /// Fits the grid to the given bounds and clears it. An empty box gives a
+    /// grid without occupancy.
+    /// @param[in]  boundsMin   Lower corner of the field bounds.
+    /// @param[in]  boundsMax   Upper corner of the field bounds.
+    /// @param[in]  lightDir    Normalized vector to the light source.
+    /// @param[in]  size        Number of voxels per edge.
+    /// @return                 False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Fit(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+             const glm::vec3& lightDir, unsigned int size);
+
+    //---------------------------------------------------------------------------
+    /// Returns the center of a voxel.
+    /// @param[in]  x       The voxel column.
+    /// @param[in]  y       The voxel row.
+    /// @param[in]  z       The voxel slice.
+    /// @return             The center in world space.
+    //---------------------------------------------------------------------------
+    glm::vec3 GetVoxelCenter(unsigned int x, unsigned int y,
+                             unsigned int z) const;
+
+    //---------------------------------------------------------------------------
+    /// Stores the occupancy of a voxel.
+    /// @param[in]  x           The voxel column.
+    /// @param[in]  y           The voxel row.
+    /// @param[in]  z           The voxel slice.
+    /// @param[in]  density     1 if the center is inside the field, else 0.
+    //---------------------------------------------------------------------------
+    void SetDensity(unsigned int x, unsigned int y, unsigned int z,
+                    float density);
+
+    //---------------------------------------------------------------------------
+    /// Integrates the occupancy toward the light for the voxels of one slice.
+    /// Call for every slice after all densities are set; the slices are
+    /// independent.
+    /// @param[in]  z       The voxel slice.
+    //---------------------------------------------------------------------------
+    void Integrate(unsigned int z);
+
+    //---------------------------------------------------------------------------
+    /// Looks up the integrated occupancy; interpolated between the voxel
+    /// centers and clamped to the grid.
+    /// @param[in]  pos     World space position.
+    /// @return             The number of samples inside the field on the
+    /// march toward the light.
+    //---------------------------------------------------------------------------
+    float GetSampleCount(const glm::vec3& pos) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the lower corner of the grid.
+    /// @return             The position in world space.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetMin() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the edge lengths of the grid.
+    /// @return             The lengths in world units.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetExtent() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the distance between the samples of Integrate().
+    /// @return             The distance in world units.
+    //---------------------------------------------------------------------------
+    float GetIntegrationStep() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of voxels per edge.
+    /// @return             The size; 0 before Fit().
+    //---------------------------------------------------------------------------
+    unsigned int GetSize() const;
+
+private:
+    //---------------------------------------------------------------------------
+    /// Interpolates a voxel grid at the given position like a linearly
+    /// filtered texture clamped to the edge.
+    /// @param[in]  data    The grid.
+    /// @param[in]  pos     World space position.
+    /// @return             The interpolated value.
+    //---------------------------------------------------------------------------
+    float Interpolate(const std::vector<float>& data,
+                      const glm::vec3&          pos) const;
+
+    glm::vec3          _min;      ///< lower corner of the grid.
+    glm::vec3          _extent;   ///< edge lengths of the grid.
+    glm::vec3          _lightDir; ///< normalized vector to the light.
+    float              _step;     ///< see GetIntegrationStep().
+    unsigned int       _size;     ///< voxels per edge.
+    std::vector<float> _density;  ///< occupancy per voxel, x fastest.
+    std::vector<float> _counts;   ///< integrated occupancy per voxel.
+};
+
+#endif // VOLUME_DEMO_LIGHTVOLUME_H__
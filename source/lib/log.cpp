@@ -1,5 +1,9 @@
 #include "log.h"
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <ctime>
+#endif
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -28,24 +32,57 @@ static auto IsError(error_sys_intern::MsgType type)
 //---------------------------------------------------------------------------
 static void PrintTime(std::ofstream& stream)
 {
+#ifdef _WIN32
     SYSTEMTIME systemTime;
 
     GetLocalTime(&systemTime);
 
-    stream << std::to_string(systemTime.wDay);
+    const auto day    = systemTime.wDay;
+    const auto month  = systemTime.wMonth;
+    const auto year   = systemTime.wYear;
+    const auto hour   = systemTime.wHour;
+    const auto minute = systemTime.wMinute;
+    const auto second = systemTime.wSecond;
+#else
+    const auto now = std::time(nullptr);
+    std::tm    systemTime{};
+    localtime_r(&now, &systemTime);
+
+    const auto day    = systemTime.tm_mday;
+    const auto month  = systemTime.tm_mon + 1;
+    const auto year   = systemTime.tm_year + 1900;
+    const auto hour   = systemTime.tm_hour;
+    const auto minute = systemTime.tm_min;
+    const auto second = systemTime.tm_sec;
+#endif
+
+    stream << std::to_string(day);
     stream << "-";
-    stream << std::to_string(systemTime.wMonth);
+    stream << std::to_string(month);
     stream << "-";
-    stream << std::to_string(systemTime.wYear);
+    stream << std::to_string(year);
     stream << " - ";
-    stream << std::to_string(systemTime.wHour);
+    stream << std::to_string(hour);
     stream << ":";
-    stream << std::to_string(systemTime.wMinute);
+    stream << std::to_string(minute);
     stream << ":";
-    stream << std::to_string(systemTime.wSecond);
+    stream << std::to_string(second);
     stream << "\n";
 }
 
+//---------------------------------------------------------------------------
+/// Prints a message to the debugger output window (Windows only).
+/// @param[in]  message     The message to print.
+//---------------------------------------------------------------------------
+static void PrintDebugString(const char* message)
+{
+#ifdef _WIN32
+    OutputDebugStringA(message);
+#else
+    (void)message;
+#endif
+}
+
 //---------------------------------------------------------------------------
 /// Prints error information to the given stream and the console.
 /// @param[in]  stream      The stream to write into.
@@ -77,10 +114,10 @@ static void PrintError(std::ofstream& stream, error_sys_intern::MsgType type,
         std::cout << file << std::endl;
 
         // print to console window
-        OutputDebugStringA(file);
-        OutputDebugStringA(" - ");
-        OutputDebugStringA(function);
-        OutputDebugStringA("\n");
+        PrintDebugString(file);
+        PrintDebugString(" - ");
+        PrintDebugString(function);
+        PrintDebugString("\n");
     }
 }
 
@@ -99,8 +136,8 @@ static void PrintMessage(std::ofstream& stream, const char* message)
     std::cout << message << std::endl;
 
     // print to console window
-    OutputDebugStringA(message);
-    OutputDebugStringA("\n");
+    PrintDebugString(message);
+    PrintDebugString("\n");
 }
 
 void error_sys_intern::WriteToLog(const char* message, MsgType type,
@@ -111,6 +148,7 @@ void error_sys_intern::WriteToLog(const char* message, MsgType type,
     if (g_unitTestMode)
         return;
 
+#ifdef _WIN32
     // get application location
     char appFilePath[MAX_PATH];
     GetModuleFileNameA(GetModuleHandle(0), appFilePath, sizeof(appFilePath));
@@ -119,6 +157,10 @@ void error_sys_intern::WriteToLog(const char* message, MsgType type,
     std::string logFilePath{appFilePath};
     const auto  found = logFilePath.find("exe");
     logFilePath.replace(found, 3, "txt");
+#else
+    // headless render nodes write into the working directory
+    const std::string logFilePath{"volume_rendering.txt"};
+#endif
 
     // write to file
     std::ofstream stream{logFilePath, std::ofstream::app};
@@ -135,7 +177,8 @@ void error_sys_intern::WriteToLog(const char* message, MsgType type,
     {
         // You hit this debug break because some error occurred.
         // Check the output console or the log file for more info.
-
+#ifdef _WIN32
         DebugBreak();
+#endif
     }
 }
@@ -0,0 +1,364 @@
+#include "noise.h"
+#include "log.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/// Texels of a row evaluated together; a multiple of the SIMD width.
+static constexpr auto NOISE_LANES = 16u;
+
+/// Lattice offset between the components; not an integer, so that the
+/// components do not share the zeros at the lattice points.
+static constexpr auto NOISE_COMPONENT_OFFSET = 101.5f;
+
+/* see
+K. Perlin, Improving noise, ACM Transactions on Graphics 21(3), 2002.
+*/
+
+/// Permutation of the lattice hash.
+static const unsigned char NOISE_PERMUTATION[256] = {
+    151, 160, 137, 91,  90,  15,  131, 13,  201, 95,  96,  53,  194, 233, 7,
+    225, 140, 36,  103, 30,  69,  142, 8,   99,  37,  240, 21,  10,  23,  190,
+    6,   148, 247, 120, 234, 75,  0,   26,  197, 62,  94,  252, 219, 203, 117,
+    35,  11,  32,  57,  177, 33,  88,  237, 149, 56,  87,  174, 20,  125, 136,
+    171, 168, 68,  175, 74,  165, 71,  134, 139, 48,  27,  166, 77,  146, 158,
+    231, 83,  111, 229, 122, 60,  211, 133, 230, 220, 105, 92,  41,  55,  46,
+    245, 40,  244, 102, 143, 54,  65,  25,  63,  161, 1,   216, 80,  73,  209,
+    76,  132, 187, 208, 89,  18,  169, 200, 196, 135, 130, 116, 188, 159, 86,
+    164, 100, 109, 198, 173, 186, 3,   64,  52,  217, 226, 250, 124, 123, 5,
+    202, 38,  147, 118, 126, 255, 82,  85,  212, 207, 206, 59,  227, 47,  16,
+    58,  17,  182, 189, 28,  42,  223, 183, 170, 213, 119, 248, 152, 2,   44,
+    154, 163, 70,  221, 153, 101, 155, 167, 43,  172, 9,   129, 22,  39,  253,
+    19,  98,  108, 110, 79,  113, 224, 232, 178, 185, 112, 104, 218, 246, 97,
+    228, 251, 34,  242, 193, 238, 210, 144, 12,  191, 179, 162, 241, 81,  51,
+    145, 235, 249, 14,  239, 107, 49,  192, 214, 31,  181, 199, 106, 157, 184,
+    84,  204, 176, 115, 121, 50,  45,  127, 4,   150, 254, 138, 236, 205, 93,
+    222, 114, 67,  29,  24,  72,  243, 141, 128, 195, 78,  66,  215, 61,  156,
+    180};
+
+/// Gradients of the lattice points: the edge midpoints of a cube, padded to
+/// 16 entries; indexed by the low bits of the hash.
+static const float NOISE_GRADIENT_X[16] = {1.0f, -1.0f, 1.0f,  -1.0f,
+                                           1.0f, -1.0f, 1.0f,  -1.0f,
+                                           0.0f, 0.0f,  0.0f,  0.0f,
+                                           1.0f, 0.0f,  -1.0f, 0.0f};
+static const float NOISE_GRADIENT_Y[16] = {1.0f, 1.0f,  -1.0f, -1.0f,
+                                           0.0f, 0.0f,  0.0f,  0.0f,
+                                           1.0f, -1.0f, 1.0f,  -1.0f,
+                                           1.0f, -1.0f, 1.0f,  -1.0f};
+static const float NOISE_GRADIENT_Z[16] = {0.0f, 0.0f, 0.0f,  0.0f,
+                                           1.0f, 1.0f, -1.0f, -1.0f,
+                                           1.0f, 1.0f, -1.0f, -1.0f,
+                                           0.0f, 1.0f, 0.0f,  -1.0f};
+
+//---------------------------------------------------------------------------
+/// Returns the quintic interpolation weight of the improved noise.
+//---------------------------------------------------------------------------
+static float Fade(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+//---------------------------------------------------------------------------
+/// Evaluates the noise at NOISE_LANES points of a row. The lanes share the
+/// lattice row in y and z; every step is a loop over the lanes without
+/// branches, so that the compiler vectorizes it.
+/// @param[in]  x       The lattice coordinates of the points.
+/// @param[in]  y       The lattice row.
+/// @param[in]  z       The lattice slice.
+/// @param[out] result  The noise values in the range [-1, 1].
+//---------------------------------------------------------------------------
+static void NoiseLanes(const float* x, float y, float z, float* result)
+{
+    const auto& p = NOISE_PERMUTATION;
+
+    const auto yFloor = std::floor(y);
+    const auto zFloor = std::floor(z);
+    const auto yi     = int(yFloor) & 255;
+    const auto zi     = int(zFloor) & 255;
+    const auto fy     = y - yFloor;
+    const auto fz     = z - zFloor;
+    const auto v      = Fade(fy);
+    const auto w      = Fade(fz);
+
+    int   xi[NOISE_LANES];
+    float fx[NOISE_LANES];
+    float u[NOISE_LANES];
+
+    for (auto l = 0u; l < NOISE_LANES; ++l)
+    {
+        const auto xFloor = std::floor(x[l]);
+        xi[l]             = int(xFloor) & 255;
+        fx[l]             = x[l] - xFloor;
+        u[l]              = Fade(fx[l]);
+    }
+
+    // dot products of the gradients at the cell corners, x fastest
+    float corner[8][NOISE_LANES];
+
+    for (auto c = 0u; c < 8; ++c)
+    {
+        const auto cx = int(c & 1);
+        const auto cy = int(c >> 1 & 1);
+        const auto cz = int(c >> 2);
+
+        for (auto l = 0u; l < NOISE_LANES; ++l)
+        {
+            const auto hx = p[(xi[l] + cx) & 255];
+            const auto hy = p[(hx + yi + cy) & 255];
+            const auto h  = p[(hy + zi + cz) & 255] & 15;
+
+            corner[c][l] = NOISE_GRADIENT_X[h] * (fx[l] - float(cx)) +
+                           NOISE_GRADIENT_Y[h] * (fy - float(cy)) +
+                           NOISE_GRADIENT_Z[h] * (fz - float(cz));
+        }
+    }
+
+    for (auto l = 0u; l < NOISE_LANES; ++l)
+    {
+        const auto x00 = corner[0][l] + (corner[1][l] - corner[0][l]) * u[l];
+        const auto x10 = corner[2][l] + (corner[3][l] - corner[2][l]) * u[l];
+        const auto x01 = corner[4][l] + (corner[5][l] - corner[4][l]) * u[l];
+        const auto x11 = corner[6][l] + (corner[7][l] - corner[6][l]) * u[l];
+
+        const auto y0 = x00 + (x10 - x00) * v;
+        const auto y1 = x01 + (x11 - x01) * v;
+
+        result[l] = y0 + (y1 - y0) * w;
+    }
+}
+
+bool NoiseParams::operator!=(const NoiseParams& other) const
+{
+    return _width != other._width || _height != other._height ||
+           _depth != other._depth || _components != other._components ||
+           _frequency != other._frequency;
+}
+
+NoiseParams GetNoiseParams(unsigned int volumeSize)
+{
+    NoiseParams params;
+
+    if (volumeSize > 0)
+    {
+        params._width      = volumeSize;
+        params._height     = volumeSize;
+        params._depth      = volumeSize;
+        params._components = NOISE_VOLUME_COMPONENTS;
+    }
+
+    return params;
+}
+
+bool CreateNoiseData(const NoiseParams& params, unsigned int threads,
+                     NoiseData& data)
+{
+    /* see
+    D. Wolff, OpenGL 4 shading language cookbook, Birmingham: Packt Publishing,
+    2013.
+
+    Chapter "Creating a noise texture using GLM"
+    */
+
+    if (IsNull(params._width, MSG_INFO("Illegal value for width.")))
+        return false;
+    if (IsNull(params._height, MSG_INFO("Illegal value for height.")))
+        return false;
+    if (IsNull(params._depth, MSG_INFO("Illegal value for depth.")))
+        return false;
+    if (IsFalse(params._components == 1 || params._components == 2,
+                MSG_INFO("Illegal value for components.")))
+        return false;
+    if (IsFalse(params._frequency > 0.0f,
+                MSG_INFO("Illegal value for frequency.")))
+        return false;
+
+    const auto width      = params._width;
+    const auto height     = params._height;
+    const auto components = params._components;
+
+    // allocate data
+    data._file.Close();
+    data._params = params;
+    data._storage.resize(size_t(width) * height * params._depth * components);
+    data._texels = data._storage.data();
+
+    // lattice coordinates of the texel centers
+    auto lattice = [&](unsigned int i, unsigned int size, unsigned int c)
+    {
+        return (float(i) + 0.5f) / float(size) * params._frequency +
+               float(c) * NOISE_COMPONENT_OFFSET;
+    };
+
+    ParallelFor(
+        height * params._depth, threads,
+        [&](unsigned int row)
+        {
+            const auto y = row % height;
+            const auto z = row / height;
+
+            auto* texels = &data._storage[size_t(row) * width * components];
+
+            for (auto c = 0u; c < components; ++c)
+            {
+                const auto yl = lattice(y, height, c);
+                const auto zl = lattice(z, params._depth, c);
+
+                for (auto x0 = 0u; x0 < width; x0 += NOISE_LANES)
+                {
+                    float xl[NOISE_LANES];
+                    float noise[NOISE_LANES];
+
+                    for (auto l = 0u; l < NOISE_LANES; ++l)
+                        xl[l] = lattice(x0 + l, width, c);
+
+                    NoiseLanes(xl, yl, zl, noise);
+
+                    const auto count = std::min(NOISE_LANES, width - x0);
+                    for (auto l = 0u; l < count; ++l)
+                    {
+                        const auto result =
+                            std::min(std::max((noise[l] + 1.0f) * .5f, 0.0f),
+                                     1.0f);
+
+                        texels[(x0 + l) * components + c] =
+                            (unsigned char)(result * 255.9f);
+                    }
+                }
+            }
+        });
+
+    return true;
+}
+
+bool LoadNoiseData(const NoiseParams& params, unsigned int threads,
+                   const AssetCache& cache, NoiseData& data)
+{
+    // the key holds every value the texels depend on
+    const unsigned int fields[] = {NOISE_GENERATOR_VERSION, params._width,
+                                   params._height, params._depth,
+                                   params._components};
+
+    std::vector<unsigned char> key(sizeof(fields) + sizeof(float));
+    std::memcpy(key.data(), fields, sizeof(fields));
+    std::memcpy(key.data() + sizeof(fields), &params._frequency,
+                sizeof(float));
+
+    const auto size =
+        size_t(params._width) * params._height * params._depth *
+        params._components;
+
+    // the previous texels are released first
+    data._texels = nullptr;
+    data._file.Close();
+    data._storage.clear();
+
+    const unsigned char* texels = nullptr;
+    auto                 cached = size_t(0);
+
+    if (cache.Load("noise", key, data._file, texels, cached))
+    {
+        if (cached == size)
+        {
+            data._params = params;
+            data._texels = texels;
+            data._storage.shrink_to_fit();
+            return true;
+        }
+
+        data._file.Close();
+    }
+
+    if (!CreateNoiseData(params, threads, data))
+        return false;
+
+    // a failed write only costs the next start the generation
+    cache.Store("noise", key, data._texels, size);
+
+    return true;
+}
+
+//---------------------------------------------------------------------------
+/// Applies GL_MIRRORED_REPEAT to the given texel index.
+/// @param[in]  i       The texel index.
+/// @param[in]  size    The texture size.
+/// @return             The index in the range [0, size).
+//---------------------------------------------------------------------------
+static int MirroredRepeat(int i, int size)
+{
+    const auto period = size * 2;
+
+    auto m = i % period;
+    if (m < 0)
+        m += period;
+    if (m >= size)
+        m = period - 1 - m;
+
+    return m;
+}
+
+float SampleNoiseData(const NoiseData& data, const glm::vec3& uvw,
+                      float blend, glm::vec3* gradient)
+{
+    const auto& params = data._params;
+    const int   size[3] = {int(params._width), int(params._height),
+                           int(params._depth)};
+
+    int   i0[3];
+    int   i1[3];
+    float f[3];
+
+    for (auto a = 0; a < 3; ++a)
+    {
+        const auto t     = uvw[a] * float(size[a]) - 0.5f;
+        const auto floor = std::floor(t);
+
+        f[a]  = t - floor;
+        i0[a] = MirroredRepeat(int(floor), size[a]);
+        i1[a] = MirroredRepeat(int(floor) + 1, size[a]);
+    }
+
+    const auto components = int(params._components);
+    const auto second     = components > 1 ? 1 : 0;
+
+    auto texel = [&](int tx, int ty, int tz)
+    {
+        const auto index =
+            ((size_t(tz) * size[1] + ty) * size[0] + tx) * components;
+        const auto a = float(data._texels[index]) / 255.0f;
+        const auto b = float(data._texels[index + second]) / 255.0f;
+        return glm::mix(a, b, blend);
+    };
+
+    const auto t000 = texel(i0[0], i0[1], i0[2]);
+    const auto t100 = texel(i1[0], i0[1], i0[2]);
+    const auto t010 = texel(i0[0], i1[1], i0[2]);
+    const auto t110 = texel(i1[0], i1[1], i0[2]);
+    const auto t001 = texel(i0[0], i0[1], i1[2]);
+    const auto t101 = texel(i1[0], i0[1], i1[2]);
+    const auto t011 = texel(i0[0], i1[1], i1[2]);
+    const auto t111 = texel(i1[0], i1[1], i1[2]);
+
+    const auto bottom0 = glm::mix(t000, t100, f[0]);
+    const auto top0    = glm::mix(t010, t110, f[0]);
+    const auto bottom1 = glm::mix(t001, t101, f[0]);
+    const auto top1    = glm::mix(t011, t111, f[0]);
+
+    const auto slice0 = glm::mix(bottom0, top0, f[1]);
+    const auto slice1 = glm::mix(bottom1, top1, f[1]);
+
+    if (gradient)
+    {
+        const auto dx0 = glm::mix(t100 - t000, t110 - t010, f[1]);
+        const auto dx1 = glm::mix(t101 - t001, t111 - t011, f[1]);
+
+        gradient->x = glm::mix(dx0, dx1, f[2]) * float(size[0]);
+        gradient->y =
+            glm::mix(top0 - bottom0, top1 - bottom1, f[2]) * float(size[1]);
+        gradient->z = (slice1 - slice0) * float(size[2]);
+    }
+
+    return glm::mix(slice0, slice1, f[2]);
+}
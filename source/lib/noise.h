@@ -0,0 +1,114 @@
+#ifndef VOLUME_DEMO_NOISE_H__
+#define VOLUME_DEMO_NOISE_H__
+
+#include "assetcache.h"
+#include "glm/glm.hpp"
+#include <vector>
+
+/// Width of the noise slice.
+static constexpr auto NOISE_TEXTURE_WIDTH = 256u;
+
+/// Height of the noise slice.
+static constexpr auto NOISE_TEXTURE_HEIGHT = 256u;
+
+/// Number of components per texel of the noise slice; stored as R8.
+static constexpr auto NOISE_TEXTURE_COMPONENTS = 1u;
+
+/// Default voxels per edge of the noise volume, see
+/// SceneSettings::_noiseVolumeSize.
+static constexpr auto DEFAULT_NOISE_VOLUME_SIZE = 64u;
+
+/// Number of components per voxel of the noise volume; two independent
+/// noises the animation blends between, stored as RG8.
+static constexpr auto NOISE_VOLUME_COMPONENTS = 2u;
+
+/// Lattice cells of the gradient noise per edge of the texture.
+static constexpr auto NOISE_FREQUENCY = 6.5f;
+
+//---------------------------------------------------------------------------
+/// Parameters of the generated noise; equal parameters give equal texels.
+//---------------------------------------------------------------------------
+struct NoiseParams
+{
+    unsigned int _width      = NOISE_TEXTURE_WIDTH;      ///< texels per row.
+    unsigned int _height     = NOISE_TEXTURE_HEIGHT;     ///< rows per slice.
+    unsigned int _depth      = 1;                        ///< slices.
+    unsigned int _components = NOISE_TEXTURE_COMPONENTS; ///< 1 or 2 noises.
+    float        _frequency  = NOISE_FREQUENCY;          ///< lattice cells.
+
+    //---------------------------------------------------------------------------
+    /// Compares all parameters.
+    /// @param[in]  other   The parameters to compare with.
+    /// @return             True if the parameters differ.
+    //---------------------------------------------------------------------------
+    bool operator!=(const NoiseParams& other) const;
+};
+
+/// Version of the noise generator; part of the asset cache key, see
+/// LoadNoiseData(). Increment it if the texels of equal parameters change.
+static constexpr auto NOISE_GENERATOR_VERSION = 1u;
+
+//---------------------------------------------------------------------------
+/// 8-bit gradient noise; the data of the OpenGL noise texture and of the
+/// CPU renderer. Texels are stored x fastest with interleaved components,
+/// either generated into _storage or mapped from the asset cache.
+//---------------------------------------------------------------------------
+struct NoiseData
+{
+    NoiseParams                _params;            ///< parameters of texels.
+    std::vector<unsigned char> _storage;           ///< generated texels.
+    MappedFile                 _file;              ///< cached texels.
+    const unsigned char*       _texels = nullptr;  ///< the normalized values.
+};
+
+//---------------------------------------------------------------------------
+/// Returns the noise parameters of the scene settings.
+/// @param[in]  volumeSize  Voxels per edge of the noise volume; 0 for the
+/// 2D slice, see SceneSettings::_noiseVolumeSize.
+/// @return                 The parameters.
+//---------------------------------------------------------------------------
+NoiseParams GetNoiseParams(unsigned int volumeSize);
+
+//---------------------------------------------------------------------------
+/// Fills the given data with improved Perlin noise. Each component samples
+/// its own lattice; a depth of 1 gives a 2D slice through the 3D noise at
+/// the lattice coordinate z = frequency / 2. The texels are sampled at their
+/// centers, so the slice differs from the former glm::perlin() texture.
+/// Whole rows are evaluated in lanes the compiler vectorizes, the rows are
+/// distributed over the threads. The result does not depend on the number
+/// of threads.
+/// @param[in]  params      The noise parameters.
+/// @param[in]  threads     The number of threads. 0 to use all cores.
+/// @param[out] data        The data to fill.
+/// @return                 False if an error occurred.
+//---------------------------------------------------------------------------
+bool CreateNoiseData(const NoiseParams& params, unsigned int threads,
+                     NoiseData& data);
+
+//---------------------------------------------------------------------------
+/// Maps the noise of the given parameters from the asset cache, or creates
+/// it with CreateNoiseData() and stores it on a cache miss.
+/// @param[in]  params      The noise parameters.
+/// @param[in]  threads     The number of threads. 0 to use all cores.
+/// @param[in]  cache       The asset cache; may be disabled.
+/// @param[out] data        The data to fill.
+/// @return                 False if an error occurred.
+//---------------------------------------------------------------------------
+bool LoadNoiseData(const NoiseParams& params, unsigned int threads,
+                   const AssetCache& cache, NoiseData& data);
+
+//---------------------------------------------------------------------------
+/// Samples the noise like texture() does with GL_LINEAR filtering and
+/// GL_MIRRORED_REPEAT wrapping, blending the first two components.
+/// @param[in]  data        The noise data.
+/// @param[in]  uvw         The texture coordinates.
+/// @param[in]  blend       Weight of the second component; ignored with one
+/// component.
+/// @param[out] gradient    Optional; the derivatives of the trilinear
+/// interpolation with respect to uvw.
+/// @return                 The normalized value.
+//---------------------------------------------------------------------------
+float SampleNoiseData(const NoiseData& data, const glm::vec3& uvw,
+                      float blend, glm::vec3* gradient);
+
+#endif // VOLUME_DEMO_NOISE_H__
@@ -0,0 +1,140 @@
+#include "octree.h"
+#include "log.h"
+#include "scene.h"
+
+#include <algorithm>
+
+Octree::Octree() {}
+
+Octree::~Octree() = default;
+
+bool Octree::Build(const ObjectArray& objects)
+{
+    const auto count = int(objects.GetObjectCount());
+
+    _nodes.clear();
+    _indices.resize(count);
+
+    for (auto i = 0; i < count; ++i)
+        _indices[i] = i;
+
+    if (count == 0)
+        return true;
+
+    // bounding cube of all centers
+    auto minPos = objects.GetPosition(0);
+    auto maxPos = minPos;
+
+    for (auto i = 1; i < count; ++i)
+    {
+        const auto pos = objects.GetPosition(i);
+        minPos         = glm::min(minPos, pos);
+        maxPos         = glm::max(maxPos, pos);
+    }
+
+    const auto extent = maxPos - minPos;
+    const auto size   = std::max(extent.x, std::max(extent.y, extent.z));
+
+    AddNode(objects, 0, count, (minPos + maxPos) * 0.5f, size * 0.5f, 0);
+
+    if (IsValue(_nodes.empty(), true, MSG_INFO("Could not build octree.")))
+        return false;
+
+    return true;
+}
+
+void Octree::AddNode(const ObjectArray& objects, int begin, int end,
+                     const glm::vec3& center, float size, int depth)
+{
+    const auto nodeIndex = _nodes.size();
+    const auto count     = end - begin;
+
+    // aggregate values
+    OctreeNode node;
+    node._center = glm::vec3(0.0f);
+    node._color  = glm::vec3(0.0f);
+
+    for (auto i = begin; i < end; ++i)
+    {
+        node._center += objects.GetPosition(_indices[i]);
+        node._color += objects.GetColor(_indices[i]);
+    }
+
+    node._center /= float(count);
+    node._radius = 0.0f;
+
+    for (auto i = begin; i < end; ++i)
+    {
+        const auto dist =
+            glm::length(objects.GetPosition(_indices[i]) - node._center);
+        node._radius = std::max(node._radius, dist);
+    }
+
+    node._count     = float(count);
+    node._next      = 0.0f;
+    node._first     = float(begin);
+    node._leafCount = 0.0f;
+    node._padding   = 0.0f;
+
+    const auto leaf = count <= MAX_LEAF_OBJECTS || depth >= MAX_OCTREE_DEPTH;
+
+    if (leaf)
+        node._leafCount = float(count);
+
+    _nodes.push_back(node);
+
+    if (!leaf)
+    {
+        // sort the indices into the octants: x, then y, then z
+        auto* first = _indices.data() + begin;
+        auto* last  = _indices.data() + end;
+
+        auto below = [&](int axis)
+        {
+            return [&objects, &center, axis](int i)
+            { return objects.GetPosition(i)[axis] < center[axis]; };
+        };
+
+        int* split[9];
+        split[0] = first;
+        split[8] = last;
+        split[4] = std::partition(split[0], split[8], below(2));
+        split[2] = std::partition(split[0], split[4], below(1));
+        split[6] = std::partition(split[4], split[8], below(1));
+        split[1] = std::partition(split[0], split[2], below(0));
+        split[3] = std::partition(split[2], split[4], below(0));
+        split[5] = std::partition(split[4], split[6], below(0));
+        split[7] = std::partition(split[6], split[8], below(0));
+
+        const auto childSize = size * 0.5f;
+
+        for (auto octant = 0; octant < 8; ++octant)
+        {
+            const auto childBegin = int(split[octant] - _indices.data());
+            const auto childEnd   = int(split[octant + 1] - _indices.data());
+
+            if (childBegin == childEnd)
+                continue;
+
+            // partitioned "below" first; octant bits are x, y, z
+            const glm::vec3 offset((octant & 1) ? childSize : -childSize,
+                                   (octant & 2) ? childSize : -childSize,
+                                   (octant & 4) ? childSize : -childSize);
+
+            AddNode(objects, childBegin, childEnd, center + offset, childSize,
+                    depth + 1);
+        }
+    }
+
+    _nodes[nodeIndex]._next = float(_nodes.size());
+}
+
+const std::vector<OctreeNode>& Octree::GetNodes() const
+{
+    return _nodes;
+}
+
+const std::vector<int>& Octree::GetIndices() const
+{
+    return _indices;
+}
@@ -0,0 +1,100 @@
+#ifndef VOLUME_DEMO_OCTREE_H__
+#define VOLUME_DEMO_OCTREE_H__
+
+#include "glm/glm.hpp"
+#include <vector>
+
+class ObjectArray;
+
+/// Maximum number of metaballs stored in a leaf node.
+static constexpr auto MAX_LEAF_OBJECTS = 4;
+
+/// Maximum depth of the octree; limits the recursion for coincident centers.
+static constexpr auto MAX_OCTREE_DEPTH = 16;
+
+//---------------------------------------------------------------------------
+/// Node of the flattened octree. Stores only floats so the node array can be
+/// uploaded as an RGBA32F texture buffer (three texels per node); the integer
+/// values are exact up to 2^24.
+//---------------------------------------------------------------------------
+struct OctreeNode
+{
+    glm::vec3 _center;    ///< mean position of the metaballs in the node.
+    float     _radius;    ///< distance from _center to the farthest metaball.
+    glm::vec3 _color;     ///< sum of the metaball colors.
+    float     _count;     ///< number of metaballs in the node.
+    float     _next;      ///< index of the node following the subtree.
+    float     _first;     ///< leaf only: first entry in the index array.
+    float     _leafCount; ///< number of indices of a leaf; 0 for inner nodes.
+    float     _padding;   ///< unused.
+};
+
+static_assert(sizeof(OctreeNode) == 12 * sizeof(float),
+              "OctreeNode must be three RGBA32F texels.");
+
+//---------------------------------------------------------------------------
+/// Octree over the metaball centers for the Barnes-Hut approximation of the
+/// inverse square kernel. A node whose bounding sphere appears smaller than
+/// the opening angle from the sample point is evaluated as a single metaball
+/// at the node's mean position; the relative error of the field is roughly
+/// the square of the opening angle.
+///
+/// The nodes are stored in depth-first order. The first child of an inner
+/// node directly follows the node and _next skips the subtree, so the tree
+/// can be traversed without a stack:
+///
+///     node = 0
+///     while node < nodeCount
+///         if leaf or far away: evaluate node, node = _next
+///         else:                node = node + 1
+//---------------------------------------------------------------------------
+class Octree
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    Octree();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~Octree();
+
+    //---------------------------------------------------------------------------
+    /// Builds the octree.
+    /// @param[in]  objects The metaballs.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Build(const ObjectArray& objects);
+
+    //---------------------------------------------------------------------------
+    /// Returns the nodes in depth-first order; the root is the first node.
+    /// @return             The node array.
+    //---------------------------------------------------------------------------
+    const std::vector<OctreeNode>& GetNodes() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the metaball indices referenced by the leaf nodes.
+    /// @return             The index array.
+    //---------------------------------------------------------------------------
+    const std::vector<int>& GetIndices() const;
+
+private:
+    //---------------------------------------------------------------------------
+    /// Adds the node for the given range of _indices and its subtree.
+    /// @param[in]  objects The metaballs.
+    /// @param[in]  begin   First entry in _indices.
+    /// @param[in]  end     Entry after the last one in _indices.
+    /// @param[in]  center  Center of the node's cube.
+    /// @param[in]  size    Half the edge length of the node's cube.
+    /// @param[in]  depth   The depth of the node.
+    //---------------------------------------------------------------------------
+    void AddNode(const ObjectArray& objects, int begin, int end,
+                 const glm::vec3& center, float size, int depth);
+
+    std::vector<OctreeNode> _nodes;   ///< nodes in depth-first order.
+    std::vector<int>        _indices; ///< metaball indices, sorted by leaf.
+};
+
+#endif // VOLUME_DEMO_OCTREE_H__
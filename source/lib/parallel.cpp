@@ -0,0 +1,109 @@
+#include "parallel.h"
+
+ThreadPool::ThreadPool()
+{
+    _function   = nullptr;
+    _context    = nullptr;
+    _count      = 0;
+    _next       = 0;
+    _helpers    = 0;
+    _busy       = 0;
+    _generation = 0;
+    _stop       = false;
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+
+    _start.notify_all();
+
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::GetInstance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Run(unsigned int count, unsigned int threads,
+                     JobFunction function, void* context)
+{
+    std::unique_lock<std::mutex> running(_runMutex, std::try_to_lock);
+
+    const auto threadCount = std::min(threads, count);
+
+    // a nested or concurrent loop runs on the calling thread
+    if (!running.owns_lock() || threadCount <= 1)
+    {
+        for (auto i = 0u; i < count; ++i)
+            function(context, i);
+        return;
+    }
+
+    const auto helpers = threadCount - 1;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        while (_workers.size() < helpers)
+            _workers.emplace_back(&ThreadPool::Work, this,
+                                  unsigned(_workers.size()));
+
+        _function = function;
+        _context  = context;
+        _count    = count;
+        _next     = 0;
+        _helpers  = helpers;
+        _busy     = helpers;
+        ++_generation;
+    }
+
+    _start.notify_all();
+
+    // the calling thread works too
+    RunJobs();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this]() { return _busy == 0; });
+}
+
+void ThreadPool::Work(unsigned int worker)
+{
+    auto generation = 0u;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (;;)
+    {
+        _start.wait(lock,
+                    [&]() { return _stop || _generation != generation; });
+
+        if (_stop)
+            return;
+
+        generation = _generation;
+
+        // Run() waits for the helpers, so none misses its loop
+        if (worker >= _helpers)
+            continue;
+
+        lock.unlock();
+        RunJobs();
+        lock.lock();
+
+        if (--_busy == 0)
+            _done.notify_one();
+    }
+}
+
+void ThreadPool::RunJobs()
+{
+    for (auto i = _next++; i < _count; i = _next++)
+        _function(_context, i);
+}
@@ -0,0 +1,126 @@
+#ifndef VOLUME_DEMO_PARALLEL_H__
+#define VOLUME_DEMO_PARALLEL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//---------------------------------------------------------------------------
+/// Returns the number of worker threads to use.
+/// @param[in]  requested   The requested thread count. 0 to use all cores.
+/// @return                 The number of threads; at least 1.
+//---------------------------------------------------------------------------
+inline unsigned int GetThreadCount(unsigned int requested)
+{
+    if (requested != 0)
+        return requested;
+
+    const auto cores = std::thread::hardware_concurrency();
+    return std::max(cores, 1u);
+}
+
+//---------------------------------------------------------------------------
+/// Worker threads that stay alive between the loops of ParallelFor(); a
+/// frame of the CPU renderer runs up to eight loops, and starting threads
+/// per loop costs more the more cores there are. The workers are created on
+/// demand and sleep between the loops. One loop runs at a time: a loop
+/// started while another one runs, e.g. from one of its jobs or from a
+/// second renderer on another thread, runs on the calling thread alone.
+//---------------------------------------------------------------------------
+class ThreadPool
+{
+public:
+    /// Function called with the context of Run() and a job index.
+    using JobFunction = void (*)(void* context, unsigned int index);
+
+    //---------------------------------------------------------------------------
+    /// Returns the pool of the process.
+    /// @return             The pool; created on the first call.
+    //---------------------------------------------------------------------------
+    static ThreadPool& GetInstance();
+
+    //---------------------------------------------------------------------------
+    /// Destructor; stops and joins the workers.
+    //---------------------------------------------------------------------------
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //---------------------------------------------------------------------------
+    /// Calls the given function for each job index in [0, count) and returns
+    /// when all jobs are done. Jobs are distributed dynamically.
+    /// @param[in]  count       The number of jobs.
+    /// @param[in]  threads     The number of threads including the calling
+    /// one; at least 1.
+    /// @param[in]  function    Function called with the context and the job
+    /// index.
+    /// @param[in]  context     Passed to the function.
+    //---------------------------------------------------------------------------
+    void Run(unsigned int count, unsigned int threads, JobFunction function,
+             void* context);
+
+private:
+    ThreadPool();
+
+    //---------------------------------------------------------------------------
+    /// Main function of a worker; takes part in the loops it is needed for.
+    /// @param[in]  worker      Index of the worker.
+    //---------------------------------------------------------------------------
+    void Work(unsigned int worker);
+
+    //---------------------------------------------------------------------------
+    /// Calls the job function until all jobs of the loop are taken.
+    //---------------------------------------------------------------------------
+    void RunJobs();
+
+    std::mutex               _runMutex;   ///< held by the running loop.
+    std::mutex               _mutex;      ///< guards the members below.
+    std::condition_variable  _start;      ///< signals a loop or _stop.
+    std::condition_variable  _done;       ///< signals the last helper.
+    std::vector<std::thread> _workers;    ///< the sleeping workers.
+    JobFunction              _function;   ///< job function of the loop.
+    void*                    _context;    ///< context of the job function.
+    unsigned int             _count;      ///< number of jobs of the loop.
+    std::atomic<unsigned>    _next;       ///< next job index to take.
+    unsigned int             _helpers;    ///< workers taking part.
+    unsigned int             _busy;       ///< helpers still running.
+    unsigned int             _generation; ///< number of loops started.
+    bool                     _stop;       ///< True to end the workers.
+};
+
+//---------------------------------------------------------------------------
+/// Calls the given function for each job index in [0, count). Jobs are
+/// distributed dynamically over the given number of threads: the calling
+/// thread and the workers of ThreadPool.
+/// @param[in]  count       The number of jobs.
+/// @param[in]  threads     The number of threads. 0 to use all cores.
+/// @param[in]  f           Function called with the job index.
+//---------------------------------------------------------------------------
+template <typename F>
+inline void ParallelFor(unsigned int count, unsigned int threads, F&& f)
+{
+    const auto threadCount = std::min(GetThreadCount(threads), count);
+
+    if (threadCount <= 1)
+    {
+        for (auto i = 0u; i < count; ++i)
+            f(i);
+        return;
+    }
+
+    using Function = std::remove_reference_t<F>;
+
+    auto call = [](void* context, unsigned int i)
+    { (*static_cast<Function*>(context))(i); };
+
+    ThreadPool::GetInstance().Run(
+        count, threadCount, call,
+        const_cast<void*>(static_cast<const void*>(&f)));
+}
+
+#endif // VOLUME_DEMO_PARALLEL_H__
@@ -7,6 +7,9 @@
 #include <iostream>
 #include <string>
 
+/// Largest object count bucket, see ShaderPermutation::GetObjectBucket().
+static constexpr auto MAX_OBJECT_BUCKET = 64u;
+
 // glGetUniformLocation returns -1 if the given name could not be found
 // see
 // https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGetUniformLocation.xhtml
@@ -65,6 +68,7 @@ ShaderProgram::ShaderProgram()
 {
     _program        = 0;
     _isLinked       = false;
+    _specialized    = false;
     _vertexShader   = 0;
     _fragmentShader = 0;
 }
@@ -106,6 +110,12 @@ bool ShaderProgram::LoadVertexShader(const char* filename)
 }
 
 bool ShaderProgram::LoadFragmentShader(const char* head, const char* body)
+{
+    return LoadFragmentShader(head, body, std::string());
+}
+
+bool ShaderProgram::LoadFragmentShader(const char* head, const char* body,
+                                       const std::string& defines)
 {
     if (IsNullptr(head, MSG_INFO("No head file set.")))
         return false;
@@ -126,6 +136,18 @@ bool ShaderProgram::LoadFragmentShader(const char* head, const char* body)
                 MSG_INFO("Could not load body file.")))
         return false;
 
+    // the defines follow the #version directive in the first line
+    if (!defines.empty())
+    {
+        const auto lineEnd = headText.find('\n');
+        if (IsValue(lineEnd, std::string::npos,
+                    MSG_INFO("Shader head has no version line.")))
+            return false;
+
+        headText.insert(lineEnd + 1, defines);
+        _specialized = true;
+    }
+
     const auto fullText = headText + bodyText;
 
     const auto res = MakeShader(GL_FRAGMENT_SHADER, fullText, _fragmentShader);
@@ -239,7 +261,8 @@ bool ShaderProgram::SetUniform(const char* name, const glm::mat4& m)
         return false;
 
     const auto location = GetUniformLocation(name);
-    if (IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
+    if (!_specialized &&
+        IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
         return false;
 
     glUniformMatrix4fv(location, 1, GL_FALSE, &m[0][0]);
@@ -253,7 +276,8 @@ bool ShaderProgram::SetUniform(const char* name, const glm::vec3& v)
         return false;
 
     const auto location = GetUniformLocation(name);
-    if (IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
+    if (!_specialized &&
+        IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
         return false;
 
     glUniform3fv(location, 1, &v[0]);
@@ -261,13 +285,29 @@ bool ShaderProgram::SetUniform(const char* name, const glm::vec3& v)
     return true;
 }
 
+bool ShaderProgram::SetUniform(const char* name, const glm::ivec3& v)
+{
+    if (IsNull(_program, MSG_INFO("Program not set.")))
+        return false;
+
+    const auto location = GetUniformLocation(name);
+    if (!_specialized &&
+        IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
+        return false;
+
+    glUniform3i(location, v.x, v.y, v.z);
+
+    return true;
+}
+
 bool ShaderProgram::SetUniform(const char* name, const glm::float32& v)
 {
     if (IsNull(_program, MSG_INFO("Program not set.")))
         return false;
 
     const auto location = GetUniformLocation(name);
-    if (IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
+    if (!_specialized &&
+        IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
         return false;
 
     glUniform1f(location, v);
@@ -281,7 +321,8 @@ bool ShaderProgram::SetUniform(const char* name, unsigned int v)
         return false;
 
     const auto location = GetUniformLocation(name);
-    if (IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
+    if (!_specialized &&
+        IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
         return false;
 
     glUniform1i(location, v);
@@ -299,7 +340,8 @@ bool ShaderProgram::SetUniform(const char* name, const glm::vec3* const v,
         return false;
 
     const auto location = GetUniformLocation(name);
-    if (IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
+    if (!_specialized &&
+        IsValue(location, LOCATION_FAIL, MSG_INFO(GetUniformErrorString(name))))
         return false;
 
     glUniform3fv(location, count, glm::value_ptr(v[0]));
@@ -327,3 +369,103 @@ void ShaderProgram::End()
 {
     glUseProgram(0);
 }
+
+unsigned int ShaderPermutation::GetObjectBucket(unsigned int objectCount)
+{
+    auto bucket = 8u;
+    while (bucket < objectCount)
+        bucket *= 2;
+
+    return bucket <= MAX_OBJECT_BUCKET ? bucket : 0u;
+}
+
+std::string ShaderPermutation::GetDefines() const
+{
+    std::string defines;
+
+    if (_shadingMode >= 0)
+        defines += "#define SHADING_MODE " + std::to_string(_shadingMode) +
+                   "\n";
+    if (_noise >= 0)
+        defines += "#define NOISE " + std::to_string(_noise) + "\n";
+    if (_objectBucket > 0)
+        defines += "#define OBJECT_BUCKET " + std::to_string(_objectBucket) +
+                   "\n";
+
+    return defines;
+}
+
+bool ShaderPermutation::operator<(const ShaderPermutation& other) const
+{
+    if (_shadingMode != other._shadingMode)
+        return _shadingMode < other._shadingMode;
+    if (_noise != other._noise)
+        return _noise < other._noise;
+
+    return _objectBucket < other._objectBucket;
+}
+
+ShaderCache::ShaderCache() = default;
+
+ShaderCache::~ShaderCache() = default;
+
+bool ShaderCache::Init(const char* vertex, const char* head, const char* body,
+                       SetupFunction setup)
+{
+    if (IsNullptr(vertex, MSG_INFO("No vertex file set.")))
+        return false;
+    if (IsNullptr(head, MSG_INFO("No head file set.")))
+        return false;
+    if (IsNullptr(body, MSG_INFO("No body file set.")))
+        return false;
+
+    _vertex = vertex;
+    _head   = head;
+    _body   = body;
+    _setup  = std::move(setup);
+    _programs.clear();
+
+    return true;
+}
+
+ShaderProgram* ShaderCache::Get(const ShaderPermutation& permutation)
+{
+    const auto found = _programs.find(permutation);
+    if (found != _programs.end())
+        return found->second.get();
+
+    auto program = std::make_unique<ShaderProgram>();
+
+    if (IsFalse(program->Init(), MSG_INFO("Shader setup failed.")))
+        return nullptr;
+    if (IsFalse(program->LoadFragmentShader(_head.c_str(), _body.c_str(),
+                                            permutation.GetDefines()),
+                MSG_INFO("Could not load fragment shader.")))
+        return nullptr;
+    if (IsFalse(program->LoadVertexShader(_vertex.c_str()),
+                MSG_INFO("Could not load vertex shader.")))
+        return nullptr;
+    if (IsFalse(program->Link(), MSG_INFO("Could not link shader.")))
+        return nullptr;
+
+    // uniform variables that never change
+    if (_setup)
+    {
+        if (IsFalse(program->Use(), MSG_INFO("Could not use shader.")))
+            return nullptr;
+        if (IsFalse(_setup(*program), MSG_INFO("Could not set up shader.")))
+            return nullptr;
+
+        ShaderProgram::End();
+    }
+
+    auto* result = program.get();
+    _programs.emplace(permutation, std::move(program));
+
+    return result;
+}
+
+size_t ShaderCache::GetProgramCount() const
+{
+    return _programs.size();
+}
@@ -3,6 +3,9 @@
 
 #include "glad/glad.h"
 #include "glm/glm.hpp"
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
 
 //---------------------------------------------------------------------------
@@ -44,6 +47,20 @@ public:
     //---------------------------------------------------------------------------
     bool LoadFragmentShader(const char* head, const char* body);
 
+    //---------------------------------------------------------------------------
+    /// Loads the fragment shader combining the given files, specialized by
+    /// the given preprocessor definitions, and creates the fragment shader.
+    /// Uniform variables a specialization removes are not active; setting
+    /// them is not an error.
+    /// @param[in]  head        The file containing the shader head.
+    /// @param[in]  body        The file containing the shader body.
+    /// @param[in]  defines     #define lines inserted after the #version line
+    /// of the head; empty for none.
+    /// @return                 False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool LoadFragmentShader(const char* head, const char* body,
+                            const std::string& defines);
+
     //---------------------------------------------------------------------------
     /// Loads the fragment shader from the given file and creates the fragment
     /// shader.
@@ -74,6 +91,14 @@ public:
     //---------------------------------------------------------------------------
     bool SetUniform(const char* name, const glm::vec3& v);
 
+    //---------------------------------------------------------------------------
+    /// Sets an uniform variable.
+    /// @param[in]  name    The name of the uniform variable.
+    /// @param[in]  v       The integer vector to set.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetUniform(const char* name, const glm::ivec3& v);
+
     //---------------------------------------------------------------------------
     /// Sets an uniform variable.
     /// @param[in]  name    The name of the uniform variable.
@@ -131,9 +156,99 @@ private:
                            unsigned int& store);
 
     bool         _isLinked;       ///> True if the shader program is linked.
+    bool         _specialized;    ///> True if compiled with defines.
     unsigned int _program;        ///> The program ID.
     unsigned int _vertexShader;   ///> The vertex shader ID.
     unsigned int _fragmentShader; ///> The fragment shader ID.
 };
 
+//---------------------------------------------------------------------------
+/// Compile-time specialization of the fragment shader head. Each set member
+/// replaces a uniform variable by a constant, so the compiler removes the
+/// code the other values need.
+//---------------------------------------------------------------------------
+struct ShaderPermutation
+{
+    int          _shadingMode  = -1; ///< SHADING_MODE; -1 for u_shadingMode.
+    int          _noise        = -1; ///< NOISE; -1 for u_noise.
+    unsigned int _objectBucket = 0;  ///< OBJECT_BUCKET; 0 for no bound.
+
+    //---------------------------------------------------------------------------
+    /// Returns the object count bucket, the loop bound of the metaball loops.
+    /// @param[in]  objectCount     The number of metaballs.
+    /// @return                     The smallest power of two of at least 8
+    /// not below the count; 0 for large counts.
+    //---------------------------------------------------------------------------
+    static unsigned int GetObjectBucket(unsigned int objectCount);
+
+    //---------------------------------------------------------------------------
+    /// Returns the preprocessor definitions of the permutation.
+    /// @return             The #define lines.
+    //---------------------------------------------------------------------------
+    std::string GetDefines() const;
+
+    //---------------------------------------------------------------------------
+    /// Orders the permutations.
+    /// @param[in]  other   The permutation to compare with.
+    /// @return             True if this permutation is ordered first.
+    //---------------------------------------------------------------------------
+    bool operator<(const ShaderPermutation& other) const;
+};
+
+//---------------------------------------------------------------------------
+/// Permutation cache of a shader program. Compiles a program per
+/// ShaderPermutation on first use and keeps it.
+//---------------------------------------------------------------------------
+class ShaderCache
+{
+public:
+    /// Sets the uniform variables of a new program that never change; the
+    /// program is in use.
+    using SetupFunction = std::function<bool(ShaderProgram&)>;
+
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    ShaderCache();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~ShaderCache();
+
+    //---------------------------------------------------------------------------
+    /// Sets the shader files; removes all programs.
+    /// @param[in]  vertex  The vertex shader file.
+    /// @param[in]  head    The file containing the fragment shader head.
+    /// @param[in]  body    The file containing the fragment shader body.
+    /// @param[in]  setup   Called once for every new program.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Init(const char* vertex, const char* head, const char* body,
+              SetupFunction setup);
+
+    //---------------------------------------------------------------------------
+    /// Returns the program of the given permutation; compiles it on first
+    /// use.
+    /// @param[in]  permutation     The permutation.
+    /// @return                     The program; nullptr if an error occurred.
+    //---------------------------------------------------------------------------
+    ShaderProgram* Get(const ShaderPermutation& permutation);
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of compiled programs.
+    /// @return             The count.
+    //---------------------------------------------------------------------------
+    size_t GetProgramCount() const;
+
+private:
+    std::string   _vertex; ///< vertex shader file.
+    std::string   _head;   ///< fragment shader head file.
+    std::string   _body;   ///< fragment shader body file.
+    SetupFunction _setup;  ///< see SetupFunction.
+
+    std::map<ShaderPermutation, std::unique_ptr<ShaderProgram>>
+        _programs; ///< compiled programs.
+};
+
 #endif // VOLUME_DEMO_PROGRAM_H__
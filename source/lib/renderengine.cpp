@@ -1,169 +1,10 @@
 #include "renderengine.h"
 
 #include "modeling.h"
+#include "noise.h"
 #include "log.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <gl/GLU.h>
-#include <glm/gtx/color_space.hpp>
-
-// z-position of all objects
-static constexpr auto Z_POS = -1.0f;
-
-/// Maximum number of objects.
-static constexpr auto MAX_OBJECT_COUNT = 18;
-
-ObjectArray::ObjectArray()
-{
-    _count        = 0;
-    _countChanged = false;
-    _userObject   = {};
-
-    // see https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glGet.xhtml
-    static_assert(MAX_OBJECT_COUNT <= 256,
-                  "Only array size of 256 is guaranteed.");
-}
-
-ObjectArray::~ObjectArray() = default;
-
-bool ObjectArray::AddObject(glm::vec3& pos, glm::vec3& color, int& index)
-{
-    // check
-    if (_count == MAX_OBJECT_COUNT)
-        return false;
-
-    _pos.push_back(pos);
-    _colors.push_back(color);
-
-    index = _count;
-    _count++;
-
-    _countChanged = true;
-
-    return true;
-}
-
-bool ObjectArray::AddObject()
-{
-    // check
-    if (_count == MAX_OBJECT_COUNT)
-        return false;
-
-    glm::vec3 null{0.0};
-
-    _pos.push_back(null);
-    _colors.push_back(null);
-
-    _count++;
-    _countChanged = true;
-
-    return true;
-}
-
-unsigned int ObjectArray::GetObjectCount() const
-{
-    return _count;
-}
-
-bool ObjectArray::SetDynamicObject(float x, float y)
-{
-    _userObject.x = x;
-    _userObject.y = y;
-    _userObject.z = Z_POS;
-
-    return true;
-}
-
-bool ObjectArray::RemoveLastObject()
-{
-    if (_count <= 1)
-        return false;
-
-    _pos.pop_back();
-    _colors.pop_back();
-    _count--;
-
-    _countChanged = true;
-
-    return true;
-}
-
-glm::vec3* ObjectArray::GetPositionData()
-{
-    return &_pos.front();
-}
-
-glm::vec3* ObjectArray::GetColorData()
-{
-    return &_colors.front();
-}
-
-int ObjectArray::GetDataSize() const
-{
-    return _count * 3;
-}
-
-void ObjectArray::Animation(float step)
-{
-    if (_count < 2)
-        return;
-
-    auto       hue     = 180.0f;
-    const auto hueStep = 360.0f / (float(_count));
-
-    for (int i = 0; i < _count; ++i)
-    {
-        // colors
-        if (_countChanged)
-        {
-            // calculate color wheel
-            const float     h = fmod(hue, 360.0f);
-            const glm::vec3 hsv(h, 1.0, 1.0);
-            const glm::vec3 rgb = glm::rgbColor(hsv);
-            _colors[i]          = rgb;
-
-            hue += hueStep;
-        }
-
-        const auto currentPos = _pos[i];
-        const auto distance   = _userObject - currentPos;
-
-        glm::vec3 movement(0.0);
-
-        if (glm::length(distance) < 0.2)
-        {
-            movement = distance;
-            movement.x *= 0.5f;
-            movement.y *= 0.5f;
-            movement.z *= 0.5f;
-        }
-        else
-        {
-            auto scale = (6.28f / (float(_count))) * float(i);
-
-            auto offset = (step * .01f) + scale;
-            auto x      = sin(offset) * 2.0f;
-            auto y      = (cos(offset) * 0.7f) + 0.25f;
-
-            glm::vec3 targetPos;
-            targetPos.x = x;
-            targetPos.y = y;
-            targetPos.z = Z_POS;
-
-            movement = targetPos - currentPos;
-
-            movement.x *= 0.1f;
-            movement.y *= 0.1f;
-            movement.z *= 0.1f;
-        }
-
-        const auto newPos = currentPos + movement;
-
-        _pos[i] = newPos;
-    }
-
-    if (_countChanged)
-        _countChanged = false;
-}
 
 template <class... Args>
 static auto SetUniform(ShaderProgram& prog, const char* name, Args... args)
@@ -208,11 +49,95 @@ template <typename F> static auto OglError(const char*, F&& f)
     return false;
 }
 
-RenderEngine::RenderEngine()
+/// Texture unit of the noise texture.
+static constexpr auto NOISE_TEXTURE_UNIT = 0u;
+
+/// Texture unit of the metaball texture buffer.
+static constexpr auto OBJECT_TEXTURE_UNIT = 1u;
+
+/// Texture units of the spatial grid texture buffers.
+static constexpr auto GRID_CELLS_TEXTURE_UNIT   = 2u;
+static constexpr auto GRID_INDICES_TEXTURE_UNIT = 3u;
+
+/// Texture units of the octree texture buffers.
+static constexpr auto OCTREE_NODES_TEXTURE_UNIT   = 4u;
+static constexpr auto OCTREE_INDICES_TEXTURE_UNIT = 5u;
+
+/// Texture unit of the hit distances of the previous frame.
+static constexpr auto HIT_DISTANCE_TEXTURE_UNIT = 6u;
+
+/// Texture unit of the distances of the coarser cone prepass level.
+static constexpr auto CONE_DISTANCE_TEXTURE_UNIT = 7u;
+
+/// Texture unit of the shadow map depths.
+static constexpr auto SHADOW_MAP_TEXTURE_UNIT = 8u;
+
+/// Texture units of the integrated and the sampled light volume.
+static constexpr auto LIGHT_VOLUME_TEXTURE_UNIT  = 9u;
+static constexpr auto LIGHT_DENSITY_TEXTURE_UNIT = 10u;
+
+/// Texture unit of the ground map colors.
+static constexpr auto GROUND_MAP_TEXTURE_UNIT = 11u;
+
+/// Texture units of the G-buffer of the deferred shading.
+static constexpr auto GBUFFER_POSITION_TEXTURE_UNIT = 12u;
+static constexpr auto GBUFFER_NORMAL_TEXTURE_UNIT   = 13u;
+static constexpr auto GBUFFER_COLOR_TEXTURE_UNIT    = 14u;
+
+/// Texture unit of the density volume.
+static constexpr auto DENSITY_VOLUME_TEXTURE_UNIT = 15u;
+
+/// Size of the framebuffer.
+static constexpr auto FRAME_WIDTH  = 1280;
+static constexpr auto FRAME_HEIGHT = 720;
+
+/// Camera position.
+static const glm::vec3 CAM_POS{0.0f, 0.0f, 2.0f};
+
+/// Lower left corner and size of the view plane.
+static const glm::vec3 VIEW_PLANE_ORIGIN{-2.0f, -0.75f, 0.0f};
+static const glm::vec2 VIEW_PLANE_SIZE{4.0f, 2.0f};
+
+RenderEngine::RenderEngine() : _objects(ObjectLayout::SOA)
 {
-    _noiseTexture = 0;
-    _step         = 0.0;
-    _settings     = {};
+    _shader               = nullptr;
+    _groundShader         = nullptr;
+    _groundBake           = nullptr;
+    _geometryShader       = nullptr;
+    _groundGeometryShader = nullptr;
+    _deferredShader       = nullptr;
+    _noiseTexture         = 0;
+    _frameBuffer          = 0;
+    _colorBuffer          = 0;
+    _depthBuffer          = 0;
+    _hitTextures[0]       = 0;
+    _hitTextures[1]       = 0;
+    _hitIndex             = 0;
+    _coneFrameBuffer      = 0;
+    _coneTextures[0]      = 0;
+    _coneTextures[1]      = 0;
+    _shadowFrameBuffer    = 0;
+    _shadowTexture        = 0;
+    _shadowTextureSize    = 0;
+    _lightFrameBuffer     = 0;
+    _lightDensity         = 0;
+    _lightVolumeTexture   = 0;
+    _lightVolumeSize      = 0;
+    _densityFrameBuffer   = 0;
+    _densityTexture       = 0;
+    _densityTextureSize   = 0;
+    _groundFrameBuffer    = 0;
+    _groundTexture        = 0;
+    _groundTextureSize    = 0;
+    _gbufferFrameBuffer   = 0;
+    _gbufferPosition      = 0;
+    _gbufferNormal        = 0;
+    _gbufferColor         = 0;
+    _displacement         = -1.0f;
+    _step                 = 0.0;
+    _settings             = {};
+    _boundsMin            = glm::vec3(1.0f);
+    _boundsMax            = glm::vec3(-1.0f);
 }
 
 RenderEngine::~RenderEngine() = default;
@@ -235,7 +160,7 @@ bool RenderEngine::Init()
 
     glEnable(GL_DEPTH_TEST);
 
-    glViewport(0, 0, 1280, 720);
+    glViewport(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
 
     if (OglError(MSG_INFO("OGL Init failed.")))
         return false;
@@ -259,37 +184,69 @@ bool RenderEngine::CreateScene()
     if (OglError(MSG_INFO("Geometry creation failed.")))
         return false;
 
-    // view shader
-    if (IsFalse(_shader.Init(), MSG_INFO("Shader setup failed.")))
+    // cone prepass shader
+    if (IsFalse(_coneShader.Init(), MSG_INFO("Shader setup failed.")))
+        return false;
+    if (IsFalse(_coneShader.LoadFragmentShader("shader/fragment_head.glsl",
+                                               "shader/cone_body.glsl"),
+                MSG_INFO("Could not load fragment shader.")))
+        return false;
+    if (IsFalse(_coneShader.LoadVertexShader("shader/vertex.glsl"),
+                MSG_INFO("Could not load vertex shader.")))
+        return false;
+    if (IsFalse(_coneShader.Link(), MSG_INFO("Could not link shader.")))
+        return false;
+
+    if (OglError(MSG_INFO("Cone shader creation failed.")))
         return false;
 
-    const auto fragmentShader = _shader.LoadFragmentShader(
-        "shader/fragment_head.glsl", "shader/volume_body.glsl");
-    if (IsFalse(fragmentShader, MSG_INFO("Could not load fragment shader.")))
+    // shadow map shader
+    if (IsFalse(_shadowShader.Init(), MSG_INFO("Shader setup failed.")))
         return false;
-    const auto vertexShader = _shader.LoadVertexShader("shader/vertex.glsl");
-    if (IsFalse(vertexShader, MSG_INFO("Could not load vertex shader.")))
+    if (IsFalse(_shadowShader.LoadFragmentShader("shader/fragment_head.glsl",
+                                                 "shader/shadow_body.glsl"),
+                MSG_INFO("Could not load fragment shader.")))
+        return false;
+    if (IsFalse(_shadowShader.LoadVertexShader("shader/vertex.glsl"),
+                MSG_INFO("Could not load vertex shader.")))
         return false;
-    if (IsFalse(_shader.Link(), MSG_INFO("Could not link shader.")))
+    if (IsFalse(_shadowShader.Link(), MSG_INFO("Could not link shader.")))
         return false;
 
-    if (OglError(MSG_INFO("Shader creation failed.")))
+    if (OglError(MSG_INFO("Shadow shader creation failed.")))
+        return false;
+
+    // light volume shader
+    if (IsFalse(_lightShader.Init(), MSG_INFO("Shader setup failed.")))
+        return false;
+    if (IsFalse(_lightShader.LoadFragmentShader(
+                    "shader/fragment_head.glsl",
+                    "shader/light_volume_body.glsl"),
+                MSG_INFO("Could not load fragment shader.")))
+        return false;
+    if (IsFalse(_lightShader.LoadVertexShader("shader/vertex.glsl"),
+                MSG_INFO("Could not load vertex shader.")))
+        return false;
+    if (IsFalse(_lightShader.Link(), MSG_INFO("Could not link shader.")))
+        return false;
+
+    if (OglError(MSG_INFO("Light volume shader creation failed.")))
         return false;
 
-    // ground shader
-    if (IsFalse(_groundShader.Init(), MSG_INFO("Shader setup failed.")))
+    // density volume shader
+    if (IsFalse(_densityShader.Init(), MSG_INFO("Shader setup failed.")))
         return false;
-    if (IsFalse(_groundShader.LoadFragmentShader("shader/fragment_head.glsl",
-                                                 "shader/ground_body.glsl"),
+    if (IsFalse(_densityShader.LoadFragmentShader("shader/fragment_head.glsl",
+                                                  "shader/density_body.glsl"),
                 MSG_INFO("Could not load fragment shader.")))
         return false;
-    if (IsFalse(_groundShader.LoadVertexShader("shader/vertex.glsl"),
+    if (IsFalse(_densityShader.LoadVertexShader("shader/vertex.glsl"),
                 MSG_INFO("Could not load vertex shader.")))
         return false;
-    if (IsFalse(_groundShader.Link(), MSG_INFO("Could not link shader.")))
+    if (IsFalse(_densityShader.Link(), MSG_INFO("Could not link shader.")))
         return false;
 
-    if (OglError(MSG_INFO("Ground shader creation failed.")))
+    if (OglError(MSG_INFO("Density volume shader creation failed.")))
         return false;
 
     // noise texture
@@ -300,6 +257,68 @@ bool RenderEngine::CreateScene()
     if (OglError(MSG_INFO("Texture creation failed.")))
         return false;
 
+    // metaball data
+
+    if (IsFalse(CreateObjectBuffers(),
+                MSG_INFO("Could not create object buffers.")))
+        return false;
+    if (OglError(MSG_INFO("Object buffer creation failed.")))
+        return false;
+
+    // reprojection
+
+    if (IsFalse(CreateFrameBuffer(),
+                MSG_INFO("Could not create framebuffer.")))
+        return false;
+    if (OglError(MSG_INFO("Framebuffer creation failed.")))
+        return false;
+
+    // cone prepass
+
+    if (IsFalse(CreateConeTextures(),
+                MSG_INFO("Could not create cone textures.")))
+        return false;
+    if (OglError(MSG_INFO("Cone texture creation failed.")))
+        return false;
+
+    // shadow map
+
+    if (IsFalse(CreateShadowMap(),
+                MSG_INFO("Could not create shadow map.")))
+        return false;
+    if (OglError(MSG_INFO("Shadow map creation failed.")))
+        return false;
+
+    // light volume
+
+    if (IsFalse(CreateLightVolume(),
+                MSG_INFO("Could not create light volume.")))
+        return false;
+    if (OglError(MSG_INFO("Light volume creation failed.")))
+        return false;
+
+    // density volume
+
+    if (IsFalse(CreateDensityVolume(),
+                MSG_INFO("Could not create density volume.")))
+        return false;
+    if (OglError(MSG_INFO("Density volume creation failed.")))
+        return false;
+
+    // ground map
+
+    if (IsFalse(CreateGroundMap(), MSG_INFO("Could not create ground map.")))
+        return false;
+    if (OglError(MSG_INFO("Ground map creation failed.")))
+        return false;
+
+    // G-buffer
+
+    if (IsFalse(CreateGBuffer(), MSG_INFO("Could not create G-buffer.")))
+        return false;
+    if (OglError(MSG_INFO("G-buffer creation failed.")))
+        return false;
+
     // create six objects
     const auto startCount = 6;
     for (auto i = 0; i < startCount; ++i)
@@ -309,7 +328,7 @@ bool RenderEngine::CreateScene()
     }
 
     // define standard matrices
-    const auto camPos = glm::vec3(0, 0, 2);
+    const auto camPos = CAM_POS;
     const auto viewMatrix =
         glm::lookAt(camPos, glm::vec3(0, 0, 0), glm::vec3(0.0f, 1.0f, 0.0f));
 
@@ -318,8 +337,10 @@ bool RenderEngine::CreateScene()
 
     auto viewPlaneModelMatrix = glm::mat4(1.0f);
     viewPlaneModelMatrix =
-        glm::translate(viewPlaneModelMatrix, glm::vec3(-2, -0.75, 0));
-    viewPlaneModelMatrix = glm::scale(viewPlaneModelMatrix, glm::vec3(4, 2, 2));
+        glm::translate(viewPlaneModelMatrix, VIEW_PLANE_ORIGIN);
+    viewPlaneModelMatrix = glm::scale(
+        viewPlaneModelMatrix,
+        glm::vec3(VIEW_PLANE_SIZE.x, VIEW_PLANE_SIZE.y, 2.0f));
 
     auto groundPlaneModelMatrix = glm::mat4(1.0f);
     groundPlaneModelMatrix =
@@ -329,20 +350,213 @@ bool RenderEngine::CreateScene()
     groundPlaneModelMatrix = glm::rotate(
         groundPlaneModelMatrix, glm::radians(90.0f), glm::vec3(1, 0, 0));
 
+    // view shaders; the uniform variables that never change are set once
+    // per compiled permutation
+    {
+        const auto mv  = viewMatrix * viewPlaneModelMatrix;
+        const auto MVP = projectionMatrix * mv;
+
+        auto setup = [MVP, viewPlaneModelMatrix, camPos](ShaderProgram& prog)
+        {
+            if (!SetUniform(prog, "u_mvp", MVP))
+                return false;
+            if (!SetUniform(prog, "u_modelMatrix", viewPlaneModelMatrix))
+                return false;
+            if (!SetUniform(prog, "u_camPos", camPos))
+                return false;
+            if (!SetUniform(prog, "u_noiseTexture", NOISE_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_objectData", OBJECT_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gridCells", GRID_CELLS_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gridIndices", GRID_INDICES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_octreeNodes", OCTREE_NODES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_octreeIndices",
+                            OCTREE_INDICES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_prevHitDistance",
+                            HIT_DISTANCE_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_coneDistance",
+                            CONE_DISTANCE_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_shadowMap", SHADOW_MAP_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_lightVolume", LIGHT_VOLUME_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_densityVolume",
+                            DENSITY_VOLUME_TEXTURE_UNIT))
+                return false;
+
+            return true;
+        };
+
+        if (IsFalse(_volumeShaders.Init("shader/vertex.glsl",
+                                        "shader/fragment_head.glsl",
+                                        "shader/volume_body.glsl", setup),
+                    MSG_INFO("Could not set up view shaders.")))
+            return false;
+
+        // the geometry pass searches the same primary rays
+        auto geometrySetup = [setup](ShaderProgram& prog)
+        {
+            if (!setup(prog))
+                return false;
+
+            return SetUniform(prog, "u_gbufferGround", 0u);
+        };
+
+        if (IsFalse(_geometryShaders.Init("shader/vertex.glsl",
+                                          "shader/fragment_head.glsl",
+                                          "shader/gbuffer_body.glsl",
+                                          geometrySetup),
+                    MSG_INFO("Could not set up geometry shaders.")))
+            return false;
+    }
+
     {
-        if (IsFalse(_shader.Use(), MSG_INFO("Could not use shader.")))
+        // the cone prepass draws the view plane at a lower resolution
+        if (IsFalse(_coneShader.Use(), MSG_INFO("Could not use shader.")))
             return false;
 
         const auto mv  = viewMatrix * viewPlaneModelMatrix;
         const auto MVP = projectionMatrix * mv;
 
-        if (!SetUniform(_shader, "u_mvp", MVP))
+        if (!SetUniform(_coneShader, "u_mvp", MVP))
+            return false;
+        if (!SetUniform(_coneShader, "u_modelMatrix", viewPlaneModelMatrix))
+            return false;
+        if (!SetUniform(_coneShader, "u_camPos", camPos))
+            return false;
+        if (!SetUniform(_coneShader, "u_noiseTexture", NOISE_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_coneShader, "u_objectData", OBJECT_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_coneShader, "u_gridCells", GRID_CELLS_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_coneShader, "u_gridIndices",
+                        GRID_INDICES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_coneShader, "u_octreeNodes",
+                        OCTREE_NODES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_coneShader, "u_octreeIndices",
+                        OCTREE_INDICES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_coneShader, "u_coneDistance",
+                        CONE_DISTANCE_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_coneShader, "u_densityVolume",
+                        DENSITY_VOLUME_TEXTURE_UNIT))
+            return false;
+
+        ShaderProgram::End();
+    }
+
+    {
+        // the shadow map pass stretches the view plane over the whole target;
+        // the model matrix is fitted per frame, see RenderShadowMap()
+        if (IsFalse(_shadowShader.Use(), MSG_INFO("Could not use shader.")))
+            return false;
+
+        auto MVP = glm::mat4(1.0f);
+        MVP      = glm::translate(MVP, glm::vec3(-1.0f, -1.0f, 0.0f));
+        MVP      = glm::scale(MVP, glm::vec3(2.0f, 2.0f, 1.0f));
+
+        if (!SetUniform(_shadowShader, "u_mvp", MVP))
+            return false;
+        if (!SetUniform(_shadowShader, "u_noiseTexture", NOISE_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_shadowShader, "u_objectData", OBJECT_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_shadowShader, "u_gridCells",
+                        GRID_CELLS_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_shadowShader, "u_gridIndices",
+                        GRID_INDICES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_shadowShader, "u_octreeNodes",
+                        OCTREE_NODES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_shadowShader, "u_octreeIndices",
+                        OCTREE_INDICES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_shadowShader, "u_densityVolume",
+                        DENSITY_VOLUME_TEXTURE_UNIT))
+            return false;
+
+        ShaderProgram::End();
+    }
+
+    {
+        // the light volume passes stretch the view plane over one slice
+        if (IsFalse(_lightShader.Use(), MSG_INFO("Could not use shader.")))
+            return false;
+
+        auto MVP = glm::mat4(1.0f);
+        MVP      = glm::translate(MVP, glm::vec3(-1.0f, -1.0f, 0.0f));
+        MVP      = glm::scale(MVP, glm::vec3(2.0f, 2.0f, 1.0f));
+
+        if (!SetUniform(_lightShader, "u_mvp", MVP))
+            return false;
+        if (!SetUniform(_lightShader, "u_noiseTexture", NOISE_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_lightShader, "u_objectData", OBJECT_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_lightShader, "u_gridCells", GRID_CELLS_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_lightShader, "u_gridIndices",
+                        GRID_INDICES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_lightShader, "u_octreeNodes",
+                        OCTREE_NODES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_lightShader, "u_octreeIndices",
+                        OCTREE_INDICES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_lightShader, "u_lightDensity",
+                        LIGHT_DENSITY_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_lightShader, "u_densityVolume",
+                        DENSITY_VOLUME_TEXTURE_UNIT))
+            return false;
+
+        ShaderProgram::End();
+    }
+
+    {
+        // the density bake stretches the view plane over one slice; the
+        // volume is not bound while it is baked, see RenderDensityVolume()
+        if (IsFalse(_densityShader.Use(), MSG_INFO("Could not use shader.")))
+            return false;
+
+        auto MVP = glm::mat4(1.0f);
+        MVP      = glm::translate(MVP, glm::vec3(-1.0f, -1.0f, 0.0f));
+        MVP      = glm::scale(MVP, glm::vec3(2.0f, 2.0f, 1.0f));
+
+        if (!SetUniform(_densityShader, "u_mvp", MVP))
+            return false;
+        if (!SetUniform(_densityShader, "u_noiseTexture", NOISE_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_densityShader, "u_objectData", OBJECT_TEXTURE_UNIT))
             return false;
-        if (!SetUniform(_shader, "u_modelMatrix", viewPlaneModelMatrix))
+        if (!SetUniform(_densityShader, "u_gridCells",
+                        GRID_CELLS_TEXTURE_UNIT))
             return false;
-        if (!SetUniform(_shader, "u_camPos", camPos))
+        if (!SetUniform(_densityShader, "u_gridIndices",
+                        GRID_INDICES_TEXTURE_UNIT))
             return false;
-        if (!SetUniform(_shader, "u_noiseTexture", 0u))
+        if (!SetUniform(_densityShader, "u_octreeNodes",
+                        OCTREE_NODES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_densityShader, "u_octreeIndices",
+                        OCTREE_INDICES_TEXTURE_UNIT))
+            return false;
+        if (!SetUniform(_densityShader, "u_densityVolume",
+                        DENSITY_VOLUME_TEXTURE_UNIT))
             return false;
 
         ShaderProgram::End();
@@ -353,22 +567,172 @@ bool RenderEngine::CreateScene()
         const glm::mat4 MVground  = viewMatrix * groundPlaneModelMatrix;
         const glm::mat4 MVPground = projectionMatrix * MVground;
 
-        if (IsFalse(_groundShader.Use(),
-                    MSG_INFO("Could not enable ground shader")))
-            return false;
-        if (IsFalse(_groundShader.SetUniform("u_mvp", MVPground),
-                    MSG_INFO("Could not set MVP.")))
+        auto setup = [MVPground, groundPlaneModelMatrix,
+                      camPos](ShaderProgram& prog)
+        {
+            if (IsFalse(prog.SetUniform("u_mvp", MVPground),
+                        MSG_INFO("Could not set MVP.")))
+                return false;
+            if (IsFalse(prog.SetUniform("u_modelMatrix",
+                                        groundPlaneModelMatrix),
+                        MSG_INFO("Could not set model matrix.")))
+                return false;
+            if (!SetUniform(prog, "u_camPos", camPos))
+                return false;
+            if (!SetUniform(prog, "u_noiseTexture", NOISE_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_objectData", OBJECT_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gridCells", GRID_CELLS_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gridIndices", GRID_INDICES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_octreeNodes", OCTREE_NODES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_octreeIndices",
+                            OCTREE_INDICES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_shadowMap", SHADOW_MAP_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_lightVolume", LIGHT_VOLUME_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_densityVolume",
+                            DENSITY_VOLUME_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_groundMap", GROUND_MAP_TEXTURE_UNIT))
+                return false;
+
+            return true;
+        };
+
+        if (IsFalse(_groundShaders.Init("shader/vertex.glsl",
+                                        "shader/fragment_head.glsl",
+                                        "shader/ground_body.glsl", setup),
+                    MSG_INFO("Could not set up ground shaders.")))
             return false;
-        if (IsFalse(_groundShader.SetUniform("u_modelMatrix",
-                                             groundPlaneModelMatrix),
-                    MSG_INFO("Could not set model matrix.")))
+
+        // the geometry pass searches the same rays up from the ground
+        auto geometrySetup = [setup](ShaderProgram& prog)
+        {
+            if (!setup(prog))
+                return false;
+
+            return SetUniform(prog, "u_gbufferGround", 1u);
+        };
+
+        if (IsFalse(_groundGeometryShaders.Init("shader/vertex.glsl",
+                                                "shader/fragment_head.glsl",
+                                                "shader/gbuffer_body.glsl",
+                                                geometrySetup),
+                    MSG_INFO("Could not set up ground geometry shaders.")))
             return false;
-        if (!SetUniform(_groundShader, "u_camPos", camPos))
+    }
+
+    {
+        // the ground map pass stretches the view plane over the footprint;
+        // the model matrix is fitted per frame, see RenderGroundMap()
+        auto MVP = glm::mat4(1.0f);
+        MVP      = glm::translate(MVP, glm::vec3(-1.0f, -1.0f, 0.0f));
+        MVP      = glm::scale(MVP, glm::vec3(2.0f, 2.0f, 1.0f));
+
+        auto setup = [MVP, camPos](ShaderProgram& prog)
+        {
+            if (!SetUniform(prog, "u_mvp", MVP))
+                return false;
+            if (!SetUniform(prog, "u_camPos", camPos))
+                return false;
+            if (!SetUniform(prog, "u_noiseTexture", NOISE_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_objectData", OBJECT_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gridCells", GRID_CELLS_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gridIndices", GRID_INDICES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_octreeNodes", OCTREE_NODES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_octreeIndices",
+                            OCTREE_INDICES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_shadowMap", SHADOW_MAP_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_lightVolume", LIGHT_VOLUME_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_densityVolume",
+                            DENSITY_VOLUME_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_groundMap", GROUND_MAP_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_groundMapSize", 0u))
+                return false;
+
+            return true;
+        };
+
+        if (IsFalse(_groundBakes.Init("shader/vertex.glsl",
+                                      "shader/fragment_head.glsl",
+                                      "shader/ground_body.glsl", setup),
+                    MSG_INFO("Could not set up ground map shaders.")))
             return false;
+    }
 
-        ShaderProgram::End();
+    {
+        // the shading pass stretches the view plane over the whole frame
+        auto MVP = glm::mat4(1.0f);
+        MVP      = glm::translate(MVP, glm::vec3(-1.0f, -1.0f, 0.0f));
+        MVP      = glm::scale(MVP, glm::vec3(2.0f, 2.0f, 1.0f));
+
+        auto setup = [MVP, camPos](ShaderProgram& prog)
+        {
+            if (!SetUniform(prog, "u_mvp", MVP))
+                return false;
+            if (!SetUniform(prog, "u_camPos", camPos))
+                return false;
+            if (!SetUniform(prog, "u_noiseTexture", NOISE_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_objectData", OBJECT_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gridCells", GRID_CELLS_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gridIndices", GRID_INDICES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_octreeNodes", OCTREE_NODES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_octreeIndices",
+                            OCTREE_INDICES_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_shadowMap", SHADOW_MAP_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_lightVolume", LIGHT_VOLUME_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_densityVolume",
+                            DENSITY_VOLUME_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gbufferPos",
+                            GBUFFER_POSITION_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gbufferNormal",
+                            GBUFFER_NORMAL_TEXTURE_UNIT))
+                return false;
+            if (!SetUniform(prog, "u_gbufferColor", GBUFFER_COLOR_TEXTURE_UNIT))
+                return false;
+
+            return true;
+        };
+
+        if (IsFalse(_deferredShaders.Init("shader/vertex.glsl",
+                                          "shader/fragment_head.glsl",
+                                          "shader/deferred_body.glsl", setup),
+                    MSG_INFO("Could not set up deferred shaders.")))
+            return false;
     }
 
+    // compiles the permutation of the initial settings
+    if (IsFalse(SelectShaders(), MSG_INFO("Could not compile shaders.")))
+        return false;
+    if (OglError(MSG_INFO("Shader creation failed.")))
+        return false;
+
     InfoMessage(MSG_INFO(("Scene setup done...")));
 
     return true;
@@ -397,7 +761,7 @@ void RenderEngine::UpdateScene(const SceneSettings& settings)
     // add object from mouse click
     if (settings._addObjectClick)
     {
-        if (_objects.GetObjectCount() >= MAX_OBJECT_COUNT)
+        if (_objects.GetObjectCount() >= _objects.GetMaxObjectCount())
             return;
 
         glm::vec3 pos;
@@ -430,50 +794,163 @@ bool RenderEngine::Render()
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    const auto* posData     = _objects.GetPositionData();
-    const auto* colorData   = _objects.GetColorData();
-    const auto  posDataSize = _objects.GetDataSize();
-    const auto  objectCnt   = _objects.GetObjectCount();
+    if (IsFalse(UpdateObjectBuffers(),
+                MSG_INFO("Could not update object buffers.")))
+        return false;
+
+    GetFieldBounds(_objects, _settings, _boundsMin, _boundsMax);
+
+    _displacement = _history.Update(_objects, _settings);
+
+    if (IsFalse(SelectShaders(), MSG_INFO("Could not select shaders.")))
+        return false;
+
+    if (IsFalse(UpdateNoiseTexture(),
+                MSG_INFO("Could not update noise texture.")))
+        return false;
+    if (IsFalse(RenderDensityVolume(),
+                MSG_INFO("Could not render density volume.")))
+        return false;
+    if (IsFalse(RenderConePrepass(), MSG_INFO("Could not render prepass.")))
+        return false;
+    if (IsFalse(RenderShadowMap(), MSG_INFO("Could not render shadow map.")))
+        return false;
+    if (IsFalse(RenderLightVolume(),
+                MSG_INFO("Could not render light volume.")))
+        return false;
+    if (IsFalse(RenderGroundMap(), MSG_INFO("Could not render ground map.")))
+        return false;
 
+    if (_settings._deferredShading)
     {
-        if (IsFalse(_shader.Use(), MSG_INFO("Could not use shader.")))
+        if (IsFalse(RenderDeferred(), MSG_INFO("Could not render G-buffer.")))
             return false;
-
-        if (!SetUniform(_shader, "u_shadingMode", _settings._renderMode))
+    }
+    else
+    {
+        if (IsFalse(RenderForward(), MSG_INFO("Could not render volume.")))
             return false;
-        if (!SetUniform(_shader, "u_animation", _step))
+    }
+
+    // the geometry pass includes the ground unless it is looked up
+    if (!_settings._deferredShading || _settings._groundMapSize > 0)
+    {
+        if (IsFalse(_groundShader->Use(),
+                    MSG_INFO("Could not enable ground shader")))
             return false;
-        if (!SetUniform(_shader, "u_noise", _settings.GetNoise()))
+
+        if (!SetFrameUniforms(*_groundShader))
             return false;
-        if (!SetUniform(_shader, "u_objectCnt", objectCnt))
+        if (!SetShadowUniforms(*_groundShader))
             return false;
-        if (!SetUniform(_shader, "u_objectPos", posData, posDataSize))
+        if (!SetLightVolumeUniforms(*_groundShader))
             return false;
-        if (!SetUniform(_shader, "u_objectColor", colorData, posDataSize))
+        if (!SetGroundMapUniforms())
             return false;
 
-        if (IsFalse(_viewPlane.Draw(), MSG_INFO("Could not draw view plane.")))
+        if (IsFalse(_ground.Draw(), MSG_INFO("Could not draw ground.")))
             return false;
 
         ShaderProgram::End();
     }
 
-    {
-        if (IsFalse(_groundShader.Use(),
-                    MSG_INFO("Could not enable ground shader")))
+    if (OglError(MSG_INFO("Rendering failed.")))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::RenderForward()
+{
+    BeginReprojection();
+
+    {
+        if (IsFalse(_shader->Use(), MSG_INFO("Could not use shader.")))
+            return false;
+
+        if (!SetFrameUniforms(*_shader))
+            return false;
+        if (!SetTileUniforms(*_shader))
+            return false;
+        if (!SetReprojectionUniforms(*_shader))
+            return false;
+
+        const auto coneScale =
+            _settings._conePrepass ? CONE_TILE_SIZES[CONE_LEVELS - 1] : 0u;
+        if (!SetConeUniforms(*_shader, coneScale))
+            return false;
+        if (!SetShadowUniforms(*_shader))
+            return false;
+        if (!SetLightVolumeUniforms(*_shader))
+            return false;
+
+        if (IsFalse(_viewPlane.Draw(), MSG_INFO("Could not draw view plane.")))
+            return false;
+
+        ShaderProgram::End();
+    }
+
+    EndReprojection();
+
+    return true;
+}
+
+bool RenderEngine::RenderDeferred()
+{
+    // the hit distances of the previous frame are read, the others written
+    if (_settings._reprojection)
+    {
+        _hitIndex = 1 - _hitIndex;
+
+        glActiveTexture(GL_TEXTURE0 + HIT_DISTANCE_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, _hitTextures[1 - _hitIndex]);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _gbufferFrameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                           GL_TEXTURE_2D, _hitTextures[_hitIndex], 0);
+
+    const GLfloat noSurface[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    const GLfloat noHit[]     = {-1.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, noSurface);
+    glClearBufferfv(GL_COLOR, 1, noHit);
+    glClearBufferfv(GL_COLOR, 2, noSurface);
+    glClearBufferfv(GL_COLOR, 3, noSurface);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    // the surfaces are not blended; the view plane occludes the ground
+    glDisable(GL_BLEND);
+
+    {
+        if (IsFalse(_geometryShader->Use(), MSG_INFO("Could not use shader.")))
             return false;
 
-        if (!SetUniform(_groundShader, "u_animation", _step))
+        if (!SetFrameUniforms(*_geometryShader))
             return false;
-        if (!SetUniform(_groundShader, "u_shadingMode", _settings._renderMode))
+        if (!SetTileUniforms(*_geometryShader))
             return false;
-        if (!SetUniform(_groundShader, "u_objectPos", posData, posDataSize))
+        if (!SetReprojectionUniforms(*_geometryShader))
+            return false;
+
+        const auto coneScale =
+            _settings._conePrepass ? CONE_TILE_SIZES[CONE_LEVELS - 1] : 0u;
+        if (!SetConeUniforms(*_geometryShader, coneScale))
             return false;
-        if (!SetUniform(_groundShader, "u_objectColor", colorData, posDataSize))
+
+        if (IsFalse(_viewPlane.Draw(), MSG_INFO("Could not draw view plane.")))
             return false;
-        if (!SetUniform(_groundShader, "u_objectCnt", objectCnt))
+
+        ShaderProgram::End();
+    }
+
+    // a ground map replaces the rays up from the ground, see Render()
+    if (_settings._groundMapSize == 0)
+    {
+        if (IsFalse(_groundGeometryShader->Use(),
+                    MSG_INFO("Could not use shader.")))
             return false;
-        if (!SetUniform(_groundShader, "u_noise", _settings.GetNoise()))
+
+        if (!SetFrameUniforms(*_groundGeometryShader))
             return false;
 
         if (IsFalse(_ground.Draw(), MSG_INFO("Could not draw ground.")))
@@ -482,8 +959,42 @@ bool RenderEngine::Render()
         ShaderProgram::End();
     }
 
-    if (OglError(MSG_INFO("Rendering failed.")))
-        return false;
+    // the ground shader is depth tested against the view plane
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _gbufferFrameBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, FRAME_WIDTH, FRAME_HEIGHT, 0, 0, FRAME_WIDTH,
+                      FRAME_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_POSITION_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _gbufferPosition);
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_NORMAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _gbufferNormal);
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_COLOR_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _gbufferColor);
+
+    // one shading pass covers the view plane and the ground
+    glDisable(GL_DEPTH_TEST);
+
+    {
+        if (IsFalse(_deferredShader->Use(), MSG_INFO("Could not use shader.")))
+            return false;
+
+        if (!SetFrameUniforms(*_deferredShader))
+            return false;
+        if (!SetShadowUniforms(*_deferredShader))
+            return false;
+        if (!SetLightVolumeUniforms(*_deferredShader))
+            return false;
+
+        if (IsFalse(_viewPlane.Draw(), MSG_INFO("Could not draw view plane.")))
+            return false;
+
+        ShaderProgram::End();
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
 
     return true;
 }
@@ -491,84 +1002,1151 @@ bool RenderEngine::Render()
 bool RenderEngine::Close()
 {
     glDeleteTextures(1, &_noiseTexture);
+    glDeleteTextures(2, _hitTextures);
+    glDeleteRenderbuffers(1, &_colorBuffer);
+    glDeleteRenderbuffers(1, &_depthBuffer);
+    glDeleteFramebuffers(1, &_frameBuffer);
+    glDeleteTextures(CONE_LEVELS, _coneTextures);
+    glDeleteFramebuffers(1, &_coneFrameBuffer);
+    glDeleteTextures(1, &_shadowTexture);
+    glDeleteFramebuffers(1, &_shadowFrameBuffer);
+    glDeleteTextures(1, &_lightDensity);
+    glDeleteTextures(1, &_lightVolumeTexture);
+    glDeleteFramebuffers(1, &_lightFrameBuffer);
+    glDeleteTextures(1, &_densityTexture);
+    glDeleteFramebuffers(1, &_densityFrameBuffer);
+    glDeleteTextures(1, &_groundTexture);
+    glDeleteFramebuffers(1, &_groundFrameBuffer);
+    glDeleteTextures(1, &_gbufferPosition);
+    glDeleteTextures(1, &_gbufferNormal);
+    glDeleteTextures(1, &_gbufferColor);
+    glDeleteFramebuffers(1, &_gbufferFrameBuffer);
+
+    _objectBuffer.Close();
+    _gridCells.Close();
+    _gridIndices.Close();
+    _octreeNodes.Close();
+    _octreeIndices.Close();
 
     return true;
 }
 
-#include "glm/gtc/noise.hpp"
-
 bool RenderEngine::CreateNoiseTexture()
 {
-    /* see
-    D. Wolff, OpenGL 4 shading language cookbook, Birmingham: Packt Publishing,
-    2013.
-
-    Chapter "Creating a noise texture using GLM"
-    */
-
     glGenTextures(1, &_noiseTexture);
     if (IsNull(_noiseTexture, MSG_INFO("Could not create OGL texture.")))
         return false;
 
-    const auto width  = 256;
-    const auto height = 256;
+    // setup OpenGL texture and bind to the noise texture unit; the 2D slice
+    // is a volume of depth 1, so that one sampler serves both
+
+    glActiveTexture(GL_TEXTURE0 + NOISE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, _noiseTexture);
+    // set texture parameters
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_MIRRORED_REPEAT);
+
+    _assetCache.SetDirectory(DEFAULT_ASSET_CACHE_DIRECTORY);
+
+    _noiseParams = GetNoiseParams(_settings._noiseVolumeSize);
+    return UploadNoiseTexture();
+}
+
+bool RenderEngine::UpdateNoiseTexture()
+{
+    const auto params = GetNoiseParams(_settings._noiseVolumeSize);
+    if (!(params != _noiseParams))
+        return true;
+
+    _noiseParams = params;
+    return UploadNoiseTexture();
+}
+
+bool RenderEngine::UploadNoiseTexture()
+{
+    // mapped from the cache if an earlier start generated it
+    NoiseData data;
+    if (IsFalse(LoadNoiseData(_noiseParams, 0, _assetCache, data),
+                MSG_INFO("Could not create noise data.")))
+        return false;
+
+    // one byte per noise; R8 for the slice, RG8 for the volume
+    const auto twoNoises = _noiseParams._components == 2;
+    const auto internal  = twoNoises ? GL_RG8 : GL_R8;
+    const auto format    = twoNoises ? GL_RG : GL_RED;
+
+    glActiveTexture(GL_TEXTURE0 + NOISE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, _noiseTexture);
+
+    // the rows are not padded to four bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, internal, int(_noiseParams._width),
+                 int(_noiseParams._height), int(_noiseParams._depth), 0,
+                 format, GL_UNSIGNED_BYTE, data._texels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (OglError(MSG_INFO("Noise texture upload failed.")))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::CreateObjectBuffers()
+{
+    // one float per texel; see GetMetaballPos() in fragment_head.glsl
+    if (IsFalse(_objectBuffer.Init(OBJECT_TEXTURE_UNIT, GL_R32F),
+                MSG_INFO("Could not create object buffer.")))
+        return false;
+    // offset and count per texel
+    if (IsFalse(_gridCells.Init(GRID_CELLS_TEXTURE_UNIT, GL_RG32I),
+                MSG_INFO("Could not create grid cell buffer.")))
+        return false;
+    if (IsFalse(_gridIndices.Init(GRID_INDICES_TEXTURE_UNIT, GL_R32I),
+                MSG_INFO("Could not create grid index buffer.")))
+        return false;
+    // three texels per OctreeNode
+    if (IsFalse(_octreeNodes.Init(OCTREE_NODES_TEXTURE_UNIT, GL_RGBA32F),
+                MSG_INFO("Could not create octree node buffer.")))
+        return false;
+    if (IsFalse(_octreeIndices.Init(OCTREE_INDICES_TEXTURE_UNIT, GL_R32I),
+                MSG_INFO("Could not create octree index buffer.")))
+        return false;
+
+    // the texture buffer size limits the number of objects
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (IsNull(maxTexels, MSG_INFO("Could not query texture buffer size.")))
+        return false;
+
+    const auto maxObjects = unsigned(maxTexels) / OBJECT_COMPONENT_COUNT;
+    _objects.SetMaxObjectCount((maxObjects / SIMD_WIDTH) * SIMD_WIDTH);
+
+    return true;
+}
+
+bool RenderEngine::CreateFrameBuffer()
+{
+    glGenFramebuffers(1, &_frameBuffer);
+    if (IsNull(_frameBuffer, MSG_INFO("Could not create OGL framebuffer.")))
+        return false;
+
+    glGenRenderbuffers(1, &_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, FRAME_WIDTH,
+                          FRAME_HEIGHT);
+
+    // same format as the default framebuffer, see EndReprojection()
+    glGenRenderbuffers(1, &_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, FRAME_WIDTH,
+                          FRAME_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    // one float per pixel; see vHitDistance in volume_body.glsl
+    glActiveTexture(GL_TEXTURE0 + HIT_DISTANCE_TEXTURE_UNIT);
+    glGenTextures(2, _hitTextures);
+    for (const auto texture : _hitTextures)
+    {
+        if (IsNull(texture, MSG_INFO("Could not create OGL texture.")))
+            return false;
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, FRAME_WIDTH, FRAME_HEIGHT, 0,
+                     GL_RED, GL_FLOAT, nullptr);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _frameBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, _colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, _depthBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                           GL_TEXTURE_2D, _hitTextures[_hitIndex], 0);
+
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+
+    const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (IsFalse(status == GL_FRAMEBUFFER_COMPLETE,
+                MSG_INFO("Framebuffer is incomplete.")))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::CreateConeTextures()
+{
+    glGenFramebuffers(1, &_coneFrameBuffer);
+    if (IsNull(_coneFrameBuffer, MSG_INFO("Could not create OGL framebuffer.")))
+        return false;
+
+    // one float per tile; see ConeMarch() in fragment_head.glsl
+    glActiveTexture(GL_TEXTURE0 + CONE_DISTANCE_TEXTURE_UNIT);
+    glGenTextures(CONE_LEVELS, _coneTextures);
+
+    for (auto level = 0u; level < CONE_LEVELS; ++level)
+    {
+        if (IsNull(_coneTextures[level],
+                   MSG_INFO("Could not create OGL texture.")))
+            return false;
+
+        const auto tileSize = int(CONE_TILE_SIZES[level]);
+
+        glBindTexture(GL_TEXTURE_2D, _coneTextures[level]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, FRAME_WIDTH / tileSize,
+                     FRAME_HEIGHT / tileSize, 0, GL_RED, GL_FLOAT, nullptr);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _coneFrameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, _coneTextures[0], 0);
+
+    const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (IsFalse(status == GL_FRAMEBUFFER_COMPLETE,
+                MSG_INFO("Framebuffer is incomplete.")))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::RenderConePrepass()
+{
+    if (!_settings._conePrepass)
+        return true;
+
+    if (IsFalse(_coneShader.Use(), MSG_INFO("Could not use shader.")))
+        return false;
+
+    if (!SetFieldUniforms(_coneShader))
+        return false;
+
+    // the distances are neither blended nor depth tested
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _coneFrameBuffer);
+    glActiveTexture(GL_TEXTURE0 + CONE_DISTANCE_TEXTURE_UNIT);
+
+    const GLfloat noDistance[] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    for (auto level = 0u; level < CONE_LEVELS; ++level)
+    {
+        const auto tileSize = CONE_TILE_SIZES[level];
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, _coneTextures[level], 0);
+        glViewport(0, 0, FRAME_WIDTH / int(tileSize),
+                   FRAME_HEIGHT / int(tileSize));
+        glClearBufferfv(GL_COLOR, 0, noDistance);
+
+        // each level starts at the distances of the level before
+        auto parentScale = 0u;
+        if (level > 0)
+        {
+            parentScale = CONE_TILE_SIZES[level - 1] / tileSize;
+            glBindTexture(GL_TEXTURE_2D, _coneTextures[level - 1]);
+        }
+
+        if (!SetConeUniforms(_coneShader, parentScale))
+            return false;
+
+        if (IsFalse(_viewPlane.Draw(), MSG_INFO("Could not draw view plane.")))
+            return false;
+    }
+
+    ShaderProgram::End();
+
+    // the volume pass reads the finest level
+    glBindTexture(GL_TEXTURE_2D, _coneTextures[CONE_LEVELS - 1]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+
+    return true;
+}
+
+bool RenderEngine::CreateDensityVolume()
+{
+    glGenFramebuffers(1, &_densityFrameBuffer);
+    if (IsNull(_densityFrameBuffer,
+               MSG_INFO("Could not create OGL framebuffer.")))
+        return false;
+
+    // the storage is allocated with the size of the grid in
+    // RenderDensityVolume(); filtered like DensityVolume::Sample()
+    glActiveTexture(GL_TEXTURE0 + DENSITY_VOLUME_TEXTURE_UNIT);
+    glGenTextures(1, &_densityTexture);
+    if (IsNull(_densityTexture, MSG_INFO("Could not create OGL texture.")))
+        return false;
+
+    glBindTexture(GL_TEXTURE_3D, _densityTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return true;
+}
+
+bool RenderEngine::RenderDensityVolume()
+{
+    const auto size = _settings._densityVolumeSize;
+    if (size == 0)
+        return true;
+
+    // the texture keeps the bricks of the previous frames unless it is new
+    if (_densityTextureSize != size)
+    {
+        const auto edge = int(size);
+
+        glActiveTexture(GL_TEXTURE0 + DENSITY_VOLUME_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_3D, _densityTexture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA32F, edge, edge, edge, 0,
+                     GL_RGBA, GL_FLOAT, nullptr);
+
+        _densityVolume.Reset();
+        _densityTextureSize = size;
+    }
+
+    if (IsFalse(_densityVolume.Update(_boundsMin, _boundsMax, _objects,
+                                      _settings, float(_step)),
+                MSG_INFO("Could not update density volume.")))
+        return false;
+
+    // the empty bricks are not baked, only marked for the ray skip
+    const auto& cleared = _densityVolume.GetClearedBricks();
+    if (!cleared.empty())
+    {
+        const auto edge = int(DENSITY_BRICK_SIZE);
+        const std::vector<glm::vec4> emptyBrick(
+            DENSITY_BRICK_SIZE * DENSITY_BRICK_SIZE * DENSITY_BRICK_SIZE,
+            _densityVolume.GetEmptyVoxel());
+
+        glActiveTexture(GL_TEXTURE0 + DENSITY_VOLUME_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_3D, _densityTexture);
+
+        for (const auto brick : cleared)
+        {
+            unsigned int x, y, z;
+            _densityVolume.GetBrickOrigin(brick, x, y, z);
 
-    static_assert(width > 0, "Illegal value for width");
-    static_assert(height > 0, "Illegal value for width");
+            glTexSubImage3D(GL_TEXTURE_3D, 0, int(x), int(y), int(z), edge,
+                            edge, edge, GL_RGBA, GL_FLOAT, emptyBrick.data());
+        }
+    }
 
-    // TODO: change to one-component bitmap
-    const auto components = 4;
+    const auto& bricks = _densityVolume.GetDirtyBricks();
+    if (bricks.empty())
+        return true;
 
-    // allocate data
-    const auto dataCnt = width * height * components;
-    auto*      data    = new GLubyte[dataCnt];
+    if (IsFalse(_densityShader.Use(), MSG_INFO("Could not use shader.")))
+        return false;
 
-    if (IsNullptr(data,
-                  MSG_INFO("Could not allocate memory for noise texture.")))
+    // the bake sums the metaballs
+    if (!SetFieldUniforms(_densityShader))
+        return false;
+    if (!SetUniform(_densityShader, "u_densityVolumeSize", 0u))
         return false;
 
-    const auto widthF  = float(width);
-    const auto heightF = float(height);
-    const auto scale   = 6.5f;
+    // the voxels are neither blended nor depth tested; the texture is not
+    // sampled while it is rendered to
+    glActiveTexture(GL_TEXTURE0 + DENSITY_VOLUME_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _densityFrameBuffer);
+    glViewport(0, 0, int(size), int(size));
 
-    for (auto y = 0; y < height; ++y)
+    const auto& min    = _densityVolume.GetMin();
+    const auto& extent = _densityVolume.GetExtent();
+
+    auto drawSlice = [&](unsigned int z)
     {
-        const auto yf = float(y) / heightF;
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  _densityTexture, 0, int(z));
+
+        // maps the view plane to the voxel centers of the slice
+        const auto depth = (float(z) + 0.5f) / float(size);
+        const glm::mat4 modelMatrix(
+            glm::vec4(extent.x, 0.0f, 0.0f, 0.0f),
+            glm::vec4(0.0f, extent.y, 0.0f, 0.0f),
+            glm::vec4(0.0f, 0.0f, extent.z, 0.0f),
+            glm::vec4(min.x, min.y, min.z + extent.z * depth, 1.0f));
+
+        if (!SetUniform(_densityShader, "u_modelMatrix", modelMatrix))
+            return false;
+
+        if (IsFalse(_viewPlane.Draw(), MSG_INFO("Could not draw view plane.")))
+            return false;
+
+        return true;
+    };
 
-        for (auto x = 0; x < width; ++x)
+    const auto bricksPerEdge = _densityVolume.GetBricksPerEdge();
+    const auto brickCount    = bricksPerEdge * bricksPerEdge * bricksPerEdge;
+
+    if (bricks.size() == brickCount)
+    {
+        for (auto z = 0u; z < size; ++z)
         {
-            const auto xf = float(x) / widthF;
+            if (!drawSlice(z))
+                return false;
+        }
+    }
+    else
+    {
+        // the scissor rectangle limits the slices to the brick
+        glEnable(GL_SCISSOR_TEST);
 
-            // todo: we could also store different noises in different channels
-            const glm::vec2 pos{xf * scale, yf * scale};
-            const auto      noise   = glm::perlin(pos);
-            const auto      result  = (noise + 1.0f) * .5f;
-            const auto      byteRes = GLubyte(result * 255.9f);
+        for (const auto brick : bricks)
+        {
+            unsigned int x, y, z;
+            _densityVolume.GetBrickOrigin(brick, x, y, z);
 
-            const auto componentOffset = (y * width + x) * components;
+            const auto edge = int(DENSITY_BRICK_SIZE);
+            glScissor(int(x), int(y), edge, edge);
 
-            for (auto c = 0; c < components; ++c)
+            for (auto slice = z; slice < z + DENSITY_BRICK_SIZE; ++slice)
             {
-                const auto componentIndex = componentOffset + c;
-                data[componentIndex]      = byteRes;
+                if (!drawSlice(slice))
+                    return false;
             }
         }
+
+        glDisable(GL_SCISSOR_TEST);
     }
 
-    // setup OpenGL texture and bind to texture unit 0
+    ShaderProgram::End();
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, _noiseTexture);
-    // set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-    // copy texture data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, data);
+    // every later pass samples the baked field
+    glActiveTexture(GL_TEXTURE0 + DENSITY_VOLUME_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, _densityTexture);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+
+    return true;
+}
+
+bool RenderEngine::CreateShadowMap()
+{
+    glGenFramebuffers(1, &_shadowFrameBuffer);
+    if (IsNull(_shadowFrameBuffer,
+               MSG_INFO("Could not create OGL framebuffer.")))
+        return false;
+
+    // one float per texel, see shadow_body.glsl; the storage is allocated
+    // with the size of the map in RenderShadowMap()
+    glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_TEXTURE_UNIT);
+    glGenTextures(1, &_shadowTexture);
+    if (IsNull(_shadowTexture, MSG_INFO("Could not create OGL texture.")))
+        return false;
+
+    glBindTexture(GL_TEXTURE_2D, _shadowTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    return true;
+}
+
+bool RenderEngine::RenderShadowMap()
+{
+    const auto size = _settings._shadowMapSize;
+    if (size == 0)
+        return true;
+
+    const auto lightDir = glm::normalize(LIGHT_VECTOR);
+    if (IsFalse(_shadowMap.Fit(_boundsMin, _boundsMax, lightDir, size),
+                MSG_INFO("Could not fit shadow map.")))
+        return false;
+
+    glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _shadowTexture);
+
+    if (_shadowTextureSize != size)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, int(size), int(size), 0,
+                     GL_RED, GL_FLOAT, nullptr);
+        _shadowTextureSize = size;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _shadowFrameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, _shadowTexture, 0);
+
+    // maps the view plane to the rays of the texels
+    const auto edgeU = _shadowMap.GetTexelEdge(0) * float(size);
+    const auto edgeV = _shadowMap.GetTexelEdge(1) * float(size);
+    const glm::mat4 modelMatrix(glm::vec4(edgeU, 0.0f),
+                                glm::vec4(edgeV, 0.0f),
+                                glm::vec4(lightDir, 0.0f),
+                                glm::vec4(_shadowMap.GetOrigin(), 1.0f));
 
-    delete[] data;
+    const auto steps =
+        unsigned(std::ceil(_shadowMap.GetRayLength() / SHADOW_MAP_STEP));
+
+    if (IsFalse(_shadowShader.Use(), MSG_INFO("Could not use shader.")))
+        return false;
+
+    if (!SetUniform(_shadowShader, "u_modelMatrix", modelMatrix))
+        return false;
+    if (!SetUniform(_shadowShader, "u_shadowSteps", steps))
+        return false;
+    if (!SetRayUniforms(_shadowShader))
+        return false;
+
+    // the depths are neither blended nor depth tested
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glViewport(0, 0, int(size), int(size));
+
+    if (IsFalse(_viewPlane.Draw(), MSG_INFO("Could not draw view plane.")))
+        return false;
+
+    ShaderProgram::End();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+
+    return true;
+}
+
+bool RenderEngine::CreateLightVolume()
+{
+    glGenFramebuffers(1, &_lightFrameBuffer);
+    if (IsNull(_lightFrameBuffer,
+               MSG_INFO("Could not create OGL framebuffer.")))
+        return false;
+
+    // the storage is allocated with the size of the grid in
+    // RenderLightVolume(); both are filtered like LightVolume::Interpolate()
+    glActiveTexture(GL_TEXTURE0 + LIGHT_DENSITY_TEXTURE_UNIT);
+    glGenTextures(1, &_lightDensity);
+    if (IsNull(_lightDensity, MSG_INFO("Could not create OGL texture.")))
+        return false;
+
+    glActiveTexture(GL_TEXTURE0 + LIGHT_VOLUME_TEXTURE_UNIT);
+    glGenTextures(1, &_lightVolumeTexture);
+    if (IsNull(_lightVolumeTexture, MSG_INFO("Could not create OGL texture.")))
+        return false;
+
+    for (const auto texture : {_lightDensity, _lightVolumeTexture})
+    {
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+    return true;
+}
+
+bool RenderEngine::RenderLightVolume()
+{
+    const auto size = _settings._lightVolumeSize;
+    if (size == 0)
+        return true;
+
+    if (IsFalse(_lightVolume.Fit(_boundsMin, _boundsMax,
+                                 glm::normalize(LIGHT_VECTOR), size),
+                MSG_INFO("Could not fit light volume.")))
+        return false;
+
+    if (_lightVolumeSize != size)
+    {
+        const auto edge = int(size);
+
+        glActiveTexture(GL_TEXTURE0 + LIGHT_DENSITY_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_3D, _lightDensity);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, edge, edge, edge, 0, GL_RED,
+                     GL_UNSIGNED_BYTE, nullptr);
+
+        glActiveTexture(GL_TEXTURE0 + LIGHT_VOLUME_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_3D, _lightVolumeTexture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, edge, edge, edge, 0, GL_RED,
+                     GL_FLOAT, nullptr);
+
+        _lightVolumeSize = size;
+    }
+
+    if (IsFalse(_lightShader.Use(), MSG_INFO("Could not use shader.")))
+        return false;
+
+    if (!SetFieldUniforms(_lightShader))
+        return false;
+    if (!SetUniform(_lightShader, "u_lightVolumeMin", _lightVolume.GetMin()))
+        return false;
+    if (!SetUniform(_lightShader, "u_lightVolumeExtent",
+                    _lightVolume.GetExtent()))
+        return false;
+    if (!SetUniform(_lightShader, "u_lightVolumeStep",
+                    _lightVolume.GetIntegrationStep()))
+        return false;
+
+    // the voxels are neither blended nor depth tested
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _lightFrameBuffer);
+    glViewport(0, 0, int(size), int(size));
+
+    // neither pass samples the texture it renders to
+    const unsigned int targets[] = {_lightDensity, _lightVolumeTexture};
+    const auto&        min       = _lightVolume.GetMin();
+    const auto&        extent    = _lightVolume.GetExtent();
+
+    for (auto pass = 0u; pass < 2; ++pass)
+    {
+        glActiveTexture(GL_TEXTURE0 + LIGHT_VOLUME_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_3D, 0);
+        glActiveTexture(GL_TEXTURE0 + LIGHT_DENSITY_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_3D, pass > 0 ? _lightDensity : 0);
+
+        if (!SetUniform(_lightShader, "u_lightVolumePass", pass))
+            return false;
+
+        for (auto z = 0u; z < size; ++z)
+        {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                      targets[pass], 0, int(z));
+
+            // maps the view plane to the voxel centers of the slice
+            const auto depth = (float(z) + 0.5f) / float(size);
+            const glm::mat4 modelMatrix(
+                glm::vec4(extent.x, 0.0f, 0.0f, 0.0f),
+                glm::vec4(0.0f, extent.y, 0.0f, 0.0f),
+                glm::vec4(0.0f, 0.0f, extent.z, 0.0f),
+                glm::vec4(min.x, min.y, min.z + extent.z * depth, 1.0f));
+
+            if (!SetUniform(_lightShader, "u_modelMatrix", modelMatrix))
+                return false;
+
+            if (IsFalse(_viewPlane.Draw(),
+                        MSG_INFO("Could not draw view plane.")))
+                return false;
+        }
+    }
+
+    ShaderProgram::End();
+
+    // the volume and ground passes read the integrated occupancy
+    glActiveTexture(GL_TEXTURE0 + LIGHT_VOLUME_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, _lightVolumeTexture);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+
+    return true;
+}
+
+bool RenderEngine::CreateGroundMap()
+{
+    glGenFramebuffers(1, &_groundFrameBuffer);
+    if (IsNull(_groundFrameBuffer,
+               MSG_INFO("Could not create OGL framebuffer.")))
+        return false;
+
+    // the storage is allocated with the size of the map in
+    // RenderGroundMap(); the ground is black beyond the footprint
+    glActiveTexture(GL_TEXTURE0 + GROUND_MAP_TEXTURE_UNIT);
+    glGenTextures(1, &_groundTexture);
+    if (IsNull(_groundTexture, MSG_INFO("Could not create OGL texture.")))
+        return false;
+
+    const GLfloat black[] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+    glBindTexture(GL_TEXTURE_2D, _groundTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, black);
+
+    return true;
+}
+
+bool RenderEngine::CreateGBuffer()
+{
+    glGenFramebuffers(1, &_gbufferFrameBuffer);
+    if (IsNull(_gbufferFrameBuffer,
+               MSG_INFO("Could not create OGL framebuffer.")))
+        return false;
+
+    // position and brightness, normal and error code, color; see
+    // gbuffer_body.glsl
+    const GLint formats[] = {GL_RGBA32F, GL_RGBA16F, GL_RGBA16F};
+    unsigned int* textures[] = {&_gbufferPosition, &_gbufferNormal,
+                                &_gbufferColor};
+
+    for (auto i = 0; i < 3; ++i)
+    {
+        glGenTextures(1, textures[i]);
+        if (IsNull(*textures[i], MSG_INFO("Could not create OGL texture.")))
+            return false;
+
+        glBindTexture(GL_TEXTURE_2D, *textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, formats[i], FRAME_WIDTH, FRAME_HEIGHT,
+                     0, GL_RGBA, GL_FLOAT, nullptr);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the hit distances are attached per frame, see RenderDeferred(); the
+    // depth is shared with the volume pass target
+    glBindFramebuffer(GL_FRAMEBUFFER, _gbufferFrameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, _gbufferPosition, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                           GL_TEXTURE_2D, _hitTextures[_hitIndex], 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2,
+                           GL_TEXTURE_2D, _gbufferNormal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3,
+                           GL_TEXTURE_2D, _gbufferColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, _depthBuffer);
+
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                  GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+    glDrawBuffers(4, drawBuffers);
+
+    const auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (IsFalse(status == GL_FRAMEBUFFER_COMPLETE,
+                MSG_INFO("G-buffer is incomplete.")))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::RenderGroundMap()
+{
+    const auto size = _settings._groundMapSize;
+    if (size == 0)
+        return true;
+
+    if (IsFalse(_groundMap.Fit(_boundsMin, _boundsMax, size),
+                MSG_INFO("Could not fit ground map.")))
+        return false;
+
+    // the pass does not sample the texture it renders to
+    glActiveTexture(GL_TEXTURE0 + GROUND_MAP_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _groundTexture);
+
+    if (_groundTextureSize != size)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, int(size), int(size), 0,
+                     GL_RGBA, GL_FLOAT, nullptr);
+        _groundTextureSize = size;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _groundFrameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, _groundTexture, 0);
+
+    // maps the view plane to the texel centers on the ground
+    const auto&     min    = _groundMap.GetMin();
+    const auto&     extent = _groundMap.GetExtent();
+    const glm::mat4 modelMatrix(glm::vec4(extent.x, 0.0f, 0.0f, 0.0f),
+                                glm::vec4(0.0f, 0.0f, extent.z, 0.0f),
+                                glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),
+                                glm::vec4(min, 1.0f));
+
+    if (IsFalse(_groundBake->Use(), MSG_INFO("Could not use shader.")))
+        return false;
+
+    if (!SetUniform(*_groundBake, "u_modelMatrix", modelMatrix))
+        return false;
+    if (!SetFrameUniforms(*_groundBake))
+        return false;
+    if (!SetShadowUniforms(*_groundBake))
+        return false;
+    if (!SetLightVolumeUniforms(*_groundBake))
+        return false;
+
+    // the colors are neither blended nor depth tested
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glViewport(0, 0, int(size), int(size));
+
+    if (IsFalse(_viewPlane.Draw(), MSG_INFO("Could not draw view plane.")))
+        return false;
+
+    ShaderProgram::End();
+
+    // the ground pass reads the colors
+    glActiveTexture(GL_TEXTURE0 + GROUND_MAP_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _groundTexture);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+
+    return true;
+}
+
+void RenderEngine::BeginReprojection()
+{
+    if (!_settings._reprojection)
+        return;
+
+    // the hit distances of the previous frame are read, the others written
+    _hitIndex = 1 - _hitIndex;
+
+    glActiveTexture(GL_TEXTURE0 + HIT_DISTANCE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _hitTextures[1 - _hitIndex]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _frameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                           GL_TEXTURE_2D, _hitTextures[_hitIndex], 0);
+
+    const GLfloat background[] = {0.0f, 0.0f, 0.0f, 1.0f};
+    const GLfloat noHit[]      = {-1.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, background);
+    glClearBufferfv(GL_COLOR, 1, noHit);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    // the hit distances are not blended
+    glDisablei(GL_BLEND, 1);
+}
+
+void RenderEngine::EndReprojection()
+{
+    if (!_settings._reprojection)
+        return;
+
+    // the ground is drawn into the default framebuffer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _frameBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, FRAME_WIDTH, FRAME_HEIGHT, 0, 0, FRAME_WIDTH,
+                      FRAME_HEIGHT, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                      GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool RenderEngine::SelectShaders()
+{
+    ShaderPermutation permutation;
+    permutation._shadingMode  = int(_settings._renderMode);
+    permutation._noise        = int(_settings.GetNoise());
+    permutation._objectBucket =
+        ShaderPermutation::GetObjectBucket(_objects.GetObjectCount());
+
+    // compiles only the programs of the current pipeline
+    if (_settings._deferredShading)
+    {
+        _geometryShader = _geometryShaders.Get(permutation);
+        if (IsNullptr(_geometryShader,
+                      MSG_INFO("Could not get geometry shader.")))
+            return false;
+
+        _groundGeometryShader = _groundGeometryShaders.Get(permutation);
+        if (IsNullptr(_groundGeometryShader,
+                      MSG_INFO("Could not get ground geometry shader.")))
+            return false;
+
+        _deferredShader = _deferredShaders.Get(permutation);
+        if (IsNullptr(_deferredShader,
+                      MSG_INFO("Could not get deferred shader.")))
+            return false;
+    }
+    else
+    {
+        _shader = _volumeShaders.Get(permutation);
+        if (IsNullptr(_shader, MSG_INFO("Could not get view shader.")))
+            return false;
+    }
+
+    _groundShader = _groundShaders.Get(permutation);
+    if (IsNullptr(_groundShader, MSG_INFO("Could not get ground shader.")))
+        return false;
+
+    _groundBake = _groundBakes.Get(permutation);
+    if (IsNullptr(_groundBake, MSG_INFO("Could not get ground map shader.")))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::UpdateObjectBuffers()
+{
+    const auto data = _objects.GetSoAData();
+    const auto size = size_t(data._size) * sizeof(float);
+
+    if (IsFalse(_objectBuffer.Upload(data._data, size),
+                MSG_INFO("Could not upload object data.")))
+        return false;
+
+    // the distance field evaluates every sphere
+    if (_settings._kernel == MetaballKernel::SMOOTH_MIN)
+        return true;
+
+    if (_settings._kernel != MetaballKernel::WYVILL)
+    {
+        if (_settings._openingAngle <= 0.0f)
+            return true;
+
+        if (IsFalse(_octree.Build(_objects),
+                    MSG_INFO("Could not build octree.")))
+            return false;
+
+        const auto& nodes   = _octree.GetNodes();
+        const auto& indices = _octree.GetIndices();
+
+        if (IsFalse(_octreeNodes.Upload(nodes.data(),
+                                        nodes.size() * sizeof(OctreeNode)),
+                    MSG_INFO("Could not upload octree nodes.")))
+            return false;
+        if (IsFalse(_octreeIndices.Upload(indices.data(),
+                                          indices.size() * sizeof(int)),
+                    MSG_INFO("Could not upload octree indices.")))
+            return false;
+
+        return true;
+    }
+
+    if (IsFalse(_grid.Build(_objects, _settings._kernelRadius),
+                MSG_INFO("Could not build grid.")))
+        return false;
+    if (IsFalse(_tiles.Build(_objects, _settings._kernelRadius, CAM_POS,
+                             VIEW_PLANE_ORIGIN, VIEW_PLANE_SIZE),
+                MSG_INFO("Could not build tiles.")))
+        return false;
+
+    // the tiles are appended to the grid cells, so both share the samplers
+    const auto& cells   = _grid.GetCells();
+    const auto& indices = _grid.GetIndices();
+    const auto& tiles   = _tiles.GetTiles();
+    const auto  offset  = int(indices.size());
+
+    _cellData.assign(cells.begin(), cells.end());
+    for (size_t i = 0; i < tiles.size(); i += 2)
+    {
+        _cellData.push_back(tiles[i] + offset);
+        _cellData.push_back(tiles[i + 1]);
+    }
+
+    _indexData.assign(indices.begin(), indices.end());
+    _indexData.insert(_indexData.end(), _tiles.GetIndices().begin(),
+                      _tiles.GetIndices().end());
+
+    if (IsFalse(_gridCells.Upload(_cellData.data(),
+                                  _cellData.size() * sizeof(int)),
+                MSG_INFO("Could not upload grid cells.")))
+        return false;
+    if (IsFalse(_gridIndices.Upload(_indexData.data(),
+                                    _indexData.size() * sizeof(int)),
+                MSG_INFO("Could not upload grid indices.")))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::SetFrameUniforms(ShaderProgram& prog)
+{
+    if (!SetUniform(prog, "u_shadingMode", _settings._renderMode))
+        return false;
+
+    return SetRayUniforms(prog);
+}
+
+bool RenderEngine::SetRayUniforms(ShaderProgram& prog)
+{
+    if (!SetUniform(prog, "u_boundsMin", _boundsMin))
+        return false;
+    if (!SetUniform(prog, "u_boundsMax", _boundsMax))
+        return false;
+
+    const auto intervalRays = _settings._intervalRays ? 1u : 0u;
+    if (!SetUniform(prog, "u_intervalRays", intervalRays))
+        return false;
+
+    return SetFieldUniforms(prog);
+}
+
+bool RenderEngine::SetFieldUniforms(ShaderProgram& prog)
+{
+    if (!SetUniform(prog, "u_animation", _step))
+        return false;
+    if (!SetUniform(prog, "u_noise", _settings.GetNoise()))
+        return false;
+    if (!SetUniform(prog, "u_objectCnt", _objects.GetObjectCount()))
+        return false;
+    if (!SetUniform(prog, "u_objectStride", _objects.GetStride()))
+        return false;
+
+    // the baked field replaces the kernels
+    const auto densitySize = _settings._densityVolumeSize;
+    if (!SetUniform(prog, "u_densityVolumeSize", densitySize))
+        return false;
+
+    if (densitySize > 0)
+    {
+        if (!SetUniform(prog, "u_densityVolumeMin", _densityVolume.GetMin()))
+            return false;
+        if (!SetUniform(prog, "u_densityVolumeExtent",
+                        _densityVolume.GetExtent()))
+            return false;
+    }
+
+    // metaball kernel
+    const auto kernel = unsigned(_settings._kernel);
+    if (!SetUniform(prog, "u_fieldKernel", kernel))
+        return false;
+
+    if (_settings._kernel == MetaballKernel::SMOOTH_MIN)
+        return SetUniform(prog, "u_blendDistance", _settings._blendDistance);
+
+    if (_settings._kernel != MetaballKernel::WYVILL)
+    {
+        const auto angle = _settings._openingAngle;
+        if (!SetUniform(prog, "u_openingAngle", angle))
+            return false;
+
+        if (angle <= 0.0f)
+            return true;
+
+        const auto nodeCount = unsigned(_octree.GetNodes().size());
+        if (!SetUniform(prog, "u_octreeNodeCnt", nodeCount))
+            return false;
+
+        return true;
+    }
+
+    const auto radius = _settings._kernelRadius;
+    if (!SetUniform(prog, "u_kernelRadius", radius))
+        return false;
+    if (!SetUniform(prog, "u_kernelScale", GetWyvillScale(radius)))
+        return false;
+
+    const glm::ivec3 gridDim(_grid.GetDimension(0), _grid.GetDimension(1),
+                             _grid.GetDimension(2));
+    if (!SetUniform(prog, "u_gridMin", _grid.GetMin()))
+        return false;
+    if (!SetUniform(prog, "u_gridCellSize", _grid.GetCellSize()))
+        return false;
+    if (!SetUniform(prog, "u_gridDim", gridDim))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::SetTileUniforms(ShaderProgram& prog)
+{
+    if (_settings._kernel != MetaballKernel::WYVILL)
+        return true;
+
+    const auto tileCountX = unsigned(_tiles.GetTileCount(0));
+    const auto tileCountY = unsigned(_tiles.GetTileCount(1));
+    const auto tileOffset = unsigned(_grid.GetCells().size() / 2);
+
+    if (!SetUniform(prog, "u_tileOffset", tileOffset))
+        return false;
+    if (!SetUniform(prog, "u_tileOrigin", _tiles.GetOrigin()))
+        return false;
+    if (!SetUniform(prog, "u_tileSize", _tiles.GetTileSize()))
+        return false;
+    if (!SetUniform(prog, "u_tileCountX", tileCountX))
+        return false;
+    if (!SetUniform(prog, "u_tileCountY", tileCountY))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::SetReprojectionUniforms(ShaderProgram& prog)
+{
+    if (!SetUniform(prog, "u_displacement", _displacement))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::SetConeUniforms(ShaderProgram& prog, unsigned int scale)
+{
+    if (!SetUniform(prog, "u_coneScale", scale))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::SetShadowUniforms(ShaderProgram& prog)
+{
+    const auto size = _settings._shadowMapSize;
+    if (!SetUniform(prog, "u_shadowMapSize", size))
+        return false;
+
+    if (size == 0)
+        return true;
+
+    if (!SetUniform(prog, "u_shadowOrigin", _shadowMap.GetOrigin()))
+        return false;
+    if (!SetUniform(prog, "u_shadowAxisU", _shadowMap.GetTexelAxis(0)))
+        return false;
+    if (!SetUniform(prog, "u_shadowAxisV", _shadowMap.GetTexelAxis(1)))
+        return false;
+    if (!SetUniform(prog, "u_shadowBias", _shadowMap.GetBias()))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::SetLightVolumeUniforms(ShaderProgram& prog)
+{
+    const auto size = _settings._lightVolumeSize;
+    if (!SetUniform(prog, "u_lightVolumeSize", size))
+        return false;
+
+    if (size == 0)
+        return true;
+
+    if (!SetUniform(prog, "u_lightVolumeMin", _lightVolume.GetMin()))
+        return false;
+    if (!SetUniform(prog, "u_lightVolumeExtent", _lightVolume.GetExtent()))
+        return false;
+
+    return true;
+}
+
+bool RenderEngine::SetGroundMapUniforms()
+{
+    const auto size = _settings._groundMapSize;
+    if (!SetUniform(*_groundShader, "u_groundMapSize", size))
+        return false;
+
+    if (size == 0)
+        return true;
+
+    if (!SetUniform(*_groundShader, "u_groundMapMin", _groundMap.GetMin()))
+        return false;
+    if (!SetUniform(*_groundShader, "u_groundMapExtent",
+                    _groundMap.GetExtent()))
+        return false;
 
     return true;
 }
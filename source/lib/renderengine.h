@@ -4,175 +4,357 @@
 #include "polygonobject.h"
 #include "window.h"
 #include "program.h"
+#include "densityvolume.h"
+#include "groundmap.h"
+#include "lightvolume.h"
+#include "noise.h"
+#include "octree.h"
+#include "reprojection.h"
+#include "scene.h"
+#include "shadowmap.h"
+#include "spatialgrid.h"
+#include "texturebuffer.h"
+#include "tilelists.h"
 #include <vector>
 
-//---------------------------------------------------------------------------
-/// Utility class storing all information on the scene objects.
-//---------------------------------------------------------------------------
-class ObjectArray
+class RenderEngine
 {
 public:
+    RenderEngine();
+    ~RenderEngine();
+
     //---------------------------------------------------------------------------
-    /// Constructor
+    /// Prepares OpenGL.
+    /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    ObjectArray();
+    static bool Init();
 
     //---------------------------------------------------------------------------
-    /// Destructor.
+    /// Creates the scene data. Must be called after Init().
+    /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    ~ObjectArray();
+    bool CreateScene();
 
     //---------------------------------------------------------------------------
-    /// Adds an object to the scene.
-    /// @param[in]  pos     The object position.
-    /// @param[in]  color   The object color.
-    /// @param[out] index   The new object index.
+    /// Updates the scene.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    bool AddObject(glm::vec3& pos, glm::vec3& color, int& index);
+    void UpdateScene(const SceneSettings& settings);
 
     //---------------------------------------------------------------------------
-    /// Adds an object to the scene.
+    /// Renders the scene.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    bool AddObject();
+    bool Render();
 
     //---------------------------------------------------------------------------
-    /// Returns the number of objects in the scene
-    /// @return             The number of objects.
+    /// Closes the render engine; frees resources.
+    /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    unsigned int GetObjectCount() const;
+    bool Close();
 
+private:
     //---------------------------------------------------------------------------
-    /// Sets the position of the dynamic, user controlled object.
-    /// @param[in]  x       The x-coordinate.
-    /// @param[int] y       The y-coordinate.
+    /// Creates the noise texture for the current settings.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    bool SetDynamicObject(float x, float y);
+    bool CreateNoiseTexture();
 
     //---------------------------------------------------------------------------
-    /// Removes the last object from the scene.
+    /// Generates the noise texture again if SceneSettings::_noiseVolumeSize
+    /// changed.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    bool RemoveLastObject();
+    bool UpdateNoiseTexture();
 
     //---------------------------------------------------------------------------
-    /// Returns the size of the arrays accessed with GetPositionData() and
-    /// GetColorData().
-    /// @return             The size of the arrays.
+    /// Generates the noise of _noiseParams and copies it to the texture.
+    /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    int GetDataSize() const;
+    bool UploadNoiseTexture();
 
     //---------------------------------------------------------------------------
-    /// Returns the array containing position data.
-    /// @return             The position data.
+    /// Creates the texture buffers storing the metaball data.
+    /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    glm::vec3* GetPositionData();
+    bool CreateObjectBuffers();
 
     //---------------------------------------------------------------------------
-    /// Returns the array containing color data.
-    /// @return             The color data.
+    /// Uploads the metaball data and the spatial grid into the texture
+    /// buffers. Called once per frame; the buffers are shared by all shaders.
+    /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    glm::vec3* GetColorData();
+    bool UpdateObjectBuffers();
 
     //---------------------------------------------------------------------------
-    /// Animates the scene.
-    /// @param[in]  step        The current animation step.
+    /// Creates the framebuffer of the volume pass with reprojection. Besides
+    /// color and depth it stores the hit distances of the primary rays.
+    /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    void Animation(float step);
+    bool CreateFrameBuffer();
 
-private:
-    int                    _count;      ///> number of elements.
-    std::vector<glm::vec3> _pos;        ///> position information.
-    std::vector<glm::vec3> _colors;     ///> color information.
-    glm::vec3              _userObject; ///> position of the user object.
-    bool _countChanged; ///> True if the number of elements has changed. Reset
-                        /// Animation().
-};
+    //---------------------------------------------------------------------------
+    /// Creates the framebuffer and the textures of the cone prepass.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool CreateConeTextures();
 
-enum class NoiseMode : unsigned int
-{
-    NOISE    = 1,
-    NO_NOISE = 2
-};
+    //---------------------------------------------------------------------------
+    /// Renders the cone prepass from coarse to fine and binds the distances of
+    /// the finest level for the volume pass. Does nothing if the prepass is
+    /// off.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool RenderConePrepass();
 
-//---------------------------------------------------------------------------
-/// General scene settings.
-//---------------------------------------------------------------------------
-struct SceneSettings
-{
-    bool         _timeStep;
-    unsigned int _renderMode;
-    float        _timeOff;
-    float        _dynamicObjectX;
-    float        _dynamicObjectY;
-    NoiseMode    _noise;
-    bool         _addObjectClick;
-    bool         _removeObject;
-    bool         _addObject;
-
-    unsigned int GetNoise() const
-    {
-        if (_noise == NoiseMode::NOISE)
-            return 1u;
-        return 0u;
-    }
-};
+    //---------------------------------------------------------------------------
+    /// Creates the framebuffer and the texture of the density volume.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool CreateDensityVolume();
 
-class RenderEngine
-{
-public:
-    RenderEngine();
-    ~RenderEngine();
+    //---------------------------------------------------------------------------
+    /// Fits the density volume to the field bounds, bakes the bricks that
+    /// changed since the last frame and binds it for all later passes. Does
+    /// nothing if the density volume is off.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool RenderDensityVolume();
 
     //---------------------------------------------------------------------------
-    /// Prepares OpenGL.
+    /// Creates the framebuffer and the texture of the shadow map.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    static bool Init();
+    bool CreateShadowMap();
 
     //---------------------------------------------------------------------------
-    /// Creates the scene data. Must be called after Init().
+    /// Fits the shadow map to the field bounds, renders its depths and binds
+    /// them for the volume and ground passes. Does nothing if the shadow map
+    /// is off.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    bool CreateScene();
+    bool RenderShadowMap();
 
     //---------------------------------------------------------------------------
-    /// Updates the scene.
+    /// Creates the framebuffer and the textures of the light volume.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    void UpdateScene(const SceneSettings& settings);
+    bool CreateLightVolume();
 
     //---------------------------------------------------------------------------
-    /// Renders the scene.
+    /// Fits the light volume to the field bounds, samples and integrates its
+    /// slices and binds it for the volume and ground passes. Does nothing if
+    /// the light volume is off.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    bool Render();
+    bool RenderLightVolume();
 
     //---------------------------------------------------------------------------
-    /// Closes the render engine; frees resources.
+    /// Creates the framebuffer and the texture of the ground map.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    bool Close();
+    bool CreateGroundMap();
 
-private:
     //---------------------------------------------------------------------------
-    /// Creates the noise texture.
+    /// Fits the ground map to the field bounds, renders its colors and binds
+    /// them for the ground pass. Does nothing if the ground map is off. Must
+    /// be called after the shadow map and the light volume.
     /// @return             False if an error occurred.
     //---------------------------------------------------------------------------
-    bool CreateNoiseTexture();
+    bool RenderGroundMap();
+
+    //---------------------------------------------------------------------------
+    /// Creates the framebuffer and the textures of the G-buffer; must be
+    /// called after CreateFrameBuffer().
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool CreateGBuffer();
+
+    //---------------------------------------------------------------------------
+    /// Renders the view plane in a single pass that searches the surfaces and
+    /// shades them.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool RenderForward();
+
+    //---------------------------------------------------------------------------
+    /// Renders the surfaces of the view plane and of the ground into the
+    /// G-buffer, then shades them in one full screen pass. The ground is left
+    /// to the ground shader if the ground map is on.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool RenderDeferred();
+
+    //---------------------------------------------------------------------------
+    /// Binds the framebuffer for the volume pass and the hit distances of the
+    /// previous frame. Does nothing if reprojection is off.
+    //---------------------------------------------------------------------------
+    void BeginReprojection();
+
+    //---------------------------------------------------------------------------
+    /// Copies color and depth of the volume pass into the default framebuffer.
+    /// Does nothing if reprojection is off.
+    //---------------------------------------------------------------------------
+    void EndReprojection();
+
+    //---------------------------------------------------------------------------
+    /// Selects the view, ground and ground map shaders specialized for the
+    /// current shading mode, noise and object count; compiles them on first
+    /// use. The view shader is replaced by the geometry and shading shaders
+    /// if deferred shading is on.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SelectShaders();
+
+    //---------------------------------------------------------------------------
+    /// Sets the uniform variables that change per frame.
+    /// @param[in]  prog    The shader program; must be in use.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetFrameUniforms(ShaderProgram& prog);
+
+    //---------------------------------------------------------------------------
+    /// Sets the uniform variables of SampleToSurface() that change per frame;
+    /// a subset of SetFrameUniforms() used by the shadow map shader.
+    /// @param[in]  prog    The shader program; must be in use.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetRayUniforms(ShaderProgram& prog);
+
+    //---------------------------------------------------------------------------
+    /// Sets the uniform variables of the metaball field that change per frame;
+    /// a subset of SetRayUniforms() used by all shaders.
+    /// @param[in]  prog    The shader program; must be in use.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetFieldUniforms(ShaderProgram& prog);
+
+    //---------------------------------------------------------------------------
+    /// Sets the tile uniform variables; only the primary rays use the tiles.
+    /// @param[in]  prog    The volume or geometry shader; must be in use.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetTileUniforms(ShaderProgram& prog);
+
+    //---------------------------------------------------------------------------
+    /// Sets the reprojection uniform variables; only the primary rays are
+    /// reprojected.
+    /// @param[in]  prog    The volume or geometry shader; must be in use.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetReprojectionUniforms(ShaderProgram& prog);
+
+    //---------------------------------------------------------------------------
+    /// Sets the cone prepass uniform variables.
+    /// @param[in]  prog    The volume or cone shader; must be in use.
+    /// @param[in]  scale   Pixels per texel of the bound cone distances; 0 for
+    /// none.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetConeUniforms(ShaderProgram& prog, unsigned int scale);
+
+    //---------------------------------------------------------------------------
+    /// Sets the shadow map uniform variables.
+    /// @param[in]  prog    The volume or ground shader; must be in use.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetShadowUniforms(ShaderProgram& prog);
+
+    //---------------------------------------------------------------------------
+    /// Sets the light volume uniform variables.
+    /// @param[in]  prog    The volume or ground shader; must be in use.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetLightVolumeUniforms(ShaderProgram& prog);
+
+    //---------------------------------------------------------------------------
+    /// Sets the ground map uniform variables of the ground shader. The ground
+    /// shader must be in use.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetGroundMapUniforms();
 
     PolygonObject _viewPlane; ///< view plane object.
     PolygonObject _ground;    ///< ground plane object
 
-    ShaderProgram _shader;       ///< main view shader.
-    ShaderProgram _groundShader; ///< ground shader
+    ShaderCache _volumeShaders;         ///< main view shader permutations.
+    ShaderCache _groundShaders;         ///< ground shader permutations.
+    ShaderCache _groundBakes;           ///< ground map shader permutations.
+    ShaderCache _geometryShaders;       ///< view plane G-buffer permutations.
+    ShaderCache _groundGeometryShaders; ///< ground G-buffer permutations.
+    ShaderCache _deferredShaders;       ///< G-buffer shading permutations.
+
+    ShaderProgram* _shader;               ///< main view shader of the frame.
+    ShaderProgram* _groundShader;         ///< ground shader of the frame.
+    ShaderProgram* _groundBake;           ///< ground map shader of the frame.
+    ShaderProgram* _geometryShader;       ///< view plane G-buffer shader.
+    ShaderProgram* _groundGeometryShader; ///< ground G-buffer shader.
+    ShaderProgram* _deferredShader;       ///< G-buffer shading shader.
+    ShaderProgram  _coneShader;           ///< cone prepass shader.
+    ShaderProgram  _shadowShader;         ///< shadow map shader.
+    ShaderProgram  _lightShader;          ///< light volume shader.
+    ShaderProgram  _densityShader;        ///< density volume shader.
 
     unsigned int _noiseTexture; ///< ID of the noise texture.
+    NoiseParams  _noiseParams;  ///< parameters of _noiseTexture.
+    AssetCache   _assetCache;   ///< generated noise of earlier starts.
+
+    unsigned int _frameBuffer;    ///< volume pass target with reprojection.
+    unsigned int _colorBuffer;    ///< color attachment of _frameBuffer.
+    unsigned int _depthBuffer;    ///< depth attachment of _frameBuffer.
+    unsigned int _hitTextures[2]; ///< hit distances, written and read.
+    unsigned int _hitIndex;       ///< index of the written hit distances.
+
+    unsigned int _coneFrameBuffer;           ///< target of the prepass.
+    unsigned int _coneTextures[CONE_LEVELS]; ///< distances, coarse to fine.
+
+    unsigned int _shadowFrameBuffer; ///< target of the shadow map pass.
+    unsigned int _shadowTexture;     ///< depths of the shadow map.
+    unsigned int _shadowTextureSize; ///< texels per edge of _shadowTexture.
+    ShadowMap    _shadowMap;         ///< light space of the shadow map.
+
+    unsigned int _lightFrameBuffer;   ///< target of the light volume passes.
+    unsigned int _lightDensity;       ///< occupancy of the light volume.
+    unsigned int _lightVolumeTexture; ///< integrated occupancy.
+    unsigned int _lightVolumeSize;    ///< voxels per edge of the textures.
+    LightVolume  _lightVolume;        ///< grid of the light volume.
+
+    unsigned int  _densityFrameBuffer; ///< target of the density bake.
+    unsigned int  _densityTexture;     ///< colors and field values.
+    unsigned int  _densityTextureSize; ///< voxels per edge of the texture.
+    DensityVolume _densityVolume;      ///< grid and dirty bricks.
+
+    unsigned int _groundFrameBuffer; ///< target of the ground map pass.
+    unsigned int _groundTexture;     ///< colors of the ground map.
+    unsigned int _groundTextureSize; ///< texels per edge of _groundTexture.
+    GroundMap    _groundMap;         ///< footprint of the ground map.
+
+    unsigned int _gbufferFrameBuffer; ///< target of the geometry pass.
+    unsigned int _gbufferPosition;    ///< surface positions and brightness.
+    unsigned int _gbufferNormal;      ///< surface normals and error codes.
+    unsigned int _gbufferColor;       ///< surface colors.
+
+    TextureBuffer _objectBuffer; ///< metaball positions and colors.
+    TextureBuffer _gridCells;    ///< grid cells followed by the tiles.
+    TextureBuffer _gridIndices;  ///< metaball indices of the cells and tiles.
+    TextureBuffer _octreeNodes;  ///< nodes of the Barnes-Hut octree.
+    TextureBuffer _octreeIndices; ///< metaball indices of the octree leaves.
+
+    SpatialGrid _grid;   ///< spatial grid for the compact kernel.
+    Octree      _octree; ///< octree for the inverse square kernel.
+    TileLists   _tiles;  ///< tiles for the compact kernel.
+
+    ReprojectionHistory _history;      ///< centers of the previous frame.
+    float               _displacement; ///< see ReprojectionHistory::Update().
+
+    std::vector<int> _cellData;  ///< upload buffer of _gridCells.
+    std::vector<int> _indexData; ///< upload buffer of _gridIndices.
 
     float _step; ///< current animation time
 
+    glm::vec3 _boundsMin; ///< field bounds of the frame, see GetFieldBounds().
+    glm::vec3 _boundsMax; ///< field bounds of the frame, see GetFieldBounds().
+
     SceneSettings _settings; ///< scene settings.
 
     ObjectArray _objects; ///< scene objects.
@@ -0,0 +1,50 @@
+#include "reprojection.h"
+
+ReprojectionHistory::ReprojectionHistory()
+{
+    _kernel        = MetaballKernel::INVERSE_SQUARE;
+    _kernelRadius  = 0.0f;
+    _blendDistance = 0.0f;
+    _valid         = false;
+}
+
+ReprojectionHistory::~ReprojectionHistory() = default;
+
+float ReprojectionHistory::Update(const ObjectArray&   objects,
+                                  const SceneSettings& settings)
+{
+    const auto count = int(objects.GetObjectCount());
+
+    auto valid = _valid && settings._reprojection &&
+                 int(_positions.size()) == count &&
+                 settings._kernel == _kernel &&
+                 settings._kernelRadius == _kernelRadius &&
+                 settings._blendDistance == _blendDistance;
+
+    auto displacement = 0.0f;
+
+    _positions.resize(size_t(count));
+
+    for (auto i = 0; i < count; ++i)
+    {
+        const auto pos = objects.GetPosition(i);
+        displacement   = glm::max(displacement,
+                                  glm::length(pos - _positions[size_t(i)]));
+        _positions[size_t(i)] = pos;
+    }
+
+    _kernel        = settings._kernel;
+    _kernelRadius  = settings._kernelRadius;
+    _blendDistance = settings._blendDistance;
+    _valid         = settings._reprojection;
+
+    if (valid == false)
+        return -1.0f;
+
+    return displacement;
+}
+
+void ReprojectionHistory::Reset()
+{
+    _valid = false;
+}
@@ -0,0 +1,56 @@
+#ifndef VOLUME_DEMO_REPROJECTION_H__
+#define VOLUME_DEMO_REPROJECTION_H__
+
+#include "glm/glm.hpp"
+#include "scene.h"
+#include <vector>
+
+/// Distance in world units a reprojected ray starts in front of the previous
+/// hit, in addition to the center displacement.
+static constexpr auto REPROJECTION_MARGIN = 0.1f;
+
+//---------------------------------------------------------------------------
+/// Tracks the metaball centers between frames. The primary rays of a frame
+/// start close to the hit distance of the previous frame; the surface moved
+/// by at most the center displacement returned by Update(). The camera does
+/// not move, so each pixel reprojects onto itself.
+//---------------------------------------------------------------------------
+class ReprojectionHistory
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    ReprojectionHistory();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~ReprojectionHistory();
+
+    //---------------------------------------------------------------------------
+    /// Compares the objects with the previous frame and stores them for the
+    /// next frame.
+    /// @param[in]  objects     The scene objects of the new frame.
+    /// @param[in]  settings    The scene settings of the new frame.
+    /// @return                 The largest distance a center moved since the
+    /// previous frame. Negative if the previous hit distances are invalid:
+    /// in the first frame, if objects were added or removed, if the field
+    /// function changed or if SceneSettings::_reprojection is off.
+    //---------------------------------------------------------------------------
+    float Update(const ObjectArray& objects, const SceneSettings& settings);
+
+    //---------------------------------------------------------------------------
+    /// Invalidates the history, e.g. if the image size changed.
+    //---------------------------------------------------------------------------
+    void Reset();
+
+private:
+    std::vector<glm::vec3> _positions;     ///< centers of the previous frame.
+    MetaballKernel         _kernel;        ///< kernel of the previous frame.
+    float                  _kernelRadius;  ///< see SceneSettings.
+    float                  _blendDistance; ///< see SceneSettings.
+    bool                   _valid;         ///< false if there is no history.
+};
+
+#endif // VOLUME_DEMO_REPROJECTION_H__
@@ -0,0 +1,446 @@
+#include "scene.h"
+#include "fastmath.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+ObjectArray::ObjectArray(ObjectLayout layout, unsigned int capacity)
+{
+    _layout       = layout;
+    _count        = 0;
+    _maxCount     = std::numeric_limits<unsigned int>::max();
+    _stride       = 0;
+    _countChanged = false;
+    _userObject   = {};
+    _threadCount  = 1;
+
+    // allocate up front; no reallocation below the given capacity
+    Reserve(capacity);
+}
+
+ObjectArray::~ObjectArray() = default;
+
+void ObjectArray::Reserve(unsigned int capacity)
+{
+    if (_layout == ObjectLayout::AOS)
+    {
+        _pos.reserve(capacity);
+        _colors.reserve(capacity);
+        return;
+    }
+
+    const auto stride = GetPaddedCount(std::max(capacity, 1u));
+    if (stride <= _stride)
+        return;
+
+    AlignedFloatArray soa(size_t(stride) * OBJECT_COMPONENT_COUNT, 0.0f);
+
+    for (auto c = 0u; c < OBJECT_COMPONENT_COUNT; ++c)
+    {
+        const auto* src = _soa.data() + size_t(c) * _stride;
+        std::copy(src, src + _count, soa.data() + size_t(c) * stride);
+    }
+
+    _soa.swap(soa);
+    _stride = stride;
+}
+
+bool ObjectArray::PushObject(const glm::vec3& pos, const glm::vec3& color)
+{
+    // check
+    if (unsigned(_count) >= _maxCount)
+        return false;
+
+    if (_layout == ObjectLayout::AOS)
+    {
+        _pos.push_back(pos);
+        _colors.push_back(color);
+    }
+    else
+    {
+        // grow, but not past the padded limit
+        if (unsigned(_count) == _stride)
+        {
+            const auto limit = std::min(_maxCount, _stride * 2);
+            Reserve(GetPaddedCount(limit));
+        }
+
+        SetPosition(_count, pos);
+        SetColor(_count, color);
+    }
+
+    _count++;
+    _countChanged = true;
+
+    return true;
+}
+
+bool ObjectArray::AddObject(glm::vec3& pos, glm::vec3& color, int& index)
+{
+    if (!PushObject(pos, color))
+        return false;
+
+    index = _count - 1;
+
+    return true;
+}
+
+bool ObjectArray::AddObject()
+{
+    const glm::vec3 null{0.0};
+
+    return PushObject(null, null);
+}
+
+unsigned int ObjectArray::GetObjectCount() const
+{
+    return _count;
+}
+
+void ObjectArray::SetMaxObjectCount(unsigned int count)
+{
+    _maxCount = count;
+}
+
+unsigned int ObjectArray::GetMaxObjectCount() const
+{
+    return _maxCount;
+}
+
+bool ObjectArray::SetDynamicObject(float x, float y)
+{
+    _userObject.x = x;
+    _userObject.y = y;
+    _userObject.z = Z_POS;
+
+    return true;
+}
+
+bool ObjectArray::RemoveLastObject()
+{
+    if (_count <= 1)
+        return false;
+
+    if (_layout == ObjectLayout::AOS)
+    {
+        _pos.pop_back();
+        _colors.pop_back();
+    }
+    else
+    {
+        // keep the padding cleared
+        const glm::vec3 null{0.0};
+        SetPosition(_count - 1, null);
+        SetColor(_count - 1, null);
+    }
+
+    _count--;
+
+    _countChanged = true;
+
+    return true;
+}
+
+ObjectLayout ObjectArray::GetLayout() const
+{
+    return _layout;
+}
+
+glm::vec3* ObjectArray::GetPositionData()
+{
+    return _pos.data();
+}
+
+glm::vec3* ObjectArray::GetColorData()
+{
+    return _colors.data();
+}
+
+const glm::vec3* ObjectArray::GetPositionData() const
+{
+    return _pos.data();
+}
+
+const glm::vec3* ObjectArray::GetColorData() const
+{
+    return _colors.data();
+}
+
+unsigned int ObjectArray::GetStride() const
+{
+    return _stride;
+}
+
+FloatSpan ObjectArray::GetComponentData(ObjectComponent component) const
+{
+    FloatSpan span;
+
+    if (_layout == ObjectLayout::SOA)
+    {
+        span._data = _soa.data() + size_t(component) * _stride;
+        span._size = _count;
+    }
+
+    return span;
+}
+
+FloatSpan ObjectArray::GetSoAData() const
+{
+    FloatSpan span;
+    span._data = _soa.data();
+    span._size = unsigned(_soa.size());
+    return span;
+}
+
+glm::vec3 ObjectArray::GetPosition(int i) const
+{
+    if (_layout == ObjectLayout::AOS)
+        return _pos[i];
+
+    const auto* x = _soa.data() + i;
+    return glm::vec3(x[0], x[_stride], x[_stride * 2]);
+}
+
+glm::vec3 ObjectArray::GetColor(int i) const
+{
+    if (_layout == ObjectLayout::AOS)
+        return _colors[i];
+
+    const auto* r = _soa.data() + size_t(ObjectComponent::R) * _stride + i;
+    return glm::vec3(r[0], r[_stride], r[_stride * 2]);
+}
+
+void ObjectArray::SetPosition(int i, const glm::vec3& pos)
+{
+    if (_layout == ObjectLayout::AOS)
+    {
+        _pos[i] = pos;
+        return;
+    }
+
+    auto* x        = _soa.data() + i;
+    x[0]           = pos.x;
+    x[_stride]     = pos.y;
+    x[_stride * 2] = pos.z;
+}
+
+void ObjectArray::SetColor(int i, const glm::vec3& color)
+{
+    if (_layout == ObjectLayout::AOS)
+    {
+        _colors[i] = color;
+        return;
+    }
+
+    auto* r        = _soa.data() + size_t(ObjectComponent::R) * _stride + i;
+    r[0]           = color.x;
+    r[_stride]     = color.y;
+    r[_stride * 2] = color.z;
+}
+
+int ObjectArray::GetDataSize() const
+{
+    return _count * 3;
+}
+
+//---------------------------------------------------------------------------
+/// Sets the colors of a range of objects to a color wheel; see
+/// ObjectArray::Animation(). The components are STRIDE floats apart per
+/// object. The loop has no branches or calls, so that it vectorizes.
+/// @param[out] r           The red components.
+/// @param[out] g           The green components.
+/// @param[out] b           The blue components.
+/// @param[in]  begin       The first object.
+/// @param[in]  end         The object after the last.
+/// @param[in]  hueStep     Hue between two objects in turns.
+//---------------------------------------------------------------------------
+template <size_t STRIDE>
+static void ColorRange(float* r, float* g, float* b, int begin, int end,
+                       float hueStep)
+{
+    // fully saturated and bright, see glm::rgbColor()
+    auto channel = [](float hue)
+    {
+        const auto f = hue - float(int(hue));
+        return std::min(std::max(std::fabs(f * 6.0f - 3.0f) - 1.0f, 0.0f),
+                        1.0f);
+    };
+
+    for (auto i = begin; i < end; ++i)
+    {
+        // the wheel starts at cyan
+        const auto hue = 0.5f + float(i) * hueStep;
+        const auto k   = size_t(i) * STRIDE;
+
+        r[k] = channel(hue + 1.0f);
+        g[k] = channel(hue + 2.0f / 3.0f);
+        b[k] = channel(hue + 1.0f / 3.0f);
+    }
+}
+
+//---------------------------------------------------------------------------
+/// Moves a range of objects one animation step; see ObjectArray::Animation().
+/// The components are STRIDE floats apart per object. The loop has no
+/// branches or calls, so that it vectorizes.
+/// @param[in,out] x            The x-coordinates.
+/// @param[in,out] y            The y-coordinates.
+/// @param[in,out] z            The z-coordinates.
+/// @param[in]     begin        The first object.
+/// @param[in]     end          The object after the last.
+/// @param[in]     user         Position of the user object.
+/// @param[in]     step         The current animation step.
+/// @param[in]     angleStep    Orbit angle between two objects.
+//---------------------------------------------------------------------------
+template <size_t STRIDE>
+static void AnimateRange(float* x, float* y, float* z, int begin, int end,
+                         const glm::vec3& user, float step, float angleStep)
+{
+    // locals, so that the stores to x, y and z do not alias the user object
+    const auto ux = user.x;
+    const auto uy = user.y;
+    const auto uz = user.z;
+
+    for (auto i = begin; i < end; ++i)
+    {
+        const auto k  = size_t(i) * STRIDE;
+        const auto px = x[k];
+        const auto py = y[k];
+        const auto pz = z[k];
+
+        float s, c;
+        FastSinCos((step * .01f) + angleStep * float(i), s, c);
+
+        const auto dx   = ux - px;
+        const auto dy   = uy - py;
+        const auto dz   = uz - pz;
+        const auto near = dx * dx + dy * dy + dz * dz < 0.2f * 0.2f;
+
+        // halfway to the close user object, else a tenth toward the orbit;
+        // one blend weight instead of a select per value, which GCC does not
+        // if-convert
+        const auto w    = near ? 1.0f : 0.0f;
+        const auto ox   = s * 2.0f;
+        const auto oy   = (c * 0.7f) + 0.25f;
+        const auto tx   = ox + (ux - ox) * w;
+        const auto ty   = oy + (uy - oy) * w;
+        const auto tz   = Z_POS + (uz - Z_POS) * w;
+        const auto rate = 0.1f + 0.4f * w;
+
+        x[k] = px + (tx - px) * rate;
+        y[k] = py + (ty - py) * rate;
+        z[k] = pz + (tz - pz) * rate;
+    }
+}
+
+void ObjectArray::SetThreadCount(unsigned int count)
+{
+    _threadCount = count;
+}
+
+void ObjectArray::Animation(float step)
+{
+    if (_count < 2)
+        return;
+
+    // the components of an object are 3 floats apart with AOS
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float),
+                  "glm::vec3 is not packed");
+
+    const auto aos = _layout == ObjectLayout::AOS;
+
+    float* pos[3];
+    float* color[3];
+
+    for (auto a = 0u; a < 3; ++a)
+    {
+        pos[a]   = aos ? &_pos[0][a] : _soa.data() + size_t(a) * _stride;
+        color[a] = aos ? &_colors[0][a] : _soa.data() + size_t(a + 3) * _stride;
+    }
+
+    const auto count     = _count;
+    const auto colors    = _countChanged;
+    const auto angleStep = 6.28f / float(count);
+    const auto hueStep   = 1.0f / float(count);
+
+    const auto chunks = (unsigned(count) + ANIMATION_CHUNK_SIZE - 1) /
+                        ANIMATION_CHUNK_SIZE;
+
+    ParallelFor(chunks, _threadCount,
+                [&](unsigned int chunk)
+                {
+                    const auto begin = int(chunk * ANIMATION_CHUNK_SIZE);
+                    const auto end =
+                        std::min(begin + int(ANIMATION_CHUNK_SIZE), count);
+
+                    // a constant stride lets the compiler shuffle the AOS
+                    // components instead of loading them one by one
+                    if (aos && colors)
+                    {
+                        ColorRange<3>(color[0], color[1], color[2], begin,
+                                      end, hueStep);
+                    }
+                    else if (colors)
+                    {
+                        ColorRange<1>(color[0], color[1], color[2], begin,
+                                      end, hueStep);
+                    }
+
+                    if (aos)
+                    {
+                        AnimateRange<3>(pos[0], pos[1], pos[2], begin, end,
+                                        _userObject, step, angleStep);
+                    }
+                    else
+                    {
+                        AnimateRange<1>(pos[0], pos[1], pos[2], begin, end,
+                                        _userObject, step, angleStep);
+                    }
+                });
+
+    _countChanged = false;
+}
+
+void GetFieldBounds(const ObjectArray& objects, const SceneSettings& settings,
+                    glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    const auto count = int(objects.GetObjectCount());
+
+    if (count == 0)
+    {
+        // empty box
+        boundsMin = glm::vec3(1.0f);
+        boundsMax = glm::vec3(-1.0f);
+        return;
+    }
+
+    boundsMin = objects.GetPosition(0);
+    boundsMax = boundsMin;
+
+    for (auto i = 1; i < count; ++i)
+    {
+        const auto pos = objects.GetPosition(i);
+        boundsMin      = glm::min(boundsMin, pos);
+        boundsMax      = glm::max(boundsMax, pos);
+    }
+
+    auto padding = settings._kernelRadius;
+
+    if (settings._kernel == MetaballKernel::INVERSE_SQUARE)
+    {
+        // each metaball adds less than 1 / padding² outside of the box
+        auto threshold = METABALL_THRESHOLD;
+        if (settings._noise == NoiseMode::NOISE)
+            threshold -= NOISE_FIELD_AMPLITUDE;
+
+        padding = std::sqrt(float(count) / threshold);
+    }
+    else if (settings._kernel == MetaballKernel::SMOOTH_MIN)
+    {
+        padding = SDF_SPHERE_RADIUS + settings._blendDistance * 0.25f;
+    }
+
+    boundsMin -= glm::vec3(padding);
+    boundsMax += glm::vec3(padding);
+}
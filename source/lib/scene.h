@@ -0,0 +1,377 @@
+#ifndef VOLUME_DEMO_SCENE_H__
+#define VOLUME_DEMO_SCENE_H__
+
+#include "alignedarray.h"
+#include "glm/glm.hpp"
+#include <vector>
+
+/// z-position of all objects
+static constexpr auto Z_POS = -1.0f;
+
+/// Number of objects ObjectArray reserves memory for by default.
+static constexpr auto DEFAULT_OBJECT_CAPACITY = 256u;
+
+/// Number of objects per job of the multithreaded ObjectArray::Animation().
+static constexpr auto ANIMATION_CHUNK_SIZE = 16384u;
+
+/// Threshold value separating "inside" and "outside" of the metaball field.
+static constexpr auto METABALL_THRESHOLD = 20.0f;
+
+/// Maximum absolute value the procedural noise adds to the metaball field,
+/// see GetRandomFieldValue() in fragment_head.glsl.
+static constexpr auto NOISE_FIELD_AMPLITUDE = 10.0f;
+
+/// Default influence radius of the compact metaball kernel.
+static constexpr auto DEFAULT_KERNEL_RADIUS = 0.5f;
+
+/// Default opening angle of the Barnes-Hut approximation, see Octree.
+static constexpr auto DEFAULT_OPENING_ANGLE = 0.5f;
+
+/// Sphere radius of the distance field; sqrt(1 / METABALL_THRESHOLD), the
+/// iso-surface radius of an isolated metaball.
+static constexpr auto SDF_SPHERE_RADIUS = 0.2236068f;
+
+/// Default distance over which the smooth minimum blends two spheres.
+static constexpr auto DEFAULT_BLEND_DISTANCE = 0.2f;
+
+/// Vector to the directional light source; normalized by GetLightDir() in
+/// fragment_head.glsl.
+static const glm::vec3 LIGHT_VECTOR{-0.2f, 1.0f, 1.0f};
+
+/// Edge lengths in pixels of the tiles of the cone prepass, from coarse to
+/// fine; each divides the one before. See SceneSettings::_conePrepass.
+static constexpr auto         CONE_LEVELS                  = 2u;
+static constexpr unsigned int CONE_TILE_SIZES[CONE_LEVELS] = {8u, 4u};
+
+//---------------------------------------------------------------------------
+/// Memory layout of the object data.
+//---------------------------------------------------------------------------
+enum class ObjectLayout : unsigned int
+{
+    AOS = 0, ///< interleaved glm::vec3 arrays, see GetPositionData().
+    SOA = 1  ///< separate, SIMD padded arrays, see GetComponentData().
+};
+
+//---------------------------------------------------------------------------
+/// Components of the object data stored with ObjectLayout::SOA.
+//---------------------------------------------------------------------------
+enum class ObjectComponent : unsigned int
+{
+    X = 0,
+    Y = 1,
+    Z = 2,
+    R = 3,
+    G = 4,
+    B = 5
+};
+
+/// Number of values of ObjectComponent.
+static constexpr auto OBJECT_COMPONENT_COUNT = 6u;
+
+//---------------------------------------------------------------------------
+/// Utility class storing all information on the scene objects.
+//---------------------------------------------------------------------------
+class ObjectArray
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor
+    /// @param[in]  layout      The memory layout.
+    /// @param[in]  capacity    The number of objects to reserve memory for.
+    //---------------------------------------------------------------------------
+    explicit ObjectArray(ObjectLayout layout   = ObjectLayout::AOS,
+                         unsigned int capacity = DEFAULT_OBJECT_CAPACITY);
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~ObjectArray();
+
+    //---------------------------------------------------------------------------
+    /// Adds an object to the scene.
+    /// @param[in]  pos     The object position.
+    /// @param[in]  color   The object color.
+    /// @param[out] index   The new object index.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool AddObject(glm::vec3& pos, glm::vec3& color, int& index);
+
+    //---------------------------------------------------------------------------
+    /// Adds an object to the scene.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool AddObject();
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of objects in the scene
+    /// @return             The number of objects.
+    //---------------------------------------------------------------------------
+    unsigned int GetObjectCount() const;
+
+    //---------------------------------------------------------------------------
+    /// Sets the maximum number of objects. AddObject() fails if the limit is
+    /// reached. By default the number of objects is unlimited.
+    /// @param[in]  count   The maximum number of objects.
+    //---------------------------------------------------------------------------
+    void SetMaxObjectCount(unsigned int count);
+
+    //---------------------------------------------------------------------------
+    /// Returns the maximum number of objects.
+    /// @return             The maximum number of objects.
+    //---------------------------------------------------------------------------
+    unsigned int GetMaxObjectCount() const;
+
+    //---------------------------------------------------------------------------
+    /// Sets the position of the dynamic, user controlled object.
+    /// @param[in]  x       The x-coordinate.
+    /// @param[int] y       The y-coordinate.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool SetDynamicObject(float x, float y);
+
+    //---------------------------------------------------------------------------
+    /// Removes the last object from the scene.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool RemoveLastObject();
+
+    //---------------------------------------------------------------------------
+    /// Returns the memory layout.
+    /// @return             The layout.
+    //---------------------------------------------------------------------------
+    ObjectLayout GetLayout() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the size of the arrays accessed with GetPositionData() and
+    /// GetColorData().
+    /// @return             The size of the arrays.
+    //---------------------------------------------------------------------------
+    int GetDataSize() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the array containing position data.
+    /// @return             The position data; nullptr with ObjectLayout::SOA.
+    //---------------------------------------------------------------------------
+    glm::vec3* GetPositionData();
+
+    //---------------------------------------------------------------------------
+    /// Returns the array containing position data.
+    /// @return             The position data; nullptr with ObjectLayout::SOA.
+    //---------------------------------------------------------------------------
+    const glm::vec3* GetPositionData() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the array containing color data.
+    /// @return             The color data; nullptr with ObjectLayout::SOA.
+    //---------------------------------------------------------------------------
+    glm::vec3* GetColorData();
+
+    //---------------------------------------------------------------------------
+    /// Returns the array containing color data.
+    /// @return             The color data; nullptr with ObjectLayout::SOA.
+    //---------------------------------------------------------------------------
+    const glm::vec3* GetColorData() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the position of the given object; works with both layouts.
+    /// @param[in]  i       The object index.
+    /// @return             The position.
+    //---------------------------------------------------------------------------
+    glm::vec3 GetPosition(int i) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the color of the given object; works with both layouts.
+    /// @param[in]  i       The object index.
+    /// @return             The color.
+    //---------------------------------------------------------------------------
+    glm::vec3 GetColor(int i) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the distance between two components in the array returned by
+    /// GetSoAData(). The stride is a multiple of SIMD_WIDTH; the values past
+    /// the object count are padding and may be loaded but not used.
+    /// @return             The stride; 0 with ObjectLayout::AOS.
+    //---------------------------------------------------------------------------
+    unsigned int GetStride() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the SIMD aligned array of the given component. Only available
+    /// with ObjectLayout::SOA.
+    /// @param[in]  component   The component.
+    /// @return                 The array; the size is the object count.
+    //---------------------------------------------------------------------------
+    FloatSpan GetComponentData(ObjectComponent component) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns all components in one block, ordered as in ObjectComponent and
+    /// GetStride() floats apart. Only available with ObjectLayout::SOA.
+    /// @return             The array.
+    //---------------------------------------------------------------------------
+    FloatSpan GetSoAData() const;
+
+    //---------------------------------------------------------------------------
+    /// Sets the number of threads of Animation(); each moves chunks of
+    /// ANIMATION_CHUNK_SIZE objects. By default the calling thread animates
+    /// all objects.
+    /// @param[in]  count   The number of threads. 0 to use all cores.
+    //---------------------------------------------------------------------------
+    void SetThreadCount(unsigned int count);
+
+    //---------------------------------------------------------------------------
+    /// Animates the scene. Every object moves a step toward its orbit, or
+    /// toward the close user object; the orbits use FastSinCos(). Sets the
+    /// colors to a color wheel if the object count changed. The loops over
+    /// the objects vectorize, best with ObjectLayout::SOA.
+    /// @param[in]  step        The current animation step.
+    //---------------------------------------------------------------------------
+    void Animation(float step);
+
+private:
+    //---------------------------------------------------------------------------
+    /// Appends an object.
+    /// @param[in]  pos     The object position.
+    /// @param[in]  color   The object color.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool PushObject(const glm::vec3& pos, const glm::vec3& color);
+
+    //---------------------------------------------------------------------------
+    /// Reserves memory for the given number of objects.
+    /// @param[in]  capacity    The number of objects.
+    //---------------------------------------------------------------------------
+    void Reserve(unsigned int capacity);
+
+    void SetPosition(int i, const glm::vec3& pos);
+    void SetColor(int i, const glm::vec3& color);
+
+    ObjectLayout           _layout;      ///> memory layout.
+    int                    _count;       ///> number of elements.
+    unsigned int           _maxCount;    ///> maximum number of elements.
+    std::vector<glm::vec3> _pos;         ///> position information (AOS).
+    std::vector<glm::vec3> _colors;      ///> color information (AOS).
+    AlignedFloatArray      _soa;         ///> all components (SOA).
+    unsigned int           _stride;      ///> distance between components (SOA).
+    glm::vec3              _userObject;  ///> position of the user object.
+    unsigned int           _threadCount; ///> see SetThreadCount().
+    bool _countChanged; ///> True if the number of elements has changed. Reset
+                        /// Animation().
+};
+
+enum class NoiseMode : unsigned int
+{
+    NOISE    = 1,
+    NO_NOISE = 2
+};
+
+//---------------------------------------------------------------------------
+/// Function describing the influence of a single metaball.
+//---------------------------------------------------------------------------
+enum class MetaballKernel : unsigned int
+{
+    INVERSE_SQUARE = 0, ///< 1/r^2; every metaball influences every point.
+    WYVILL         = 1, ///< (1 - r^2/R^2)^3; zero beyond the radius R.
+    SMOOTH_MIN     = 2  ///< signed distance to spheres joined with a
+                        ///< polynomial smooth minimum; sphere traced.
+};
+
+//---------------------------------------------------------------------------
+/// Returns the scale of the compact kernel. An isolated metaball has the same
+/// iso-surface radius with both kernels.
+/// @param[in]  radius  The influence radius R. Must be larger than the
+/// iso-surface radius sqrt(1 / METABALL_THRESHOLD).
+/// @return             The scale factor.
+//---------------------------------------------------------------------------
+inline float GetWyvillScale(float radius)
+{
+    const auto isoRadiusSq = 1.0f / METABALL_THRESHOLD;
+    const auto f           = 1.0f - isoRadiusSq / (radius * radius);
+    return METABALL_THRESHOLD / (f * f * f);
+}
+
+//---------------------------------------------------------------------------
+/// General scene settings.
+//---------------------------------------------------------------------------
+struct SceneSettings
+{
+    bool         _timeStep;
+    unsigned int _renderMode;
+    float        _timeOff;
+    float        _dynamicObjectX;
+    float        _dynamicObjectY;
+    NoiseMode    _noise;
+    bool         _addObjectClick;
+    bool         _removeObject;
+    bool         _addObject;
+
+    MetaballKernel _kernel        = MetaballKernel::INVERSE_SQUARE;
+    float          _kernelRadius  = DEFAULT_KERNEL_RADIUS;
+    float          _blendDistance = DEFAULT_BLEND_DISTANCE;
+
+    /// Opening angle of the Barnes-Hut approximation of the inverse square
+    /// kernel; 0 evaluates every metaball.
+    float _openingAngle = 0.0f;
+
+    /// Finds the surface of the exact inverse square field by subdividing the
+    /// rays into intervals with bounded field values instead of stepping.
+    bool _intervalRays = false;
+
+    /// Starts the primary rays close to the hit of the previous frame, see
+    /// ReprojectionHistory.
+    bool _reprojection = false;
+
+    /// Starts the primary rays at the distances of a cone march over coarse
+    /// tiles of the image, see CONE_TILE_SIZES and ConeMarch() in
+    /// cpushader.h.
+    bool _conePrepass = false;
+
+    /// Number of texels per edge of the shadow map, see ShadowMap; 0 marches
+    /// a shadow ray per shaded pixel instead.
+    unsigned int _shadowMapSize = 0;
+
+    /// Number of voxels per edge of the light volume, see LightVolume; 0
+    /// marches toward the light per shaded pixel instead.
+    unsigned int _lightVolumeSize = 0;
+
+    /// Number of texels per edge of the ground map, see GroundMap; 0 marches
+    /// up from every ground pixel instead.
+    unsigned int _groundMapSize = 0;
+
+    /// Number of voxels per edge of the baked metaball field, see
+    /// DensityVolume; a multiple of DENSITY_BRICK_SIZE. 0 evaluates the field
+    /// from the centers at every sample instead.
+    unsigned int _densityVolumeSize = 0;
+
+    /// Number of voxels per edge of the 3D noise volume, see noise.h; 0
+    /// samples the 2D noise slice instead.
+    unsigned int _noiseVolumeSize = 0;
+
+    /// Searches the surfaces of the frame first and shades them in a second
+    /// pass; otherwise every pixel searches and shades in one pass.
+    bool _deferredShading = false;
+
+    unsigned int GetNoise() const
+    {
+        if (_noise == NoiseMode::NOISE)
+            return 1u;
+        return 0u;
+    }
+};
+
+//---------------------------------------------------------------------------
+/// Returns the axis aligned box containing every point where the metaball
+/// field can reach METABALL_THRESHOLD. The box of the centers is padded by
+/// the influence radius of the compact kernel, or by sqrt(N / (T - noise))
+/// for the inverse square kernel: outside of it N metaballs sum up to less
+/// than T - noise. The smooth minimum is at most a quarter of the blend
+/// distance below the minimum, which pads the sphere radius.
+/// Rays only have to be sampled inside the box.
+/// @param[in]  objects     The metaballs.
+/// @param[in]  settings    The scene settings.
+/// @param[out] boundsMin   The minimum corner. Larger than boundsMax if
+/// there are no objects.
+/// @param[out] boundsMax   The maximum corner.
+//---------------------------------------------------------------------------
+void GetFieldBounds(const ObjectArray& objects, const SceneSettings& settings,
+                    glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+#endif // VOLUME_DEMO_SCENE_H__
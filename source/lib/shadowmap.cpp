@@ -0,0 +1,133 @@
+#include "shadowmap.h"
+#include "log.h"
+
+#include <algorithm>
+
+ShadowMap::ShadowMap()
+{
+    _origin    = glm::vec3(0.0f);
+    _edge[0]   = glm::vec3(0.0f);
+    _edge[1]   = glm::vec3(0.0f);
+    _axis[0]   = glm::vec3(0.0f);
+    _axis[1]   = glm::vec3(0.0f);
+    _lightDir  = glm::vec3(0.0f, 1.0f, 0.0f);
+    _rayLength = 0.0f;
+    _bias      = SHADOW_MAP_BIAS;
+    _size      = 0;
+}
+
+ShadowMap::~ShadowMap() = default;
+
+bool ShadowMap::Fit(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                    const glm::vec3& lightDir, unsigned int size)
+{
+    if (IsNull(size, MSG_INFO("Invalid shadow map size.")))
+        return false;
+
+    _lightDir = lightDir;
+    _size     = size;
+    _depths.assign(size_t(size) * size, SHADOW_MAP_NO_HIT);
+
+    // orthonormal light space; the light is not parallel to the z axis
+    const auto u = glm::normalize(glm::cross(glm::vec3(0.0f, 0.0f, 1.0f),
+                                             lightDir));
+    const auto v = glm::cross(lightDir, u);
+
+    auto lo = boundsMin;
+    auto hi = boundsMax;
+
+    // nothing casts a shadow
+    if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z)
+    {
+        lo = glm::vec3(0.0f);
+        hi = glm::vec3(1.0f);
+    }
+
+    // light space extent of the box corners
+    glm::vec3 minCoord(1e30f);
+    glm::vec3 maxCoord(-1e30f);
+
+    for (auto i = 0; i < 8; ++i)
+    {
+        const glm::vec3 corner((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y,
+                               (i & 4) ? hi.z : lo.z);
+        const glm::vec3 coord(glm::dot(corner, u), glm::dot(corner, v),
+                              glm::dot(corner, lightDir));
+
+        minCoord = glm::min(minCoord, coord);
+        maxCoord = glm::max(maxCoord, coord);
+    }
+
+    // the rays start in front of the box and end behind it
+    const auto margin = SHADOW_MAP_STEP;
+
+    _edge[0]   = u * ((maxCoord.x - minCoord.x) / float(size));
+    _edge[1]   = v * ((maxCoord.y - minCoord.y) / float(size));
+    _axis[0]   = u * (float(size) / std::max(maxCoord.x - minCoord.x, 1e-6f));
+    _axis[1]   = v * (float(size) / std::max(maxCoord.y - minCoord.y, 1e-6f));
+    _origin    = u * minCoord.x + v * minCoord.y +
+                 lightDir * (maxCoord.z + margin);
+    _rayLength = maxCoord.z - minCoord.z + margin * 2.0f;
+    _bias      = SHADOW_MAP_BIAS + glm::length(_edge[0] + _edge[1]);
+
+    return true;
+}
+
+glm::vec3 ShadowMap::GetRayStart(unsigned int x, unsigned int y) const
+{
+    return _origin + _edge[0] * (float(x) + 0.5f) +
+           _edge[1] * (float(y) + 0.5f);
+}
+
+float ShadowMap::GetRayLength() const
+{
+    return _rayLength;
+}
+
+void ShadowMap::SetDepth(unsigned int x, unsigned int y, float depth)
+{
+    if (x >= _size || y >= _size)
+        return;
+
+    _depths[size_t(y) * _size + x] = depth;
+}
+
+bool ShadowMap::IsShadowed(const glm::vec3& pos) const
+{
+    const auto rel = pos - _origin;
+    const auto x   = glm::dot(rel, _axis[0]);
+    const auto y   = glm::dot(rel, _axis[1]);
+
+    // nothing outside of the bounds
+    if (x < 0.0f || y < 0.0f || x >= float(_size) || y >= float(_size))
+        return false;
+
+    const auto depth = -glm::dot(rel, _lightDir);
+
+    return _depths[size_t(y) * _size + size_t(x)] < depth - _bias;
+}
+
+const glm::vec3& ShadowMap::GetOrigin() const
+{
+    return _origin;
+}
+
+const glm::vec3& ShadowMap::GetTexelEdge(int axis) const
+{
+    return _edge[axis];
+}
+
+const glm::vec3& ShadowMap::GetTexelAxis(int axis) const
+{
+    return _axis[axis];
+}
+
+unsigned int ShadowMap::GetSize() const
+{
+    return _size;
+}
+
+float ShadowMap::GetBias() const
+{
+    return _bias;
+}
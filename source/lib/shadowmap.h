@@ -0,0 +1,131 @@
+#ifndef VOLUME_DEMO_SHADOWMAP_H__
+#define VOLUME_DEMO_SHADOWMAP_H__
+
+#include "glm/glm.hpp"
+#include <vector>
+
+/// Default number of texels per edge of the shadow map, see
+/// SceneSettings::_shadowMapSize.
+static constexpr auto DEFAULT_SHADOW_MAP_SIZE = 256u;
+
+/// Length of the steps of the shadow rays of the map.
+static constexpr auto SHADOW_MAP_STEP = 0.05f;
+
+/// Depth of a texel whose shadow ray does not hit the surface.
+static constexpr auto SHADOW_MAP_NO_HIT = 1e10f;
+
+/// Depth difference below which a surface does not shadow itself, in
+/// addition to the slope across a texel; the per-pixel shadow rays start
+/// one step of 0.05 away from the surface. See ShadowMap::GetBias().
+static constexpr auto SHADOW_MAP_BIAS = 0.05f;
+
+//---------------------------------------------------------------------------
+/// Depth map of the metaball surface seen from the directional light. The
+/// map is fitted to the field bounds every frame; each texel stores the
+/// distance from the plane in front of the bounds to the first surface hit
+/// along the shadow ray through the texel center. A position is in shadow
+/// if its depth is larger than the depth of its texel.
+//---------------------------------------------------------------------------
+class ShadowMap
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    ShadowMap();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~ShadowMap();
+
+    //---------------------------------------------------------------------------
+    /// Fits the map to the given bounds and resets the depths. An empty box
+    /// gives a map without occluders.
+    /// @param[in]  boundsMin   Lower corner of the field bounds.
+    /// @param[in]  boundsMax   Upper corner of the field bounds.
+    /// @param[in]  lightDir    Normalized vector to the light source.
+    /// @param[in]  size        Number of texels per edge.
+    /// @return                 False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Fit(const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+             const glm::vec3& lightDir, unsigned int size);
+
+    //---------------------------------------------------------------------------
+    /// Returns the start of the shadow ray of a texel; the ray runs away from
+    /// the light.
+    /// @param[in]  x       The texel column.
+    /// @param[in]  y       The texel row.
+    /// @return             The start position in world space.
+    //---------------------------------------------------------------------------
+    glm::vec3 GetRayStart(unsigned int x, unsigned int y) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the length of the shadow rays; they end behind the bounds.
+    /// @return             The length in world units.
+    //---------------------------------------------------------------------------
+    float GetRayLength() const;
+
+    //---------------------------------------------------------------------------
+    /// Stores the depth of a texel.
+    /// @param[in]  x       The texel column.
+    /// @param[in]  y       The texel row.
+    /// @param[in]  depth   Distance from the ray start to the surface;
+    /// SHADOW_MAP_NO_HIT if the ray does not hit.
+    //---------------------------------------------------------------------------
+    void SetDepth(unsigned int x, unsigned int y, float depth);
+
+    //---------------------------------------------------------------------------
+    /// Tests if a position is shadowed by the surface.
+    /// @param[in]  pos     World space position.
+    /// @return             True if a surface lies between the position and
+    /// the light.
+    //---------------------------------------------------------------------------
+    bool IsShadowed(const glm::vec3& pos) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the ray start of the lower left corner of the map.
+    /// @return             The position in world space.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetOrigin() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the edge of a texel along the given map axis.
+    /// @param[in]  axis    The axis (0 or 1).
+    /// @return             The edge in world space.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetTexelEdge(int axis) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the vector whose dot product with the offset of a position to
+    /// GetOrigin() is the texel coordinate along the given map axis.
+    /// @param[in]  axis    The axis (0 or 1).
+    /// @return             The vector in world space.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetTexelAxis(int axis) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of texels per edge.
+    /// @return             The size; 0 before Fit().
+    //---------------------------------------------------------------------------
+    unsigned int GetSize() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the depth bias of IsShadowed(): SHADOW_MAP_BIAS plus the depth
+    /// change of a surface at 45 degrees across a texel diagonal.
+    /// @return             The bias in world units.
+    //---------------------------------------------------------------------------
+    float GetBias() const;
+
+private:
+    glm::vec3          _origin;    ///< ray start of the lower left corner.
+    glm::vec3          _edge[2];   ///< texel edges in world space.
+    glm::vec3          _axis[2];   ///< inverse of the texel edges.
+    glm::vec3          _lightDir;  ///< normalized vector to the light.
+    float              _rayLength; ///< length of the shadow rays.
+    float              _bias;      ///< see GetBias().
+    unsigned int       _size;      ///< texels per edge.
+    std::vector<float> _depths;    ///< depth per texel, rows bottom to top.
+};
+
+#endif // VOLUME_DEMO_SHADOWMAP_H__
@@ -0,0 +1,158 @@
+#include "spatialgrid.h"
+#include "log.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid()
+{
+    _min      = glm::vec3(0.0f);
+    _cellSize = 1.0f;
+    _dim[0]   = 0;
+    _dim[1]   = 0;
+    _dim[2]   = 0;
+}
+
+SpatialGrid::~SpatialGrid() = default;
+
+bool SpatialGrid::Build(const ObjectArray& objects, float radius)
+{
+    if (IsFalse(radius > 0.0f, MSG_INFO("Invalid radius.")))
+        return false;
+
+    const auto count = int(objects.GetObjectCount());
+
+    _cells.clear();
+    _indices.clear();
+    _dim[0] = 0;
+    _dim[1] = 0;
+    _dim[2] = 0;
+
+    if (count == 0)
+        return true;
+
+    // bounds of all influence spheres
+    auto minPos = objects.GetPosition(0);
+    auto maxPos = minPos;
+
+    for (auto i = 1; i < count; ++i)
+    {
+        const auto pos = objects.GetPosition(i);
+        minPos         = glm::min(minPos, pos);
+        maxPos         = glm::max(maxPos, pos);
+    }
+
+    _min              = minPos - glm::vec3(radius);
+    const auto size   = (maxPos - minPos) + glm::vec3(radius * 2.0f);
+    const auto extent = std::max(size.x, std::max(size.y, size.z));
+
+    // cells not smaller than the radius and not more than the maximum; the
+    // slack keeps rounding from cutting off the last cell
+    const auto minCellSize = (extent * 1.001f) / float(MAX_GRID_DIMENSION);
+    _cellSize              = std::max(radius, minCellSize);
+
+    for (auto a = 0; a < 3; ++a)
+    {
+        const auto cells = int(std::ceil(size[a] / _cellSize));
+        _dim[a]          = std::min(std::max(cells, 1), MAX_GRID_DIMENSION);
+    }
+
+    const auto cellCount = _dim[0] * _dim[1] * _dim[2];
+    _cells.assign(size_t(cellCount) * 2, 0);
+
+    // calls f(cell) for every cell overlapped by the sphere of the object
+    auto forEachCell = [&](int i, auto&& f)
+    {
+        const auto pos = objects.GetPosition(i);
+
+        int lo[3];
+        int hi[3];
+        for (auto a = 0; a < 3; ++a)
+        {
+            const auto l = (pos[a] - radius - _min[a]) / _cellSize;
+            const auto h = (pos[a] + radius - _min[a]) / _cellSize;
+            lo[a]        = std::max(int(std::floor(l)), 0);
+            hi[a]        = std::min(int(std::floor(h)), _dim[a] - 1);
+        }
+
+        for (auto z = lo[2]; z <= hi[2]; ++z)
+            for (auto y = lo[1]; y <= hi[1]; ++y)
+                for (auto x = lo[0]; x <= hi[0]; ++x)
+                    f((z * _dim[1] + y) * _dim[0] + x);
+    };
+
+    // count entries per cell
+    for (auto i = 0; i < count; ++i)
+        forEachCell(i, [&](int cell) { _cells[cell * 2 + 1]++; });
+
+    // prefix sum
+    auto offset = 0;
+    for (auto cell = 0; cell < cellCount; ++cell)
+    {
+        _cells[cell * 2] = offset;
+        offset += _cells[cell * 2 + 1];
+        _cells[cell * 2 + 1] = 0;
+    }
+
+    // fill
+    _indices.resize(offset);
+
+    for (auto i = 0; i < count; ++i)
+    {
+        forEachCell(i,
+                    [&](int cell)
+                    {
+                        auto& cellCnt = _cells[cell * 2 + 1];
+                        _indices[_cells[cell * 2] + cellCnt] = i;
+                        cellCnt++;
+                    });
+    }
+
+    return true;
+}
+
+const int* SpatialGrid::FindCell(const glm::vec3& pos,
+                                 unsigned int&    count) const
+{
+    count = 0;
+
+    int c[3];
+    for (auto a = 0; a < 3; ++a)
+    {
+        const auto f = std::floor((pos[a] - _min[a]) / _cellSize);
+        if (f < 0.0f || f >= float(_dim[a]))
+            return nullptr;
+        c[a] = int(f);
+    }
+
+    const auto cell = (c[2] * _dim[1] + c[1]) * _dim[0] + c[0];
+    count           = unsigned(_cells[cell * 2 + 1]);
+
+    return _indices.data() + _cells[cell * 2];
+}
+
+const glm::vec3& SpatialGrid::GetMin() const
+{
+    return _min;
+}
+
+float SpatialGrid::GetCellSize() const
+{
+    return _cellSize;
+}
+
+int SpatialGrid::GetDimension(int axis) const
+{
+    return _dim[axis];
+}
+
+const std::vector<int>& SpatialGrid::GetCells() const
+{
+    return _cells;
+}
+
+const std::vector<int>& SpatialGrid::GetIndices() const
+{
+    return _indices;
+}
@@ -0,0 +1,88 @@
+#ifndef VOLUME_DEMO_SPATIALGRID_H__
+#define VOLUME_DEMO_SPATIALGRID_H__
+
+#include "glm/glm.hpp"
+#include <vector>
+
+class ObjectArray;
+
+/// Maximum number of grid cells along one axis.
+static constexpr auto MAX_GRID_DIMENSION = 64;
+
+//---------------------------------------------------------------------------
+/// Uniform grid over the metaball centers. Each cell lists all metaballs
+/// whose influence sphere overlaps the cell, so a field evaluation only has to
+/// visit the cell containing the sample point. Used with the compact
+/// MetaballKernel::WYVILL kernel; rebuilt every frame.
+//---------------------------------------------------------------------------
+class SpatialGrid
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    SpatialGrid();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~SpatialGrid();
+
+    //---------------------------------------------------------------------------
+    /// Builds the grid.
+    /// @param[in]  objects The metaballs.
+    /// @param[in]  radius  The influence radius of a metaball.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Build(const ObjectArray& objects, float radius);
+
+    //---------------------------------------------------------------------------
+    /// Returns the metaballs influencing the given position.
+    /// @param[in]  pos     World space position.
+    /// @param[out] count   The number of metaballs.
+    /// @return             The metaball indices; nullptr if the position is
+    /// outside of the grid.
+    //---------------------------------------------------------------------------
+    const int* FindCell(const glm::vec3& pos, unsigned int& count) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the minimum corner of the grid.
+    /// @return             The minimum corner in world space.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetMin() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the edge length of a cell.
+    /// @return             The edge length.
+    //---------------------------------------------------------------------------
+    float GetCellSize() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of cells along the given axis.
+    /// @param[in]  axis    The axis (0, 1 or 2).
+    /// @return             The number of cells.
+    //---------------------------------------------------------------------------
+    int GetDimension(int axis) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the cell array. Two values per cell: the offset into the index
+    /// array and the number of indices. Cells are ordered x, then y, then z.
+    /// @return             The cell array.
+    //---------------------------------------------------------------------------
+    const std::vector<int>& GetCells() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the index array referenced by the cells.
+    /// @return             The index array.
+    //---------------------------------------------------------------------------
+    const std::vector<int>& GetIndices() const;
+
+private:
+    glm::vec3        _min;      ///< minimum corner.
+    float            _cellSize; ///< edge length of a cell.
+    int              _dim[3];   ///< number of cells per axis.
+    std::vector<int> _cells;    ///< offset and count per cell.
+    std::vector<int> _indices;  ///< metaball indices.
+};
+
+#endif // VOLUME_DEMO_SPATIALGRID_H__
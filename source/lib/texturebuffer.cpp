@@ -0,0 +1,79 @@
+#include "texturebuffer.h"
+
+#include "log.h"
+
+#include "glad/glad.h"
+
+TextureBuffer::TextureBuffer()
+{
+    _buffer  = 0;
+    _texture = 0;
+    _size    = 0;
+}
+
+TextureBuffer::~TextureBuffer() {}
+
+bool TextureBuffer::Init(unsigned int unit, unsigned int format)
+{
+    if (IsNotValue(_buffer, 0U, MSG_INFO("Buffer already created.")))
+        return false;
+
+    glGenBuffers(1, &_buffer);
+    if (IsNull(_buffer, MSG_INFO("Could not create OGL buffer.")))
+        return false;
+
+    glGenTextures(1, &_texture);
+    if (IsNull(_texture, MSG_INFO("Could not create OGL texture.")))
+        return false;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, _texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, _buffer);
+    glActiveTexture(GL_TEXTURE0);
+
+    return true;
+}
+
+bool TextureBuffer::Upload(const void* data, size_t size)
+{
+    if (IsNull(_buffer, MSG_INFO("Buffer not set.")))
+        return false;
+
+    // nothing to do; shaders must not access empty buffers
+    if (size == 0)
+        return true;
+
+    if (IsNullptr(data, MSG_INFO("Invalid data.")))
+        return false;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+
+    if (size > _size)
+    {
+        // grow
+        glBufferData(GL_TEXTURE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+        _size = size;
+    }
+    else
+    {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    return true;
+}
+
+void TextureBuffer::Close()
+{
+    glDeleteTextures(1, &_texture);
+    glDeleteBuffers(1, &_buffer);
+
+    _texture = 0;
+    _buffer  = 0;
+    _size    = 0;
+}
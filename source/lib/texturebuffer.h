@@ -0,0 +1,53 @@
+#ifndef VOLUME_DEMO_TEXTUREBUFFER_H__
+#define VOLUME_DEMO_TEXTUREBUFFER_H__
+
+#include <cstddef>
+
+//---------------------------------------------------------------------------
+/// A TextureBuffer represents an OpenGL buffer object accessed in shaders as
+/// a texture buffer (samplerBuffer). The texture stays bound to its texture
+/// unit.
+//---------------------------------------------------------------------------
+class TextureBuffer
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    TextureBuffer();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~TextureBuffer();
+
+    //---------------------------------------------------------------------------
+    /// Creates the buffer and the texture and binds the texture to the given
+    /// texture unit.
+    /// @param[in]  unit    The texture unit.
+    /// @param[in]  format  The internal format, e.g. GL_R32F.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Init(unsigned int unit, unsigned int format);
+
+    //---------------------------------------------------------------------------
+    /// Copies the given data into the buffer. The buffer is only reallocated
+    /// if it is too small.
+    /// @param[in]  data    The data.
+    /// @param[in]  size    The size of the data in bytes.
+    /// @return             False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Upload(const void* data, size_t size);
+
+    //---------------------------------------------------------------------------
+    /// Frees the OpenGL resources.
+    //---------------------------------------------------------------------------
+    void Close();
+
+private:
+    unsigned int _buffer;  ///< buffer ID.
+    unsigned int _texture; ///< texture ID.
+    size_t       _size;    ///< allocated size of the buffer.
+};
+
+#endif // VOLUME_DEMO_TEXTUREBUFFER_H__
@@ -0,0 +1,168 @@
+#include "tilelists.h"
+#include "log.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+
+TileLists::TileLists()
+{
+    _origin   = glm::vec3(0.0f);
+    _tileSize = 1.0f;
+    _count[0] = 0;
+    _count[1] = 0;
+}
+
+TileLists::~TileLists() = default;
+
+bool TileLists::Build(const ObjectArray& objects, float radius,
+                      const glm::vec3& camPos, const glm::vec3& planeOrigin,
+                      const glm::vec2& planeSize)
+{
+    if (IsFalse(radius > 0.0f, MSG_INFO("Invalid radius.")))
+        return false;
+    if (IsFalse(camPos.z > planeOrigin.z,
+                MSG_INFO("Camera must be in front of the view plane.")))
+        return false;
+
+    _origin   = planeOrigin;
+    _tileSize = planeSize.x / float(TILE_COUNT_X);
+    _count[0] = TILE_COUNT_X;
+    _count[1] = std::max(int(std::ceil(planeSize.y / _tileSize)), 1);
+
+    const auto tileCount = _count[0] * _count[1];
+    _tiles.assign(size_t(tileCount) * 2, 0);
+    _indices.clear();
+
+    const auto count = int(objects.GetObjectCount());
+    const auto r     = radius + TILE_PADDING;
+
+    // tile range covered by the projection of the influence sphere; the
+    // projection of its bounding box contains the projection of the sphere
+    auto getRange = [&](int i, int* lo, int* hi)
+    {
+        const auto pos = objects.GetPosition(i);
+
+        glm::vec2 minPos(0.0f);
+        glm::vec2 maxPos(0.0f);
+
+        if (pos.z + r >= camPos.z)
+        {
+            // reaches behind the camera; all tiles
+            lo[0] = 0;
+            lo[1] = 0;
+            hi[0] = _count[0] - 1;
+            hi[1] = _count[1] - 1;
+            return;
+        }
+
+        for (auto corner = 0; corner < 8; ++corner)
+        {
+            const glm::vec3 p(pos.x + ((corner & 1) ? r : -r),
+                              pos.y + ((corner & 2) ? r : -r),
+                              pos.z + ((corner & 4) ? r : -r));
+
+            // intersection of the line camera - p with the view plane
+            const auto s = (camPos.z - planeOrigin.z) / (camPos.z - p.z);
+            const glm::vec2 q(camPos.x + (p.x - camPos.x) * s,
+                              camPos.y + (p.y - camPos.y) * s);
+
+            minPos = corner == 0 ? q : glm::min(minPos, q);
+            maxPos = corner == 0 ? q : glm::max(maxPos, q);
+        }
+
+        for (auto a = 0; a < 2; ++a)
+        {
+            const auto l = (minPos[a] - planeOrigin[a]) / _tileSize;
+            const auto h = (maxPos[a] - planeOrigin[a]) / _tileSize;
+            lo[a]        = std::max(int(std::floor(l)), 0);
+            hi[a]        = std::min(int(std::floor(h)), _count[a] - 1);
+        }
+    };
+
+    // calls f(tile) for every tile overlapped by the object
+    auto forEachTile = [&](int i, auto&& f)
+    {
+        int lo[2];
+        int hi[2];
+        getRange(i, lo, hi);
+
+        for (auto y = lo[1]; y <= hi[1]; ++y)
+            for (auto x = lo[0]; x <= hi[0]; ++x)
+                f(y * _count[0] + x);
+    };
+
+    // count entries per tile
+    for (auto i = 0; i < count; ++i)
+        forEachTile(i, [&](int tile) { _tiles[tile * 2 + 1]++; });
+
+    // prefix sum
+    auto offset = 0;
+    for (auto tile = 0; tile < tileCount; ++tile)
+    {
+        _tiles[tile * 2] = offset;
+        offset += _tiles[tile * 2 + 1];
+        _tiles[tile * 2 + 1] = 0;
+    }
+
+    // fill
+    _indices.resize(offset);
+
+    for (auto i = 0; i < count; ++i)
+    {
+        forEachTile(i,
+                    [&](int tile)
+                    {
+                        auto& tileCnt = _tiles[tile * 2 + 1];
+                        _indices[_tiles[tile * 2] + tileCnt] = i;
+                        tileCnt++;
+                    });
+    }
+
+    return true;
+}
+
+int TileLists::FindTile(const glm::vec3& pos) const
+{
+    int t[2];
+    for (auto a = 0; a < 2; ++a)
+    {
+        const auto f = std::floor((pos[a] - _origin[a]) / _tileSize);
+        if (f < 0.0f || f >= float(_count[a]))
+            return -1;
+        t[a] = int(f);
+    }
+
+    return t[1] * _count[0] + t[0];
+}
+
+const int* TileLists::GetTile(int tile, unsigned int& count) const
+{
+    count = unsigned(_tiles[tile * 2 + 1]);
+    return _indices.data() + _tiles[tile * 2];
+}
+
+const glm::vec3& TileLists::GetOrigin() const
+{
+    return _origin;
+}
+
+float TileLists::GetTileSize() const
+{
+    return _tileSize;
+}
+
+int TileLists::GetTileCount(int axis) const
+{
+    return _count[axis];
+}
+
+const std::vector<int>& TileLists::GetTiles() const
+{
+    return _tiles;
+}
+
+const std::vector<int>& TileLists::GetIndices() const
+{
+    return _indices;
+}
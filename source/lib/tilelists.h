@@ -0,0 +1,106 @@
+#ifndef VOLUME_DEMO_TILELISTS_H__
+#define VOLUME_DEMO_TILELISTS_H__
+
+#include "glm/glm.hpp"
+#include <vector>
+
+class ObjectArray;
+
+/// Number of tiles along the x axis of the view plane.
+static constexpr auto TILE_COUNT_X = 32;
+
+/// Distance the field is sampled away from the primary ray, e.g. to compute
+/// normals; added to the influence radius.
+static constexpr auto TILE_PADDING = 0.02f;
+
+//---------------------------------------------------------------------------
+/// Per-tile metaball lists for the primary rays. The view plane is divided
+/// into square tiles; each tile lists all metaballs whose influence sphere,
+/// projected from the camera onto the view plane, overlaps the tile. A
+/// primary ray starting in a tile stays inside the tile's frustum, so the
+/// field along the ray only depends on the tile's metaballs. Used with the
+/// compact MetaballKernel::WYVILL kernel; rebuilt every frame.
+//---------------------------------------------------------------------------
+class TileLists
+{
+public:
+    //---------------------------------------------------------------------------
+    /// Constructor.
+    //---------------------------------------------------------------------------
+    TileLists();
+
+    //---------------------------------------------------------------------------
+    /// Destructor.
+    //---------------------------------------------------------------------------
+    ~TileLists();
+
+    //---------------------------------------------------------------------------
+    /// Builds the lists.
+    /// @param[in]  objects     The metaballs.
+    /// @param[in]  radius      The influence radius of a metaball.
+    /// @param[in]  camPos      The camera position.
+    /// @param[in]  planeOrigin Lower left corner of the view plane. The plane
+    /// is parallel to the xy plane.
+    /// @param[in]  planeSize   Width and height of the view plane.
+    /// @return                 False if an error occurred.
+    //---------------------------------------------------------------------------
+    bool Build(const ObjectArray& objects, float radius,
+               const glm::vec3& camPos, const glm::vec3& planeOrigin,
+               const glm::vec2& planeSize);
+
+    //---------------------------------------------------------------------------
+    /// Returns the tile containing the given view plane position.
+    /// @param[in]  pos     World space position on the view plane.
+    /// @return             The tile index; -1 if outside of the view plane.
+    //---------------------------------------------------------------------------
+    int FindTile(const glm::vec3& pos) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the metaballs of the given tile.
+    /// @param[in]  tile    The tile index, see FindTile().
+    /// @param[out] count   The number of metaballs.
+    /// @return             The metaball indices.
+    //---------------------------------------------------------------------------
+    const int* GetTile(int tile, unsigned int& count) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the lower left corner of the view plane.
+    /// @return             The corner in world space.
+    //---------------------------------------------------------------------------
+    const glm::vec3& GetOrigin() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the edge length of a tile.
+    /// @return             The edge length.
+    //---------------------------------------------------------------------------
+    float GetTileSize() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the number of tiles along the given axis.
+    /// @param[in]  axis    The axis (0 or 1).
+    /// @return             The number of tiles.
+    //---------------------------------------------------------------------------
+    int GetTileCount(int axis) const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the tile array. Two values per tile: the offset into the index
+    /// array and the number of indices. Tiles are ordered x, then y.
+    /// @return             The tile array.
+    //---------------------------------------------------------------------------
+    const std::vector<int>& GetTiles() const;
+
+    //---------------------------------------------------------------------------
+    /// Returns the index array referenced by the tiles.
+    /// @return             The index array.
+    //---------------------------------------------------------------------------
+    const std::vector<int>& GetIndices() const;
+
+private:
+    glm::vec3        _origin;   ///< lower left corner of the view plane.
+    float            _tileSize; ///< edge length of a tile.
+    int              _count[2]; ///< number of tiles per axis.
+    std::vector<int> _tiles;    ///< offset and count per tile.
+    std::vector<int> _indices;  ///< metaball indices.
+};
+
+#endif // VOLUME_DEMO_TILELISTS_H__
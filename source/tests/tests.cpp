@@ -1,5 +1,108 @@
+#include "cpurenderer.h"
+#include "assetcache.h"
+#include "cpushader.h"
+#include "densityvolume.h"
+#include "fastmath.h"
+#include "fieldkernel.h"
+#include "groundmap.h"
+#include "lightvolume.h"
 #include "log.h"
+#include "noise.h"
+#include "octree.h"
+#include "parallel.h"
+#include "reprojection.h"
+#include "shadowmap.h"
+#include "spatialgrid.h"
+#include "tilelists.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <vector>
+#include <glm/gtx/color_space.hpp>
+
+//---------------------------------------------------------------------------
+/// Creates the default scene of RenderEngine::CreateScene() and animates it
+/// until the objects reached their orbit.
+//---------------------------------------------------------------------------
+static void CreateTestScene(ObjectArray& objects, unsigned int count)
+{
+    for (auto i = 0u; i < count; ++i)
+        objects.AddObject();
+
+    objects.SetDynamicObject(10.0f, 10.0f);
+
+    for (auto step = 0; step < 100; ++step)
+        objects.Animation(float(step));
+}
+
+//---------------------------------------------------------------------------
+/// Returns default scene settings.
+//---------------------------------------------------------------------------
+static SceneSettings GetTestSettings(unsigned int renderMode)
+{
+    SceneSettings settings{};
+    settings._renderMode = renderMode;
+    settings._noise      = NoiseMode::NO_NOISE;
+    return settings;
+}
+
+//---------------------------------------------------------------------------
+/// Returns uniform values for the given objects; the layout must be SOA.
+//---------------------------------------------------------------------------
+static CpuUniforms GetTestUniforms(const ObjectArray& objects)
+{
+    CpuUniforms u{};
+    u._centers._x     = objects.GetComponentData(ObjectComponent::X)._data;
+    u._centers._y     = objects.GetComponentData(ObjectComponent::Y)._data;
+    u._centers._z     = objects.GetComponentData(ObjectComponent::Z)._data;
+    u._centers._r     = objects.GetComponentData(ObjectComponent::R)._data;
+    u._centers._g     = objects.GetComponentData(ObjectComponent::G)._data;
+    u._centers._b     = objects.GetComponentData(ObjectComponent::B)._data;
+    u._centers._count = objects.GetObjectCount();
+    u._fieldKernel    = GetFieldKernel(SimdLevel::SCALAR);
+    u._kernel         = MetaballKernel::INVERSE_SQUARE;
+    u._tile           = -1;
+    u._blendDistance  = DEFAULT_BLEND_DISTANCE;
+    u._displacement   = -1.0f;
+
+    GetFieldBounds(objects, GetTestSettings(0), u._boundsMin, u._boundsMax);
+
+    return u;
+}
+
+TEST(ThreadPool, ParallelFor)
+{
+    // the workers of the first loop are reused by the later ones
+    for (const auto threads : {4u, 2u, 4u, 3u})
+    {
+        std::vector<std::atomic<int>> calls(1000);
+
+        ParallelFor(unsigned(calls.size()), threads,
+                    [&](unsigned int i) { calls[i]++; });
+
+        for (const auto& count : calls)
+            EXPECT_EQ(count.load(), 1);
+    }
+
+    // a loop inside a job runs on the thread of the job
+    std::atomic<int> inner{0};
+
+    ParallelFor(8, 4,
+                [&](unsigned int)
+                {
+                    const auto id = std::this_thread::get_id();
+                    ParallelFor(16, 4,
+                                [&](unsigned int)
+                                {
+                                    EXPECT_EQ(std::this_thread::get_id(), id);
+                                    inner++;
+                                });
+                });
+
+    EXPECT_EQ(inner.load(), 8 * 16);
+}
 
 TEST(ErrorHandling, ErrorClass)
 {
@@ -28,6 +131,1481 @@ TEST(ErrorHandling, ErrorClass)
     EXPECT_FALSE(IsNotValue(1, 1, MSG_INFO("")));
 }
 
+TEST(CpuRenderer, Render)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    ObjectArray objects;
+    CreateTestScene(objects, 6);
+
+    CpuRenderer renderer;
+    ASSERT_TRUE(renderer.Init());
+
+    const auto width  = 64u;
+    const auto height = 36u;
+
+    std::vector<float> single(width * height * 4);
+    std::vector<float> multi(width * height * 4);
+
+    // mode 8 colors every hit green
+    const auto settings = GetTestSettings(8);
+
+    renderer.SetThreadCount(1);
+    EXPECT_TRUE(
+        renderer.Render(objects, settings, 99.0f, width, height, &single[0]));
+    renderer.SetThreadCount(4);
+    EXPECT_TRUE(
+        renderer.Render(objects, settings, 99.0f, width, height, &multi[0]));
+
+    EXPECT_EQ(single, multi);
+
+    auto hits = 0;
+    for (auto i = 0u; i < width * height; ++i)
+    {
+        EXPECT_EQ(single[i * 4 + 3], 1.0f);
+        if (single[i * 4 + 1] == 1.0f)
+            hits++;
+    }
+    EXPECT_GT(hits, 0);
+
+    // top left corner shows the background
+    EXPECT_EQ(single[0], 0.0f);
+    EXPECT_EQ(single[1], 0.0f);
+    EXPECT_EQ(single[2], 0.0f);
+
+    EXPECT_FALSE(
+        renderer.Render(objects, settings, 99.0f, width, height, nullptr));
+}
+
+TEST(CpuRenderer, Reprojection)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    ObjectArray objects;
+    CreateTestScene(objects, 6);
+
+    auto settings          = GetTestSettings(8);
+    settings._reprojection = true;
+
+    ReprojectionHistory history;
+    EXPECT_LT(history.Update(objects, settings), 0.0f);
+    EXPECT_EQ(history.Update(objects, settings), 0.0f);
+    objects.Animation(100.0f);
+    EXPECT_GT(history.Update(objects, settings), 0.0f);
+    objects.AddObject();
+    EXPECT_LT(history.Update(objects, settings), 0.0f);
+    settings._kernel = MetaballKernel::WYVILL;
+    EXPECT_LT(history.Update(objects, settings), 0.0f);
+
+    const auto width  = 64u;
+    const auto height = 36u;
+
+    std::vector<float> reprojected(width * height * 4);
+    std::vector<float> reference(width * height * 4);
+
+    for (const auto kernel : {MetaballKernel::INVERSE_SQUARE,
+                              MetaballKernel::WYVILL,
+                              MetaballKernel::SMOOTH_MIN})
+    {
+        settings._kernel = kernel;
+
+        CpuRenderer renderer;
+        ASSERT_TRUE(renderer.Init());
+
+        for (auto frame = 0; frame < 3; ++frame)
+        {
+            objects.Animation(101.0f + float(frame));
+
+            settings._reprojection = true;
+            EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width,
+                                        height, &reprojected[0]));
+
+            CpuRenderer fresh;
+            ASSERT_TRUE(fresh.Init());
+            settings._reprojection = false;
+            EXPECT_TRUE(fresh.Render(objects, settings, 99.0f, width, height,
+                                     &reference[0]));
+
+            // a start closer to the surface changes the phase of the march;
+            // only a few grazing hits at the silhouette may differ
+            auto differences = 0u;
+            for (auto i = 0u; i < width * height; ++i)
+                if (reprojected[i * 4 + 1] != reference[i * 4 + 1])
+                    differences++;
+
+            EXPECT_LE(differences, width * height / 100);
+        }
+    }
+
+    // a metaball moves sideways in front of the previous hits of another one;
+    // the rays that narrowly missed it must not skip its new surface. The
+    // shading tells the two apart, the hits alone do not.
+    auto lambert = GetTestSettings(2);
+
+    for (const auto kernel : {MetaballKernel::INVERSE_SQUARE,
+                              MetaballKernel::WYVILL,
+                              MetaballKernel::SMOOTH_MIN})
+    {
+        lambert._kernel = kernel;
+
+        ObjectArray crossing;
+        glm::vec3   farPos(0.0f, 0.25f, -2.0f), nearPos(-0.45f, 0.25f, -0.4f);
+        glm::vec3   color(1.0f);
+        auto        index = 0;
+        ASSERT_TRUE(crossing.AddObject(farPos, color, index));
+        ASSERT_TRUE(crossing.AddObject(nearPos, color, index));
+
+        CpuRenderer renderer;
+        ASSERT_TRUE(renderer.Init());
+
+        lambert._reprojection = true;
+        EXPECT_TRUE(renderer.Render(crossing, lambert, 99.0f, width, height,
+                                    &reprojected[0]));
+
+        crossing.GetPositionData()[1].x = -0.15f;
+        EXPECT_TRUE(renderer.Render(crossing, lambert, 99.0f, width, height,
+                                    &reprojected[0]));
+
+        CpuRenderer fresh;
+        ASSERT_TRUE(fresh.Init());
+        lambert._reprojection = false;
+        EXPECT_TRUE(fresh.Render(crossing, lambert, 99.0f, width, height,
+                                 &reference[0]));
+
+        for (auto i = 0u; i < width * height; ++i)
+            EXPECT_NEAR(reprojected[i * 4 + 1], reference[i * 4 + 1], 0.1f);
+    }
+}
+
+TEST(CpuRenderer, Specialization)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    EXPECT_EQ(GetObjectBucket(1), SMALL_OBJECT_BUCKET);
+    EXPECT_EQ(GetObjectBucket(SMALL_OBJECT_BUCKET + 1), LARGE_OBJECT_BUCKET);
+    EXPECT_EQ(GetObjectBucket(LARGE_OBJECT_BUCKET + 1), 0u);
+
+    const auto width  = 64u;
+    const auto height = 36u;
+
+    std::vector<float> generic(width * height * 4);
+    std::vector<float> specialized(width * height * 4);
+
+    // one object count per bucket; the specialized shaders only drop code,
+    // so the images match exactly
+    for (auto count : {6u, 20u, 40u})
+    {
+        ObjectArray objects;
+        CreateTestScene(objects, count);
+
+        for (auto mode : {0u, 5u, 9u})
+        {
+            for (auto noise : {NoiseMode::NO_NOISE, NoiseMode::NOISE})
+            {
+                auto settings   = GetTestSettings(mode);
+                settings._noise = noise;
+
+                CpuRenderer renderer;
+                ASSERT_TRUE(renderer.Init());
+
+                renderer.SetSpecialization(false);
+                EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width,
+                                            height, &generic[0]));
+                renderer.SetSpecialization(true);
+                EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width,
+                                            height, &specialized[0]));
+
+                EXPECT_EQ(generic, specialized);
+            }
+        }
+    }
+}
+
+TEST(CpuRenderer, Deferred)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    const auto width  = 64u;
+    const auto height = 36u;
+
+    std::vector<float> forward(width * height * 4);
+    std::vector<float> deferred(width * height * 4);
+
+    ObjectArray objects;
+    CreateTestScene(objects, 6);
+
+    // the shading pass runs the code of the forward shaders on the stored
+    // surfaces, so the images match exactly; the second frame reprojects
+    for (auto mode : {0u, 1u, 5u})
+    {
+        for (auto groundMapSize : {0u, DEFAULT_GROUND_MAP_SIZE})
+        {
+            auto settings           = GetTestSettings(mode);
+            settings._reprojection  = true;
+            settings._groundMapSize = groundMapSize;
+
+            CpuRenderer forwardRenderer;
+            CpuRenderer deferredRenderer;
+            ASSERT_TRUE(forwardRenderer.Init());
+            ASSERT_TRUE(deferredRenderer.Init());
+
+            for (auto frame = 0; frame < 2; ++frame)
+            {
+                settings._deferredShading = false;
+                EXPECT_TRUE(forwardRenderer.Render(objects, settings, 99.0f,
+                                                   width, height,
+                                                   &forward[0]));
+                settings._deferredShading = true;
+                EXPECT_TRUE(deferredRenderer.Render(objects, settings, 99.0f,
+                                                    width, height,
+                                                    &deferred[0]));
+
+                EXPECT_EQ(forward, deferred);
+            }
+        }
+    }
+}
+
+TEST(ShadowMap, Lookup)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    const auto      lightDir = glm::normalize(LIGHT_VECTOR);
+    const glm::vec3 boundsMin(-1.0f, -0.5f, -1.0f);
+    const glm::vec3 boundsMax(1.0f, 1.5f, 0.5f);
+    const auto      size = 16u;
+
+    ShadowMap map;
+    EXPECT_FALSE(map.Fit(boundsMin, boundsMax, lightDir, 0));
+    ASSERT_TRUE(map.Fit(boundsMin, boundsMax, lightDir, size));
+
+    // the rays start at the texel centers in front of the bounds
+    for (auto y = 0u; y < size; ++y)
+    {
+        for (auto x = 0u; x < size; ++x)
+        {
+            const auto rel = map.GetRayStart(x, y) - map.GetOrigin();
+            EXPECT_NEAR(glm::dot(rel, map.GetTexelAxis(0)), x + 0.5f, 1e-3f);
+            EXPECT_NEAR(glm::dot(rel, map.GetTexelAxis(1)), y + 0.5f, 1e-3f);
+            EXPECT_NEAR(glm::dot(rel, lightDir), 0.0f, 1e-4f);
+        }
+    }
+
+    // behind an occluder at depth 1
+    const auto start = map.GetRayStart(3, 5);
+    EXPECT_FALSE(map.IsShadowed(start - lightDir * 2.0f));
+    map.SetDepth(3, 5, 1.0f);
+    EXPECT_TRUE(map.IsShadowed(start - lightDir * 2.0f));
+    EXPECT_FALSE(map.IsShadowed(start - lightDir * (1.0f + map.GetBias() / 2)));
+    EXPECT_FALSE(map.IsShadowed(start - lightDir * 0.5f));
+    EXPECT_FALSE(map.IsShadowed(start - lightDir * 2.0f -
+                                map.GetTexelEdge(0) * float(size)));
+
+    // the map replaces the shadow rays of the hard shadow mode
+    ObjectArray objects;
+    CreateTestScene(objects, 6);
+
+    auto settings = GetTestSettings(5);
+
+    const auto width  = 128u;
+    const auto height = 72u;
+
+    std::vector<float> mapped(width * height * 4);
+    std::vector<float> reference(width * height * 4);
+
+    CpuRenderer renderer;
+    ASSERT_TRUE(renderer.Init());
+
+    settings._shadowMapSize = 0;
+    EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width, height,
+                                &reference[0]));
+    settings._shadowMapSize = DEFAULT_SHADOW_MAP_SIZE;
+    EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width, height,
+                                &mapped[0]));
+
+    // the texels blur the shadow edges
+    auto differences = 0u;
+    for (auto i = 0u; i < width * height; ++i)
+        if (mapped[i * 4] != reference[i * 4])
+            differences++;
+
+    EXPECT_LE(differences, width * height / 40);
+}
+
+TEST(LightVolume, Integration)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    const glm::vec3 lightDir(0.0f, 1.0f, 0.0f);
+    const glm::vec3 boundsMin(-1.0f, -0.5f, -1.0f);
+    const glm::vec3 boundsMax(1.0f, 0.5f, 1.0f);
+    const auto      size = 8u;
+
+    LightVolume volume;
+    EXPECT_FALSE(volume.Fit(boundsMin, boundsMax, lightDir, 0));
+    ASSERT_TRUE(volume.Fit(boundsMin, boundsMax, lightDir, size));
+
+    // a slab filling the upper half absorbs above every voxel
+    for (auto z = 0u; z < size; ++z)
+        for (auto y = size / 2; y < size; ++y)
+            for (auto x = 0u; x < size; ++x)
+                volume.SetDensity(x, y, z, 1.0f);
+
+    for (auto z = 0u; z < size; ++z)
+        volume.Integrate(z);
+
+    // the march counts the samples between the position and the top
+    const auto count = [](float length)
+    { return length / LIGHT_VOLUME_SAMPLE_STEP; };
+
+    const auto top    = volume.GetVoxelCenter(3, size - 1, 3);
+    const auto bottom = volume.GetVoxelCenter(3, 0, 3);
+    const auto tol    = count(volume.GetIntegrationStep()) + 1e-3f;
+
+    EXPECT_NEAR(volume.GetSampleCount(top), count(0.5f - top.y), tol);
+    EXPECT_NEAR(volume.GetSampleCount(bottom), count(0.5f), 2.0f * tol);
+    EXPECT_NEAR(volume.GetSampleCount(glm::vec3(0.0f, 5.0f, 0.0f)),
+                volume.GetSampleCount(glm::vec3(0.0f, top.y, 0.0f)), 1e-4f);
+
+    // the volume replaces the marches of the volume light
+    ObjectArray objects;
+    CreateTestScene(objects, 6);
+
+    auto settings = GetTestSettings(6);
+
+    const auto width  = 128u;
+    const auto height = 72u;
+
+    std::vector<float> sampled(width * height * 4);
+    std::vector<float> reference(width * height * 4);
+
+    CpuRenderer renderer;
+    ASSERT_TRUE(renderer.Init());
+
+    settings._lightVolumeSize = 0;
+    EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width, height,
+                                &reference[0]));
+    settings._lightVolumeSize = DEFAULT_LIGHT_VOLUME_SIZE;
+    EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width, height,
+                                &sampled[0]));
+
+    // the grid smooths the absorption
+    auto error = 0.0;
+    for (size_t i = 0; i < sampled.size(); ++i)
+        error += std::fabs(sampled[i] - reference[i]);
+
+    EXPECT_LT(error / double(sampled.size()), 0.01);
+}
+
+TEST(DensityVolume, IncrementalBake)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    ObjectArray objects;
+    CreateTestScene(objects, 20);
+
+    auto settings               = GetTestSettings(0);
+    settings._kernel            = MetaballKernel::WYVILL;
+    settings._kernelRadius      = DEFAULT_KERNEL_RADIUS;
+    settings._densityVolumeSize = 12;
+
+    glm::vec3 boundsMin, boundsMax;
+    GetFieldBounds(objects, settings, boundsMin, boundsMax);
+
+    DensityVolume volume;
+    EXPECT_FALSE(volume.Update(boundsMin, boundsMax, objects, settings, 0.0f));
+
+    settings._densityVolumeSize = DEFAULT_DENSITY_VOLUME_SIZE;
+    ASSERT_TRUE(volume.Update(boundsMin, boundsMax, objects, settings, 0.0f));
+
+    // the first frame bakes every stored brick and clears the others
+    const auto bricks     = volume.GetBricksPerEdge();
+    const auto brickCount = size_t(bricks) * bricks * bricks;
+    const auto stored     = size_t(volume.GetStoredBrickCount());
+    EXPECT_EQ(volume.GetDirtyBricks().size(), stored);
+    EXPECT_EQ(volume.GetClearedBricks().size(), brickCount - stored);
+
+    // a paused scene keeps every brick
+    ASSERT_TRUE(volume.Update(boundsMin, boundsMax, objects, settings, 0.0f));
+    EXPECT_TRUE(volume.GetDirtyBricks().empty());
+    EXPECT_TRUE(volume.GetClearedBricks().empty());
+
+    // a moved center re-bakes the bricks in its reach at both positions
+    const auto before = objects.GetPosition(0);
+    const auto after  = before + glm::vec3(0.02f, 0.0f, 0.0f);
+    objects.GetPositionData()[0] = after;
+
+    GetFieldBounds(objects, settings, boundsMin, boundsMax);
+    ASSERT_TRUE(volume.Update(boundsMin, boundsMax, objects, settings, 0.0f));
+
+    const auto& dirty = volume.GetDirtyBricks();
+    EXPECT_FALSE(dirty.empty());
+    EXPECT_LT(dirty.size(), brickCount / 4);
+
+    // the voxel centers of a brick span all but one voxel of it
+    const auto voxel = volume.GetExtent() / float(volume.GetSize());
+    const auto half  = float(DENSITY_BRICK_SIZE - 1) * 0.5f;
+    const auto reach = settings._kernelRadius + glm::length(voxel) * half;
+
+    for (const auto brick : dirty)
+    {
+        auto x = 0u, y = 0u, z = 0u;
+        volume.GetBrickOrigin(brick, x, y, z);
+
+        const auto center = volume.GetVoxelCenter(x, y, z) + voxel * half;
+        EXPECT_LT(glm::min(glm::length(center - before),
+                           glm::length(center - after)),
+                  reach + 1e-4f);
+    }
+
+    // the renderer bakes the grid and samples it instead of the metaballs
+    const auto width  = 128u;
+    const auto height = 72u;
+
+    std::vector<float> baked(width * height * 4);
+    std::vector<float> reference(width * height * 4);
+
+    CpuRenderer renderer;
+    ASSERT_TRUE(renderer.Init());
+
+    settings = GetTestSettings(0);
+    EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width, height,
+                                &reference[0]));
+    settings._densityVolumeSize = DEFAULT_DENSITY_VOLUME_SIZE;
+    EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width, height,
+                                &baked[0]));
+
+    auto error = 0.0;
+    for (size_t i = 0; i < baked.size(); ++i)
+        error += std::fabs(baked[i] - reference[i]);
+
+    EXPECT_LT(error / double(baked.size()), 0.01);
+}
+
+TEST(DensityVolume, SparseBricks)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 6);
+
+    auto settings               = GetTestSettings(0);
+    settings._kernel            = MetaballKernel::WYVILL;
+    settings._kernelRadius      = DEFAULT_KERNEL_RADIUS;
+    settings._densityVolumeSize = DEFAULT_DENSITY_VOLUME_SIZE;
+
+    glm::vec3 boundsMin, boundsMax;
+    GetFieldBounds(objects, settings, boundsMin, boundsMax);
+
+    DensityVolume volume;
+    ASSERT_TRUE(volume.Update(boundsMin, boundsMax, objects, settings, 0.0f));
+
+    // only the bricks near the centers are stored
+    const auto bricks     = volume.GetBricksPerEdge();
+    const auto brickCount = bricks * bricks * bricks;
+    EXPECT_GT(volume.GetStoredBrickCount(), 0u);
+    EXPECT_LT(volume.GetStoredBrickCount(), brickCount / 2);
+
+    SpatialGrid grid;
+    ASSERT_TRUE(grid.Build(objects, settings._kernelRadius));
+
+    auto u          = GetTestUniforms(objects);
+    u._kernel       = MetaballKernel::WYVILL;
+    u._kernelRadius = settings._kernelRadius;
+    u._kernelScale  = GetWyvillScale(settings._kernelRadius);
+    u._grid         = &grid;
+
+    for (const auto brick : volume.GetDirtyBricks())
+    {
+        auto x0 = 0u, y0 = 0u, z0 = 0u;
+        volume.GetBrickOrigin(brick, x0, y0, z0);
+
+        for (auto z = z0; z < z0 + DENSITY_BRICK_SIZE; ++z)
+        {
+            for (auto y = y0; y < y0 + DENSITY_BRICK_SIZE; ++y)
+            {
+                for (auto x = x0; x < x0 + DENSITY_BRICK_SIZE; ++x)
+                {
+                    const auto sample =
+                        MetaballField(u, volume.GetVoxelCenter(x, y, z), true);
+                    volume.SetVoxel(x, y, z, sample._value, sample._color);
+                }
+            }
+        }
+    }
+
+    // the voxels store the field at their centers
+    const auto size = volume.GetSize();
+    const auto inv  = float(size) / volume.GetExtent();
+    const auto cell = (objects.GetPosition(2) - volume.GetMin()) * inv;
+
+    const auto pos = volume.GetVoxelCenter(unsigned(cell.x), unsigned(cell.y),
+                                           unsigned(cell.z));
+    const auto expected = MetaballField(u, pos, true);
+
+    glm::vec3 gradient, color;
+    EXPECT_NEAR(volume.Sample(pos, &gradient, &color), expected._value,
+                1e-4f * expected._value);
+    EXPECT_NEAR(color.x, expected._color.x, 1e-4f);
+    EXPECT_NEAR(color.y, expected._color.y, 1e-4f);
+    EXPECT_NEAR(color.z, expected._color.z, 1e-4f);
+
+    // the empty bricks are outside and skipped
+    const glm::vec3 dir(0.01f, 0.0f, 0.0f);
+    const auto      voxel = volume.GetExtent() / float(size);
+
+    for (const auto brick : volume.GetClearedBricks())
+    {
+        auto x = 0u, y = 0u, z = 0u;
+        volume.GetBrickOrigin(brick, x, y, z);
+
+        const auto center = volume.GetVoxelCenter(x, y, z) +
+                            voxel * (float(DENSITY_BRICK_SIZE - 1) * 0.5f);
+
+        EXPECT_LT(MetaballField(u, center, false)._value, METABALL_THRESHOLD);
+        EXPECT_LT(volume.Sample(center, nullptr, nullptr), METABALL_THRESHOLD);
+        EXPECT_GT(volume.GetEmptySpan(center, dir), 0.0f);
+    }
+
+    EXPECT_FLOAT_EQ(volume.GetEmptySpan(objects.GetPosition(2), dir), 0.0f);
+}
+
+TEST(GroundMap, Lookup)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    const glm::vec3 boundsMin(-1.0f, -0.5f, -1.0f);
+    const glm::vec3 boundsMax(1.0f, 0.5f, 0.0f);
+    const auto      size = 4u;
+
+    GroundMap map;
+    EXPECT_FALSE(map.Fit(boundsMin, boundsMax, 0));
+    ASSERT_TRUE(map.Fit(boundsMin, boundsMax, size));
+
+    const glm::vec4 red(1.0f, 0.0f, 0.0f, 1.0f);
+    for (auto y = 0u; y < size; ++y)
+        for (auto x = 0u; x < size; ++x)
+            map.SetColor(x, y, red);
+
+    // the texels cover the footprint on the ground plane
+    const auto first = map.GetTexelCenter(0, 0);
+    const auto last  = map.GetTexelCenter(size - 1, size - 1);
+    EXPECT_FLOAT_EQ(first.x, -0.75f);
+    EXPECT_FLOAT_EQ(first.y, GROUND_HEIGHT);
+    EXPECT_FLOAT_EQ(first.z, -0.875f);
+    EXPECT_FLOAT_EQ(last.x, 0.75f);
+    EXPECT_FLOAT_EQ(last.z, -0.125f);
+
+    EXPECT_FLOAT_EQ(map.GetColor(first).x, 1.0f);
+    EXPECT_FLOAT_EQ(map.GetColor(glm::vec3(0.0f, 0.0f, -0.5f)).x, 1.0f);
+    EXPECT_FLOAT_EQ(map.GetColor(glm::vec3(-1.0f, 0.0f, -0.5f)).x, 0.5f);
+    EXPECT_FLOAT_EQ(map.GetColor(glm::vec3(2.0f, 0.0f, -0.5f)).x, 0.0f);
+    EXPECT_FLOAT_EQ(map.GetColor(glm::vec3(2.0f, 0.0f, -0.5f)).w, 1.0f);
+
+    // the map replaces the marches up from the ground
+    ObjectArray objects;
+    CreateTestScene(objects, 6);
+
+    auto settings = GetTestSettings(0);
+
+    const auto width  = 128u;
+    const auto height = 72u;
+
+    std::vector<float> mapped(width * height * 4);
+    std::vector<float> reference(width * height * 4);
+
+    CpuRenderer renderer;
+    ASSERT_TRUE(renderer.Init());
+
+    settings._groundMapSize = 0;
+    EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width, height,
+                                &reference[0]));
+    settings._groundMapSize = DEFAULT_GROUND_MAP_SIZE;
+    EXPECT_TRUE(renderer.Render(objects, settings, 99.0f, width, height,
+                                &mapped[0]));
+
+    auto error = 0.0;
+    for (size_t i = 0; i < mapped.size(); ++i)
+        error += std::fabs(mapped[i] - reference[i]);
+
+    EXPECT_LT(error / double(mapped.size()), 0.005);
+}
+
+TEST(FieldKernel, Tolerance)
+{
+    // odd count to test the masked tail
+    const auto count = 37u;
+
+    std::mt19937                          gen(42);
+    std::uniform_real_distribution<float> dist(-2.0f, 2.0f);
+
+    std::vector<float> data(count * 6);
+    for (auto& v : data)
+        v = dist(gen);
+
+    MetaballCenters centers;
+    centers._x     = &data[0];
+    centers._y     = &data[count];
+    centers._z     = &data[count * 2];
+    centers._r     = &data[count * 3];
+    centers._g     = &data[count * 4];
+    centers._b     = &data[count * 5];
+    centers._count = count;
+
+    const auto scalar = GetFieldKernel(SimdLevel::SCALAR);
+
+    for (const auto level : {SimdLevel::AVX2, SimdLevel::AVX512})
+    {
+        const auto kernel = GetFieldKernel(level);
+
+        for (auto i = 0; i < 100; ++i)
+        {
+            const auto x = dist(gen);
+            const auto y = dist(gen);
+            const auto z = dist(gen);
+
+            float refValue, refColor[3], refGradient[3];
+            scalar(centers, x, y, z, true, refValue, refColor, refGradient);
+
+            float value, color[3], gradient[3];
+            kernel(centers, x, y, z, true, value, color, gradient);
+
+            EXPECT_NEAR(value, refValue,
+                        std::fabs(refValue) * FIELD_KERNEL_TOLERANCE);
+
+            const auto gradientTolerance =
+                glm::length(glm::vec3(refGradient[0], refGradient[1],
+                                      refGradient[2])) *
+                FIELD_KERNEL_TOLERANCE * 10.0f;
+
+            for (auto c = 0; c < 3; ++c)
+            {
+                EXPECT_NEAR(color[c], refColor[c],
+                            std::fabs(refValue) * FIELD_KERNEL_TOLERANCE);
+                EXPECT_NEAR(gradient[c], refGradient[c], gradientTolerance);
+            }
+        }
+    }
+}
+
+TEST(CpuShader, AnalyticGradient)
+{
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 20);
+
+    NoiseData slice;
+    NoiseData volume;
+    ASSERT_TRUE(CreateNoiseData(GetNoiseParams(0), 0, slice));
+    ASSERT_TRUE(
+        CreateNoiseData(GetNoiseParams(DEFAULT_NOISE_VOLUME_SIZE), 0, volume));
+
+    SpatialGrid grid;
+    ASSERT_TRUE(grid.Build(objects, DEFAULT_KERNEL_RADIUS));
+
+    auto u          = GetTestUniforms(objects);
+    u._animation    = 99.0f;
+    u._kernelRadius = DEFAULT_KERNEL_RADIUS;
+    u._kernelScale  = GetWyvillScale(DEFAULT_KERNEL_RADIUS);
+    u._grid         = &grid;
+
+    std::mt19937                          gen(17);
+    std::uniform_real_distribution<float> dist(-0.3f, 0.3f);
+
+    const auto h = 1e-3f;
+
+    for (const auto kernel :
+         {MetaballKernel::INVERSE_SQUARE, MetaballKernel::WYVILL})
+    {
+        for (const auto noiseMode : {0u, 1u, 2u})
+        {
+            u._kernel       = kernel;
+            u._noise        = noiseMode > 0 ? 1u : 0u;
+            u._noiseTexture = noiseMode == 2 ? &volume : &slice;
+
+            auto checked = 0;
+            auto failed  = 0;
+
+            for (auto i = 0; i < 200; ++i)
+            {
+                // points near the surface of the metaballs
+                const auto center = objects.GetPosition(i % 20);
+                const auto pos =
+                    center + glm::vec3(dist(gen), dist(gen), dist(gen));
+
+                const auto sample = MetaballField(u, pos, true);
+                if (glm::length(sample._gradient) < 1.0f)
+                    continue;
+
+                glm::vec3 reference;
+                for (auto a = 0; a < 3; ++a)
+                {
+                    auto offset = glm::vec3(0.0f);
+                    offset[a]   = h;
+                    reference[a] =
+                        (MetaballField(u, pos + offset, false)._value -
+                         MetaballField(u, pos - offset, false)._value) /
+                        (2.0f * h);
+                }
+
+                // the filtered noise has kinks at the texel borders
+                checked++;
+                if (glm::length(sample._gradient - reference) >
+                    glm::length(reference) * 0.01f)
+                    failed++;
+            }
+
+            EXPECT_GT(checked, 100);
+            EXPECT_LE(failed, noiseMode ? checked / 20 : 0);
+        }
+    }
+}
+
+TEST(Noise, Generator)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    // the rows do not depend on the thread that generates them
+    NoiseData single;
+    NoiseData parallel;
+    ASSERT_TRUE(CreateNoiseData(GetNoiseParams(0), 1, single));
+    ASSERT_TRUE(CreateNoiseData(GetNoiseParams(0), 4, parallel));
+
+    EXPECT_EQ(single._storage.size(),
+              size_t(NOISE_TEXTURE_WIDTH) * NOISE_TEXTURE_HEIGHT);
+    EXPECT_EQ(single._storage, parallel._storage);
+
+    const auto size = 32u;
+
+    NoiseData volume;
+    ASSERT_TRUE(CreateNoiseData(GetNoiseParams(size), 0, volume));
+    ASSERT_EQ(volume._storage.size(),
+              size_t(size) * size * size * NOISE_VOLUME_COMPONENTS);
+
+    // two independent noises spanning the byte range
+    auto differing = 0u;
+    auto minTexel  = 255;
+    auto maxTexel  = 0;
+
+    for (size_t i = 0; i < volume._storage.size(); i += 2)
+    {
+        const auto r = int(volume._storage[i]);
+        const auto g = int(volume._storage[i + 1]);
+
+        differing += std::abs(r - g) > 16 ? 1 : 0;
+        minTexel = std::min(minTexel, std::min(r, g));
+        maxTexel = std::max(maxTexel, std::max(r, g));
+    }
+
+    EXPECT_GT(differing, size * size * size / 2);
+    EXPECT_LT(minTexel, 64);
+    EXPECT_GT(maxTexel, 192);
+
+    // a texel center returns the texel; the blend mixes the noises
+    const auto x = 5u, y = 17u, z = 30u;
+    const auto index = ((size_t(z) * size + y) * size + x) * 2;
+    const auto uvw   = (glm::vec3(float(x), float(y), float(z)) + 0.5f) /
+                     float(size);
+
+    EXPECT_NEAR(SampleNoiseData(volume, uvw, 0.0f, nullptr),
+                volume._storage[index] / 255.0f, 1e-5f);
+    EXPECT_NEAR(SampleNoiseData(volume, uvw, 1.0f, nullptr),
+                volume._storage[index + 1] / 255.0f, 1e-5f);
+
+    // the slice has no gradient across its depth
+    glm::vec3 gradient;
+    SampleNoiseData(single, glm::vec3(0.3f, 0.7f, 0.5f), 0.0f, &gradient);
+    EXPECT_EQ(gradient.z, 0.0f);
+
+    auto params   = GetNoiseParams(0);
+    params._depth = 0;
+    EXPECT_FALSE(CreateNoiseData(params, 0, single));
+}
+
+TEST(AssetCache, NoiseCache)
+{
+    error_sys_intern::SetUnitTestMode();
+
+    const auto directory =
+        std::filesystem::temp_directory_path() / "volume_demo_test_cache";
+    std::filesystem::remove_all(directory);
+
+    AssetCache cache;
+    cache.SetDirectory(directory.string());
+
+    const auto params = GetNoiseParams(16);
+
+    // a miss generates and stores the noise, a hit maps the file
+    NoiseData generated;
+    ASSERT_TRUE(LoadNoiseData(params, 0, cache, generated));
+    EXPECT_FALSE(generated._storage.empty());
+    EXPECT_EQ(generated._file.GetData(), nullptr);
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(directory))
+        files.push_back(entry.path());
+    ASSERT_EQ(files.size(), 1u);
+
+    NoiseData mapped;
+    ASSERT_TRUE(LoadNoiseData(params, 0, cache, mapped));
+    EXPECT_TRUE(mapped._storage.empty());
+    ASSERT_NE(mapped._file.GetData(), nullptr);
+    EXPECT_GE(mapped._texels, mapped._file.GetData());
+    EXPECT_TRUE(std::equal(generated._storage.begin(),
+                           generated._storage.end(), mapped._texels));
+
+    // other parameters are another asset
+    auto other       = params;
+    other._frequency = 3.0f;
+
+    NoiseData otherData;
+    ASSERT_TRUE(LoadNoiseData(other, 0, cache, otherData));
+    EXPECT_FALSE(otherData._storage.empty());
+
+    // a truncated file is a miss and written again
+    const auto path = files[0];
+    mapped._file.Close();
+    std::filesystem::resize_file(path, 100);
+
+    NoiseData repaired;
+    ASSERT_TRUE(LoadNoiseData(params, 0, cache, repaired));
+    EXPECT_FALSE(repaired._storage.empty());
+    EXPECT_EQ(repaired._storage, generated._storage);
+    EXPECT_GT(std::filesystem::file_size(path), generated._storage.size());
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(SpatialGrid, CompactKernel)
+{
+    ObjectArray objects;
+    CreateTestScene(objects, 40);
+
+    const auto radius = 0.4f;
+    const auto scale  = GetWyvillScale(radius);
+
+    SpatialGrid grid;
+    ASSERT_TRUE(grid.Build(objects, radius));
+
+    const auto wyvill = [&](const glm::vec3& pos, int i) {
+        const auto d = pos - objects.GetPosition(i);
+        const auto f = 1.0f - glm::dot(d, d) / (radius * radius);
+        return f > 0.0f ? scale * f * f * f : 0.0f;
+    };
+
+    std::mt19937                          gen(7);
+    std::uniform_real_distribution<float> dist(-2.0f, 2.0f);
+
+    for (auto i = 0; i < 1000; ++i)
+    {
+        const glm::vec3 pos(dist(gen), dist(gen), dist(gen));
+
+        auto bruteForce = 0.0f;
+        for (auto k = 0; k < int(objects.GetObjectCount()); ++k)
+            bruteForce += wyvill(pos, k);
+
+        auto        count   = 0u;
+        const auto* indices = grid.FindCell(pos, count);
+
+        auto gridValue = 0.0f;
+        for (auto k = 0u; k < count; ++k)
+            gridValue += wyvill(pos, indices[k]);
+
+        EXPECT_NEAR(gridValue, bruteForce, 1e-4f);
+    }
+}
+
+TEST(TileLists, PrimaryRays)
+{
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 40);
+
+    const auto      radius = 0.4f;
+    const glm::vec3 camPos(0.0f, 0.0f, 2.0f);
+    const glm::vec3 planeOrigin(-2.0f, -0.75f, 0.0f);
+    const glm::vec2 planeSize(4.0f, 2.0f);
+
+    SpatialGrid grid;
+    ASSERT_TRUE(grid.Build(objects, radius));
+
+    TileLists tiles;
+    ASSERT_TRUE(tiles.Build(objects, radius, camPos, planeOrigin, planeSize));
+    EXPECT_LT(tiles.GetIndices().size(), size_t(40 * 32 * 16));
+
+    auto u          = GetTestUniforms(objects);
+    u._kernel       = MetaballKernel::WYVILL;
+    u._kernelRadius = radius;
+    u._kernelScale  = GetWyvillScale(radius);
+    u._grid         = &grid;
+    u._tiles        = &tiles;
+
+    std::mt19937                          gen(13);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    for (auto i = 0; i < 200; ++i)
+    {
+        const glm::vec3 start(planeOrigin.x + dist(gen) * planeSize.x,
+                              planeOrigin.y + dist(gen) * planeSize.y, 0.0f);
+        const auto dir  = glm::normalize(start - camPos);
+        const auto tile = tiles.FindTile(start);
+        ASSERT_GE(tile, 0);
+
+        // samples along the ray and the offsets of MetaballNormal()
+        for (auto k = 0; k < 40; ++k)
+        {
+            const auto pos    = start + dir * (float(k) * 0.1f);
+            const auto offset = glm::vec3(dist(gen), dist(gen), dist(gen));
+            const auto sample = pos - offset * 0.01f;
+
+            u._tile          = -1;
+            const auto value = MetaballField(u, sample, false)._value;
+
+            u._tile = tile;
+            EXPECT_NEAR(MetaballField(u, sample, false)._value, value, 1e-4f);
+        }
+    }
+}
+
+TEST(Octree, BarnesHut)
+{
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 200);
+
+    Octree octree;
+    ASSERT_TRUE(octree.Build(objects));
+
+    // every metaball is in exactly one leaf
+    auto leafCount = 0;
+    for (const auto& node : octree.GetNodes())
+        leafCount += int(node._leafCount);
+    EXPECT_EQ(leafCount, 200);
+
+    auto u    = GetTestUniforms(objects);
+    u._octree = &octree;
+
+    std::mt19937                          gen(3);
+    std::uniform_real_distribution<float> dist(-2.0f, 2.0f);
+
+    for (const auto angle : {0.25f, 0.5f})
+    {
+        auto maxError = 0.0f;
+
+        for (auto i = 0; i < 1000; ++i)
+        {
+            const glm::vec3 pos(dist(gen), dist(gen), dist(gen));
+
+            u._openingAngle = 0.0f;
+            const auto bruteForce = MetaballField(u, pos, false)._value;
+
+            u._openingAngle = angle;
+            const auto tree = MetaballField(u, pos, false)._value;
+
+            maxError = std::max(maxError,
+                                std::fabs(tree - bruteForce) / bruteForce);
+        }
+
+        EXPECT_LT(maxError, angle * angle) << "opening angle " << angle;
+    }
+}
+
+TEST(Scene, FieldBounds)
+{
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 20);
+
+    auto       settings = GetTestSettings(0);
+    const auto u        = GetTestUniforms(objects);
+
+    std::mt19937                          gen(11);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    for (const auto noise : {NoiseMode::NO_NOISE, NoiseMode::NOISE})
+    {
+        settings._noise = noise;
+
+        glm::vec3 boundsMin, boundsMax;
+        GetFieldBounds(objects, settings, boundsMin, boundsMax);
+
+        const auto maxField = noise == NoiseMode::NOISE
+                                  ? METABALL_THRESHOLD - NOISE_FIELD_AMPLITUDE
+                                  : METABALL_THRESHOLD;
+
+        // points on the faces of the box
+        for (auto i = 0; i < 600; ++i)
+        {
+            const glm::vec3 t(dist(gen), dist(gen), dist(gen));
+
+            auto pos   = boundsMin + (boundsMax - boundsMin) * t;
+            pos[i % 3] = (i % 2) ? boundsMin[i % 3] : boundsMax[i % 3];
+
+            EXPECT_LE(MetaballField(u, pos, false)._value, maxField);
+        }
+    }
+
+    // no objects: empty box
+    ObjectArray empty;
+    glm::vec3   boundsMin, boundsMax;
+    GetFieldBounds(empty, settings, boundsMin, boundsMax);
+    EXPECT_GT(boundsMin.x, boundsMax.x);
+}
+
+TEST(CpuShader, SurfaceRefinement)
+{
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 10);
+
+    const auto u = GetTestUniforms(objects);
+
+    std::mt19937                          gen(5);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    auto hits = 0;
+
+    for (auto i = 0; i < 500; ++i)
+    {
+        // primary ray of volume_body.glsl
+        const glm::vec3 camPos(0.0f, 0.0f, 2.0f);
+        const glm::vec3 startPos(dist(gen) * 2.0f, dist(gen), 0.0f);
+        const auto sampleStep = glm::normalize(startPos - camPos) * 0.01f;
+
+        const auto res = SampleToSurface(u, startPos, sampleStep, 200);
+
+        if (res._inside == false)
+            continue;
+
+        hits++;
+
+        // reference: first fine step inside, then bisection
+        auto outside = startPos;
+        auto inside  = startPos;
+        for (auto k = 1; k <= 2000; ++k)
+        {
+            inside = startPos + sampleStep * (float(k) * 0.1f);
+            if (MetaballField(u, inside, false)._value >= METABALL_THRESHOLD)
+                break;
+            outside = inside;
+        }
+        for (auto k = 0; k < 30; ++k)
+        {
+            const auto mid = (outside + inside) * 0.5f;
+            if (MetaballField(u, mid, false)._value >= METABALL_THRESHOLD)
+                inside = mid;
+            else
+                outside = mid;
+        }
+
+        // the former linear walk was accurate to one sample step
+        EXPECT_LT(glm::length(res._pos - inside),
+                  glm::length(sampleStep) * 0.1f);
+    }
+
+    EXPECT_GT(hits, 0);
+}
+
+TEST(CpuShader, IntervalRays)
+{
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 10);
+
+    NoiseData noise;
+    ASSERT_TRUE(CreateNoiseData(GetNoiseParams(0), 0, noise));
+
+    auto u          = GetTestUniforms(objects);
+    u._intervalRays = true;
+    u._animation    = 99.0f;
+    u._noiseTexture = &noise;
+
+    std::mt19937                          gen(11);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    // the noise leaves a wide band undecided by the bound, in which the
+    // steps of the interval search run out
+    for (const auto noiseMode : {NoiseMode::NO_NOISE, NoiseMode::NOISE})
+    {
+        auto settings   = GetTestSettings(0);
+        settings._noise = noiseMode;
+        GetFieldBounds(objects, settings, u._boundsMin, u._boundsMax);
+        u._noise = noiseMode == NoiseMode::NOISE ? 1u : 0u;
+
+        auto hits = 0;
+
+        for (auto i = 0; i < 500; ++i)
+        {
+            // primary ray of volume_body.glsl
+            const glm::vec3 camPos(0.0f, 0.0f, 2.0f);
+            const glm::vec3 startPos(dist(gen) * 2.0f, dist(gen), 0.0f);
+            const auto sampleStep = glm::normalize(startPos - camPos) * 0.01f;
+
+            const auto res = SampleToSurface(u, startPos, sampleStep, 200);
+
+            // reference: fine linear walk
+            auto inside = false;
+            auto pos    = startPos;
+            for (auto k = 1; k <= 20000 && inside == false; ++k)
+            {
+                pos = startPos + sampleStep * (float(k) * 0.01f);
+                inside =
+                    MetaballField(u, pos, false)._value >= METABALL_THRESHOLD;
+            }
+
+            EXPECT_EQ(res._inside, inside);
+            if (res._inside == false || inside == false)
+                continue;
+
+            hits++;
+            EXPECT_LT(glm::length(res._pos - pos),
+                      glm::length(sampleStep) * 0.1f);
+        }
+
+        EXPECT_GT(hits, 0);
+    }
+
+    // a ray grazing a single metaball; the chord is shorter than the big
+    // step and lies between two big steps of the linear search
+    ObjectArray single(ObjectLayout::SOA);
+    glm::vec3   center(0.0f), color(1.0f);
+    auto        index = 0;
+    ASSERT_TRUE(single.AddObject(center, color, index));
+
+    auto grazing = GetTestUniforms(single);
+
+    const glm::vec3 startPos(-0.95f, 0.2234f, 0.0f);
+    const glm::vec3 sampleStep(0.01f, 0.0f, 0.0f);
+
+    grazing._intervalRays = false;
+    EXPECT_FALSE(SampleToSurface(grazing, startPos, sampleStep, 200)._inside);
+
+    grazing._intervalRays = true;
+    EXPECT_TRUE(SampleToSurface(grazing, startPos, sampleStep, 200)._inside);
+
+    // a fine ray passing the first metaball where the noise could reach the
+    // threshold runs out of interval steps before it hits the second one
+    ObjectArray pair(ObjectLayout::SOA);
+    glm::vec3   behind(1.0f, 0.27f, 0.0f);
+    ASSERT_TRUE(pair.AddObject(center, color, index));
+    ASSERT_TRUE(pair.AddObject(behind, color, index));
+
+    auto banded          = GetTestUniforms(pair);
+    banded._intervalRays = true;
+    banded._animation    = 99.0f;
+    banded._noise        = 1u;
+    banded._noiseTexture = &noise;
+
+    auto settings   = GetTestSettings(0);
+    settings._noise = NoiseMode::NOISE;
+    GetFieldBounds(pair, settings, banded._boundsMin, banded._boundsMax);
+
+    const glm::vec3 bandStart(-0.5f, 0.27f, 0.0f);
+    const glm::vec3 bandStep(0.001f, 0.0f, 0.0f);
+
+    auto inside = false;
+    auto pos    = bandStart;
+    for (auto k = 1; k <= 200000 && inside == false; ++k)
+    {
+        pos    = bandStart + bandStep * (float(k) * 0.01f);
+        inside = MetaballField(banded, pos, false)._value >= METABALL_THRESHOLD;
+    }
+
+    const auto res = SampleToSurface(banded, bandStart, bandStep, 2000);
+
+    ASSERT_TRUE(inside);
+    ASSERT_TRUE(res._inside);
+    EXPECT_LT(glm::length(res._pos - pos), glm::length(bandStep) * 0.1f);
+}
+
+TEST(CpuShader, ConeMarch)
+{
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 10);
+
+    SpatialGrid grid;
+    ASSERT_TRUE(grid.Build(objects, DEFAULT_KERNEL_RADIUS));
+
+    auto u          = GetTestUniforms(objects);
+    u._camPos       = glm::vec3(0.0f, 0.0f, 2.0f);
+    u._kernelRadius = DEFAULT_KERNEL_RADIUS;
+    u._kernelScale  = GetWyvillScale(DEFAULT_KERNEL_RADIUS);
+    u._grid         = &grid;
+
+    std::mt19937                          gen(5);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    for (const auto kernel : {MetaballKernel::INVERSE_SQUARE,
+                              MetaballKernel::WYVILL,
+                              MetaballKernel::SMOOTH_MIN})
+    {
+        u._kernel = kernel;
+
+        auto settings    = GetTestSettings(0);
+        settings._kernel = kernel;
+        GetFieldBounds(objects, settings, u._boundsMin, u._boundsMax);
+
+        auto total = 0.0f;
+
+        for (auto i = 0; i < 200; ++i)
+        {
+            // a tile on the view plane
+            const glm::vec3 center(dist(gen) * 4.0f - 2.0f,
+                                   dist(gen) * 2.0f - 0.75f, 0.0f);
+            const auto      size = 0.01f + dist(gen) * 0.04f;
+            const glm::vec3 halfX(size, 0.0f, 0.0f);
+            const glm::vec3 halfY(0.0f, size, 0.0f);
+
+            const auto distance = ConeMarch(u, center, halfX, halfY, 0.0f);
+            total += distance;
+
+            // no ray of the tile hits the surface before the distance
+            for (auto k = 0; k < 8; ++k)
+            {
+                const auto startPos = center +
+                                      halfX * (dist(gen) * 2.0f - 1.0f) +
+                                      halfY * (dist(gen) * 2.0f - 1.0f);
+                const auto dir = glm::normalize(startPos - u._camPos);
+
+                for (auto s = 0.0f; s < distance; s += 0.002f)
+                {
+                    const auto value =
+                        MetaballField(u, startPos + dir * s, false)._value;
+
+                    if (kernel == MetaballKernel::SMOOTH_MIN)
+                        ASSERT_GT(value, 0.0f);
+                    else
+                        ASSERT_LT(value, METABALL_THRESHOLD);
+                }
+            }
+        }
+
+        EXPECT_GT(total, 0.0f);
+    }
+}
+
+TEST(CpuShader, SphereTracing)
+{
+    ObjectArray objects(ObjectLayout::SOA);
+    CreateTestScene(objects, 10);
+
+    auto settings    = GetTestSettings(0);
+    settings._kernel = MetaballKernel::SMOOTH_MIN;
+
+    auto u    = GetTestUniforms(objects);
+    u._kernel = MetaballKernel::SMOOTH_MIN;
+    GetFieldBounds(objects, settings, u._boundsMin, u._boundsMax);
+
+    std::mt19937                          gen(9);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    // sphere tracing relies on the field being a distance bound
+    for (auto i = 0; i < 1000; ++i)
+    {
+        const glm::vec3 a(dist(gen) * 2.0f, dist(gen), dist(gen) - 1.0f);
+        const auto b = a + glm::vec3(dist(gen), dist(gen), dist(gen)) * 0.2f;
+
+        const auto fa = MetaballField(u, a, false)._value;
+        const auto fb = MetaballField(u, b, false)._value;
+        EXPECT_LE(std::fabs(fa - fb), glm::length(a - b) * 1.0001f + 1e-6f);
+    }
+
+    auto hits   = 0;
+    auto missed = 0;
+
+    for (auto i = 0; i < 500; ++i)
+    {
+        // primary ray of volume_body.glsl
+        const glm::vec3 camPos(0.0f, 0.0f, 2.0f);
+        const glm::vec3 startPos(dist(gen) * 2.0f, dist(gen), 0.0f);
+        const auto sampleStep = glm::normalize(startPos - camPos) * 0.01f;
+
+        const auto res = SampleToSurface(u, startPos, sampleStep, 200);
+
+        // reference: fine linear walk
+        auto inside = false;
+        auto pos    = startPos;
+        for (auto k = 1; k <= 20000 && inside == false; ++k)
+        {
+            pos    = startPos + sampleStep * (float(k) * 0.01f);
+            inside = MetaballField(u, pos, false)._value <= 0.0f;
+        }
+
+        // grazing rays may run out of steps
+        if (inside != res._inside)
+        {
+            missed++;
+            continue;
+        }
+
+        if (inside == false)
+            continue;
+
+        // grazing rays stop up to SDF_HIT_DISTANCE / cos(angle) early
+        hits++;
+        EXPECT_LT(glm::length(res._pos - pos), glm::length(sampleStep) * 2.0f);
+    }
+
+    EXPECT_GT(hits, 0);
+    EXPECT_LE(missed, 5);
+}
+
+TEST(ObjectArray, Layout)
+{
+    ObjectArray aos(ObjectLayout::AOS);
+    ObjectArray soa(ObjectLayout::SOA, 4);
+
+    // exceeds the reserved capacity of the SOA array
+    CreateTestScene(aos, 6);
+    CreateTestScene(soa, 6);
+
+    EXPECT_EQ(soa.GetObjectCount(), 6u);
+    EXPECT_EQ(soa.GetStride() % SIMD_WIDTH, 0u);
+    EXPECT_EQ(soa.GetPositionData(), nullptr);
+    EXPECT_EQ(aos.GetComponentData(ObjectComponent::X)._data, nullptr);
+
+    const auto* pos    = aos.GetPositionData();
+    const auto* colors = aos.GetColorData();
+
+    for (auto c = 0u; c < OBJECT_COMPONENT_COUNT; ++c)
+    {
+        const auto span = soa.GetComponentData(ObjectComponent(c));
+        EXPECT_EQ(span._size, 6u);
+        EXPECT_EQ(size_t(span._data) % SIMD_ALIGNMENT, 0u);
+
+        for (auto i = 0u; i < span._size; ++i)
+        {
+            const auto& ref = c < 3 ? pos[i][c] : colors[i][c - 3];
+            EXPECT_EQ(span._data[i], ref);
+        }
+    }
+
+    CpuRenderer renderer;
+    ASSERT_TRUE(renderer.Init());
+
+    const auto width  = 32u;
+    const auto height = 18u;
+
+    std::vector<float> imageAos(width * height * 4);
+    std::vector<float> imageSoa(width * height * 4);
+
+    const auto settings = GetTestSettings(0);
+    EXPECT_TRUE(
+        renderer.Render(aos, settings, 99.0f, width, height, &imageAos[0]));
+    EXPECT_TRUE(
+        renderer.Render(soa, settings, 99.0f, width, height, &imageSoa[0]));
+
+    EXPECT_EQ(imageAos, imageSoa);
+}
+
+TEST(ObjectArray, MaxObjectCount)
+{
+    ObjectArray objects(ObjectLayout::SOA, 1);
+    objects.SetMaxObjectCount(40);
+
+    // grows past the initial capacity up to the limit
+    for (auto i = 0; i < 40; ++i)
+        EXPECT_TRUE(objects.AddObject());
+
+    EXPECT_FALSE(objects.AddObject());
+    EXPECT_EQ(objects.GetObjectCount(), 40u);
+    EXPECT_EQ(objects.GetStride(), GetPaddedCount(40));
+    EXPECT_EQ(objects.GetSoAData()._size,
+              objects.GetStride() * OBJECT_COMPONENT_COUNT);
+}
+
+TEST(FastMath, SinCos)
+{
+    auto maxError = 0.0f;
+
+    for (auto x = -FAST_SINCOS_RANGE; x <= FAST_SINCOS_RANGE; x += 0.37f)
+    {
+        float s, c;
+        FastSinCos(x, s, c);
+
+        maxError = std::max(maxError, std::fabs(s - std::sin(x)));
+        maxError = std::max(maxError, std::fabs(c - std::cos(x)));
+    }
+
+    EXPECT_LT(maxError, FAST_SINCOS_TOLERANCE);
+}
+
+TEST(ObjectArray, Animation)
+{
+    const auto count = 100;
+
+    // the scalar animation of the original demo
+    std::vector<glm::vec3> pos(count, glm::vec3(0.0f));
+    std::vector<glm::vec3> colors(count);
+    const glm::vec3        user(0.5f, 0.3f, Z_POS);
+
+    for (auto step = 0; step < 200; ++step)
+    {
+        for (auto i = 0; i < count; ++i)
+        {
+            const auto hue = std::fmod(180.0f + 360.0f / count * i, 360.0f);
+            colors[i] = glm::rgbColor(glm::vec3(hue, 1.0f, 1.0f));
+
+            const auto distance = user - pos[i];
+            if (glm::length(distance) < 0.2f)
+            {
+                pos[i] += distance * 0.5f;
+                continue;
+            }
+
+            const auto offset = step * .01f + 6.28f / float(count) * i;
+            const glm::vec3 target(std::sin(offset) * 2.0f,
+                                   std::cos(offset) * 0.7f + 0.25f, Z_POS);
+            pos[i] += (target - pos[i]) * 0.1f;
+        }
+    }
+
+    for (auto layout : {ObjectLayout::AOS, ObjectLayout::SOA})
+    {
+        ObjectArray objects(layout);
+        for (auto i = 0; i < count; ++i)
+            objects.AddObject();
+
+        objects.SetDynamicObject(user.x, user.y);
+
+        for (auto step = 0; step < 200; ++step)
+            objects.Animation(float(step));
+
+        for (auto i = 0; i < count; ++i)
+        {
+            const auto p = objects.GetPosition(i);
+            const auto c = objects.GetColor(i);
+
+            for (auto a = 0; a < 3; ++a)
+            {
+                EXPECT_NEAR(p[a], pos[i][a], 1e-4f);
+                EXPECT_NEAR(c[a], colors[i][a], 1e-4f);
+            }
+        }
+    }
+
+    // the chunks of the threads give the result of a single thread
+    const auto manyCount = int(ANIMATION_CHUNK_SIZE) * 2 + 5;
+
+    ObjectArray single(ObjectLayout::SOA);
+    ObjectArray multi(ObjectLayout::SOA);
+    multi.SetThreadCount(4);
+
+    for (auto i = 0; i < manyCount; ++i)
+    {
+        single.AddObject();
+        multi.AddObject();
+    }
+
+    for (auto step = 0; step < 3; ++step)
+    {
+        single.Animation(float(step));
+        multi.Animation(float(step));
+    }
+
+    for (auto c = 0u; c < OBJECT_COMPONENT_COUNT; ++c)
+    {
+        const auto a = single.GetComponentData(ObjectComponent(c));
+        const auto b = multi.GetComponentData(ObjectComponent(c));
+        ASSERT_EQ(a._size, b._size);
+        EXPECT_TRUE(std::equal(a._data, a._data + a._size, b._data));
+    }
+}
+
 int main(int argc, char** argv)
 {
     testing::InitGoogleTest(&argc, argv);